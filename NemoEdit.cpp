@@ -28,12 +28,13 @@ NemoEdit::NemoEdit()
       m_lineSpacing(5),
 	  m_margin({ 5, 15, 5, 0 }),
       m_lineHeight(0), m_charWidth(0),
-	  m_scrollX(0), m_scrollYLine(0), m_scrollYWrapLine(0),
+	  m_scrollX(0), m_scrollYLine(0), m_scrollYWrapLine(0), m_scrollRows(0),
       m_nextDiffNum(0),
 	  m_isUseScrollCtrl(FALSE), m_showScrollBars(FALSE),
 	  m_tabSize(4), m_maxWidth(0), m_numberAreaWidth(0),
       m_lastClickTime(0), m_clickCount(0)
-    , m_imeWidth(0)
+    , m_imeWidth(0), m_cutFirst(0), m_cutCount(0), m_cutChars(0), m_cutClipSeq(0)
+    , m_measurer(&m_d2Render), m_lineWidthNext(0), m_lineStepNext(0), m_wrapCacheBytes(0), m_wrapCacheWidth(0), m_wrapKeysEdits(0), m_rewrapPending(false), m_rewrapSkipped(0), m_rewrapFailed(false), m_readFailed(false)
  {
     // 텍스트 라인 관련
     m_rope.insert(0, L"");
@@ -69,6 +70,9 @@ NemoEdit::NemoEdit()
 
 // 소멸자
 NemoEdit::~NemoEdit() {
+    // 백그라운드 워드랩이 Rope 스냅샷과 텍스트 포맷을 쓰는 중일 수 있으므로 먼저 멈추고 스레드가 끝날 때까지 기다림
+    m_rewrap.Cancel();
+    m_rewrap.Wait();
     // D2Render 정리
     m_d2Render.Shutdown();
 }
@@ -153,14 +157,18 @@ BEGIN_MESSAGE_MAP(NemoEdit, CWnd)
     ON_MESSAGE(WM_IME_COMPOSITION, OnImeComposition)
     ON_MESSAGE(WM_IME_CHAR, OnImeChar)
     ON_MESSAGE(WM_IME_ENDCOMPOSITION, OnImeEndComposition)
+    ON_MESSAGE(WM_NEMO_REWRAP, OnRewrapProgress)
+    ON_MESSAGE(WM_NEMO_READERROR, OnReadError)
+    ON_WM_RENDERFORMAT()
+    ON_WM_RENDERALLFORMATS()
+    ON_WM_DESTROYCLIPBOARD()
     ON_WM_LBUTTONDBLCLK()
 END_MESSAGE_MAP()
 
 
 int NemoEdit::GetLineWidth(int lineIndex) {
-    std::wstring line = m_rope.getLine(lineIndex);
-    line = ExpandTabs(line);
-    return GetTextWidth(line);
+    if (m_rope.getLineSize(lineIndex) >= LONG_LINE_MIN) return GetLineStepWidths(lineIndex).back();
+    return GetTextWidth(ExpandTabs(m_rope.getLineView(lineIndex)));
 }
 
 // 현재 화면에 표시되는 라인 중 가장 긴 라인의 너비를 계산
@@ -206,6 +214,7 @@ int NemoEdit::OnCreate(LPCREATESTRUCT lpCreateStruct) {
 
 // 폰트 변경 (LOGFONT 사용) : font 변경 메인 코어
 void NemoEdit::ApplyFont() {
+    ClearWidthCaches();
     m_lineHeight = m_d2Render.GetLineHeight() + m_lineSpacing;
     m_charWidth = GetTextWidth(L"080")-GetTextWidth(L"08"); // 공백 문자 너비로 대체
     m_imeWidth = GetTextWidth(L"한");
@@ -235,6 +244,7 @@ void NemoEdit::GetFont(std::wstring& fontName, int& fontSize, bool& bold, bool&
 
 void NemoEdit::SetTabSize(int size) {
     m_tabSize = size;
+    ClearWidthCaches();
     RecalcScrollSizes();
     Invalidate(FALSE);
 }
@@ -266,6 +276,7 @@ void NemoEdit::SetWordWrap(bool enable) {
     else {
         NemoShowScrollBar(SB_HORZ, TRUE);
     }
+    RequestRewrap(); // 켜면 문서 전체를 다시 세고, 끄면 진행 중인 작업을 멈춤
     RecalcScrollSizes();
     Invalidate(FALSE);
 }
@@ -351,22 +362,18 @@ void NemoEdit::SetText(const std::wstring& text) {
     SetRedraw(FALSE);
     ClearText();
 
-    // 개행 기준으로 문자열 파싱
-    std::list<std::wstring> lines;
-    SplitTextByNewlines((std::wstring & )text, lines);
-
-    if (lines.empty()) {
-        lines.push_back(L"");
-    }
+    // 개행 기준으로 문자열 파싱 (빈 텍스트도 빈 라인 하나)
+    TextLines lines;
+    SplitTextByNewlines(text, lines);
 
-    // SPLIT_THRESHOLD 값을 넘는 경우 insertMultiple 사용
-    if (lines.size() > SPLIT_THRESHOLD) {
-        m_rope.insertMultiple(0, lines);
+    // 리프 하나의 줄수를 넘는 경우 insertMultiple 사용
+    if (lines.size() > m_rope.getLimits().splitLines) {
+        m_rope.insertMultiple(0, lines, 0, lines.size());
     }
     else {
         // 적은 양의 텍스트는 개별 삽입
-        for (const auto& line : lines) {
-            m_rope.insertBack(line);
+        for (size_t i = 0; i < lines.size(); i++) {
+            m_rope.insertBack(lines.lineView(i));
         }
     }
 
@@ -384,11 +391,78 @@ void NemoEdit::SetText(const std::wstring& text) {
     HideIME();
 }
 
+// 파일을 메모리 맵으로 열어서 설정 ( 전체를 읽지 않고 화면 등에서 접근하는 부분만 디코딩 )
+bool NemoEdit::LoadFile(const std::wstring& path) {
+    // 화면 갱신 일시 중지
+    SetRedraw(FALSE);
+    ClearText();
+
+    bool result = m_rope.loadFile(path);
+    if (!result) {
+        m_rope.insertBack(L"");
+    }
+
+    // 최대 라인 사이즈 초기화
+    m_maxWidth = 0;
+
+    // Undo/Redo 스택 초기화
+    m_undoStack.clear();
+    m_redoStack.clear();
+
+    m_caretPos = TextPos(0, 0);
+    EnsureCaretVisible();
+    SetRedraw(TRUE);
+    RedrawWindow(NULL, NULL, RDW_INVALIDATE | RDW_UPDATENOW | RDW_ALLCHILDREN);
+    HideIME();
+    return result;
+}
+
 // 에디터 전체 텍스트 얻기 ('\n'으로 구분)
 std::wstring NemoEdit::GetText() {
 	return m_rope.getText();
 }
 
+// 스냅샷은 O(1)이며 이후 편집은 공유 노드를 복사해서 진행하므로, 다른 스레드에서 저장/검색하는 동안에도 편집할 수 있다.
+std::shared_ptr<const RopeSnapshot> NemoEdit::GetSnapshot() {
+    return m_rope.snapshot();
+}
+
+// 큰 문서를 주로 읽기만 할 때 메모리를 줄인다. 최근 접근한 hotLeaves개 리프만 풀어두고 나머지는 압축한다. (0이면 끔)
+void NemoEdit::SetColdCompression(size_t hotLeaves) {
+    m_rope.setColdCompression(hotLeaves);
+}
+
+RopePackStats NemoEdit::GetCompressionStats() {
+    return m_rope.getPackStats();
+}
+
+// 메모리보다 큰 문서를 편집할 때 사용한다. 원본 파일로 연 부분은 처음부터 메모리에 올라오지 않으므로 예산은 고친 리프들에 대한 것이다.
+void NemoEdit::SetSwapBudget(size_t budgetBytes) {
+    m_rope.setSwapBudget(budgetBytes);
+}
+
+RopeSwapStats NemoEdit::GetSwapStats() {
+    return m_rope.getSwapStats();
+}
+
+// 같은 내용의 라인이 많은 로그를 열기 전에 켠다. 이미 들어 있는 라인은 바꾸지 않는다.
+void NemoEdit::SetLineInterning(bool enable) {
+    m_rope.setLineInterning(enable);
+}
+
+RopeInternStats NemoEdit::GetInternStats() {
+    return m_rope.getInternStats();
+}
+
+void NemoEdit::SetTextMeasurer(TextMeasurer* measurer) {
+    m_measurer = measurer ? measurer : &m_d2Render;
+    if (m_hWnd) ApplyFont(); // 줄 높이 외의 폭 정보를 새 구현으로 다시 잰다.
+}
+
+void NemoEdit::SetRopeLimits(const RopeLimits& limits) {
+    m_rope.setLimits(limits);
+}
+
 void NemoEdit::AddText(std::wstring text) {
     // 라인이 없는 경우 SetText 호출 (텍스트 초기화)
     if (m_rope.getSize() == 0) {
@@ -397,14 +471,9 @@ void NemoEdit::AddText(std::wstring text) {
     }
 
     // 개행 기준으로 문자열 파싱
-    std::list<std::wstring> lines;
+    TextLines lines;
     SplitTextByNewlines(text, lines);
 
-    // 텍스트가 없으면 종료
-    if (lines.empty()) {
-        return;
-    }
-
     // 추가 위치는 마지막 라인 다음 (마지막 라인의 인덱스 + 1)
     int insertIndex = (int)m_rope.getSize();
 
@@ -414,16 +483,16 @@ void NemoEdit::AddText(std::wstring text) {
     //rec.start = TextPos(insertIndex, 0);
     //rec.text = text;  // 원본 텍스트 그대로 저장
 
-    size_t endColumn = lines.back().length(); // lines가 insert 후에 사라지기 때문에 그전에 값을 얻어놓음.
+    size_t endColumn = lines.lineLen(lines.size() - 1);
 
-    // SPLIT_THRESHOLD 값을 넘는 경우 insertMultiple 사용
-    if (lines.size() > SPLIT_THRESHOLD) {
-        m_rope.insertMultiple(insertIndex, lines);
+    // 리프 하나의 줄수를 넘는 경우 insertMultiple 사용
+    if (lines.size() > m_rope.getLimits().splitLines) {
+        m_rope.insertMultiple(insertIndex, lines, 0, lines.size());
     }
     else {
         // 적은 양의 텍스트는 개별 삽입
-        for (const auto& line : lines) {
-            m_rope.insert(insertIndex++, line);
+        for (size_t i = 0; i < lines.size(); i++) {
+            m_rope.insert(insertIndex++, lines.lineView(i));
         }
     }
 
@@ -447,7 +516,17 @@ void NemoEdit::AddText(std::wstring text) {
 }
 
 void NemoEdit::ClearText() {
+    // 떼어낸 라인들은 clear() 뒤에는 반환할 수 없으므로 들고 있는 레코드를 먼저 놓는다. (클립보드 텍스트는 m_cutSnap에서 계속 만듦)
+    m_undoStack.clear();
+    m_redoStack.clear();
+    m_cutLines.reset();
+    m_rewrap.Cancel();
+    m_rewrap.Wait(); // 멈춘 작업의 스냅샷이 비울 스왑 파일과 원본 파일을 읽고 있을 수 있음
+    m_rewrapHeld.clear();
     m_rope.clear();
+    m_rewrapFailed = false; // 실패는 이전 문서의 스왑 파일이나 크기 때문일 수 있으므로 새 문서는 다시 시도
+    m_readFailed = false; // 새 문서의 스왑 파일은 새로 만듦
+    RequestRewrap(); // 새로 채운 내용을 이어서 셈 (LoadFile 등)
     m_nextDiffNum = 0; // numLineArea 재계산
     m_caretPos = TextPos(0, 0);
     m_scrollX = 0;
@@ -461,30 +540,12 @@ void NemoEdit::ClearText() {
 }
 
 // Tab 문자를 주어진 크기의 공백으로 변환하는 함수
-std::wstring NemoEdit::ExpandTabs(const std::wstring& text) {
-    // 결과를 저장할 문자열
-    std::wstring result;
-    result.reserve(text.length() * 2);
-    // 탭용 공백 문자열을 미리 한 번만 생성
-    const std::wstring tabSpaces(m_tabSize, L' ');
-
-    // 입력 문자열을 순회하며 탭을 공백으로 변환
-    for (size_t i = 0; i < text.length(); ++i) {
-        if (text[i] == L'\t') {
-            // 탭 문자 발견 시 지정된 수의 공백 추가
-            result.append(tabSpaces);
-        }
-        else {
-            // 일반 문자는 그대로 복사
-            result.push_back(text[i]);
-        }
-    }
-
-    return result;
+std::wstring NemoEdit::ExpandTabs(std::wstring_view text) {
+    return LineLayout::ExpandTabs(text, m_tabSize);
 }
 
 // Tab 문자의 개수를 카운팅
-int NemoEdit::TabCount(const std::wstring& text, int endPos) {
+int NemoEdit::TabCount(std::wstring_view text, int endPos) {
     int endCnt = min(endPos, text.length());
     int tabCnt = 0;
     // 입력 문자열을 순회하며 탭을 공백으로 변환
@@ -584,7 +645,7 @@ bool NemoEdit::IsWordDelimiter(wchar_t ch) {
 }
 
 // 특정 위치의 단어 경계 찾기 (단순화 버전)
-void NemoEdit::FindWordBoundary(const std::wstring& text, int position, int& start, int& end) {
+void NemoEdit::FindWordBoundary(std::wstring_view text, int position, int& start, int& end) {
     int length = static_cast<int>(text.length());
 
     // 빈 문자열이거나 범위를 벗어난 경우
@@ -739,13 +800,43 @@ NemoEdit::UndoRecord NemoEdit::CreateReplaceRecord(const TextPos& start, const T
     return record;
 }
 
+// Move 레코드 생성
+NemoEdit::UndoRecord NemoEdit::CreateMoveRecord(int lineIndex, int count, int to) {
+    UndoRecord record;
+    record.type = UndoRecord::Move;
+    record.start = TextPos(lineIndex, 0);           // 옮길 구간 시작 라인 (작업 전)
+    record.end = TextPos(lineIndex + count, 0);     // 옮길 구간 끝 라인 (작업 전, 미포함)
+    record.startAfter = TextPos(to, 0);             // 옮겨 넣을 라인 (구간을 떼어낸 뒤 기준)
+    SaveCurrentState(record);
+    return record;
+}
+
+// 라인 단위 잘라내기/붙여넣기 레코드 생성 : 텍스트 대신 [lineIndex, lineIndex + count) 라인과 그 라인들을 담을 lines를 기억
+NemoEdit::UndoRecord NemoEdit::CreateLinesRecord(UndoRecord::Type type, int lineIndex, int count, const std::shared_ptr<CutLines>& lines) {
+    UndoRecord record;
+    record.type = type;
+    record.start = TextPos(lineIndex, 0);           // 구간 시작 라인
+    record.end = TextPos(lineIndex + count, 0);     // 구간 끝 라인 (미포함)
+    record.lines = lines;
+    SaveCurrentState(record);
+    return record;
+}
+
+// 라인들은 문서와 record.lines 중 한 곳에만 있으므로, Undo/Redo 순서대로라면 떼어낼 때 record.lines는 비어 있다.
+void NemoEdit::DetachCutLines(const UndoRecord& record) {
+    m_rope.releaseLines(record.lines->slice);
+    record.lines->slice = m_rope.detachLines(record.start.lineIndex, record.end.lineIndex - record.start.lineIndex);
+}
+
+void NemoEdit::SpliceCutLines(const UndoRecord& record) {
+    m_rope.spliceLines(record.start.lineIndex, record.lines->slice);
+}
+
 // 지정된 범위의 텍스트 삭제 (Undo/Redo용)
 void NemoEdit::DeleteSelectionRange(const TextPos& start, const TextPos& end) {
     if (start.lineIndex == end.lineIndex) {
         // 한 라인 내 삭제
-        std::wstring text = m_rope.getLine(start.lineIndex);
-        text.erase(start.column, end.column - start.column);
-        m_rope.update(start.lineIndex, text);
+        m_rope.eraseAt(start.lineIndex, start.column, end.column - start.column);
     }
     else {
         // 여러 라인 삭제
@@ -761,39 +852,28 @@ void NemoEdit::DeleteSelectionRange(const TextPos& start, const TextPos& end) {
 
 // 지정된 위치에 텍스트 삽입 (Undo/Redo용)
 void NemoEdit::InsertTextAt(const TextPos& pos, std::wstring& text) {
-    std::list<std::wstring> parts;
+    TextLines parts;
     SplitTextByNewlines(text, parts);
+    size_t partCnt = parts.size();
 
-    if (parts.size() == 1) {
+    if (partCnt == 1) {
         // 단일 텍스트 삽입
-        m_rope.insertAt(pos.lineIndex, pos.column, parts.front());
+        m_rope.insertAt(pos.lineIndex, pos.column, text);
     }
     else {
-        // 여러 라인 텍스트 삽입
-        std::wstring currentLine = m_rope.getLine(pos.lineIndex);
-        std::wstring headText = currentLine.substr(0, pos.column);
-        std::wstring tailText = currentLine.substr(pos.column);
-
-        // 첫 번째 라인과 마지막 라인은 기존 텍스트와 결합
-        parts.front() = headText + parts.front();
-        parts.back() += tailText;
+        // 여러 라인 텍스트 삽입 : 삽입 위치에서 라인을 나누고 첫 번째 라인과 마지막 라인은 양쪽에 붙인다.
+        m_rope.splitLine(pos.lineIndex, pos.column);
+        m_rope.insertAt(pos.lineIndex, pos.column, parts.lineView(0));
+        m_rope.insertAt(pos.lineIndex + 1, 0, parts.lineView(partCnt - 1));
 
-        // 첫 번째 라인 업데이트
-        m_rope.update(pos.lineIndex, parts.front());
-
-        // 나머지 라인들 삽입 - SPLIT_THRESHOLD 조건 적용
-        if (parts.size() - 1 > SPLIT_THRESHOLD) {
-            parts.pop_front();
-            m_rope.insertMultiple(pos.lineIndex + 1, parts);
+        // 중간 라인들 삽입 - 리프 하나의 줄수를 넘으면 insertMultiple
+        if (partCnt - 1 > m_rope.getLimits().splitLines) {
+            m_rope.insertMultiple(pos.lineIndex + 1, parts, 1, partCnt - 2);
         }
         else {
-            // 소량 삽입 시 개별 삽입 (첫 번째 라인 제외)
-            auto it = parts.begin();
-            if (!parts.empty()) ++it;
-            for (size_t i = 1; i < parts.size(); ++it, ++i) {
-                if (it != parts.end()) {
-                    m_rope.insert(pos.lineIndex + i, *it);
-                }
+            // 소량 삽입 시 개별 삽입
+            for (size_t i = 1; i + 1 < partCnt; i++) {
+                m_rope.insert(pos.lineIndex + i, parts.lineView(i));
             }
         }
     }
@@ -827,6 +907,39 @@ void NemoEdit::Cut() {
     }
 
     try {
+        // 라인 단위로 맞춰진 큰 선택은 라인들을 복사 없이 떼어내서 들고 있다가 붙여넣기에 그대로 쓴다.
+        TextPos start = m_selectInfo.start;
+        TextPos end = m_selectInfo.end;
+        if (end.lineIndex < start.lineIndex ||
+            (end.lineIndex == start.lineIndex && end.column < start.column)) {
+            start = m_selectInfo.end;
+            end = m_selectInfo.start;
+        }
+        size_t lineCnt = end.lineIndex - start.lineIndex;
+        // 클립보드 텍스트는 지연 렌더링으로 등록만 하고, 붙여넣기 전에 요청받으면 잘라내기 직전 스냅샷에서 만든다.
+        if (start.column == 0 && end.column == 0 && lineCnt > m_rope.getLimits().splitLines && SaveClipBoardDelayed()) {
+            m_cutSnap = m_rope.snapshot();
+            m_cutFirst = start.lineIndex;
+            m_cutCount = lineCnt;
+            m_cutChars = m_rope.offsetFromPos(end.lineIndex, 0) - m_rope.offsetFromPos(start.lineIndex, 0);
+            m_cutClipSeq = GetClipboardSequenceNumber();
+
+            m_cutLines = std::make_shared<CutLines>(m_rope);
+            UndoRecord record = CreateLinesRecord(UndoRecord::Delete, start.lineIndex, (int)lineCnt, m_cutLines);
+            DetachCutLines(record);
+
+            m_caretPos = start;
+            m_selectInfo.start = m_selectInfo.end = m_selectInfo.anchor = m_caretPos;
+            m_selectInfo.isSelected = false;
+            m_selectInfo.isSelecting = false;
+            AddUndoRecord(record);
+
+            EnsureCaretVisible();
+            RecalcScrollSizes();
+            Invalidate(FALSE);
+            return;
+        }
+
         // 먼저 클립보드에 복사
         Copy();
 
@@ -843,12 +956,59 @@ void NemoEdit::Cut() {
 void NemoEdit::Paste() {
     if (m_isReadOnly) return;
 
+    // Cut으로 떼어낸 라인들이 아직 클립보드 내용이면 클립보드를 읽지 않고 라인 시작 위치에 그대로 끼운다.
+    if (m_cutLines && m_cutLines->slice.root && GetClipboardSequenceNumber() == m_cutClipSeq &&
+        !m_selectInfo.isSelected && m_caretPos.column == 0) {
+        int lineCnt = (int)m_cutLines->slice.lines;
+        UndoRecord record = CreateLinesRecord(UndoRecord::Insert, m_caretPos.lineIndex, lineCnt, m_cutLines);
+        SpliceCutLines(record);
+
+        m_caretPos.lineIndex += lineCnt;
+        m_selectInfo.start = m_selectInfo.end = m_selectInfo.anchor = m_caretPos;
+        AddUndoRecord(record);
+
+        EnsureCaretVisible();
+        RecalcScrollSizes();
+        Invalidate(FALSE);
+        return;
+    }
+
     std::wstring clipText = LoadClipText();
     if (clipText.empty()) return;
 
     ReplaceSelection(clipText);
 }
 
+// 캐럿 라인(선택 영역이 있으면 걸친 라인들)을 한 줄 위/아래로 이동 : 이웃 라인 하나를 반대편으로 옮긴다.
+// 옮기는 것은 늘 한 줄이므로 Rope::moveLines의 복사 경로를 탄다. (서브트리를 떼어내고 끼우는 경로는 큰 라인 단위 Cut/Paste에서만 씀)
+void NemoEdit::MoveSelectedLines(bool up) {
+    if (m_isReadOnly) return;
+
+    int first = m_caretPos.lineIndex;
+    int last = first;
+    if (m_selectInfo.isSelected) {
+        first = min(m_selectInfo.start.lineIndex, m_selectInfo.end.lineIndex);
+        last = max(m_selectInfo.start.lineIndex, m_selectInfo.end.lineIndex);
+        // 선택이 라인 시작에서 끝나면 그 라인은 포함하지 않는다.
+        TextPos selEnd = (m_selectInfo.start.lineIndex > m_selectInfo.end.lineIndex) ? m_selectInfo.start : m_selectInfo.end;
+        if (last > first && selEnd.lineIndex == last && selEnd.column == 0) last--;
+    }
+    if (up ? first == 0 : last + 1 >= (int)m_rope.getSize()) return;
+
+    UndoRecord record = up ? CreateMoveRecord(first - 1, 1, last) : CreateMoveRecord(last + 1, 1, first);
+    m_rope.moveLines(record.start.lineIndex, 1, record.startAfter.lineIndex);
+
+    int delta = up ? -1 : 1;
+    m_caretPos.lineIndex += delta;
+    m_selectInfo.start.lineIndex += delta;
+    m_selectInfo.end.lineIndex += delta;
+    m_selectInfo.anchor.lineIndex += delta;
+    AddUndoRecord(record);
+
+    EnsureCaretVisible();
+    Invalidate(FALSE);
+}
+
 // Undo 실행
 void NemoEdit::Undo() {
     if (m_undoStack.empty() || m_isReadOnly) return;
@@ -865,15 +1025,25 @@ void NemoEdit::Undo() {
     // 작업 타입별 처리
     switch (record.type) {
     case UndoRecord::Insert: {
+        if (record.lines) {
+            // 붙여넣은 라인들을 다시 떼어냄
+            DetachCutLines(record);
+            redoRecord.start = record.start;
+            redoRecord.end = record.end;
+            redoRecord.lines = record.lines;
+            break;
+        }
+
         // Insert 취소: 삽입된 텍스트 제거
-        std::list<std::wstring> parts;
+        TextLines parts;
         SplitTextByNewlines(record.text, parts);
 
+        size_t lastLen = parts.lineLen(parts.size() - 1);
         TextPos end;
         if (parts.size() == 1) 
-             end = TextPos(record.start.lineIndex + (int)parts.size() - 1, record.start.column+parts.back().length());
+             end = TextPos(record.start.lineIndex + (int)parts.size() - 1, record.start.column + lastLen);
         else 
-            end = TextPos(record.start.lineIndex + (int)parts.size() - 1, parts.back().length());
+            end = TextPos(record.start.lineIndex + (int)parts.size() - 1, lastLen);
         
         DeleteSelectionRange(record.start, end);
 
@@ -887,8 +1057,10 @@ void NemoEdit::Undo() {
         redoRecord.start = record.start;
         redoRecord.end = record.end;
         redoRecord.text = record.text;
+        redoRecord.lines = record.lines;
 
-        InsertTextAt(record.start, record.text);
+        if (record.lines) SpliceCutLines(record); // 잘라낸 라인들을 제자리에 끼움
+        else InsertTextAt(record.start, record.text);
         break;
     }
 
@@ -910,6 +1082,17 @@ void NemoEdit::Undo() {
         InsertTextAt(record.start, record.text);          // A 복원
         break;
     }
+
+    case UndoRecord::Move: {
+        // Move 취소: 옮겨진 라인들을 원래 위치로 되돌림
+        redoRecord.start = record.start;
+        redoRecord.end = record.end;
+        redoRecord.startAfter = record.startAfter;
+
+        int count = record.end.lineIndex - record.start.lineIndex;
+        m_rope.moveLines(record.startAfter.lineIndex, count, record.start.lineIndex);
+        break;
+    }
     }
 
     // 상태 복원
@@ -941,9 +1124,12 @@ void NemoEdit::Redo() {
     switch (record.type) {
     case UndoRecord::Insert: {
         // Insert 재실행
-        InsertTextAt(record.start, record.text);
+        if (record.lines) SpliceCutLines(record);
+        else InsertTextAt(record.start, record.text);
         undoRecord.start = record.start;
+        undoRecord.end = record.end;
         undoRecord.text = record.text;
+        undoRecord.lines = record.lines;
         break;
     }
 
@@ -952,7 +1138,9 @@ void NemoEdit::Redo() {
         undoRecord.start = record.start;
         undoRecord.end = record.end;
         undoRecord.text = record.text;
-        DeleteSelectionRange(record.start, record.end);
+        undoRecord.lines = record.lines;
+        if (record.lines) DetachCutLines(record);
+        else DeleteSelectionRange(record.start, record.end);
         break;
     }
 
@@ -972,6 +1160,17 @@ void NemoEdit::Redo() {
         InsertTextAt(record.start, record.text); // B복원
         break;
     }
+
+    case UndoRecord::Move: {
+        // Move 재실행
+        undoRecord.start = record.start;
+        undoRecord.end = record.end;
+        undoRecord.startAfter = record.startAfter;
+
+        int count = record.end.lineIndex - record.start.lineIndex;
+        m_rope.moveLines(record.start.lineIndex, count, record.startAfter.lineIndex);
+        break;
+    }
     }
 
     // 상태 복원
@@ -1002,7 +1201,7 @@ void NemoEdit::UpDown(int step) {
                 int currentColumn = m_caretPos.column;
 
                 // 현재 라인의 워드랩 정보 가져오기
-                auto wrapPositions = FindWordWrapPosition(currentLine);
+                const std::vector<int>& wrapPositions = FindWordWrapPosition(currentLine);
 
                 // 현재 커서가 어느 워드랩 줄에 있는지 결정
                 int currentWrapLine = 0;
@@ -1031,17 +1230,17 @@ void NemoEdit::UpDown(int step) {
                 else if (currentLine > 0) {
                     // 이전 메인 라인의 마지막 워드랩 줄로 이동
                     m_caretPos.lineIndex = currentLine - 1;
-                    auto prevLineIt = m_rope.getIterator(m_caretPos.lineIndex);
-                    auto prevWrapPositions = FindWordWrapPosition(m_caretPos.lineIndex);
+                    int prevLineSize = (int)m_rope.getLineSize(m_caretPos.lineIndex);
+                    const std::vector<int>& prevWrapPositions = FindWordWrapPosition(m_caretPos.lineIndex);
 
                     if (prevWrapPositions.empty()) {
                         // 이전 라인이 워드랩 없으면 원하는 컬럼으로 이동 (길이 제한)
-                        m_caretPos.column = min(oldPos.column, (int)prevLineIt->size());
+                        m_caretPos.column = min(oldPos.column, prevLineSize);
                     }
                     else {
                         // 이전 라인의 마지막 워드랩 줄로 이동
                         int lastWrapStartCol = prevWrapPositions.back();
-                        m_caretPos.column = lastWrapStartCol + min(relativeCol, (int)prevLineIt->size() - lastWrapStartCol);
+                        m_caretPos.column = lastWrapStartCol + min(relativeCol, prevLineSize - lastWrapStartCol);
                     }
 
                     // 이미 첫 줄까지 도달했으면 더 이상 이동 안함
@@ -1064,10 +1263,10 @@ void NemoEdit::UpDown(int step) {
                 // 현재 커서 위치의 라인과 컬럼
                 int currentLine = m_caretPos.lineIndex;
                 int currentColumn = m_caretPos.column;
-                auto currentLineIt = m_rope.getIterator(currentLine);
+                int currentLineSize = (int)m_rope.getLineSize(currentLine);
 
                 // 현재 라인의 워드랩 정보 가져오기
-                auto wrapPositions = FindWordWrapPosition(currentLine);
+                const std::vector<int>& wrapPositions = FindWordWrapPosition(currentLine);
 
                 // 현재 커서가 어느 워드랩 줄에 있는지 결정
                 int currentWrapLine = 0;
@@ -1088,7 +1287,7 @@ void NemoEdit::UpDown(int step) {
                     // 같은 메인 라인의 다음 워드랩 줄로 이동
                     int nextWrapStartCol = wrapPositions[currentWrapLine];
                     int nextWrapEndCol = (currentWrapLine + 1 < wrapPositions.size()) ?
-                        wrapPositions[currentWrapLine + 1] : (int)currentLineIt->size();
+                        wrapPositions[currentWrapLine + 1] : currentLineSize;
                     int nextWrapWidth = nextWrapEndCol - nextWrapStartCol;
 
                     // 같은 상대적 위치로 이동하되, 다음 워드랩 줄의 길이 제한
@@ -1097,22 +1296,22 @@ void NemoEdit::UpDown(int step) {
                 else if (currentLine < (int)m_rope.getSize() - 1) {
                     // 다음 메인 라인의 첫 워드랩 줄로 이동
                     m_caretPos.lineIndex = currentLine + 1;
-                    auto nextLineIt = m_rope.getIterator(m_caretPos.lineIndex);
+                    int nextLineSize = (int)m_rope.getLineSize(m_caretPos.lineIndex);
 
                     // 다음 라인의 첫 워드랩 줄의 길이만큼 상대적 위치 제한
-                    auto nextWrapPositions = FindWordWrapPosition(m_caretPos.lineIndex);
-                    int nextWrapEndCol = nextWrapPositions.empty() ? (int)nextLineIt->size() : nextWrapPositions[0];
+                    const std::vector<int>& nextWrapPositions = FindWordWrapPosition(m_caretPos.lineIndex);
+                    int nextWrapEndCol = nextWrapPositions.empty() ? nextLineSize : nextWrapPositions[0];
 
                     m_caretPos.column = min(relativeCol, nextWrapEndCol);
 
                     // 이미 마지막 줄까지 도달했으면 더 이상 이동 안함
-                    if (m_caretPos.lineIndex == (int)m_rope.getSize() - 1 && m_caretPos.column == (int)nextLineIt->size()) {
+                    if (m_caretPos.lineIndex == (int)m_rope.getSize() - 1 && m_caretPos.column == nextLineSize) {
                         break;
                     }
                 }
                 else {
                     // 이미 마지막 줄, 마지막 워드랩이면 라인 끝으로
-                    m_caretPos.column = (int)currentLineIt->size();
+                    m_caretPos.column = currentLineSize;
                     break; // 더 이상 이동 불가
                 }
             }
@@ -1164,55 +1363,12 @@ void NemoEdit::UpDown(int step) {
     }
 }
 
-// 텍스트 분할
-void NemoEdit::SplitTextByNewlines(std::wstring& text, std::list<std::wstring>& parts) {
-    parts.clear();
-
-    size_t length = text.size();
-    size_t i = 0;
-    size_t start = 0;
-    const wchar_t* data = text.data();
-
-    // 단일 루프: \r\n, \r, \n 처리
-    while (i < length) {
-        if (data[i] == L'\r' || data[i] == L'\n') {
-            // \r\n 쌍 처리
-            if (data[i] == L'\r' && i + 1 < length && data[i + 1] == L'\n') {
-                if (i > start) {
-                    parts.push_back(text.substr(start, i - start));
-                }
-                else {
-                    parts.push_back(L"");
-                }
-                start = i + 2;
-                i += 2;
-            }
-            else {
-                // 독립된 \r 또는 \n
-                if (i > start) {
-                    parts.push_back(text.substr(start, i - start));
-                }
-                else {
-                    parts.push_back(L"");
-                }
-                start = i + 1;
-                i++;
-            }
-        }
-        else {
-            i++;
-        }
-    }
-
-    // 마지막 부분 처리
-    if (start < length) {
-        parts.push_back(text.substr(start));
-    }
-
-    // 텍스트가 비어 있거나 \n 또는 \r로 끝나는 경우 빈 줄 추가
-    if (parts.empty() || (length > 0 && (data[length - 1] == L'\n' || data[length - 1] == L'\r'))) {
-        parts.push_back(L"");
-    }
+// 텍스트 분할 : 라인 문자열을 만들지 않고 줄바꿈(\r\n, \r, \n) 위치만 한 번에 기록
+void NemoEdit::SplitTextByNewlines(const std::wstring& text, TextLines& lines) {
+    lines.text = text.data();
+    lines.length = text.size();
+    lines.breaks.clear();
+    LineScanner::scan(lines.text, lines.length, 0, lines.length, (size_t)-1, lines.breaks);
 }
 
 // 여러 줄 선택 시 탭 추가 처리 메서드
@@ -1242,11 +1398,8 @@ void NemoEdit::AddTabToSelectedLines() {
     UndoRecord record = CreateReplaceRecord(recordStart, recordEnd, recordStart, recordEnd, originalText);
 
     // 각 라인에 탭 추가
-    std::wstring tabStr(1, L'\t');
     for (int lineIdx = start.lineIndex; lineIdx <= end.lineIndex; lineIdx++) {
-        std::wstring line = m_rope.getLine(lineIdx);
-        line.insert(0, tabStr);
-        m_rope.update(lineIdx, line);
+        m_rope.insertAt(lineIdx, 0, L"\t");
     }
 
     record.endAfter.column = m_rope.getLineSize(end.lineIndex);  // 텝 추가 적용
@@ -1299,7 +1452,7 @@ void NemoEdit::RemoveTabFromSelectedLines() {
     std::vector<int> removedCounts(end.lineIndex - start.lineIndex + 1, 0);
 
     for (int lineIdx = start.lineIndex; lineIdx <= end.lineIndex; lineIdx++) {
-        std::wstring line = m_rope.getLine(lineIdx);
+        std::wstring_view line = m_rope.getLineView(lineIdx);
         if (!line.empty()) {
             if (line[0] == L'\t') {
                 removedCounts[lineIdx - start.lineIndex] = 1;
@@ -1328,9 +1481,7 @@ void NemoEdit::RemoveTabFromSelectedLines() {
     for (int lineIdx = start.lineIndex; lineIdx <= end.lineIndex; lineIdx++) {
         int removeCount = removedCounts[lineIdx - start.lineIndex];
         if (removeCount > 0) {
-            std::wstring line = m_rope.getLine(lineIdx);
-            line.erase(0, removeCount);
-            m_rope.update(lineIdx, line);
+            m_rope.eraseAt(lineIdx, 0, removeCount);
         }
     }
 
@@ -1399,12 +1550,7 @@ void NemoEdit::InsertNewLine() {
     // Undo 레코드 생성 (작업 전 상태)
     UndoRecord record = CreateInsertRecord(m_caretPos, L"\n");
 
-    std::wstring text = m_rope.getLine(m_caretPos.lineIndex);
-    std::wstring tail = text.substr(m_caretPos.column);
-    std::wstring chgText = text.substr(0, m_caretPos.column);
-
-    m_rope.update(m_caretPos.lineIndex, chgText);
-    m_rope.insert(m_caretPos.lineIndex + 1, tail);
+    m_rope.splitLine(m_caretPos.lineIndex, m_caretPos.column);
 
     // 캐럿 위치 업데이트
     m_caretPos.lineIndex += 1;
@@ -1452,8 +1598,8 @@ void NemoEdit::DeleteChar(bool backspace) {
         }
         else {
             // 일반 문자 삭제
-            std::wstring line = m_rope.getLine(m_caretPos.lineIndex);
-            std::wstring removeStr = line.substr(m_caretPos.column - 1, 1);
+            std::wstring_view line = m_rope.getLineView(m_caretPos.lineIndex);
+            std::wstring removeStr(line.substr(m_caretPos.column - 1, 1));
 
             // Undo 레코드 생성 (작업 전 상태)
             TextPos deleteStart(m_caretPos.lineIndex, m_caretPos.column - 1);
@@ -1484,8 +1630,8 @@ void NemoEdit::DeleteChar(bool backspace) {
         }
         else {
             // 일반 문자 삭제
-            std::wstring line = m_rope.getLine(m_caretPos.lineIndex);
-            std::wstring removeStr = line.substr(m_caretPos.column, 1);
+            std::wstring_view line = m_rope.getLineView(m_caretPos.lineIndex);
+            std::wstring removeStr(line.substr(m_caretPos.column, 1));
 
             // Undo 레코드 생성 (작업 전 상태)
             TextPos deleteStart = m_caretPos;
@@ -1531,9 +1677,7 @@ void NemoEdit::DeleteSelection() {
     // 실제 삭제 작업
     if (start.lineIndex == end.lineIndex) {
         // 한 라인 내 삭제
-        std::wstring text = m_rope.getLine(start.lineIndex);
-        text.erase(start.column, end.column - start.column);
-        m_rope.update(start.lineIndex, text);
+        m_rope.eraseAt(start.lineIndex, start.column, end.column - start.column);
     }
     else {
         // 여러 라인 삭제
@@ -1582,7 +1726,7 @@ void NemoEdit::ReplaceSelection(std::wstring text) {
             start.lineIndex, start.column, end.lineIndex, end.column);
 
         // B의 끝 위치 미리 계산
-        std::list<std::wstring> parts;
+        TextLines parts;
         SplitTextByNewlines(text, parts);
 
         TextPos bEndPos;
@@ -1590,7 +1734,7 @@ void NemoEdit::ReplaceSelection(std::wstring text) {
             bEndPos = TextPos(start.lineIndex, start.column + text.length());
         }
         else {
-            bEndPos = TextPos(start.lineIndex + parts.size() - 1, parts.back().length());
+            bEndPos = TextPos(start.lineIndex + parts.size() - 1, parts.lineLen(parts.size() - 1));
         }
 
         // 핵심: UndoRecord의 end를 B의 끝 위치로 저장
@@ -1622,7 +1766,7 @@ void NemoEdit::ReplaceSelection(std::wstring text) {
         InsertTextAt(m_caretPos, text);
 
         // 캐럿 위치 계산 (삽입된 텍스트의 끝)
-        std::list<std::wstring> parts;
+        TextLines parts;
         SplitTextByNewlines(text, parts);
 
         if (parts.size() == 1) {
@@ -1630,7 +1774,7 @@ void NemoEdit::ReplaceSelection(std::wstring text) {
         }
         else {
             m_caretPos.lineIndex += parts.size() - 1;
-            m_caretPos.column = parts.back().length();
+            m_caretPos.column = parts.lineLen(parts.size() - 1);
         }
     }
 
@@ -1643,102 +1787,268 @@ void NemoEdit::ReplaceSelection(std::wstring text) {
 
 // 최적화된 라인 너비 계산
 int NemoEdit::GetTextWidth(const std::wstring& line) {
-    int width= m_d2Render.GetTextWidth(line);
+    int width= m_measurer->GetTextWidth(line);
     if (width > m_maxWidth) m_maxWidth = width;
     return width;
 }
 
-// lineIndex: 라인 인덱스 - 다음줄이 시작되는 column의 위치들이 데이터에 저장
-std::vector<int> NemoEdit::FindWordWrapPosition(int lineIndex) {
-    std::vector<int> wrapPos;
-
-    std::wstring lineText = m_rope.getLine(lineIndex);
-    if (lineText.empty()) return {}; // 빈 줄일 경우 워드랩 필요 없음
-
-    const size_t LARGE_TEXT_THRESHOLD = 2048;
-
-    // 대용량 텍스트 처리 (1024자 이상)
-    if (lineText.length() > LARGE_TEXT_THRESHOLD) {
-        // 처음 200문자 샘플로 화면에 들어갈 수 있는 최대 문자 수 찾기
-        int sampleSize = min(200, (int)lineText.length());
-        std::wstring sampleText = lineText.substr(0, sampleSize);
-
-        int low = 1;
-        int high = sampleSize;
-        int maxCharsInLine = 1;
+// Rope를 고친 뒤에는 항목의 라인 번호를 수정 구간만큼 옮기고 고친 라인의 항목만 버리므로, 편집 경로마다 무효화하지 않아도 된다.
+// (라인 내용을 비교하지 않아 긴 라인도 O(1)로 찾음)
+const std::vector<int>& NemoEdit::GetLinePrefixWidths(int lineIndex) {
+    uint64_t edits = m_rope.getEditCount();
+    for (LineWidthCache& entry : m_lineWidths) {
+        if (entry.lineIndex < 0) continue;
+        if (entry.edits != edits) {
+            size_t line = (size_t)entry.lineIndex;
+            entry.lineIndex = m_rope.mapLine(entry.edits, line) ? (int)line : -1;
+            entry.edits = edits;
+        }
+        if (entry.lineIndex == lineIndex) return entry.prefix;
+    }
 
-        while (low <= high) {
-            int mid = (low + high) / 2;
+    LineWidthCache& entry = m_lineWidths[m_lineWidthNext];
+    m_lineWidthNext = (m_lineWidthNext + 1) % LINE_WIDTH_CACHE_SIZE;
+    entry.lineIndex = lineIndex;
+    entry.edits = edits;
 
-            std::wstring testText = sampleText.substr(0, mid);
-            std::wstring tabTestText = ExpandTabs(testText);
-            int testWidth = GetTextWidth(tabTestText);
+    std::wstring_view line = m_rope.getLineView(lineIndex);
+    m_expandBuf = ExpandTabs(line);
+    m_measurer->GetPrefixWidths(m_expandBuf, m_prefixBuf);
+    LineLayout::MapPrefixWidths(line, m_prefixBuf, m_tabSize, entry.prefix);
+    if (entry.prefix.back() > m_maxWidth) m_maxWidth = entry.prefix.back();
+    return entry.prefix;
+}
 
-            if (testWidth <= m_wordWrapWidth) {
-                maxCharsInLine = mid;
-                low = mid + 1;
-            }
-            else {
-                high = mid - 1;
-            }
+// 긴 라인을 통째로 펼치지 않도록 PAINT_STEP_CHARS 컬럼씩 구간 뷰로 읽어서 잰다. (고친 뒤 처음 그릴 때 한 번)
+// 구간 폭은 실수로 더해서 반올림 오차가 쌓이지 않게 한다.
+const std::vector<int>& NemoEdit::GetLineStepWidths(int lineIndex) {
+    uint64_t edits = m_rope.getEditCount();
+    for (LineStepWidths& entry : m_lineSteps) {
+        if (entry.lineIndex < 0) continue;
+        if (entry.edits != edits) {
+            size_t line = (size_t)entry.lineIndex;
+            entry.lineIndex = m_rope.mapLine(entry.edits, line) ? (int)line : -1;
+            entry.edits = edits;
         }
+        if (entry.lineIndex == lineIndex) return entry.steps;
+    }
 
-        // 찾은 최대 문자 수에서 5 빼기
-        int charsPerLine = maxCharsInLine - 10;
-        if (charsPerLine < 10) charsPerLine = 10; // 최소 10문자 보장
-
-        // 고정 크기로 분할
-        for (size_t pos = charsPerLine; pos < lineText.length(); pos += charsPerLine) {
-            wrapPos.push_back(min(pos, lineText.length()));
-        }
+    LineStepWidths& entry = m_lineSteps[m_lineStepNext];
+    m_lineStepNext = (m_lineStepNext + 1) % LINE_STEP_CACHE_SIZE;
+    entry.lineIndex = lineIndex;
+    entry.edits = edits;
+    entry.steps.assign(1, 0);
 
-        return wrapPos;
+    size_t lineLen = m_rope.getLineSize(lineIndex);
+    double width = 0;
+    for (size_t column = 0; column < lineLen; column += PAINT_STEP_CHARS) {
+        m_expandBuf = ExpandTabs(m_rope.getLineView(lineIndex, column, min((size_t)PAINT_STEP_CHARS, lineLen - column)));
+        m_measurer->GetPrefixWidths(m_expandBuf, m_prefixBuf);
+        width += m_prefixBuf.back();
+        entry.steps.push_back((int)width);
     }
+    if (entry.steps.back() > m_maxWidth) m_maxWidth = entry.steps.back();
+    return entry.steps;
+}
 
-    // 기존 로직 (1024자 미만)
-    int lineWidth = GetTextWidth(ExpandTabs(lineText));
-    if (lineWidth <= m_wordWrapWidth) {
-        return {};
-    }
+void NemoEdit::ClearWidthCaches() {
+    for (LineWidthCache& entry : m_lineWidths) entry.lineIndex = -1;
+    for (LineStepWidths& entry : m_lineSteps) entry.lineIndex = -1;
+    ClearWrapCache();
+    m_rope.clearWraps();
+    RequestRewrap();
+}
 
-    int currentPos = 0;
-    int currWidthSum = 0;
-    std::wstring tabText;
-    int low, high, result, currWidth, mid, testSize;
+void NemoEdit::ClearWrapCache() {
+    m_wrapCache.clear();
+    m_wrapLru.clear();
+    m_wrapCacheBytes = 0;
+    m_wrapKeys.clear();
+}
 
-    while (currentPos < (int)lineText.length()) {
-        // 이진 검색으로 현재 위치에서 가장 긴 텍스트 찾기
-        low = 1;
-        high = (int)lineText.length() - currentPos;
-        result = 1; // 기본값
-        currWidth = 0;
+// 키는 FNV-1a (64비트, 길이 포함), check는 같은 순회에서 곱셈과 자리 섞기로 따로 구한다.
+uint64_t NemoEdit::HashLine(std::wstring_view text, uint64_t& check) {
+    uint64_t h = 14695981039346656037ull ^ text.size();
+    uint64_t c = 0x9E3779B97F4A7C15ull;
+    for (wchar_t ch : text) {
+        h = (h ^ (uint64_t)ch) * 1099511628211ull;
+        c = (c + (uint64_t)ch) * 0xBF58476D1CE4E5B9ull;
+        c ^= c >> 31;
+    }
+    check = c;
+    return h;
+}
 
-        while (low <= high) {
-            mid = (low + high) / 2;
-            if (mid <= 0) mid = 1; // 보호 코드
+// lineIndex: 라인 인덱스 - 다음줄이 시작되는 column의 위치들이 데이터에 저장
+// 한 이벤트에서 같은 라인을 여러 번 찾으므로 라인 내용별로 기억해 둔다. (돌려준 참조는 다음 호출에서 버려질 수 있음)
+// 찾은 워드랩 줄 수는 Rope의 화면 줄 색인에도 기록한다. (라인 뷰와 커서를 무효화하지 않으므로 그리는 도중에 불러도 됨)
+// 이미 찾은 라인은 기억해 둔 키로 바로 찾고, 라인 내용을 읽어 해시하는 것은 처음 찾거나 고친 라인만 한다.
+// Rope를 고치면 기억해 둔 키를 수정 구간만큼 옮기고 고친 라인의 키만 버린다. (구간 기록이 없는 수정 뒤에는 전부 버림)
+const std::vector<int>& NemoEdit::FindWordWrapPosition(int lineIndex) {
+    static const std::vector<int> noWraps;
+    SyncWrapWidth();
+
+    uint64_t edits = m_rope.getEditCount();
+    if (m_wrapKeysEdits != edits) {
+        std::unordered_map<int, WrapCacheKey> moved;
+        moved.reserve(m_wrapKeys.size());
+        for (const auto& known : m_wrapKeys) {
+            size_t line = (size_t)known.first;
+            if (m_rope.mapLine(m_wrapKeysEdits, line)) moved.emplace((int)line, known.second);
+        }
+        m_wrapKeys.swap(moved);
+        m_wrapKeysEdits = edits;
+    }
+    if (m_wrapKeys.size() >= WRAP_KEY_LINES) m_wrapKeys.clear();
+    auto known = m_wrapKeys.find(lineIndex);
+    if (known != m_wrapKeys.end()) {
+        const WrapCacheKey& wk = known->second;
+        if (wk.length == 0) return noWraps;
+        auto hit = m_wrapCache.find(wk.key);
+        if (hit != m_wrapCache.end() && hit->second.length == wk.length && hit->second.check == wk.check) {
+            m_wrapLru.splice(m_wrapLru.begin(), m_wrapLru, hit->second.lru);
+            m_rope.setLineWraps(lineIndex, hit->second.wraps.size());
+            return hit->second.wraps;
+        }
+        // 캐시에서 버려졌거나 충돌로 덮어쓴 항목 : 아래에서 다시 잰다.
+    }
+
+    std::wstring_view lineText = m_rope.getLineView(lineIndex);
+    WrapCacheKey& wk = m_wrapKeys[lineIndex];
+    wk.length = lineText.size();
+    if (lineText.empty()) return noWraps; // 빈 줄일 경우 워드랩 필요 없음
+
+    uint64_t check;
+    uint64_t key = HashLine(lineText, check);
+    wk.key = key;
+    wk.check = check;
+    auto it = m_wrapCache.find(key);
+    if (it != m_wrapCache.end()) {
+        WrapCacheEntry& entry = it->second;
+        m_wrapLru.splice(m_wrapLru.begin(), m_wrapLru, entry.lru);
+        if (entry.length == lineText.size() && entry.check == check) {
+            m_rope.setLineWraps(lineIndex, entry.wraps.size());
+            return entry.wraps;
+        }
+        m_wrapCacheBytes -= entry.wraps.capacity() * sizeof(int); // 해시 충돌 : 이 라인으로 덮어씀
+    }
+    else {
+        m_wrapLru.push_front(key);
+        it = m_wrapCache.emplace(key, WrapCacheEntry()).first;
+        it->second.lru = m_wrapLru.begin();
+        m_wrapCacheBytes += WRAP_ENTRY_BYTES;
+    }
+
+    WrapCacheEntry& entry = it->second;
+    entry.length = lineText.size();
+    entry.check = check;
+    entry.wraps = LineLayout::MeasureWordWrapPosition(lineText, m_wordWrapWidth, m_tabSize,
+        [this](const std::wstring& text, std::vector<float>& prefix) {
+            m_measurer->GetPrefixWidths(text, prefix);
+            if ((int)prefix.back() > m_maxWidth) m_maxWidth = (int)prefix.back();
+        });
+    m_wrapCacheBytes += entry.wraps.capacity() * sizeof(int);
+    m_rope.setLineWraps(lineIndex, entry.wraps.size());
+
+    // 한도를 넘으면 가장 오래 쓰지 않은 항목부터 버린다. (방금 채운 항목은 목록 맨 앞이라 남음)
+    while (m_wrapCacheBytes > WRAP_CACHE_BYTES && m_wrapLru.size() > 1) {
+        auto old = m_wrapCache.find(m_wrapLru.back());
+        m_wrapCacheBytes -= WRAP_ENTRY_BYTES + old->second.wraps.capacity() * sizeof(int);
+        m_wrapCache.erase(old);
+        m_wrapLru.pop_back();
+    }
+    return entry.wraps;
+}
+
+// 워드랩 폭이 바뀌면 잰 위치가 모두 틀리므로 비운다. (화면에 보이는 라인은 그리면서 다시 재고, 나머지는 백그라운드에서 셈)
+void NemoEdit::SyncWrapWidth() {
+    if (m_wrapCacheWidth == m_wordWrapWidth) return;
+    ClearWrapCache();
+    m_rope.clearWraps();
+    m_wrapCacheWidth = m_wordWrapWidth;
+    RequestRewrap();
+}
+
+// 창 크기를 끄는 동안에는 폭이 바뀔 때마다 불리므로 바로 시작하지 않고, 메시지를 받을 때 마지막 폭으로 한 번만 시작한다.
+// 진행 중인 작업은 이전 폭이나 폰트로 잰 것이므로 바로 멈추고 결과를 버린다. (스레드는 기다리지 않음)
+void NemoEdit::RequestRewrap() {
+    m_rewrap.Cancel();
+    m_rewrapHeld.clear();
+    m_rewrapPending = true;
+    if (m_hWnd) PostMessage(WM_NEMO_REWRAP);
+}
+
+void NemoEdit::StartRewrap() {
+    m_rewrapPending = false;
+    m_rewrap.Cancel();
+    m_rewrapHeld.clear();
+    m_rewrapSkipped = 0;
+    if (!m_wordWrap || m_wordWrapWidth <= 0 || !m_hWnd || m_rewrapFailed) return;
+
+    // 작업 스레드용 측정 함수가 없는 측정기는 그리면서 잰 라인만 화면 줄 색인에 반영
+    GlyphAdvanceCache::MeasureRun measureRun = m_measurer->GetWorkerMeasureRun();
+    if (!measureRun) return;
+
+    // 다 기록한 리프는 건너뜀 (고치거나 넣은 라인이 있는 리프, 폭이 바뀐 뒤의 모든 리프만 셈)
+    std::vector<std::pair<size_t, size_t>> ranges;
+    m_rope.getUnwrappedRanges(REWRAP_BLOCK_LINES, ranges);
+    if (ranges.empty()) return;
+
+    int wrapWidth = m_wordWrapWidth;
+    int tabSize = m_tabSize;
+    RewrapJob::CountWraps countWraps = [wrapWidth, tabSize](std::wstring_view line, GlyphAdvanceCache& advances) {
+        return LineLayout::MeasureWordWrapPosition(line, wrapWidth, tabSize,
+            [&advances](const std::wstring& text, std::vector<float>& prefix) {
+                prefix.resize(text.size() + 1);
+                advances.GetPrefixWidths(text.data(), text.size(), prefix.data());
+            }).size();
+    };
+    m_rewrap.Start(m_hWnd, m_rope.snapshot(), std::move(ranges), m_scrollYLine, measureRun, m_measurer->IsFixedPitch(), countWraps);
+}
+
+// 백그라운드 워드랩 진행 : 끝난 블록의 워드랩 줄 수를 화면 줄 색인에 기록하고 스크롤바를 갱신한다.
+LRESULT NemoEdit::OnRewrapProgress(WPARAM wParam, LPARAM lParam) {
+    m_rewrap.Reap();
+    if (m_wordWrap) SyncWrapWidth();
+    if (m_rewrapPending) {
+        StartRewrap();
+        return 0;
+    }
+    if (!m_rewrap.IsRunning()) return 0;
 
-            tabText = ExpandTabs(lineText.substr(currentPos, mid));
-            testSize = GetTextWidth(tabText);
+    // 작업 스레드가 실패하면 멈추고, 이후로는 예전처럼 그리거나 스크롤하면서 만나는 라인만 UI 스레드에서 잰다.
+    if (m_rewrap.HasFailed()) {
+        m_rewrap.Cancel();
+        m_rewrapHeld.clear();
+        m_rewrapFailed = true;
+        return 0;
+    }
 
-            if (testSize < m_wordWrapWidth) {
-                currWidth = testSize;
-                result = mid;
-                low = mid + 1;
-            }
-            else {
-                high = mid - 1;
-            }
-        }
+    std::vector<RewrapJob::Block> blocks;
+    bool finished = m_rewrap.TakeBlocks(blocks);
+    const RopeSnapshot& snapshot = m_rewrap.GetSnapshot();
 
-        currWidthSum += currWidth;
-        currentPos += result;
-        wrapPos.push_back(currentPos);
+    // 스냅샷 이후에 고쳤으면 라인 위치를 리프마다 다시 찾아야 하므로 모아 두었다가 작업이 끝날 때 한 번에 기록한다.
+    // 수정 때문에 작업을 다시 시작하지 않으므로 계속 입력하는 중에도 결과를 버리지 않는다.
+    if (snapshot.getEditCount() == m_rope.getEditCount()) {
+        m_rewrapSkipped += m_rope.setSnapshotWraps(snapshot, blocks);
+    }
+    else {
+        m_rewrapHeld.insert(m_rewrapHeld.end(), std::make_move_iterator(blocks.begin()), std::make_move_iterator(blocks.end()));
+    }
 
-        // 줄이 끝나면 종료
-        if (lineWidth - currWidthSum < m_wordWrapWidth) break;
+    if (finished) {
+        if (!m_rewrapHeld.empty()) m_rewrapSkipped += m_rope.setSnapshotWraps(snapshot, m_rewrapHeld);
+        m_rewrapHeld.clear();
+        bool again = m_rewrapSkipped || snapshot.getEditCount() != m_rope.getEditCount();
+        m_rewrap.Cancel(); // 스냅샷을 놓아서 이후 수정이 공유 노드를 복사하지 않게 함
+        if (again) StartRewrap(); // 작업 중에 고쳤거나 복사본으로 바뀐 리프만 다시 셈
     }
 
-    return wrapPos;
+    if (m_rope.getRowCount() != m_scrollRows) {
+        RecalcScrollSizes();
+    }
+    return 0;
 }
 
 // 화면 좌표로부터 텍스트 캐럿 위치 계산
@@ -1755,12 +2065,11 @@ TextPos NemoEdit::GetTextPosFromPoint(CPoint pt) {
 		int visibleLines = client.Height() / m_lineHeight;
         int lineSize = (int)m_rope.getSize();
         int prevY = 0;
-        std::vector<int> wrapCols;
         int wrapColsSize = 0;
         int startCol = 0;
         int totalPrevLines = -m_scrollYWrapLine;
         for (int i = m_scrollYLine; i < lineSize; i++) {
-            wrapCols = FindWordWrapPosition(i);
+            const std::vector<int>& wrapCols = FindWordWrapPosition(i);
             totalPrevLines += (int)wrapCols.size() + 1;
             prevY = totalPrevLines * m_lineHeight + m_margin.top - m_lineSpacing/2;
             pos.lineIndex = i;
@@ -1786,38 +2095,12 @@ TextPos NemoEdit::GetTextPosFromPoint(CPoint pt) {
 			if (totalPrevLines > visibleLines) break;
         }
 
-        // 수평 위치 계산
-        std::wstring lineText = m_rope.getLine(pos.lineIndex);
-        std::wstring tabText;
+        // 수평 위치 계산 : 라인의 누적 폭에서 이진 검색
+        const std::vector<int>& prefix = GetLinePrefixWidths(pos.lineIndex);
         int col = 0;
-        int low, high, result, pointX, mid, testSize;
-        if (!lineText.empty()) {
-            // 이진 검색으로 텍스트에서 현재 위치 찾기
-            low = 1;
-            high = (int)lineText.size() - startCol;
-            result = 0; // 기본값
-            pointX = pt.x - CalculateNumberAreaWidth()-m_margin.left;
-
-            while (low <= high) {
-                mid = (low + high) / 2;
-                if (mid <= 0) mid = 1; // 보호 코드
-
-                tabText = ExpandTabs(lineText.substr(startCol, mid));
-                testSize = GetTextWidth(tabText);
-                testSize -= GetTextWidth(tabText.substr(tabText.size() - 1, 1)) / 2;
-
-                if (testSize < pointX) {
-                    // 더 많은 텍스트를 포함할 수 있음
-                    result = mid;
-                    low = mid + 1;
-                }
-                else {
-                    // 너무 많음 -> 줄이기
-                    high = mid - 1;
-                }
-            }
-
-            col = startCol + result;
+        if (prefix.size() > 1) {
+            int pointX = pt.x - CalculateNumberAreaWidth()-m_margin.left;
+            col = LineLayout::GetColumnFromX(prefix, startCol, pointX);
         }
         pos.column = col;
     }
@@ -1827,10 +2110,10 @@ TextPos NemoEdit::GetTextPosFromPoint(CPoint pt) {
         if (pos.lineIndex < 0) pos.lineIndex = 0;
         else if (pos.lineIndex >= (int)m_rope.getSize()) pos.lineIndex = (int)m_rope.getSize() - 1;
         // 수평 위치 계산
-        std::wstring lineText = m_rope.getLine(pos.lineIndex);
+        const std::vector<int>& prefix = GetLinePrefixWidths(pos.lineIndex);
         int col = 0;
 
-        if (!lineText.empty()) {
+        if (prefix.size() > 1) {
             // 마우스 클릭 위치에서 오프셋 계산
             int targetX = pt.x;
             if (m_showLineNumbers) {
@@ -1838,31 +2121,8 @@ TextPos NemoEdit::GetTextPosFromPoint(CPoint pt) {
             }
             targetX += m_scrollX; // 가로 스크롤 오프셋 적용
 
-            // 워드랩과 동일한 이진 검색 방식
-            int low = 1;
-            int high = (int)lineText.size();
-            int result = 0;
-            int mid, testSize;
-            std::wstring tabText;
-
-            while (low <= high) {
-                mid = (low + high) / 2;
-                if (mid <= 0) mid = 1; // 보호 코드
-
-                tabText = ExpandTabs(lineText.substr(0, mid));
-                testSize = GetTextWidth(tabText);
-                testSize -= GetTextWidth(tabText.substr(tabText.size() - 1, 1)) / 2;
-
-                if (testSize < targetX) {
-                    result = mid;
-                    low = mid + 1;
-                }
-                else {
-                    high = mid - 1;
-                }
-            }
-
-            col = result;
+            // 워드랩과 동일하게 누적 폭에서 이진 검색
+            col = LineLayout::GetColumnFromX(prefix, 0, targetX);
         }
 
         pos.column = col;
@@ -1925,7 +2185,7 @@ CPoint NemoEdit::GetCaretPixelPos(const TextPos& pos) {
         // 현재 라인의 몇 번째 워드랩 라인인지 계산
         int wrapLineIndex = 0; // 캐럿 위치가 속한 워드랩 라인 인덱스
         int startCol = 0; // 현재 워드랩 라인의 시작 컬럼
-        std::vector<int> wrapPositions = FindWordWrapPosition(lineIndex);
+        const std::vector<int>& wrapPositions = FindWordWrapPosition(lineIndex);
         for (size_t i = 0; i < wrapPositions.size(); i++) {
             if (pos.column < wrapPositions[i]) {
                 break;
@@ -1963,17 +2223,11 @@ CPoint NemoEdit::GetCaretPixelPos(const TextPos& pos) {
             }
         }
 
-        // 수평 위치: 해당 라인의 문자 폭 계산
-        auto line = m_rope.getLine(lineIndex);
-        if (!line.empty() && pos.column >= startCol) {
-            if (pos.column == startCol) {
-                pt.x = 0;
-            }
-            else {
-                std::wstring text = line.substr(startCol, pos.column - startCol);
-                text = ExpandTabs(text);
-                pt.x = GetTextWidth(text);
-            }
+        // 수평 위치: 라인의 누적 폭에서 워드랩 시작 컬럼까지의 폭을 뺀다.
+        const std::vector<int>& prefix = GetLinePrefixWidths(lineIndex);
+        int column = min(pos.column, (int)prefix.size() - 1);
+        if (column > startCol) {
+            pt.x = prefix[column] - prefix[startCol];
         }
         else {
             pt.x = 0;
@@ -1986,14 +2240,11 @@ CPoint NemoEdit::GetCaretPixelPos(const TextPos& pos) {
         pt.y = (lineIndex - m_scrollYLine) * m_lineHeight;
         pt.x = 0;
 
-        // 수평 위치: 해당 라인의 문자 폭 계산
-        auto line = m_rope.getLine(lineIndex);
-        if (!line.empty()) {
-            if (pos.column > 0) {
-                std::wstring text = line.substr(0, pos.column);
-                text = ExpandTabs(text);
-                pt.x = GetTextWidth(text);
-            }
+        // 수평 위치: 라인의 누적 폭
+        const std::vector<int>& prefix = GetLinePrefixWidths(lineIndex);
+        int column = min(pos.column, (int)prefix.size() - 1);
+        if (column > 0) {
+            pt.x = prefix[column];
         }
         pt.x -= m_scrollX;
     }
@@ -2017,7 +2268,7 @@ void NemoEdit::EnsureCaretVisible() {
         m_wordWrapWidth = screenWidth;
 
         // 현재 캐럿의 워드랩 라인 인덱스 계산
-        std::vector<int> caretWrapPositions = FindWordWrapPosition(m_caretPos.lineIndex);
+        const std::vector<int>& caretWrapPositions = FindWordWrapPosition(m_caretPos.lineIndex);
         int caretWrapLineIndex = 0; // 캐럿 위치가 속한 워드랩 라인 인덱스
         for (size_t i = 0; i < caretWrapPositions.size(); i++) {
             if (m_caretPos.column < caretWrapPositions[i]) {
@@ -2031,30 +2282,10 @@ void NemoEdit::EnsureCaretVisible() {
             m_scrollYLine = m_caretPos.lineIndex;
             m_scrollYWrapLine = caretWrapLineIndex;
         }
-        // 캐럿이 화면 아래로 벗어남
+        // 캐럿이 화면 아래로 벗어남 : 캐럿 줄이 화면 마지막 줄이 되는 화면 줄로 (화면 줄 색인으로 한 번에 계산)
         else if (pt.y+ m_lineHeight >= screenHeight) {
-            // 캐럿을 화면 마지막 줄로 두고 거기서 역산
-            int targetLine = m_caretPos.lineIndex;
-            int targetWrapLine = caretWrapLineIndex;
-            int remainingLines = visibleLines - 1; // 캐럿 라인 제외
-
-            while (remainingLines > 0 && (targetLine > 0 || targetWrapLine > 0)) {
-                if (targetWrapLine > 0) {
-                    targetWrapLine--;
-                    remainingLines--;
-                }
-                else {
-                    targetLine--;
-                    if (targetLine >= 0) {
-                        std::vector<int> wrapPos = FindWordWrapPosition(targetLine);
-                        targetWrapLine = (int)wrapPos.size();
-                        remainingLines--;
-                    }
-                }
-            }
-
-            m_scrollYLine = targetLine;
-            m_scrollYWrapLine = targetWrapLine;
+            int caretRow = (int)m_rope.rowFromLine(m_caretPos.lineIndex) + caretWrapLineIndex;
+            SetScrollRow(max(0, caretRow - (visibleLines - 1)));
         }
     }
     else {
@@ -2082,7 +2313,7 @@ void NemoEdit::EnsureCaretVisible() {
 
     m_scrollYLine = max(0, m_scrollYLine);
     NemoSetScrollPos(SB_HORZ, m_scrollX, TRUE);
-    NemoSetScrollPos(SB_VERT, m_scrollYLine, TRUE);
+    NemoSetScrollPos(SB_VERT, GetScrollRow(), TRUE);
     UpdateCaretPosition();
     RecalcScrollSizes();
 }
@@ -2099,69 +2330,14 @@ void NemoEdit::ScrollViewBy(int pageCount, int lineCount) {
     bool moveCaretToo = (pageCount != 0);
 
     if (m_wordWrap) {
-        // === WordWrap 모드 ===
-        int currentLine = m_scrollYLine;
-        int currentWrapLine = m_scrollYWrapLine;
-        int totalLines = (int)m_rope.getSize();
-
-        if (totalMoveLines > 0) {
-            // 아래로 이동
-            for (int i = 0; i < totalMoveLines; i++) {
-                if (currentLine >= totalLines - 1) break;
-
-                std::vector<int> wrapPositions = FindWordWrapPosition(currentLine);
-                int maxWrapLines = (int)wrapPositions.size();
-
-                if (currentWrapLine < maxWrapLines) {
-                    // 같은 물리적 라인의 다음 WordWrap 라인으로
-                    currentWrapLine++;
-                }
-                else {
-                    // 다음 물리적 라인의 첫 WordWrap 라인으로
-                    currentLine++;
-                    currentWrapLine = 0;
-                }
-            }
-        }
-        else if (totalMoveLines < 0) {
-            // 위로 이동
-            int absMoveLines = -totalMoveLines;
-            for (int i = 0; i < absMoveLines; i++) {
-                if (currentLine <= 0 && currentWrapLine <= 0) break;
-
-                if (currentWrapLine > 0) {
-                    // 같은 물리적 라인의 이전 WordWrap 라인으로
-                    currentWrapLine--;
-                }
-                else {
-                    // 이전 물리적 라인의 마지막 WordWrap 라인으로
-                    currentLine--;
-                    if (currentLine >= 0) {
-                        std::vector<int> wrapPositions = FindWordWrapPosition(currentLine);
-                        currentWrapLine = (int)wrapPositions.size();
-                    }
-                }
-            }
-        }
-
-        // 경계값 보정
-        m_scrollYLine = max(0, min(currentLine, totalLines - 1));
-        m_scrollYWrapLine = max(0, currentWrapLine);
-
-        // WordWrap 라인 유효성 검사
-        if (m_scrollYLine < totalLines) {
-            std::vector<int> wrapPositions = FindWordWrapPosition(m_scrollYLine);
-            int maxWrapLines = (int)wrapPositions.size();
-            if (m_scrollYWrapLine > maxWrapLines) {
-                m_scrollYWrapLine = maxWrapLines;
-            }
-        }
+        // === WordWrap 모드 === : 라인을 하나씩 재며 걷지 않고 화면 줄 색인으로 바로 이동 (마지막 라인의 첫 화면 줄까지)
+        int lastRow = (int)m_rope.rowFromLine(max((size_t)1, m_rope.getSize()) - 1);
+        SetScrollRow(max(0, min(GetScrollRow() + totalMoveLines, lastRow)));
 
         // 페이지 이동시 캐럿도 이동 (WordWrap 모드)
         if (moveCaretToo) {
             UpDown(-totalMoveLines);  // 부호 반전: PageUp(음수)→위로, PageDown(양수)→아래로
         }
-
     }
     else {
         // === 일반 모드 ===
@@ -2201,6 +2377,20 @@ void NemoEdit::ScrollViewBy(int pageCount, int lineCount) {
     }
 }
 
+// 워드랩 모드의 스크롤 위치는 (라인, 워드랩 줄)이고 스크롤바는 문서 시작부터의 화면 줄 번호이므로 화면 줄 색인으로 변환한다.
+// 화면 줄 색인은 아직 재지 않은 라인을 한 줄로 세므로, 백그라운드 워드랩이 문서를 다 잴 때까지 화면 줄 번호와 스크롤바는 근사치다.
+// (그린 라인과 잰 리프부터 정확해지고, 스크롤 위치는 라인 기준이라 색인이 바뀌어도 보던 곳에 그대로 있음)
+int NemoEdit::GetScrollRow() {
+    if (!m_wordWrap) return m_scrollYLine;
+    return (int)m_rope.rowFromLine(m_scrollYLine) + m_scrollYWrapLine;
+}
+
+void NemoEdit::SetScrollRow(int row) {
+    size_t wrapRow;
+    m_scrollYLine = (int)m_rope.lineFromRow(max(0, row), wrapRow);
+    m_scrollYWrapLine = (int)wrapRow;
+}
+
 // 스크롤바 범위/페이지 크기 재계산
 void NemoEdit::RecalcScrollSizes() {
     if (!m_hWnd) return;
@@ -2220,14 +2410,15 @@ void NemoEdit::RecalcScrollSizes() {
 
         int visibleLines = max(1, (client.Height()-m_margin.top-m_margin.bottom) / m_lineHeight);
 
-        // 총 라인 수 - 전체 라인 기준으로 사용
-        int totalRealLines = max(1, (int)m_rope.getSize());
+        // 총 화면 줄 수 - 워드랩으로 늘어난 줄까지 센 화면 줄 색인 기준 (아직 재지 않은 라인은 한 줄)
+        m_scrollRows = m_rope.getRowCount();
+        int totalRows = max(1, (int)m_scrollRows);
 
-        // 수직 스크롤바 설정 - 일반 라인 수 기준으로 설정
+        // 수직 스크롤바 설정 - 화면 줄 수 기준으로 설정
         si.nMin = 0;
-        si.nMax = totalRealLines + visibleLines/2 - 2;
+        si.nMax = totalRows + visibleLines/2 - 2;
         si.nPage = visibleLines;
-        si.nPos = m_scrollYLine;
+        si.nPos = GetScrollRow();
         NemoSetScrollInfo(SB_VERT, &si, TRUE);
     }
     else {
@@ -2411,21 +2602,23 @@ void NemoEdit::OnPaint() {
         // 워드랩 모드에서의 그리기
         int lineIndex = m_scrollYLine;
         int wapLineIndex = m_scrollYWrapLine;
+        RopeCursor cursor = m_rope.cursorAt(lineIndex); // 화면 라인들은 커서로 이웃 라인을 따라가며 읽음
+        std::wstring preText; // IME 합성 중인 라인만 복사해서 사용
 
         while (y < client.Height() && lineIndex < (int)m_rope.getSize()) {
-            std::wstring lineStr = m_rope.getLine(lineIndex);
+            std::wstring_view lineStr = m_rope.getLineView(cursor);
 
             // IME 합성 중인 경우
             bool isImeComposing = m_imeComposition.isComposing && m_imeComposition.lineNo == lineIndex && !m_imeComposition.imeText.empty();
             if (isImeComposing) {
                 // 합성 중인 텍스트 출력
-                std::wstring preText = lineStr.substr(0, m_caretPos.column);
+                preText = lineStr.substr(0, m_caretPos.column);
                 preText += m_imeComposition.imeText;
                 preText += lineStr.substr(m_caretPos.column);
                 lineStr = preText;
             }
 
-            std::vector<int> wrapPositions = FindWordWrapPosition(lineIndex);
+            const std::vector<int>& wrapPositions = FindWordWrapPosition(lineIndex);
             // wordwrap이 없는 경우
             if (wrapPositions.empty()) {
                 // 워드랩이 없는 라인 처리
@@ -2433,6 +2626,7 @@ void NemoEdit::OnPaint() {
                 DrawSegment(lineIndex, 0, lineStr, numberAreaWidth, y);
                 y += m_lineHeight;
                 lineIndex++;
+                m_rope.next(cursor);
                 continue;
             }
 
@@ -2467,8 +2661,7 @@ void NemoEdit::OnPaint() {
                     }
                     
 					if (i == 0) DrawLineNo(lineIndex, y);
-                    std::wstring segment = lineStr.substr(startPos, endPos - startPos);
-                    DrawSegment(lineIndex, startPos, segment, numberAreaWidth, y);
+                    DrawSegment(lineIndex, startPos, lineStr.substr(startPos, endPos - startPos), numberAreaWidth, y);
                     y += m_lineHeight;
                 }
 
@@ -2479,31 +2672,37 @@ void NemoEdit::OnPaint() {
             }
 
             lineIndex++;
+            m_rope.next(cursor);
         }
     }
     else {
         // 기존 모드 (non-워드랩)
         int lineIndex = m_scrollYLine;
         int maxLine = (int)m_rope.getSize();
-        std::wstring lineStr;
+        std::wstring_view lineStr;
+        std::wstring preText; // IME 합성 중인 라인만 복사해서 사용
+        RopeCursor cursor = m_rope.cursorAt(lineIndex); // 화면 라인들은 커서로 이웃 라인을 따라가며 읽음
 
         while ( lineIndex< maxLine && y < client.Height()) {
-            lineStr = m_rope.getLine(lineIndex);
-            // 수평 클리핑 최적화 (화면 밖에 있는 텍스트는 그리지 않음)
-            int lineWidth = GetLineWidth(lineIndex);
-            if (numberAreaWidth - m_scrollX + lineWidth <= 0) {
-                // 완전히 화면 왼쪽 바깥에 있으면 출력하지 않고 다음 라인으로
+            // IME 합성 중인 경우
+            bool isImeComposing = m_imeComposition.isComposing && m_imeComposition.lineNo == lineIndex && !m_imeComposition.imeText.empty();
+
+            // 긴 라인은 펼치지 않고 화면에 걸친 컬럼 구간만 읽어서 그림
+            size_t lineLen = m_rope.getLineSize(cursor);
+            if (lineLen >= LONG_LINE_MIN) {
                 DrawLineNo(lineIndex, y);
+                DrawLineWindow(lineIndex, lineLen, isImeComposing, numberAreaWidth, y);
                 y += m_lineHeight;
                 lineIndex++;
+                m_rope.next(cursor);
                 continue;
             }
 
-            // IME 합성 중인 경우
-            bool isImeComposing = m_imeComposition.isComposing && m_imeComposition.lineNo == lineIndex && !m_imeComposition.imeText.empty();
+            // 수평 클리핑은 DrawSegment가 한 번 잰 폭으로 함
+            lineStr = m_rope.getLineView(cursor);
             if (isImeComposing) {
                 // 합성 중인 텍스트 출력
-                std::wstring preText = lineStr.substr(0, m_caretPos.column);
+                preText = lineStr.substr(0, m_caretPos.column);
                 preText += m_imeComposition.imeText;
                 preText += lineStr.substr(m_caretPos.column);
                 lineStr = preText;
@@ -2513,11 +2712,15 @@ void NemoEdit::OnPaint() {
             DrawSegment(lineIndex, 0, lineStr, numberAreaWidth, y);
             y += m_lineHeight;
             lineIndex++;
+            m_rope.next(cursor);
         }
     }
 
     // 오프스크린 버퍼를 화면에 출력
     m_d2Render.EndDraw();
+
+    // 그리면서 처음 잰 라인이 있으면 화면 줄 수가 달라졌으므로 스크롤바 범위를 맞춘다.
+    if (m_wordWrap && m_rope.getRowCount() != m_scrollRows) RecalcScrollSizes();
 }
 
 BOOL NemoEdit::OnEraseBkgnd(CDC* pDC) {
@@ -2530,7 +2733,8 @@ BOOL NemoEdit::OnEraseBkgnd(CDC* pDC) {
 // segment: 출력할 텍스트 ( 워드랩인 경우 segStartIdx가 0이 아니면 잘린뒤의 현재 라인에 표시할 텍스트 )
 // xOffset: X 좌표
 // y: Y 좌표
-void NemoEdit::DrawSegment(int lineIndex, size_t segStartIdx, const std::wstring& segment, int xOffset, int y) {
+// segLeft: 라인 시작부터 segment 앞까지의 픽셀 폭 (긴 라인의 화면 구간만 그릴 때)
+void NemoEdit::DrawSegment(int lineIndex, size_t segStartIdx, std::wstring_view segment, int xOffset, int y, int segLeft) {
     if (segment.empty()) {
         // 내용이 없는 경우도 캐럿 표시 위해 배경색으로 칠하기
         D2D1_RECT_F lineRect = D2D1::RectF(xOffset - m_scrollX, y, xOffset - m_scrollX + 2, y + m_lineHeight);
@@ -2538,7 +2742,7 @@ void NemoEdit::DrawSegment(int lineIndex, size_t segStartIdx, const std::wstring
         return;
     }
 
-    std::wstring segText = segment;
+    std::wstring_view segText = segment;
     std::wstring tabText = ExpandTabs(segText);
     CRect client;
     GetClientRect(&client);
@@ -2548,7 +2752,7 @@ void NemoEdit::DrawSegment(int lineIndex, size_t segStartIdx, const std::wstring
         return; // 보이지 않는 영역은 출력 생략
     }
 
-    int x = xOffset - m_scrollX + m_margin.left;
+    int x = xOffset - m_scrollX + m_margin.left + segLeft;
 
     // 텍스트의 전체 너비 계산
     CSize textSize = GetTextWidth(tabText.c_str());
@@ -2620,11 +2824,39 @@ void NemoEdit::DrawSegment(int lineIndex, size_t segStartIdx, const std::wstring
     }
 }
 
+// 라인 좌표로 본 화면 가로 구간 [left, right)에 걸친 간격들만 구간 뷰로 읽는다. (라인 전체를 펼치거나 재지 않음)
+// IME 합성 중이면 캐럿이 구간 안에 있을 때만 합성 문자열을 끼워서 그린다.
+void NemoEdit::DrawLineWindow(int lineIndex, size_t lineLen, bool imeComposing, int xOffset, int y) {
+    CRect client;
+    GetClientRect(&client);
+    const std::vector<int>& steps = GetLineStepWidths(lineIndex);
+    int left = m_scrollX - m_margin.left;
+    int right = left + client.Width() - xOffset;
+    if (steps.back() <= left || right <= 0) return; // 라인 전체가 화면 바깥
+
+    size_t first = left <= 0 ? 0 : (size_t)(std::upper_bound(steps.begin(), steps.end(), left) - steps.begin()) - 1;
+    size_t last = (size_t)(std::lower_bound(steps.begin() + first, steps.end(), right) - steps.begin());
+    last = max(last, first + 1);
+    size_t startCol = first * PAINT_STEP_CHARS;
+    size_t endCol = min(lineLen, last * PAINT_STEP_CHARS);
+
+    std::wstring_view window = m_rope.getLineView(lineIndex, startCol, endCol - startCol);
+    std::wstring imeText;
+    if (imeComposing && (size_t)m_caretPos.column >= startCol && (size_t)m_caretPos.column <= endCol) {
+        size_t at = m_caretPos.column - startCol;
+        imeText.assign(window.substr(0, at));
+        imeText += m_imeComposition.imeText;
+        imeText += window.substr(at);
+        window = imeText;
+    }
+    DrawSegment(lineIndex, startCol, window, xOffset, y, steps[first]);
+}
+
 // 이전 단어의 시작으로 캐럿 이동
 void NemoEdit::MoveCaretToPrevWord() {
 	if (m_caretPos.lineIndex > m_rope.getSize()) return;
 
-    const std::wstring& line = m_rope.getLine(m_caretPos.lineIndex);
+    std::wstring_view line = m_rope.getLineView(m_caretPos.lineIndex);
 
     // 현재 라인에서 이전 단어 찾기
     if (m_caretPos.column > 0) {
@@ -2651,7 +2883,7 @@ void NemoEdit::MoveCaretToPrevWord() {
     // 현재 라인의 시작에 있다면 이전 라인의 끝으로 이동
     else if (m_caretPos.lineIndex > 0) {
         m_caretPos.lineIndex--;
-		std::wstring prevLine = m_rope.getLine(m_caretPos.lineIndex);
+		std::wstring_view prevLine = m_rope.getLineView(m_caretPos.lineIndex);
         if (!prevLine.empty()) {
             int pos = (int)prevLine.size() - 1;
 
@@ -2683,7 +2915,7 @@ void NemoEdit::MoveCaretToPrevWord() {
 void NemoEdit::MoveCaretToNextWord() {
     if (m_caretPos.lineIndex > m_rope.getSize()) return;
 
-    const std::wstring& line = m_rope.getLine(m_caretPos.lineIndex);
+    std::wstring_view line = m_rope.getLineView(m_caretPos.lineIndex);
     int lineLength = (int)line.size();
 
     // 현재 라인에서 다음 단어 찾기
@@ -2742,15 +2974,65 @@ void NemoEdit::SaveClipBoard(const std::wstring& text) {
     CloseClipboard();
 }
 
-std::wstring NemoEdit::LoadClipText() {
-	if (!IsClipboardFormatAvailable(CF_UNICODETEXT)) return L"";
-	if (!OpenClipboard()) return L"";
-    HANDLE hData = GetClipboardData(CF_UNICODETEXT);
-    if (!hData) {
-        CloseClipboard();
-        return L"";
-    }
-
+// 내용 없이 형식만 등록하므로 잘라낸 구간이 아무리 커도 바로 끝난다. (EmptyClipboard로 이전 잘라내기 상태는 OnDestroyClipboard에서 놓음)
+bool NemoEdit::SaveClipBoardDelayed() {
+    if (!OpenClipboard()) return false;
+    EmptyClipboard();
+    SetClipboardData(CF_UNICODETEXT, nullptr);
+    CloseClipboard();
+    return true;
+}
+
+// 잘라낸 라인마다 \r\n을 붙인 텍스트 (getTextRange로 라인 시작부터 라인 시작까지 얻는 것과 같음)
+void NemoEdit::RenderCutText() {
+    if (!m_cutSnap) return;
+    HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, (m_cutChars + 1) * sizeof(wchar_t));
+    if (!hMem) return;
+    wchar_t* pMem = (wchar_t*)GlobalLock(hMem);
+    if (!pMem) {
+        GlobalFree(hMem);
+        return;
+    }
+    wchar_t* pos = pMem;
+    m_cutSnap->forEachLine(m_cutFirst, m_cutCount, [&pos](size_t, std::wstring_view line) {
+        wmemcpy(pos, line.data(), line.size());
+        pos += line.size();
+        *pos++ = L'\r';
+        *pos++ = L'\n';
+        return true;
+    });
+    *pos = 0;
+    GlobalUnlock(hMem);
+    if (!SetClipboardData(CF_UNICODETEXT, hMem)) GlobalFree(hMem);
+    m_cutClipSeq = GetClipboardSequenceNumber(); // 렌더링으로 번호가 바뀌어도 같은 잘라내기 내용
+}
+
+void NemoEdit::OnRenderFormat(UINT nFormat) {
+    if (nFormat == CF_UNICODETEXT) RenderCutText();
+}
+
+// 창을 닫을 때 아직 클립보드를 가지고 있으면 텍스트를 만들어 두어 다른 프로그램에서 붙여넣을 수 있게 한다.
+void NemoEdit::OnRenderAllFormats() {
+    if (!OpenClipboard()) return;
+    if (::GetClipboardOwner() == m_hWnd) RenderCutText();
+    CloseClipboard();
+}
+
+// 다른 내용이 클립보드에 들어갔으므로 스냅샷을 놓는다. (떼어낸 라인들은 Undo 레코드가 들고 있으면 남음)
+void NemoEdit::OnDestroyClipboard() {
+    m_cutSnap.reset();
+    m_cutLines.reset();
+}
+
+std::wstring NemoEdit::LoadClipText() {
+	if (!IsClipboardFormatAvailable(CF_UNICODETEXT)) return L"";
+	if (!OpenClipboard()) return L"";
+    HANDLE hData = GetClipboardData(CF_UNICODETEXT);
+    if (!hData) {
+        CloseClipboard();
+        return L"";
+    }
+
     wchar_t* pText = (wchar_t*)GlobalLock(hData);
     if (!pText) {
         CloseClipboard();
@@ -2784,6 +3066,29 @@ void NemoEdit::GotoLine(size_t lineNo) {
     Invalidate(FALSE);
 }
 
+size_t NemoEdit::GetCaretOffset() {
+    return m_rope.offsetFromPos(m_caretPos.lineIndex, m_caretPos.column);
+}
+
+void NemoEdit::GotoOffset(size_t offset) {
+    size_t lineIndex, column;
+    m_rope.posFromOffset(offset, lineIndex, column);
+    m_caretPos.lineIndex = (int)lineIndex;
+    m_caretPos.column = (int)column;
+    CancelSelection();
+    EnsureCaretVisible();
+    Invalidate(FALSE);
+}
+
+// 선택 영역 텍스트를 만들지 않고 양 끝 오프셋의 차이로 계산
+size_t NemoEdit::GetSelectionLength() {
+    if (!m_selectInfo.isSelected) return 0;
+
+    size_t a = m_rope.offsetFromPos(m_selectInfo.start.lineIndex, m_selectInfo.start.column);
+    size_t b = m_rope.offsetFromPos(m_selectInfo.end.lineIndex, m_selectInfo.end.column);
+    return (a < b) ? b - a : a - b;
+}
+
 // 윈도우 크기 조정
 void NemoEdit::OnSize(UINT nType, int cx, int cy) {
     CWnd::OnSize(nType, cx, cy);
@@ -2823,8 +3128,7 @@ void NemoEdit::OnVScroll(UINT nSBCode, UINT nPos, CScrollBar* pScrollBar) {
 
             // 직접 위치 설정 (WordWrap 고려)
             if (m_wordWrap) {
-                m_scrollYLine = si.nTrackPos;
-                m_scrollYWrapLine = 0;  // 썸 드래그시는 라인 시작으로
+                SetScrollRow(si.nTrackPos); // 썸 위치는 화면 줄 번호
             }
             else {
                 m_scrollYLine = si.nTrackPos;
@@ -2834,7 +3138,7 @@ void NemoEdit::OnVScroll(UINT nSBCode, UINT nPos, CScrollBar* pScrollBar) {
         default: break;
     }
 
-    NemoSetScrollPos(SB_VERT, m_scrollYLine, TRUE);
+    NemoSetScrollPos(SB_VERT, GetScrollRow(), TRUE);
     UpdateCaretPosition(); // 추가: 스크롤 후 캐럿 위치 업데이트
     Invalidate(FALSE);
 }
@@ -2876,43 +3180,8 @@ BOOL NemoEdit::OnMouseWheel(UINT nFlags, short zDelta, CPoint pt)
         int totalLines = (int)m_rope.getSize();
 
         if (m_wordWrap) {
-            // 워드랩 모드: 현재 화면에 보이는 마지막 라인 계산
-            int currentLine = m_scrollYLine;
-            int currentWrapLine = m_scrollYWrapLine;
-            int screenLinesUsed = 0;
-
-            // 화면에 표시되는 라인들을 세어가면서 마지막 라인 찾기
-            while (screenLinesUsed < visibleLines && currentLine < totalLines) {
-                std::vector<int> wrapPositions = FindWordWrapPosition(currentLine);
-                int wrapLinesInThisLine = (int)wrapPositions.size() + 1; // 워드랩 라인 수 + 1
-
-                if (currentLine == m_scrollYLine) {
-                    // 첫 번째 라인은 m_scrollYWrapLine부터 시작
-                    int remainingWrapLines = wrapLinesInThisLine - currentWrapLine;
-                    if (screenLinesUsed + remainingWrapLines <= visibleLines) {
-                        screenLinesUsed += remainingWrapLines;
-                        currentLine++;
-                        currentWrapLine = 0;
-                    }
-                    else {
-                        screenLinesUsed = visibleLines; // 화면 가득참
-                        break;
-                    }
-                }
-                else {
-                    if (screenLinesUsed + wrapLinesInThisLine <= visibleLines) {
-                        screenLinesUsed += wrapLinesInThisLine;
-                        currentLine++;
-                    }
-                    else {
-                        screenLinesUsed = visibleLines; // 화면 가득참
-                        break;
-                    }
-                }
-            }
-
-            // 현재 화면에 문서의 마지막 라인이 보이면 스크롤 차단
-            if (currentLine >= totalLines) {
+            // 워드랩 모드: 문서의 마지막 화면 줄이 이미 보이면 스크롤 차단
+            if (GetScrollRow() + visibleLines >= (int)m_rope.getRowCount()) {
                 return TRUE;
             }
         }
@@ -2928,7 +3197,7 @@ BOOL NemoEdit::OnMouseWheel(UINT nFlags, short zDelta, CPoint pt)
     int scrollLines = (zDelta > 0) ? -3 : 3;  // 3라인씩 스크롤
     ScrollViewBy(0, scrollLines);
 
-    NemoSetScrollPos(SB_VERT, m_scrollYLine, TRUE);
+    NemoSetScrollPos(SB_VERT, GetScrollRow(), TRUE);
     UpdateCaretPosition();
     Invalidate(FALSE);
     return TRUE;
@@ -2955,7 +3224,7 @@ void NemoEdit::OnLButtonDblClk(UINT nFlags, CPoint point)
     }
 
     // 현재 라인의 텍스트 가져오기
-    std::wstring lineText = m_rope.getLine(pos.lineIndex);
+    std::wstring_view lineText = m_rope.getLineView(pos.lineIndex);
 
     // 단어 경계 찾기 (단순화된 버전)
     int wordStart, wordEnd;
@@ -3378,6 +3647,29 @@ void NemoEdit::OnKillFocus(CWnd* pNewWnd) {
 
 
 // Ctrl+key 처리
+// 스왑 파일을 읽지 못하면 그리기, 클릭, 캐럿 이동 같은 읽기 경로에서도 RopeReadError가 나오므로 메시지 단위로 한 번에 받는다.
+// 그리던 중이면 그리기를 끝내고(CPaintDC는 풀리면서 EndPaint), 반쯤 읽은 문서를 더 고치지 않도록 읽기 전용으로 바꾼다.
+// 알림 창은 메시지 처리 밖에서 한 번만 띄운다. (알림 창이 떠 있는 동안 다시 그리다 실패해도 조용히 넘어감)
+LRESULT NemoEdit::WindowProc(UINT message, WPARAM wParam, LPARAM lParam) {
+    try {
+        return CDialogEx::WindowProc(message, wParam, lParam);
+    }
+    catch (const RopeReadError&) {
+        if (message == WM_PAINT) m_d2Render.EndDraw();
+        m_isReadOnly = true;
+        if (!m_readFailed) {
+            m_readFailed = true;
+            PostMessage(WM_NEMO_READERROR);
+        }
+        return 0;
+    }
+}
+
+LRESULT NemoEdit::OnReadError(WPARAM wParam, LPARAM lParam) {
+    AfxMessageBox(L"임시 스왑 파일을 읽지 못했습니다.\n문서 일부를 표시할 수 없으므로 읽기 전용으로 바꿉니다. 문서를 다시 열어 주세요.", MB_ICONERROR);
+    return 0;
+}
+
 BOOL NemoEdit::PreTranslateMessage(MSG* pMsg)
 {
 	// Ctrl 조합키 KeyDown 처리 : 여기에서 처리하는 이유는 Ctrl+key가 SystemKey처리때문에 KeyDown에 입력되지 않기때문
@@ -3417,6 +3709,14 @@ BOOL NemoEdit::PreTranslateMessage(MSG* pMsg)
             }
         }
     }
+    // Alt 조합키는 WM_SYSKEYDOWN으로 들어온다. : Alt+Up/Down 라인 이동
+    else if (pMsg->message == WM_SYSKEYDOWN && !m_isReadOnly) {
+        UINT nChar = (UINT)pMsg->wParam;
+        if (nChar == VK_UP || nChar == VK_DOWN) {
+            MoveSelectedLines(nChar == VK_UP);
+            return TRUE;
+        }
+    }
 
     return CWnd::PreTranslateMessage(pMsg);
 }
@@ -3479,722 +3779,132 @@ LRESULT NemoEdit::OnImeEndComposition(WPARAM wParam, LPARAM lParam)
     return DefWindowProc(WM_IME_ENDCOMPOSITION, wParam, lParam);
 }
 
-Rope::Rope() : root(nullptr), m_balanceCnt(0) {
-    root = new RopeNode();
-}
-
-Rope::~Rope() {}
-
-void Rope::insert(size_t lineIndex, const std::wstring& text) {
-    size_t offset;
-    RopeNode* leaf = findLeaf(root, lineIndex, offset);
-    if (leaf && leaf->length >= offset) {
-        auto it = getIterator(lineIndex);
-        auto newIt = lines.insert(it, text);
-
-        leaf->data.insert(leaf->data.begin() + offset, newIt);
-        leaf->length++;
-        updateLengthUpward(leaf, 1);
-
-        // 노드 크기 기준 분할
-        if (leaf->length > SPLIT_THRESHOLD) {
-            splitNode(leaf);
-        }
-        
-        // 주기적인 전체 트리 균형 체크 (삽입 카운터 사용)
-        if (++m_balanceCnt % (SPLIT_THRESHOLD * 2) == 0) {
-            m_balanceCnt = 0;
-            if (isUnbalanced()) {
-                balanceRope();
-            }
-        }
-    }
-}
-
-void Rope::insertAt(size_t lineIndex, size_t offset, const std::wstring& text) {
-    if (lineIndex > lines.size()) return;
-
-    auto it = getIterator(lineIndex);
-    if (it == lines.end()) {
-        insert(lineIndex, text);
-    }
-    else {
-        size_t startPos = offset;
-        if (it->empty() || offset >= it->size()) {
-            startPos = it->size();
-        }
-        it->insert(startPos, text);
-    }
-    return;
-}
-
-void Rope::insertBack(const std::wstring& text) {
-    size_t lineIndex = lines.size();
-    insert(lineIndex, text);
-}
-
-void Rope::erase(size_t lineIndex) {
-    size_t offset;
-    RopeNode* leaf = findLeaf(root, lineIndex, offset);
-    if (!leaf || leaf->length < offset) return;
-
-    lines.erase(leaf->data[offset]);
-    leaf->data.erase(leaf->data.begin() + offset);
-    leaf->length--;
-    updateLengthUpward(leaf, -1);
-
-    if (leaf->length < MERGE_THRESHOLD/2) {
-        mergeIfNeeded(leaf);
-    }
-
-    if (++m_balanceCnt % (MERGE_THRESHOLD * 2) == 0) {
-		m_balanceCnt = 0;
-        if (isUnbalanced()) {
-            balanceRope();
-        }
-    }
-}
-
-void Rope::eraseAt(size_t lineIndex, size_t offset, size_t size) {
-    if (lineIndex >= lines.size()) return;
-
-    size_t actualSize = size;
-    auto it = getIterator(lineIndex);
-    if (it->empty() || offset >= it->size()) return;
-    if (offset + size > it->size()) actualSize = it->size() - offset;
-    if (actualSize > 0) it->erase(offset, actualSize);
-}
-
-void Rope::update(size_t lineIndex, const std::wstring& newText) {
-    if (lineIndex >= lines.size()) return;
-
-    auto it = getIterator(lineIndex);
-    *it = newText;
-}
-
-void Rope::mergeLine(size_t lineIndex)
-{
-    if (lineIndex + 1 >= getSize())
-        return;
-
-    std::wstring strLine = getLine(lineIndex);
-    std::wstring strNextLine = getLine(lineIndex + 1);
-    strLine += strNextLine;
-    update(lineIndex, strLine);
-    erase(lineIndex + 1);
-}
-
-bool Rope::clear() {
-    deleteAllNodes(root);
-    lines.clear();
-    root = new RopeNode();
-    return true;
-}
-
-bool Rope::empty() {
-    return lines.empty();
-}
-
-std::list<std::wstring>::iterator Rope::getIterator(size_t lineIndex) {
-    size_t offset;
-    RopeNode* leaf = findLeaf(root, lineIndex, offset);
-    if (!leaf || offset >= leaf->data.size()) return lines.end();
-    return leaf->data[offset];
-}
-
-std::list<std::wstring>::iterator Rope::getEnd() {
-    return lines.end();
-}
-
-std::list<std::wstring>::iterator Rope::getBegin() {
-    return lines.begin();
-}
-
-size_t Rope::getSize() {
-    return lines.size();
-}
-
-size_t Rope::getLineSize(size_t lineIndex) {
-    auto it = getIterator(lineIndex);
-    return it == lines.end() ? 0 : (*it).size();
-}
-
-std::wstring Rope::getLine(size_t lineIndex) {
-    auto it = getIterator(lineIndex);
-    if (it == lines.end()) return L"";
-    return *it;
-}
+// ---------------------------------------------------
+// RewrapJob : 작업 스레드는 스냅샷만 읽고, 결과는 메인 스레드가 메시지를 받아 Rope에 기록한다.
+// ---------------------------------------------------
+void RewrapJob::Start(HWND notify, std::shared_ptr<const RopeSnapshot> snapshot, std::vector<std::pair<size_t, size_t>> ranges, size_t firstLine,
+    GlyphAdvanceCache::MeasureRun measureRun, bool fixedPitch, CountWraps countWraps) {
+    Cancel();
+    if (ranges.empty()) return;
 
-std::wstring Rope::getText() {
-    std::wstring text = L"";
-    int lineCnt = 0;
-    for (const auto& line : lines) {
-        if (lineCnt++ > 0) text += L"\r\n";
-        text += line;
+    m_run.reset(new Run());
+    Run* run = m_run.get();
+    run->notify = notify;
+    run->snapshot = snapshot;
+    run->countWraps = countWraps;
+    run->ranges = std::move(ranges);
+    // 화면 첫 라인이 있거나 그 뒤의 첫 구간부터 (없으면 처음부터)
+    while (run->firstRange < run->ranges.size() && run->ranges[run->firstRange].first + run->ranges[run->firstRange].second <= firstLine) {
+        run->firstRange++;
     }
-    return text;
-}
+    if (run->firstRange == run->ranges.size()) run->firstRange = 0;
 
-// LineIndex도 Column도 0부터 시작
-std::wstring Rope::getTextRange(size_t startLineIndex, size_t startLineColumn, size_t endLineIndex, size_t endLineColumn) {
-    std::wstring text = L"";
-    int lineCnt = 0;
-    auto itStart = getIterator(startLineIndex);
-    auto itEnd = getIterator(endLineIndex);
-    if (itStart == lines.end() || itEnd == lines.end())
-        return text;
-
-    if (startLineIndex == endLineIndex) {
-        // 한 라인 내에서 선택
-        text = itStart->substr(startLineColumn, endLineColumn - startLineColumn);
-    }
-    else {
-        // 여러 라인에 걸쳐 선택
-        text += itStart->substr(startLineColumn);
-        text += L"\r\n";
-        if (endLineIndex - startLineIndex > 1) {
-            auto it = std::next(itStart);
-            for (size_t line = startLineIndex + 1; line < endLineIndex; line++) {
-                if (it == lines.end()) break;
-                text += *it;
-                text += L"\r\n";
-                ++it;
-            }
-        }
-        text += itEnd->substr(0, endLineColumn);
+    // 메인 스레드 몫으로 코어 하나를 남김
+    size_t threadCount = max((size_t)std::thread::hardware_concurrency(), (size_t)2) - 1;
+    threadCount = min(threadCount, run->ranges.size());
+    run->active = threadCount;
+    for (size_t i = 0; i < threadCount; i++) {
+        run->threads.emplace_back(&RewrapJob::Work, run, measureRun, fixedPitch);
     }
-    return text;
 }
 
-// Implementation of methods
-RopeNode* Rope::findLeaf(RopeNode* node, size_t idx, size_t& offset) {
-    if (!node) return nullptr;
-
-    if (node->isLeaf) {
-        offset = idx;
-        return node;
+// 스왑 파일을 읽는 중인 스레드를 UI 스레드에서 기다리지 않도록 멈추라고만 알리고 m_retired로 넘긴다.
+void RewrapJob::Cancel() {
+    if (m_run) {
+        m_run->cancel = true;
+        m_retired.push_back(std::move(m_run));
     }
-
-    // idx는 0부터 length는 1부터 시작
-    if (idx < node->length)
-        return findLeaf(node->left, idx, offset);
-    else
-        return findLeaf(node->right, idx - node->length, offset);
+    Reap();
 }
 
-void Rope::updateLengthUpward(RopeNode* node, int addCnt) {
-    while (node) {
-        if (node->parent) {
-            // parent의 left일 경우
-            if (node->parent->left == node) {
-                node->parent->length += addCnt;
-            }
-
-            node = node->parent;
-        }
-        else break;
-    }
-}
-
-void Rope::splitNode(RopeNode* leaf) {
-    if (!leaf->isLeaf || leaf->length <= SPLIT_THRESHOLD) return;
-
-    // 분할 노드 생성
-    RopeNode* newLeaf = new RopeNode();
-    newLeaf->isLeaf = true;
-
-    // 기존 노드에서 중간 이터레이터 지정
-    auto midIter = leaf->data.begin() + leaf->data.size() / 2;
-    // 분할 노드에 데이터 복사
-    newLeaf->data.assign(midIter, leaf->data.end());
-    // 기존 노드 절반 삭제
-    leaf->data.resize(leaf->data.size() / 2);
-
-    // length 업데이트
-    leaf->length = leaf->data.size();
-    newLeaf->length = newLeaf->data.size();
-
-    // 내부 노드 추가 : leaf의 위치 정보로 셋팅
-    RopeNode* newInternal = new RopeNode();
-    newInternal->isLeaf = false;
-    newInternal->left = leaf; // 기존 노드는 왼쪽
-    newInternal->right = newLeaf; // 새로운 노드는 오른쪽
-    newInternal->length = leaf->length; // 왼쪽 노드의 길이만 저장
-    newInternal->parent = leaf->parent;
-
-    // leaf가 root가 아니면 내부 노드와 연결
-    if (newInternal->parent == nullptr) {
-        root = newInternal;
-    }
-    else {
-        // leaf가 왼쪽 자식이면 왼쪽에 연결
-        if (newInternal->parent->left == leaf)
-            newInternal->parent->left = newInternal;
-        else
-            newInternal->parent->right = newInternal;
-    }
-
-    leaf->parent = newLeaf->parent = newInternal;
-}
-
-bool Rope::splitNodeByExact(RopeNode* leaf, size_t cutSize) {
-    // 유효성 검사: 리프 노드가 아니거나 크기가 0이거나 cutSize가 노드 크기보다 크면 실패
-    if (!leaf || !leaf->isLeaf || leaf->data.size() < 2 || cutSize >= leaf->data.size()) {
-        return false;
-    }
-
-    try {
-        // 분할 노드 생성
-        RopeNode* newLeaf = new RopeNode();
-        newLeaf->isLeaf = true;
-
-        // cutSize 위치의 이터레이터 찾기
-        auto cutIter = leaf->data.begin() + cutSize;
-
-        // 분할 노드에 데이터 복사 (cutIter부터 끝까지)
-        newLeaf->data.assign(cutIter, leaf->data.end());
-
-        // 기존 노드의 크기를 cutSize로 조정 (cutIter 이후 삭제)
-        leaf->data.erase(cutIter, leaf->data.end());
-
-        // length 업데이트
-        leaf->length = leaf->data.size();
-        newLeaf->length = newLeaf->data.size();
-
-        // 내부 노드 추가: leaf의 위치 정보로 설정
-        RopeNode* newInternal = new RopeNode();
-        newInternal->isLeaf = false;
-        newInternal->left = leaf;       // 기존 노드는 왼쪽
-        newInternal->right = newLeaf;   // 새로운 노드는 오른쪽
-        newInternal->length = leaf->length; // 왼쪽 노드의 길이만 저장
-        newInternal->parent = leaf->parent;
-
-        // leaf가 root가 아니면 내부 노드와 연결
-        if (newInternal->parent == nullptr) {
-            root = newInternal;
+// 마지막 스레드가 active를 줄였으면 남은 일은 반환뿐이므로 join이 바로 끝난다.
+void RewrapJob::Reap() {
+    size_t keep = 0;
+    for (size_t i = 0; i < m_retired.size(); i++) {
+        if (m_retired[i]->active == 0) {
+            for (std::thread& worker : m_retired[i]->threads) worker.join();
+            m_retired[i].reset();
         }
         else {
-            // leaf가 왼쪽 자식이면 왼쪽에 연결
-            if (newInternal->parent->left == leaf)
-                newInternal->parent->left = newInternal;
-            else
-                newInternal->parent->right = newInternal;
+            m_retired[keep++] = std::move(m_retired[i]);
         }
-
-        leaf->parent = newLeaf->parent = newInternal;
-        return true; // 성공
-    }
-    catch (...) {
-        // 예외 발생 시 실패 반환
-        return false;
     }
+    m_retired.resize(keep);
 }
 
-void Rope::mergeIfNeeded(RopeNode* leaf) {
-    if (!leaf->parent) return;
-
-    RopeNode* sibling = leaf->parent->left == leaf ? leaf->parent->right : leaf->parent->left;
-    if (sibling && sibling->isLeaf && leaf->data.size() + sibling->data.size() <= MERGE_THRESHOLD) {
-        leaf->data.insert(leaf->data.end(), sibling->data.begin(), sibling->data.end());
-        leaf->length = leaf->data.size();
-
-        RopeNode* parent = leaf->parent;
-        leaf->parent = parent->parent;
-
-        if (parent->parent) {
-            if (parent->parent->left == parent) parent->parent->left = leaf;
-            else parent->parent->right = leaf;
-        }
-        else {
-            root = leaf;
-        }
-
-        sibling->left = sibling->right = nullptr;
-        parent->left = parent->right = nullptr;
-        delete sibling;
-        delete parent;
+void RewrapJob::Wait() {
+    for (std::unique_ptr<Run>& run : m_retired) {
+        for (std::thread& worker : run->threads) worker.join();
     }
+    m_retired.clear();
 }
 
-void Rope::deleteLeafNode(RopeNode* node) {
-    if (!node || !node->isLeaf) return;
-
-    RopeNode* parent = node->parent;
-
-    // m_lines에서 data에 해당하는 부분 삭제
-    if (!node->data.empty()) {
-        auto it = node->data.begin();
-        auto itEnd = node->data.begin() + node->data.size() - 1;
-        int eraseCnt = (int)node->data.size();
-        if (*it != *itEnd) lines.erase(*it, *itEnd);
-        lines.erase(*itEnd);
-
-        // 상위 length 업데이트
-        updateLengthUpward(node, -eraseCnt);
-    }
-
-    // 부모가 존재하면 현재 노드를 부모에서 제거
-    if (parent) {
-        if (parent->left == node) parent->left = nullptr;
-        else if (parent->right == node) parent->right = nullptr;
-    }
-
-    delete node;
+bool RewrapJob::TakeBlocks(std::vector<Block>& blocks) {
+    std::lock_guard<std::mutex> lock(m_run->lock);
+    blocks = std::move(m_run->done);
+    m_run->done.clear();
+    m_run->notified = false;
+    return m_run->finished == m_run->ranges.size();
 }
 
-void Rope::deleteAllNodes(RopeNode* node) {
-    // 스택 기반 반복적 삭제
-    std::stack<RopeNode*> nodeStack;
-    if (node) nodeStack.push(node);
-
-    while (!nodeStack.empty()) {
-        RopeNode* current = nodeStack.top();
-        nodeStack.pop();
-
-        // 자식 노드들을 스택에 추가
-        if (current->right) nodeStack.push(current->right);
-        if (current->left) nodeStack.push(current->left);
-
-        // 현재 노드 삭제
-        delete current;
-    }
-}
-
-// 트리 불균형 체크 함수 : 최소 깊이와 최대 깊이가 2배이면 불균형
-bool Rope::isUnbalanced() {
-    if (!root || root->isLeaf) return false;
-
-    int maxDepth = getMaxDepth(root);
-    int minDepth = getMinDepth(root);
-
-    // 최대 깊이가 최소 깊이의 2배 이상이면 불균형 상태로 간주
-    return (maxDepth > minDepth * 2);
-}
-
-// 최대 깊이 계산
-int Rope::getMaxDepth(RopeNode* node) {
-    if (!node) return 0;
-    if (node->isLeaf) return 1;
-
-    int leftDepth = getMaxDepth(node->left);
-    int rightDepth = getMaxDepth(node->right);
-
-    return 1 + max(leftDepth, rightDepth);
-}
-
-// 최소 깊이 계산
-int Rope::getMinDepth(RopeNode* node) {
-    if (!node) return 0;
-    if (node->isLeaf) return 1;
-
-    // 자식 노드가 없는 경우 처리
-    if (!node->left) return 1 + getMinDepth(node->right);
-    if (!node->right) return 1 + getMinDepth(node->left);
-
-    int leftDepth = getMinDepth(node->left);
-    int rightDepth = getMinDepth(node->right);
-
-    return 1 + min(leftDepth, rightDepth);
-}
-
-
-void Rope::eraseRange(size_t startLine, size_t eraseSize) {
-    if (eraseSize == 0) return; // 유효하지 않은 범위 방지
-
-    size_t startOffset, endOffset;
-    RopeNode* startNode = findLeaf(root, startLine, startOffset);
-    RopeNode* endNode = findLeaf(root, startLine + eraseSize - 1, endOffset);
-
-    if (!startNode || !endNode) return; // 노드가 존재하지 않는 경우
-
-    // 1. startNode에서 startOffset 이후의 데이터를 제거
-    if (startNode == endNode) {
-        // 같은 노드에 startLine과 endLine이 있는 경우
-        auto it = startNode->data.begin() + startOffset;
-        auto itEnd = startNode->data.begin() + endOffset;
-        if (*it != *itEnd) lines.erase(*it, *itEnd); // 실제 텍스트 영역 삭제
-        lines.erase(*itEnd); // 마지막 삭제
-        startNode->data.erase(it, itEnd + 1); // 노드에서 이터레이터 삭제
-        startNode->length = startNode->data.size();
-        updateLengthUpward(startNode, -(int)eraseSize);
-    }
-    else {
-        // 2. startNode의 startOffset 이후의 데이터 삭제
-        auto it = startNode->data.begin() + startOffset;
-        auto itEnd = startNode->data.begin() + startNode->data.size() - 1;
-        if (*it != *itEnd) lines.erase(*it, *itEnd); // 실제 텍스트 영역 삭제
-        lines.erase(*itEnd); // 마지막 삭제
-        startNode->data.erase(it, startNode->data.end());
-        size_t removedCount = startNode->length - startOffset;
-        startNode->length = startNode->data.size();
-        updateLengthUpward(startNode, -(int)removedCount);
-
-        // 3. endNode의 앞부분 데이터 삭제
-        it = endNode->data.begin();
-        itEnd = endNode->data.begin() + endOffset;
-        if (*it != *itEnd) lines.erase(*it, *itEnd); // 실제 텍스트 영역 삭제
-        lines.erase(*itEnd); // 마지막 삭제
-        endNode->data.erase(it, itEnd + 1);
-        removedCount = endOffset;
-        endNode->length = endNode->data.size();
-        updateLengthUpward(endNode, -(int)removedCount);
-
-        // 4. startNode와 endNode 사이의 노드들을 제거
-        size_t nextOffset = 0;
-        while (startNode) {
-            size_t nextIndex = startLine + startNode->length - startOffset; // 다음 노드의 시작점
-            RopeNode* nextNode = findLeaf(root, nextIndex, nextOffset);
-            if (!nextNode || nextNode == endNode) break;
-
-            deleteLeafNode(nextNode); // 중간 노드 삭제
-        }
-
-        // 5. 트리 재구성
-        balanceRope();
-    }
-}
-
-// 휴리스틱 최적화
-void Rope::balanceRope() {
-    if (!root || root->isLeaf) return;
-
-    // 리프 노드를 수집
-    std::list<RopeNode*> leaves;
-    collectLeafNodes(root, leaves);
-    if (leaves.empty()) {
-        std::cerr << "오류: collectLeafNodes가 리프 노드를 수집하지 못함!" << std::endl;
-        exit(1);
-    }
-
-    // 내부 노드를 수집
-    std::vector<RopeNode*> internals;
-    collectInternalNodes(root, internals);
-
-    for (auto node : internals) {
-        if (node == root) continue;
-        node->left = node->right = nullptr;
-        delete node;
-    }
-
-    // 새로운 균형 잡힌 트리 구축
-    RopeNode* newRoot = buildBalancedTree(leaves, 0, (int)leaves.size() - 1);
-    if (!newRoot) {
-        std::cerr << "오류: buildBalancedTree가 새로운 트리를 생성하지 못함!" << std::endl;
-        exit(1);
-    }
-
-    // 기존 root를 삭제 : leaf 노드라면 newRoot에 포함되어있음.
-    if (!root->isLeaf) {
-        delete root;
-        root = nullptr;
-    }
-
-    // 기존 root를 새로운 루트로 교체
-    root = newRoot;
-
-    updateNodeLengths(root);
-}
-
-void Rope::insertMultiple(size_t lineIndex, std::list<std::wstring>& newLines) {
-    if (!root) return;
-    bool isEnd = false;
-    size_t insertIndex = lineIndex;
-    if (lineIndex >= lines.size()) {
-        isEnd = true;
-        insertIndex = lines.size(); // lines.size()와 같으면 end()라고 보자.
-    }
-
-    // 삽입 지점의 리프 노드를 삽입할 부분의 좌우로 분할 : end()이면 back에 붙여넣기.
-    size_t offset;
-    RopeNode* divLeaf = findLeaf(root, insertIndex, offset);
-    if (!divLeaf || isEnd) isEnd = true;
-    else if (offset > 0 && offset < divLeaf->data.size()) {
-        splitNodeByExact(divLeaf, offset);
-    }
-    divLeaf = findLeaf(root, insertIndex, offset); // 분할되었으면 다시 지정
-    auto insertPos = getIterator(insertIndex);
-    // 리프 노드를 수집
-    std::list<RopeNode*> leaves;
-    collectLeafNodes(root, leaves);
-    if (leaves.empty()) {
-        std::cerr << "오류: collectLeafNodes가 리프 노드를 수집하지 못함!" << std::endl;
-        exit(1);
-    }
-    // 내부 노드를 수집 및 삭제
-    std::vector<RopeNode*> internals;
-    collectInternalNodes(root, internals);
-
-    for (auto node : internals) {
-        if (node == root) continue;
-        delete node;
-    }
-
-    // 데이터 만들기 : lines, leafNode
-    std::list<RopeNode*> newLeafNodes;
-
-    RopeNode* addLeaf = new RopeNode();
-    addLeaf->isLeaf = true;
-    addLeaf->length = 0;
-    addLeaf->left = addLeaf->right = addLeaf->parent = nullptr;
-
-    for (auto it = newLines.begin(); it != newLines.end(); ++it) {
-        // 현재 리프 노드에 라인 추가
-        addLeaf->data.push_back(it);
-        addLeaf->length++;
-
-        // 현재 리프 노드가 가득 찼는지 확인
-        if (addLeaf->length >= SPLIT_THRESHOLD) {
-            newLeafNodes.push_back(addLeaf);
-            addLeaf = new RopeNode();
-            addLeaf->isLeaf = true;
-            addLeaf->length = 0;
-            addLeaf->left = addLeaf->right = addLeaf->parent = nullptr;
-        }
-    }
-
-    // 마지막 리프 노드 처리
-    if (addLeaf->length > 0) {
-        newLeafNodes.push_back(addLeaf);
-    }
-    else {
-        delete addLeaf;
-    }
-
-    // 데이터 붙이기
-    if (isEnd) {
-        lines.splice(lines.end(), newLines);
-        leaves.splice(leaves.end(), newLeafNodes);
-    }
-    else {
-        if (insertPos != lines.end()) lines.splice(insertPos, newLines);
-        else lines.splice(lines.end(), newLines);
-
-        bool isFound = false;
-        if (!divLeaf) {
-            leaves.splice(leaves.end(), newLeafNodes);
-        }
-        else {
-            auto insertIt = leaves.end();
-            for (auto it = leaves.begin(); it != leaves.end(); ++it) {
-                if (*it == divLeaf) {
-                    insertIt = it;
-                    isFound = true;
-                    break;
-                }
-            }
-            if (isFound) {
-                leaves.splice(insertIt, newLeafNodes);
-            }
-            else {
-                leaves.splice(leaves.end(), newLeafNodes);
+// 블록 하나를 끝낼 때마다 결과를 넘기고, 가져가지 않은 알림이 없을 때만 메시지를 보낸다. (메시지 큐를 채우지 않도록)
+// 예외가 스레드 밖으로 나가면 프로그램이 끝나므로 여기서 받아서 작업 전체를 실패로 알린다.
+void RewrapJob::Work(Run* run, GlyphAdvanceCache::MeasureRun measureRun, bool fixedPitch) {
+    try {
+        GlyphAdvanceCache advances(measureRun, fixedPitch);
+        while (!run->cancel) {
+            size_t seq = run->nextBlock++;
+            if (seq >= run->ranges.size()) break;
+
+            Block block;
+            const std::pair<size_t, size_t>& range = run->ranges[(run->firstRange + seq) % run->ranges.size()];
+            block.first = range.first;
+            block.count = range.second;
+            run->snapshot->forEachLine(block.first, block.count, [&](size_t lineIndex, std::wstring_view line) {
+                if (run->cancel) return false;
+                size_t wraps = line.empty() ? 0 : run->countWraps(line, advances);
+                if (wraps) block.wraps.emplace_back(lineIndex, (uint32_t)wraps);
+                return true;
+            });
+            if (run->cancel) break;
+
+            std::lock_guard<std::mutex> lock(run->lock);
+            run->done.push_back(std::move(block));
+            run->finished++;
+            if (!run->notified) {
+                run->notified = true;
+                ::PostMessage(run->notify, WM_NEMO_REWRAP, 0, 0);
             }
         }
     }
-    // 새로운 균형 잡힌 트리 구축
-    RopeNode* newRoot = buildBalancedTree(leaves, 0, (int)leaves.size() - 1);
-    if (!newRoot) {
-        std::cerr << "오류: buildBalancedTree가 새로운 트리를 생성하지 못함!" << std::endl;
-        exit(1);
-    }
-    // 기존 root를 삭제 : leaf 노드라면 newRoot에 포함되어있음.
-    if (!root->isLeaf) {
-        delete root;
-        root = nullptr;
+    catch (const RopeReadError&) {
+        // 스왑된 리프를 읽지 못함
+        Fail(run);
     }
-
-    // 기존 root를 새로운 루트로 교체
-    root = newRoot;
-
-    updateNodeLengths(root);
-}
-
-void Rope::collectLeafNodes(RopeNode* node, std::list<RopeNode*>& leaves) {
-    if (!node) return;
-
-    if (node->isLeaf) {
-        node->parent = nullptr; // 부모 초기화
-        node->left = nullptr;   // 기존 내부 노드 참조 제거
-        node->right = nullptr;  // 기존 내부 노드 참조 제거
-        leaves.push_back(node);
-        return;
+    catch (...) {
+        // 메모리 부족 등
+        Fail(run);
     }
 
-    if (node->left) collectLeafNodes(node->left, leaves);
-    if (node->right) collectLeafNodes(node->right, leaves);
-}
-
-void Rope::collectInternalNodes(RopeNode* node, std::vector<RopeNode*>& internals) {
-    if (!node || node->isLeaf) return;
-
-    internals.push_back(node);
-
-    if (node->left) collectInternalNodes(node->left, internals);
-    if (node->right) collectInternalNodes(node->right, internals);
+    // 멈춘 작업의 마지막 스레드면 메인 스레드가 Reap하도록 알림
+    // (Cancel은 cancel을 세운 뒤 active를 보고, 여기서는 active를 줄인 뒤 cancel을 보므로 둘 중 한쪽은 반드시 정리함)
+    if (--run->active == 0 && run->cancel) ::PostMessage(run->notify, WM_NEMO_REWRAP, 0, 0);
 }
 
-// 초기 start=0, end=leaves.size()-1로 호출 : 3개면 0, 2
-RopeNode* Rope::buildBalancedTree(std::list<RopeNode*>& leaves, int start, int end) {
-    // 1️. Base Case: start가 end보다 크다면, 트리가 형성될 수 없으므로 nullptr 반환
-    if (start > end) return nullptr;
-
-    auto itStart = leaves.begin();
-    std::advance(itStart, start);
-    auto itEnd = std::next(itStart, end - start);  // start 기준으로 end까지 이동
-    auto itLimit = leaves.end();
-    // 2️. Base Case: start와 end가 같다면, 하나의 리프 노드만 존재하는 것이므로 이를 반환
-    if (start == end) {
-        if (itStart == itLimit) return nullptr;
-
-        (*itStart)->parent = nullptr;  // 부모 초기화 (추후 상위 노드에서 설정)
-        (*itStart)->isLeaf = true;      // 리프 노드로 설정
-        return (*itStart);  // 단일 리프 노드를 반환
-    }
-
-    // 3️. 중간 인덱스 선택 (이진 균형 트리를 만들기 위해 중앙 분할)
-    int mid = start + (end - start) / 2;
-
-    // 4️. 새로운 내부 노드 생성 (isLeaf = false)
-    RopeNode* node = new RopeNode();
-    node->isLeaf = false;
-    node->left = nullptr;
-    node->right = nullptr;
-    node->parent = nullptr;  // 부모 초기화 (추후 상위 노드에서 설정)
-
-    // 5️. 왼쪽 서브트리 구성
-    node->left = buildBalancedTree(leaves, start, mid);
-    if (node->left) {
-        if (node->left == node) {  // 오류 체크: 자기 참조 방지
-            node->left = nullptr;
-        }
-        node->left->parent = node;  // 부모 설정
-    }
-
-    // 6️. 오른쪽 서브트리 구성
-    node->right = buildBalancedTree(leaves, mid + 1, end);
-    if (node->right) {
-        if (node->right == node) {  // 오류 체크: 자기 참조 방지
-            node->right = nullptr;
-        }
-        node->right->parent = node;  // 부모 설정
+void RewrapJob::Fail(Run* run) {
+    run->cancel = true;
+    std::lock_guard<std::mutex> lock(run->lock);
+    run->failed = true;
+    if (!run->notified) {
+        run->notified = true;
+        ::PostMessage(run->notify, WM_NEMO_REWRAP, 0, 0);
     }
-
-    return node;  // 균형 잡힌 내부 노드 반환
 }
 
-size_t Rope::updateNodeLengths(RopeNode* node) {
-    if (node == nullptr) return 0;
-
-    // 리프 노드인 경우
-    if (node->isLeaf) {
-        node->length = node->data.size(); // 문자열 길이를 weight로 설정
-        return node->length;
-    }
-
-    // 내부 노드: 좌우 자식의 Length를 재귀적으로 계산
-    node->length = (node->left != nullptr) ? updateNodeLengths(node->left) : 0;
-    size_t rightLength = (node->right != nullptr) ? updateNodeLengths(node->right) : 0;
-
-    return node->length + rightLength;
+bool RewrapJob::HasFailed() {
+    if (!m_run) return false;
+    std::lock_guard<std::mutex> lock(m_run->lock);
+    return m_run->failed;
 }
 
 // ---------------------------------------------------
@@ -4213,7 +3923,9 @@ inline D2D1::ColorF ColorRefToColorF(COLORREF color) {
 
 // D2Render 클래스 구현
 D2Render::D2Render()
-    : m_fontName(L"Consolas")
+    : m_advances([this](const wchar_t* text, size_t length, float* prefix) { return MeasureRun(text, length, prefix); }, false)
+    , m_fixedPitch(false)
+    , m_fontName(L"Consolas")
     , m_fontSize(16.0f)
     , m_fontWeight(DWRITE_FONT_WEIGHT_NORMAL)
     , m_fontStyle(DWRITE_FONT_STYLE_NORMAL)
@@ -4495,18 +4207,32 @@ void D2Render::SetSelectionColors(COLORREF textColor, COLORREF bgColor) {
     }
 }
 
+// 폭을 잴 때마다 레이아웃을 만들지 않도록 문자 폭 캐시를 거친다.
 float D2Render::GetTextWidth(const std::wstring& line) {
     if (!m_initialized || !m_pDWriteFactory || !m_pTextFormat || line.empty()) {
         return 0.0f;
     }
+    return m_advances.GetTextWidth(line.data(), line.size());
+}
 
-    CComPtr<IDWriteTextLayout> textLayout;
-    HRESULT hr = m_pDWriteFactory->CreateTextLayout(
-        line.c_str(),
-        static_cast<UINT32>(line.length()),
-        m_pTextFormat,
+float D2Render::MeasureRun(const wchar_t* text, size_t length, float* prefix) {
+    return MeasureLayout(m_pDWriteFactory, m_pTextFormat,
         static_cast<float>(m_width * 2),  // 넉넉한 최대 너비
-        static_cast<float>(m_textMetrics.lineHeight),
+        static_cast<float>(m_textMetrics.lineHeight), text, length, prefix);
+}
+
+// 공유 팩토리와 텍스트 포맷은 여러 스레드가 함께 써도 되고, 레이아웃은 호출마다 따로 만든다.
+// 누적 폭은 레이아웃 하나의 클러스터 폭을 논리 순서대로 더한다. (오른쪽에서 왼쪽 문자도 누적 폭은 늘어나기만 함)
+// 클러스터 안쪽 위치는 클러스터 시작과 같은 폭으로 둔다.
+float D2Render::MeasureLayout(IDWriteFactory* factory, IDWriteTextFormat* format, float maxWidth, float height, const wchar_t* text, size_t length, float* prefix) {
+    if (prefix) std::fill(prefix, prefix + length + 1, 0.0f);
+    CComPtr<IDWriteTextLayout> textLayout;
+    HRESULT hr = factory->CreateTextLayout(
+        text,
+        static_cast<UINT32>(length),
+        format,
+        prefix ? D2D1::FloatMax() : maxWidth,  // 누적 폭은 줄바꿈 없이 한 줄로
+        height,
         &textLayout
     );
 
@@ -4514,6 +4240,28 @@ float D2Render::GetTextWidth(const std::wstring& line) {
         return 0.0f;
     }
 
+    if (prefix) {
+        UINT32 clusterCount = 0;
+        textLayout->GetClusterMetrics(nullptr, 0, &clusterCount);
+        std::vector<DWRITE_CLUSTER_METRICS> clusters(clusterCount);
+        if (clusterCount == 0 || FAILED(textLayout->GetClusterMetrics(clusters.data(), clusterCount, &clusterCount))) {
+            return 0.0f;
+        }
+
+        size_t pos = 0;
+        float width = 0.0f;
+        for (const DWRITE_CLUSTER_METRICS& cluster : clusters) {
+            for (UINT16 i = 0; i < cluster.length && pos < length; i++) {
+                prefix[pos++] = width;
+            }
+            width += cluster.width;
+        }
+        while (pos <= length) {
+            prefix[pos++] = width;
+        }
+        return width;
+    }
+
     DWRITE_TEXT_METRICS metrics;
     hr = textLayout->GetMetrics(&metrics);
     if (FAILED(hr)) {
@@ -4522,6 +4270,29 @@ float D2Render::GetTextWidth(const std::wstring& line) {
     return metrics.widthIncludingTrailingWhitespace;
 }
 
+// 폰트를 바꾸면 텍스트 포맷을 새로 만들므로, 붙잡아 둔 포맷은 부른 시점의 폰트로 잰다. (NemoEdit는 폰트를 바꾸면 작업을 다시 시작)
+GlyphAdvanceCache::MeasureRun D2Render::GetWorkerMeasureRun() {
+    if (!m_initialized || !m_pDWriteFactory || !m_pTextFormat) {
+        return nullptr;
+    }
+    CComPtr<IDWriteFactory> factory = m_pDWriteFactory;
+    CComPtr<IDWriteTextFormat> format = m_pTextFormat;
+    float maxWidth = static_cast<float>(m_width * 2);
+    float height = static_cast<float>(m_textMetrics.lineHeight);
+    return [factory, format, maxWidth, height](const wchar_t* text, size_t length, float* prefix) {
+        return MeasureLayout(factory, format, maxWidth, height, text, length, prefix);
+    };
+}
+
+// 고정폭 폰트는 문자 폭 캐시로, 비례 폰트나 셰이핑이 필요한 라인은 레이아웃 하나로 잰다.
+void D2Render::GetPrefixWidths(const std::wstring& line, std::vector<float>& prefix) {
+    prefix.assign(line.size() + 1, 0.0f);
+    if (!m_initialized || !m_pDWriteFactory || !m_pTextFormat || line.empty()) {
+        return;
+    }
+    m_advances.GetPrefixWidths(line.data(), line.size(), prefix.data());
+}
+
 // 텍스트 내의 각 문자 위치(오프셋)를 픽셀 단위로 측정
 std::vector<int> D2Render::MeasureTextPositions(const std::wstring& text) {
     std::vector<int> positions;
@@ -4753,6 +4524,11 @@ void D2Render::UpdateTextMetrics() {
         return;
     }
 
+    // 고정폭 폰트만 문자별 폭을 더해서 잰다. (비례 폰트는 커닝, 합자 때문에 레이아웃으로)
+    CComQIPtr<IDWriteFont1> font1(font);
+    m_fixedPitch = font1 && font1->IsMonospacedFont();
+    m_advances.Reset(m_fixedPitch);
+
     // 메트릭스 가져오기
     DWRITE_FONT_METRICS fontMetrics;
     font->GetMetrics(&fontMetrics);
@@ -4777,8 +4553,10 @@ bool D2Render::CreateTextFormat() {
         return false;
     }
 
-    // 기존 텍스트 포맷 해제
+    // 기존 텍스트 포맷 해제 (문자 폭도 폰트마다 다르므로 비움)
     m_pTextFormat = nullptr;
+    m_fixedPitch = false; // UpdateTextMetrics에서 폰트를 확인할 때까지는 레이아웃으로 잰다.
+    m_advances.Reset(m_fixedPitch);
     m_pLineNumFormat = nullptr;
 
     // 메인 텍스트 포맷 생성
@@ -4953,3 +4731,560 @@ void D2Render::LogRenderTargetState() {
     }
     TRACE(L"----------------------\n");
 }
+
+#ifdef NEMO_BENCH
+// ---------------------------------------------------
+// NemoBench : 성능 측정 하네스 (NEMO_BENCH를 정의했을 때만 빌드)
+// ---------------------------------------------------
+#include <chrono>
+#include <iomanip>
+
+// start부터 지난 밀리초
+static double BenchElapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void BenchRow(std::wostream& out, const wchar_t* name, double ms) {
+    out << L"  " << name << L" : " << std::fixed << std::setprecision(2) << ms << L" ms\n";
+}
+
+// 로그 형태의 시험 텍스트 : 시각, 수준, 스레드, 요청 번호가 라인마다 달라서 길이도 조금씩 다름
+static std::wstring BenchCorpus(size_t lines) {
+    static const wchar_t* levels[] = { L"INFO", L"DEBUG", L"WARN", L"ERROR" };
+    std::wstring text;
+    text.reserve(lines * 72);
+    wchar_t line[128];
+    for (size_t i = 0; i < lines; i++) {
+        swprintf(line, 128, L"2024-05-01 %02u:%02u:%02u.%03u [%ls] worker-%u request %u done in %u ms%ls",
+            (unsigned)(i / 3600000 % 24), (unsigned)(i / 60000 % 60), (unsigned)(i / 1000 % 60), (unsigned)(i % 1000),
+            levels[i * 7 % 4], (unsigned)(i % 32), (unsigned)(i * 2654435761u % 1000000), (unsigned)(i * 13 % 500),
+            i + 1 < lines ? L"\r\n" : L"");
+        text += line;
+    }
+    return text;
+}
+
+void NemoBench::Run(std::wostream& out) {
+    ArenaAlloc(out, 2000000);
+    ScanNewlines(out, 1024);
+    TreeBuild(out, 100000);
+    FingerAccess(out, 4000000);
+    MoveLines(out, 4000000);
+    CutPaste(out, 4000000);
+    ColdPack(out, 4000000);
+    LimitsSweep(out, 2000000);
+    MeasureTests(out);
+    MeasureText(out, 200000);
+}
+
+// 예전 구조처럼 라인마다 문자열을 힙에 할당하는 경우와, 같은 라인들을 아레나의 리프 버퍼에 넣고 clear()로 일괄 해제하는 경우를 비교한다.
+void NemoBench::ArenaAlloc(std::wostream& out, size_t lines) {
+    std::wstring text = BenchCorpus(lines);
+    TextLines split;
+    split.text = text.data();
+    split.length = text.size();
+    LineScanner::scan(split.text, split.length, 0, split.length, (size_t)-1, split.breaks);
+    out << L"[arena] lines=" << split.size() << L"\n";
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::list<std::wstring> heapLines;
+        for (size_t i = 0; i < split.size(); i++) heapLines.emplace_back(split.linePtr(i), split.lineLen(i));
+        BenchRow(out, L"heap build (std::list<std::wstring>)", BenchElapsed(start));
+        start = std::chrono::steady_clock::now();
+        heapLines.clear();
+        BenchRow(out, L"heap free", BenchElapsed(start));
+    }
+
+    Rope rope;
+    for (int round = 0; round < 2; round++) {
+        auto start = std::chrono::steady_clock::now();
+        rope.insertMultiple(0, split, 0, split.size());
+        BenchRow(out, round ? L"arena build (reused slabs)" : L"arena build", BenchElapsed(start));
+        start = std::chrono::steady_clock::now();
+        rope.clear();
+        BenchRow(out, L"arena clear (reset)", BenchElapsed(start));
+    }
+
+    // 스냅샷이 살아 있으면 일괄 반환할 수 없으므로 해제를 미뤘다가 스냅샷을 놓은 뒤 노드를 하나씩 반환하는 경로
+    rope.insertMultiple(0, split, 0, split.size());
+    {
+        auto snapshot = rope.snapshot();
+        auto start = std::chrono::steady_clock::now();
+        rope.clear();
+        BenchRow(out, L"arena clear (snapshot alive, deferred)", BenchElapsed(start));
+        snapshot.reset();
+        start = std::chrono::steady_clock::now();
+        rope.clear();
+        BenchRow(out, L"release deferred nodes one by one", BenchElapsed(start));
+    }
+    RopeArenaStats stats = rope.getArenaStats();
+    out << L"  slabs=" << stats.slabCount << L" peak=" << stats.peakBytes / 1024 << L"KB allocs=" << stats.allocCount
+        << L" reused=" << stats.reuseCount << L" resets=" << stats.resetCount << L"\n";
+}
+
+// 예전 SplitTextByNewlines처럼 한 문자씩 보며 줄바꿈 위치를 기록 (\r\n, 단독 \r, \n을 LineScanner와 같게 처리)
+template <typename T>
+static size_t BenchScalarScan(const T* text, size_t len, std::vector<size_t>& breaks) {
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '\r' || text[i] == '\n') {
+            breaks.push_back(i);
+            if (text[i] == '\r' && i + 1 < len && text[i + 1] == '\n') i++;
+        }
+    }
+    return breaks.size();
+}
+
+// SetText 경로(UTF-16)와 파일 로드 경로(UTF-8 바이트)를 각각 문자 단위 검색과 비교하고, 작은 표본으로 예전의 라인별 문자열 분리도 잰다.
+void NemoBench::ScanNewlines(std::wostream& out, size_t megabytes) {
+    std::wstring chunk = BenchCorpus(100000) + L"\r\nlone cr\rlone lf\n";
+    std::wstring text;
+    size_t target = megabytes * 1024 * 1024 / sizeof(wchar_t);
+    text.reserve(target + chunk.size());
+    while (text.size() < target) text += chunk;
+    std::string bytes(text.begin(), text.end()); // 시험 텍스트는 ASCII
+    out << L"[scan] chars=" << text.size() << L"\n";
+
+    std::vector<size_t> breaks, simdBreaks;
+    breaks.reserve(text.size() / 60);
+    simdBreaks.reserve(text.size() / 60);
+    auto start = std::chrono::steady_clock::now();
+    BenchScalarScan(text.data(), text.size(), breaks);
+    BenchRow(out, L"utf-16 scalar", BenchElapsed(start));
+    start = std::chrono::steady_clock::now();
+    LineScanner::scan(text.data(), text.size(), 0, text.size(), (size_t)-1, simdBreaks);
+    BenchRow(out, L"utf-16 LineScanner", BenchElapsed(start));
+    if (breaks != simdBreaks) out << L"  MISMATCH utf-16\n";
+
+    breaks.clear();
+    simdBreaks.clear();
+    start = std::chrono::steady_clock::now();
+    BenchScalarScan((const uint8_t*)bytes.data(), bytes.size(), breaks);
+    BenchRow(out, L"utf-8 scalar", BenchElapsed(start));
+    start = std::chrono::steady_clock::now();
+    LineScanner::scan((const uint8_t*)bytes.data(), bytes.size(), 0, bytes.size(), (size_t)-1, simdBreaks);
+    BenchRow(out, L"utf-8 LineScanner", BenchElapsed(start));
+    if (breaks != simdBreaks) out << L"  MISMATCH utf-8\n";
+    out << L"  lines=" << breaks.size() + 1 << L"\n";
+
+    // 예전 방식 : 라인마다 substr로 문자열을 만들어 std::list에 추가 (메모리 때문에 64MB 표본만)
+    size_t sample = min(text.size(), (size_t)64 * 1024 * 1024 / sizeof(wchar_t));
+    start = std::chrono::steady_clock::now();
+    std::list<std::wstring> lines;
+    size_t lineStart = 0;
+    for (size_t i = 0; i < sample; i++) {
+        if (text[i] == L'\r' || text[i] == L'\n') {
+            lines.push_back(text.substr(lineStart, i - lineStart));
+            if (text[i] == L'\r' && i + 1 < sample && text[i + 1] == L'\n') i++;
+            lineStart = i + 1;
+        }
+    }
+    lines.push_back(text.substr(lineStart, sample - lineStart));
+    double listMs = BenchElapsed(start);
+    TextLines split;
+    start = std::chrono::steady_clock::now();
+    split.text = text.data();
+    split.length = sample;
+    LineScanner::scan(split.text, split.length, 0, split.length, (size_t)-1, split.breaks);
+    BenchRow(out, L"64MB sample, substr + std::list", listMs);
+    BenchRow(out, L"64MB sample, TextLines", BenchElapsed(start));
+}
+// 리프를 작게(16줄) 잡아서 적은 메모리로 리프 수를 늘린다. 리프당 시간이 리프 수와 무관하면 선형.
+void NemoBench::TreeBuild(std::wostream& out, size_t maxLeaves) {
+    const RopeLimits limits = { 16, 8, 64 * 1024 };
+    std::wstring text = BenchCorpus(maxLeaves * limits.splitLines * 2);
+    TextLines split;
+    split.text = text.data();
+    split.length = text.size();
+    LineScanner::scan(split.text, split.length, 0, split.length, (size_t)-1, split.breaks);
+    out << L"[tree build] lines per leaf=" << limits.splitLines << L"\n";
+
+    for (size_t leaves = maxLeaves / 8; leaves <= maxLeaves; leaves *= 2) {
+        size_t lines = leaves * limits.splitLines;
+        out << L"  leaves=" << leaves << L"\n";
+
+        // 빈 문서에 한 번에 (SetText 경로)
+        Rope bulk;
+        bulk.setLimits(limits);
+        auto start = std::chrono::steady_clock::now();
+        bulk.insertMultiple(0, split, 0, lines);
+        double ms = BenchElapsed(start);
+        std::vector<RopeLeaf*> built;
+        for (RopeLeaf* leaf = bulk.firstLeaf(); leaf; leaf = leaf->next) built.push_back(leaf);
+        BenchRow(out, L"bottom-up into empty (with line encoding)", ms);
+        out << L"    " << std::setprecision(1) << ms * 1e6 / built.size() << L" ns/leaf (" << built.size() << L" leaves)\n";
+
+        // 트리 구성만 : 내부 노드를 버리고 같은 리프 배열로 다시 구성
+        bulk.releaseInternals(bulk.root);
+        start = std::chrono::steady_clock::now();
+        bulk.buildFromLeaves(built);
+        ms = BenchElapsed(start);
+        BenchRow(out, L"buildFromLeaves only", ms);
+        out << L"    " << std::setprecision(1) << ms * 1e6 / built.size() << L" ns/leaf\n";
+
+        // 같은 크기의 문서 가운데에 끼움 : 기존 리프와 새 리프를 한 배열로 모아 다시 구성
+        start = std::chrono::steady_clock::now();
+        bulk.insertMultiple(lines / 2, split, lines, lines);
+        ms = BenchElapsed(start);
+        BenchRow(out, L"bottom-up rebuild, insert into equal-size doc", ms);
+        out << L"    " << std::setprecision(1) << ms * 1e6 / (built.size() * 2) << L" ns/leaf\n";
+
+        // 기존 문서보다 적게 끼움 : 리프마다 루트에서 내려가 삽입 (리프당 O(log n))
+        Rope perLeaf;
+        perLeaf.setLimits(limits);
+        perLeaf.insertMultiple(0, split, lines, lines + 1);
+        start = std::chrono::steady_clock::now();
+        perLeaf.insertMultiple(lines / 2, split, 0, lines);
+        ms = BenchElapsed(start);
+        BenchRow(out, L"per-leaf insertLeafAt", ms);
+        out << L"    " << std::setprecision(1) << ms * 1e6 / built.size() << L" ns/leaf\n";
+    }
+}
+
+// OnPaint처럼 임의의 화면 위치에서 60줄을 차례로 읽고, 라인마다 폭, 워드랩, 캐럿 계산이 같은 라인을 두 번 더 읽는 형태
+void NemoBench::FingerAccess(std::wostream& out, size_t lines) {
+    std::wstring text = BenchCorpus(lines);
+    TextLines split;
+    split.text = text.data();
+    split.length = text.size();
+    LineScanner::scan(split.text, split.length, 0, split.length, (size_t)-1, split.breaks);
+    Rope rope;
+    rope.insertMultiple(0, split, 0, split.size());
+    text.clear();
+    text.shrink_to_fit();
+    out << L"[finger] lines=" << rope.getSize() << L"\n";
+
+    const size_t screens = 20000, visible = 60, repeats = 3;
+    std::vector<size_t> tops(screens);
+    uint64_t seed = 88172645463325252ull;
+    for (size_t& top : tops) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        top = (size_t)(seed % (rope.getSize() - visible));
+    }
+
+    size_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t top : tops) {
+        for (size_t i = top; i < top + visible; i++) {
+            for (size_t r = 0; r < repeats; r++) {
+                size_t offset;
+                RopeLeaf* leaf = rope.findLeaf(i, offset);
+                sum += rope.lineView(leaf, offset).size();
+            }
+        }
+    }
+    BenchRow(out, L"findLeaf per line", BenchElapsed(start));
+
+    start = std::chrono::steady_clock::now();
+    for (size_t top : tops) {
+        for (size_t i = top; i < top + visible; i++) {
+            for (size_t r = 0; r < repeats; r++) sum += rope.getLineView(i).size();
+        }
+    }
+    BenchRow(out, L"getLineView (finger)", BenchElapsed(start));
+
+    start = std::chrono::steady_clock::now();
+    for (size_t top : tops) {
+        RopeCursor cursor = rope.cursorAt(top);
+        for (size_t i = 0; i < visible; i++) {
+            sum += rope.getLineView(cursor).size();
+            for (size_t r = 1; r < repeats; r++) sum += rope.getLineView(top + i).size();
+            rope.next(cursor);
+        }
+    }
+    BenchRow(out, L"cursor walk + finger lookups", BenchElapsed(start));
+
+    // 라인 뷰를 만들지 않고 리프 찾기만
+    start = std::chrono::steady_clock::now();
+    for (size_t top : tops) {
+        for (size_t i = top; i < top + visible; i++) {
+            for (size_t r = 0; r < repeats; r++) {
+                size_t offset;
+                rope.findLeaf(i, offset);
+                sum += offset;
+            }
+        }
+    }
+    BenchRow(out, L"lookup only, findLeaf", BenchElapsed(start));
+    start = std::chrono::steady_clock::now();
+    for (size_t top : tops) {
+        for (size_t i = top; i < top + visible; i++) {
+            for (size_t r = 0; r < repeats; r++) {
+                size_t offset;
+                rope.findFingerLeaf(i, offset);
+                sum += offset;
+            }
+        }
+    }
+    BenchRow(out, L"lookup only, findFingerLeaf", BenchElapsed(start));
+    out << L"  (" << screens << L" screens x " << visible << L" lines x " << repeats << L" reads, checksum " << sum % 1000 << L")\n";
+}
+// 블록 이동 : 예전 경로(구간 텍스트를 문자열로 만들고 지운 뒤 다시 분리해서 삽입)와 detachLines/spliceLines를 비교한다.
+void NemoBench::MoveLines(std::wostream& out, size_t lines) {
+    std::wstring text = BenchCorpus(lines);
+    TextLines split;
+    split.text = text.data();
+    split.length = text.size();
+    LineScanner::scan(split.text, split.length, 0, split.length, (size_t)-1, split.breaks);
+    Rope rope;
+    rope.insertMultiple(0, split, 0, split.size());
+    text.clear();
+    text.shrink_to_fit();
+    size_t block = rope.getSize() / 4;
+    out << L"[move lines] lines=" << rope.getSize() << L" block=" << block << L"\n";
+
+    // 앞쪽 블록을 끝으로 옮김 (블록 마지막 라인의 줄바꿈까지 포함해서 라인 단위로 잘라냄)
+    auto start = std::chrono::steady_clock::now();
+    std::wstring moved = rope.getTextRange(0, 0, block, 0);
+    rope.eraseRange(0, block);
+    TextLines movedLines;
+    movedLines.text = moved.data();
+    movedLines.length = moved.size() - 2; // 끝의 \r\n은 다음 라인의 시작
+    LineScanner::scan(movedLines.text, movedLines.length, 0, movedLines.length, (size_t)-1, movedLines.breaks);
+    rope.insertMultiple(rope.getSize(), movedLines, 0, movedLines.size());
+    BenchRow(out, L"getTextRange + eraseRange + scan + insertMultiple", BenchElapsed(start));
+    moved.clear();
+    moved.shrink_to_fit();
+    std::wstring first = rope.getLine(0);
+    std::wstring last = rope.getLine(rope.getSize() - 1);
+
+    start = std::chrono::steady_clock::now();
+    rope.moveLines(0, block, rope.getSize() - block);
+    BenchRow(out, L"moveLines (detach + splice)", BenchElapsed(start));
+    if (rope.getLine(rope.getSize() - block) != first || rope.getLine(rope.getSize() - block - 1) != last) out << L"  MISMATCH\n";
+
+    // 잘라내기/붙여넣기 : 떼어낸 구간을 들고 있다가 다른 위치에 끼움
+    start = std::chrono::steady_clock::now();
+    RopeSlice cut = rope.detachLines(rope.getSize() / 3, block);
+    BenchRow(out, L"detachLines (cut)", BenchElapsed(start));
+    start = std::chrono::steady_clock::now();
+    rope.spliceLines(rope.getSize() / 2, cut);
+    BenchRow(out, L"spliceLines (paste)", BenchElapsed(start));
+
+    // 한 줄 위/아래 이동을 반복 (Alt+Up/Down을 누르고 있는 경우)
+    const size_t steps = 100000;
+    size_t line = rope.getSize() / 2;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < steps; i++, line--) rope.moveLines(line, 1, line - 1);
+    BenchRow(out, L"move one line up x100000", BenchElapsed(start));
+    size_t leaves = 0;
+    for (RopeLeaf* leaf = rope.firstLeaf(); leaf; leaf = leaf->next) leaves++;
+    out << L"  lines=" << rope.getSize() << L" leaves=" << leaves << L"\n";
+}
+// 편집기 명령으로 라인 블록 잘라내기/붙여넣기 : 클립보드 등록, Undo 레코드, 화면 갱신 준비까지 포함한 시간
+// 숨은 부모 창에 컨트롤을 만들어서 부르며, 클립보드 텍스트는 다른 프로그램이 읽는 것처럼 마지막에 따로 읽는다.
+void NemoBench::CutPaste(std::wostream& out, size_t lines) {
+    CWnd parent;
+    if (!parent.CreateEx(0, AfxRegisterWndClass(0), L"NemoBench", WS_OVERLAPPEDWINDOW, 0, 0, 800, 600, nullptr, 0)) {
+        out << L"[cut/paste] window creation failed\n";
+        return;
+    }
+    NemoEdit edit;
+    edit.Create(0, CRect(0, 0, 800, 600), &parent, 1);
+    edit.SetWordWrap(false);
+    edit.SetText(BenchCorpus(lines));
+    int total = (int)edit.m_rope.getSize();
+    int block = total / 4;
+    int from = total / 3;
+    out << L"[cut/paste] lines=" << total << L" block=" << block << L"\n";
+    std::wstring first = edit.m_rope.getLine(from);
+    std::wstring last = edit.m_rope.getLine(from + block - 1);
+    auto select = [&edit](int a, int b) {
+        edit.m_selectInfo.start = edit.m_selectInfo.anchor = TextPos(a, 0);
+        edit.m_selectInfo.end = edit.m_caretPos = TextPos(b, 0);
+        edit.m_selectInfo.isSelected = true;
+    };
+
+    select(from, from + block);
+    auto start = std::chrono::steady_clock::now();
+    edit.Copy();
+    BenchRow(out, L"Copy (text for comparison)", BenchElapsed(start));
+
+    start = std::chrono::steady_clock::now();
+    edit.Cut();
+    BenchRow(out, L"Cut", BenchElapsed(start));
+
+    edit.m_caretPos = TextPos(total / 2, 0);
+    edit.m_selectInfo.start = edit.m_selectInfo.end = edit.m_selectInfo.anchor = edit.m_caretPos;
+    start = std::chrono::steady_clock::now();
+    edit.Paste();
+    BenchRow(out, L"Paste", BenchElapsed(start));
+    if (edit.m_rope.getLine(total / 2) != first || edit.m_rope.getLine(total / 2 + block - 1) != last) out << L"  MISMATCH\n";
+
+    start = std::chrono::steady_clock::now();
+    edit.Undo();
+    edit.Undo();
+    BenchRow(out, L"Undo paste + Undo cut", BenchElapsed(start));
+    start = std::chrono::steady_clock::now();
+    edit.Redo();
+    edit.Redo();
+    BenchRow(out, L"Redo cut + Redo paste", BenchElapsed(start));
+    if ((int)edit.m_rope.getSize() != total || edit.m_rope.getLine(total / 2) != first) out << L"  MISMATCH\n";
+
+    // 지연 렌더링된 클립보드 텍스트를 읽음 (다른 프로그램에서 붙여넣는 경우)
+    start = std::chrono::steady_clock::now();
+    std::wstring clip = edit.LoadClipText();
+    BenchRow(out, L"clipboard text on demand", BenchElapsed(start));
+    if (clip.size() != edit.m_cutChars || clip.compare(0, first.size(), first) != 0) out << L"  MISMATCH\n";
+
+    edit.DestroyWindow();
+    parent.DestroyWindow();
+}
+
+// 차가운 리프 압축 : 상주 메모리(아레나 사용량)를 압축 전후로 비교하고, 화면 위치를 옮겨 가며 읽을 때의 압축 해제 횟수와 시간을 잰다.
+void NemoBench::ColdPack(std::wostream& out, size_t lines) {
+    std::wstring text = BenchCorpus(lines);
+    TextLines split;
+    split.text = text.data();
+    split.length = text.size();
+    LineScanner::scan(split.text, split.length, 0, split.length, (size_t)-1, split.breaks);
+    Rope rope;
+    rope.insertMultiple(0, split, 0, split.size());
+    text.clear();
+    text.shrink_to_fit();
+    size_t rawUsed = rope.getArenaStats().usedBytes;
+    out << L"[cold pack] lines=" << rope.getSize() << L" resident=" << rawUsed / 1024 << L"KB\n";
+
+    // 화면 위치 : 대부분은 현재 위치 근처로 스크롤하고, 가끔 멀리 점프
+    const size_t screens = 20000, visible = 60;
+    std::vector<size_t> tops(screens);
+    uint64_t seed = 88172645463325252ull;
+    size_t top = 0;
+    for (size_t& t : tops) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        if (seed % 50 == 0) top = (size_t)(seed % (rope.getSize() - visible));
+        else top = min(top + visible / 2, rope.getSize() - visible);
+        t = top;
+    }
+    auto readScreens = [&]() {
+        size_t sum = 0;
+        for (size_t t : tops) {
+            for (size_t i = t; i < t + visible; i++) sum += rope.getLineView(i).size();
+        }
+        return sum;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    size_t sum = readScreens();
+    BenchRow(out, L"screens, compression off", BenchElapsed(start));
+
+    start = std::chrono::steady_clock::now();
+    rope.setColdCompression(64);
+    rope.getLine(0); // 다음 읽기 연산의 시작에서 목록 밖의 리프를 압축
+    BenchRow(out, L"compress all cold leaves", BenchElapsed(start));
+    RopePackStats stats = rope.getPackStats();
+    size_t packedUsed = rope.getArenaStats().usedBytes;
+    out << L"  leaves=" << stats.packedLeaves << L" raw=" << stats.rawBytes / 1024 << L"KB packed=" << stats.packedBytes / 1024
+        << L"KB (" << std::setprecision(2) << (double)stats.rawBytes / max(stats.packedBytes, (size_t)1) << L"x) resident="
+        << packedUsed / 1024 << L"KB (" << (double)rawUsed / max(packedUsed, (size_t)1) << L"x)\n";
+
+    start = std::chrono::steady_clock::now();
+    sum += readScreens();
+    BenchRow(out, L"screens, compression on (hot 64 leaves)", BenchElapsed(start));
+    RopePackStats after = rope.getPackStats();
+    out << L"  unpack=" << after.unpackCount - stats.unpackCount << L" pack=" << after.packCount - stats.packCount
+        << L" (" << screens << L" screens, checksum " << sum % 1000 << L")\n";
+}
+// 리프 크기 한도 비교 : 같은 작업 흐름을 RopeLimits 설정마다 돌려서 작업별로 가장 빠른 설정을 고른다.
+// 팬아웃은 컴파일 상수라서 -DNODE_FANOUT=32 처럼 값을 바꿔 다시 빌드하고 같은 표를 비교한다.
+void NemoBench::LimitsSweep(std::wostream& out, size_t lines) {
+    struct Config { const wchar_t* name; RopeLimits limits; };
+    const Config configs[] = {
+        { L"smallEdits", RopeLimits::smallEdits() },
+        { L"512/256/32K", { 512, 256, 32 * 1024 } },
+        { L"default", RopeLimits() },
+        { L"4000/2000/256K", { 4000, 2000, 256 * 1024 } },
+        { L"hugeLogs", RopeLimits::hugeLogs() },
+    };
+    const wchar_t* workloads[] = { L"edit", L"load", L"append", L"paint", L"getLine", L"eraseRange" };
+    const size_t configCount = sizeof(configs) / sizeof(configs[0]), workloadCount = sizeof(workloads) / sizeof(workloads[0]);
+    double ms[sizeof(configs) / sizeof(configs[0])][sizeof(workloads) / sizeof(workloads[0])];
+
+    std::wstring text = BenchCorpus(lines);
+    TextLines split;
+    split.text = text.data();
+    split.length = text.size();
+    LineScanner::scan(split.text, split.length, 0, split.length, (size_t)-1, split.breaks);
+    const size_t editLines = 20000, edits = 200000, appends = 200000, screens = 20000, visible = 60, reads = 1000000, ranges = 1000;
+    out << L"[limits sweep] fanout=" << NODE_FANOUT << L" edit doc=" << editLines << L" lines, log=" << split.size() << L" lines\n";
+
+    for (size_t c = 0; c < configCount; c++) {
+        uint64_t seed = 88172645463325252ull;
+        auto random = [&seed](size_t n) { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return (size_t)(seed % n); };
+
+        // 작은 문서 편집 : 캐럿 근처에서 글자 입력, 삭제, 엔터, 줄 합치기 (가끔 멀리 이동)
+        Rope doc;
+        doc.setLimits(configs[c].limits);
+        doc.insertMultiple(0, split, 0, editLines);
+        auto start = std::chrono::steady_clock::now();
+        size_t caret = 0;
+        for (size_t i = 0; i < edits; i++) {
+            if (random(100) == 0) caret = random(doc.getSize());
+            caret = min(caret, doc.getSize() - 1);
+            size_t len = doc.getLineSize(caret);
+            switch (random(10)) {
+            case 0: doc.splitLine(caret, random(len + 1)); caret++; break;
+            case 1: if (caret + 1 < doc.getSize()) doc.mergeLine(caret); break;
+            case 2: case 3: if (len > 0) doc.eraseAt(caret, random(len), 1); break;
+            default: doc.insertAt(caret, random(len + 1), L"x"); break;
+            }
+        }
+        ms[c][0] = BenchElapsed(start);
+
+        // 큰 로그 : 한 번에 읽고, 끝에 덧붙이고, 화면 단위와 임의 위치로 읽고, 구간을 지움
+        Rope log;
+        log.setLimits(configs[c].limits);
+        start = std::chrono::steady_clock::now();
+        log.insertMultiple(0, split, 0, split.size());
+        ms[c][1] = BenchElapsed(start);
+
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < appends; i++) log.insertBack(std::wstring_view(split.linePtr(i), split.lineLen(i)));
+        ms[c][2] = BenchElapsed(start);
+
+        size_t sum = 0;
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < screens; i++) {
+            RopeCursor cursor = log.cursorAt(random(log.getSize() - visible));
+            for (size_t j = 0; j < visible; j++, log.next(cursor)) sum += log.getLineView(cursor).size();
+        }
+        ms[c][3] = BenchElapsed(start);
+
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < reads; i++) sum += log.getLine(random(log.getSize())).size();
+        ms[c][4] = BenchElapsed(start);
+
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < ranges; i++) log.eraseRange(random(log.getSize() - 1000), 1000);
+        ms[c][5] = BenchElapsed(start);
+        if (sum == 0) out << L"  (empty)\n";
+    }
+
+    out << L"  " << std::setw(16) << std::left << L"ms" << std::right;
+    for (size_t w = 0; w < workloadCount; w++) out << std::setw(11) << workloads[w];
+    out << L"\n";
+    for (size_t c = 0; c < configCount; c++) {
+        out << L"  " << std::setw(16) << std::left << configs[c].name << std::right;
+        for (size_t w = 0; w < workloadCount; w++) out << std::setw(11) << std::fixed << std::setprecision(1) << ms[c][w];
+        out << L"\n";
+    }
+    out << L"  best :";
+    for (size_t w = 0; w < workloadCount; w++) {
+        size_t best = 0;
+        for (size_t c = 1; c < configCount; c++) if (ms[c][w] < ms[best][w]) best = c;
+        out << L" " << workloads[w] << L"=" << configs[best].name;
+    }
+    out << L"\n";
+}
+
+// ---------------------------------------------------
+// NemoBench 텍스트 측정 : 문자별 폭 표 측정기로 DirectWrite 없이 워드랩과 히트 테스트를 시험하고 잰다.
+// ---------------------------------------------------
+bool NemoBench::MeasureTests(std::wostream& out) {
+    return RunMeasureTests(out);
+}
+
+void NemoBench::MeasureText(std::wostream& out, size_t lines) {
+    RunMeasureBench(out, lines);
+}
+#endif
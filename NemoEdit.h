@@ -22,91 +22,37 @@
 #include <afxwin.h>
 #include <list>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <deque>
 #include <imm.h>
 #include <map>
+#include <unordered_map>
 #include <iostream>
 #include <functional>
 #include <optional>
 #include <stack>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
 #include <d2d1.h>
 #include <dwrite.h>
+#include <dwrite_1.h>
 #include <atlbase.h>
-
-#define SPLIT_THRESHOLD         2000
-#define MERGE_THRESHOLD     1000
+#include "NemoMeasure.h"
+#include "NemoRope.h"
 
 #define CURSOR_UP 1
 #define CURSOR_DOWN -1
 
 using namespace std;
 
-class RopeNode {
-public:
-    std::vector<std::list<std::wstring>::iterator> data;  // 리프 노드의 라인 이터레이터들
-    size_t      length;  // 이 노드(서브트리)가 보유한 총 라인 수
-    RopeNode* left;
-    RopeNode* right;
-    RopeNode* parent;
-    bool        isLeaf;
-
-    RopeNode() : length(0), left(nullptr), right(nullptr), parent(nullptr), isLeaf(true) { data.reserve(SPLIT_THRESHOLD + 1);  }
-    ~RopeNode() { data.clear(); }
-};
-
-class Rope {
-private:
-    RopeNode* root;    // Rope 트리의 루트 노드
-    size_t m_balanceCnt; // 트리 재조정용 체크 카운터
-
-    // 내부 함수
-    RopeNode* findLeaf(RopeNode* node, size_t idx, size_t& offset);
-    void updateLengthUpward(RopeNode* node, int addCnt); // 현재 leafNode에서부터 root까지 parent만 타고가면서 length 변경사항 적용
-    void splitNode(RopeNode* leaf);
-    bool splitNodeByExact(RopeNode* leaf, size_t cutSize); // 중간삽입시 분리용
-    void mergeIfNeeded(RopeNode* leaf);
-    void deleteLeafNode(RopeNode* node);
-    void deleteAllNodes(RopeNode* node);
-
-    // 휴리스틱 최적화
-    void balanceRope();
-    void collectLeafNodes(RopeNode* node, std::list<RopeNode*>& leaves);
-    void collectInternalNodes(RopeNode* node, std::vector<RopeNode*>& internals);
-    RopeNode* buildBalancedTree(std::list<RopeNode*>& leaves, int start, int end);
-    size_t updateNodeLengths(RopeNode* node); // root에 걸어서 length 재계산
-    bool isUnbalanced();
-    int getMaxDepth(RopeNode* node);
-    int getMinDepth(RopeNode* node);
-
-public:
-    std::list<std::wstring> lines;  // 원본 텍스트 라인 저장소
-
-    Rope();
-    ~Rope();
-    // 핵심 연산들:
-    void insert(size_t lineIndex, const std::wstring& text);
-    void insertAt(size_t lineIndex, size_t offset, const std::wstring& text);
-    void insertBack(const std::wstring& text);
-    void insertMultiple(size_t lineIndex, std::list<std::wstring>& newLines);
-    void erase(size_t lineIndex);
-    void eraseAt(size_t lineIndex, size_t offset, size_t size);
-    void eraseRange(size_t startLine, size_t endLine);
-    void update(size_t lineIndex, const std::wstring& newText);
-    void mergeLine(size_t lineIndex);
-    bool clear(); // 전체 초기화
-    bool empty(); // lines.empty()
-    std::list<std::wstring>::iterator getIterator(size_t lineIndex); // lines의 해당 라인 it
-    std::list<std::wstring>::iterator getEnd(); // lines의 end
-    std::list<std::wstring>::iterator getBegin(); // lines의 begin
-    size_t getSize(); // 전체 줄수
-    size_t getLineSize(size_t lineIndex); // 라인 사이즈
-    std::wstring getLine(size_t lineIndex); // 라인 텍스트
-    std::wstring getText(); // 전체 텍스트
-    std::wstring getTextRange(size_t startLineIndex, size_t startLineColum, size_t endLineIndex, size_t endLineColumn); // 구간 텍스트
-};
-
 // TextMetrics 구조체 정의
 struct TextMetrics {
     float ascent;                    // 기준선에서 문자의 최상단까지의 거리
@@ -122,7 +68,7 @@ struct TextMetrics {
 };
 
 // D2Render 클래스 정의
-class D2Render {
+class D2Render : public TextMeasurer {
 public:
     D2Render();                      // 생성자: 기본값으로 객체 초기화
     ~D2Render();                     // 소멸자: 리소스 해제
@@ -149,10 +95,13 @@ public:
     void SetSelectionColors(COLORREF textColor, COLORREF bgColor);  // 선택 영역 색상 설정
 
     // 텍스트 측정 및 분석
-    float GetTextWidth(const std::wstring& line);  // 텍스트 문자열의 픽셀 너비 계산
+    float GetTextWidth(const std::wstring& line);  // 텍스트 문자열의 픽셀 너비 계산 (문자 폭 캐시 사용)
+    void GetPrefixWidths(const std::wstring& line, std::vector<float>& prefix);  // 문자 위치별 누적 폭 (셰이핑이 필요하면 클러스터 폭으로)
     std::vector<int> MeasureTextPositions(const std::wstring& text);  // 텍스트 내의 각 문자 위치(오프셋)를 픽셀 단위로 측정
     TextMetrics GetTextMetrics() const;  // 현재 폰트의 메트릭스(높이, 간격 등) 정보 반환
     float GetLineHeight() const;     // 현재 폰트의 줄 높이 반환
+    GlyphAdvanceCache::MeasureRun GetWorkerMeasureRun();  // 팩토리와 텍스트 포맷을 붙잡아 둔 측정 함수 (초기화 전이면 nullptr)
+    bool IsFixedPitch() { return m_fixedPitch; }  // 현재 폰트가 고정폭인지 (UpdateTextMetrics에서 확인)
 
     // 텍스트 그리기
     void FillSolidRect(const D2D1_RECT_F& rect, COLORREF color);  // 단색으로 사각형 채우기
@@ -176,6 +125,8 @@ private:
 
     // 캐시된 텍스트 메트릭스
     TextMetrics m_textMetrics;       // 현재 폰트의 메트릭스 정보 저장
+    GlyphAdvanceCache m_advances;    // 현재 폰트의 문자별 폭 (텍스트 포맷을 만들 때 비움)
+    bool m_fixedPitch;               // 현재 폰트가 고정폭 (IDWriteFont1::IsMonospacedFont, 확인 전에는 false)
 
     // 폰트 설정
     std::wstring m_fontName;         // 폰트 이름 (예: "Consolas", "D2Coding")
@@ -203,6 +154,8 @@ private:
     // 내부 메소드
     void UpdateTextMetrics();        // 폰트 변경 시 텍스트 메트릭스 정보 업데이트
     bool CreateTextFormat();         // 텍스트 포맷 객체 생성
+    float MeasureRun(const wchar_t* text, size_t length, float* prefix);  // 텍스트 레이아웃으로 폭 측정 (셰이핑 포함, prefix가 있으면 클러스터 누적 폭도)
+    static float MeasureLayout(IDWriteFactory* factory, IDWriteTextFormat* format, float maxWidth, float height, const wchar_t* text, size_t length, float* prefix);
     bool CreateBrushes();            // 브러시 객체 생성
     void SetUnifiedBaseline();      // 베이스라인 75% 강제 설정
 public:
@@ -240,6 +193,95 @@ struct SelectInfo {
     TextPos anchor;
 };
 
+#define LINE_WIDTH_CACHE_SIZE 8 // 누적 폭을 기억해 둘 라인 수 (캐럿 라인, 클릭한 라인 등)
+#define PAINT_STEP_CHARS 1024 // 긴 라인의 누적 폭을 기록해 두는 컬럼 간격 (그릴 때는 화면에 걸친 간격만 읽음)
+#define LINE_STEP_CACHE_SIZE 4 // 간격별 누적 폭을 기억해 둘 긴 라인 수
+#define WRAP_CACHE_BYTES (32 * 1024 * 1024) // 워드랩 위치 캐시의 최대 바이트 (넘으면 가장 오래 쓰지 않은 라인부터 버림)
+#define WRAP_KEY_LINES 4096 // 라인별로 기억해 둘 워드랩 캐시 키 수 (넘으면 비우고 다시 채움)
+#define WRAP_ENTRY_BYTES 96 // 워드랩 캐시 항목 하나의 고정 비용 (항목, 해시 노드, 목록 노드의 근사치)
+#define REWRAP_BLOCK_LINES 4096  // 백그라운드 워드랩에서 작업 스레드가 한 번에 맡는 라인 수
+#define WM_NEMO_REWRAP (WM_APP + 0x100) // 백그라운드 워드랩 결과가 나왔음을 알리는 메시지
+#define WM_NEMO_READERROR (WM_APP + 0x101) // 스왑 파일을 읽지 못했음을 메시지 처리 밖에서 알리기 위한 메시지
+
+// 백그라운드 워드랩 : Rope가 아직 다 기록하지 않았다고 알려 준 구간들을 스냅샷에서 작업 스레드들이 나눠 센다.
+// 화면 첫 라인의 구간부터 돌아가며 나눠 주고, 끝난 블록은 모아 두었다가 알림 창에 WM_NEMO_REWRAP을 보낸다. (받은 쪽이 TakeBlocks로 가져가 Rope에 기록)
+// 작업 스레드마다 문자 폭 캐시를 따로 둔다. Cancel()은 스왑 파일을 읽는 중일 수 있는 스레드를 기다리지 않고 멈춘 작업으로 넘겨 두었다가, 다 끝나면 Reap()에서 정리한다.
+class RewrapJob {
+public:
+    typedef std::function<size_t(std::wstring_view line, GlyphAdvanceCache& advances)> CountWraps; // 라인의 워드랩 줄 수
+    typedef RopeWrapBlock Block;
+
+    RewrapJob() {}
+    ~RewrapJob() { Cancel(); Wait(); }
+    // 진행 중인 작업을 멈추고 ranges(Rope::getUnwrappedRanges)를 새로 셈
+    void Start(HWND notify, std::shared_ptr<const RopeSnapshot> snapshot, std::vector<std::pair<size_t, size_t>> ranges, size_t firstLine,
+        GlyphAdvanceCache::MeasureRun measureRun, bool fixedPitch, CountWraps countWraps);
+    void Cancel(); // 작업 스레드에 멈추라고 알리고 모아 둔 결과를 버림 (스레드는 기다리지 않음)
+    void Reap(); // 멈춘 작업 중 스레드가 모두 끝난 것을 정리 (스냅샷을 놓음)
+    void Wait(); // 멈춘 작업의 스레드가 모두 끝날 때까지 기다림 (Rope를 비우거나 없애기 전)
+    bool TakeBlocks(std::vector<Block>& blocks); // 끝난 블록들을 가져감 (모든 블록이 끝났으면 true)
+    const RopeSnapshot& GetSnapshot() const { return *m_run->snapshot; } // 진행 중인 작업의 스냅샷 (블록의 라인 번호 기준)
+    bool IsRunning() const { return m_run != nullptr; }
+    bool HasFailed(); // 작업 스레드가 예외로 멈췄음 (스왑 파일 읽기 실패, 메모리 부족)
+
+private:
+    // 작업 하나의 상태 : 작업 스레드는 이것만 읽고 쓰므로 Cancel 뒤에도 스레드가 끝날 때까지 m_retired에 남겨 둔다.
+    struct Run {
+        HWND notify = NULL;
+        std::shared_ptr<const RopeSnapshot> snapshot;
+        CountWraps countWraps;
+        std::vector<std::pair<size_t, size_t>> ranges; // 셀 구간 (구간 하나가 블록 하나)
+        size_t firstRange = 0;                          // 화면 첫 라인이 있는 구간
+        std::vector<std::thread> threads;
+        std::atomic<bool> cancel{ false };
+        std::atomic<size_t> nextBlock{ 0 };  // 다음에 나눠 줄 순번 (구간 = (firstRange + 순번) % 구간 수)
+        std::atomic<size_t> active{ 0 };     // 아직 끝나지 않은 작업 스레드 수
+
+        std::mutex lock;             // 아래 멤버 보호
+        std::vector<Block> done;     // 끝났지만 아직 가져가지 않은 블록
+        size_t finished = 0;         // 끝난 블록 수
+        bool notified = false;       // 가져가지 않은 알림이 있음
+        bool failed = false;         // 작업 스레드가 예외로 멈춤
+    };
+
+    static void Work(Run* run, GlyphAdvanceCache::MeasureRun measureRun, bool fixedPitch);
+    static void Fail(Run* run); // 모든 작업 스레드를 멈추고 실패를 알림
+
+    std::unique_ptr<Run> m_run;                  // 진행 중인 작업
+    std::vector<std::unique_ptr<Run>> m_retired; // 멈췄지만 스레드가 아직 끝나지 않았을 수 있는 작업 (메인 스레드만 씀)
+};
+
+// 라인별 누적 폭 : 캐럿 좌표와 클릭 위치의 컬럼을 라인마다 한 번 잰 값에서 이진 검색으로 찾는다.
+// 라인 번호가 맞는 Rope 수정 횟수를 같이 들고 있다가, 그 뒤에 고쳤으면 Rope::mapLine으로 번호를 옮기고 고친 라인만 다시 잰다. (폰트나 탭 크기가 바뀌면 전부 비움)
+struct LineWidthCache {
+    int lineIndex = -1;
+    uint64_t edits = 0;         // lineIndex가 맞는 Rope 수정 횟수 (getEditCount)
+    std::vector<int> prefix;    // prefix[c] : 0 ~ c 컬럼 앞까지의 픽셀 폭 (탭은 m_tabSize 칸)
+};
+
+// 긴 라인(LONG_LINE_MIN 이상)의 간격별 누적 폭 : 워드랩이 아닐 때 화면에 걸친 컬럼 구간만 읽어서 그리는 데 쓴다.
+// 탭은 늘 m_tabSize 칸이므로 구간별로 잰 폭을 더해도 라인 전체 폭과 같다. (LineWidthCache와 같은 방식으로 고친 라인만 다시 잼)
+struct LineStepWidths {
+    int lineIndex = -1;
+    uint64_t edits = 0;         // lineIndex가 맞는 Rope 수정 횟수 (getEditCount)
+    std::vector<int> steps;     // steps[k] : 0 ~ k * PAINT_STEP_CHARS 컬럼 앞까지의 픽셀 폭 (마지막은 라인 전체 폭)
+};
+
+// 워드랩 위치 캐시 항목 : 라인 내용의 해시로 찾고, 길이와 두 번째 해시까지 같을 때만 쓴다. (해시 충돌이면 다시 재서 덮어씀)
+struct WrapCacheEntry {
+    size_t length = 0;                  // 잰 라인의 길이
+    uint64_t check = 0;                 // 키와 다른 방식으로 구한 두 번째 해시
+    std::vector<int> wraps;             // 워드랩 위치
+    std::list<uint64_t>::iterator lru;  // m_wrapLru 안의 위치 (앞쪽이 최근에 쓴 항목)
+};
+
+// 라인별 워드랩 캐시 키 : 같은 라인을 다시 찾으면 라인 뷰와 해시 없이 캐시 항목으로 간다. (Rope를 고치면 Rope::mapLine으로 옮김)
+struct WrapCacheKey {
+    uint64_t key = 0;                   // m_wrapCache 키
+    uint64_t check = 0;                 // 두 번째 해시
+    size_t length = 0;                  // 라인 길이 (0이면 빈 줄)
+};
+
 struct ColorInfo {
     COLORREF text;
     COLORREF textBg;
@@ -288,7 +330,17 @@ public:
 
     // 텍스트 조작 메서드
     void SetText(const std::wstring& text);
+    bool LoadFile(const std::wstring& path); // 대용량 파일 열기 (메모리 맵, 필요한 부분만 디코딩)
     std::wstring GetText();
+    std::shared_ptr<const RopeSnapshot> GetSnapshot(); // 편집과 무관하게 다른 스레드에서 읽을 수 있는 현재 내용 (컨트롤보다 먼저 해제)
+    void SetColdCompression(size_t hotLeaves); // 화면과 캐럿 주변에서 최근에 읽은 hotLeaves개 리프 외에는 메모리에서 압축 (0이면 끔)
+    RopePackStats GetCompressionStats(); // 압축된 크기, 압축 해제 횟수
+    void SetSwapBudget(size_t budgetBytes); // 메모리보다 큰 문서 편집용 : 상주 리프 버퍼를 budgetBytes 안으로 유지하고 나머지는 스왑 파일로 (0이면 끔)
+    RopeSwapStats GetSwapStats(); // 스왑 파일 크기, 스왑 인/아웃 횟수
+    void SetLineInterning(bool enable); // 반복되는 라인(하트비트, 빈 스택 프레임 등)이 많은 로그용 : 같은 내용의 라인이 버퍼 하나를 공유
+    RopeInternStats GetInternStats(); // 중복 제거율 (lineBytes / storedBytes)
+    void SetTextMeasurer(TextMeasurer* measurer); // 텍스트 폭 측정 구현 교체 (nullptr이면 D2Render)
+    void SetRopeLimits(const RopeLimits& limits); // 리프 크기 한도 (RopeLimits::smallEdits(), RopeLimits::hugeLogs() 등)
 	std::wstring GetSelect();
     void AddText(std::wstring text);
     void Copy();
@@ -303,18 +355,32 @@ public:
 	size_t GetSize();
 	int GetCurrentLineNo();
     void GotoLine(size_t lineNo);
+    size_t GetCaretOffset(); // 문서 시작부터 캐럿까지의 문자 수 (줄바꿈은 \r\n 2문자, GetText 기준)
+    void GotoOffset(size_t offset); // 문자 오프셋 위치로 캐럿 이동
+    size_t GetSelectionLength(); // 선택 영역의 문자 수 (Copy로 복사되는 텍스트 길이와 같음)
 
 protected:
 
+    // 라인 단위로 잘라낸 구간 : m_cutLines와 잘라내기/붙여넣기 Undo 레코드가 함께 들고, 라인들은 문서와 slice 중 한 곳에만 있다.
+    // 마지막 참조가 사라질 때 slice에 남은 라인을 Rope에 반환한다. (Rope를 비우기 전에 모두 놓아야 함)
+    struct CutLines {
+        Rope& rope;
+        RopeSlice slice;
+
+        explicit CutLines(Rope& owner) : rope(owner) {}
+        ~CutLines() { rope.releaseLines(slice); }
+    };
+
     struct UndoRecord {
-        enum Type { Insert, Delete, Replace } type;
+        enum Type { Insert, Delete, Replace, Move } type;
 
         // 작업 범위 (모두 작업 전 상태 기준)
         TextPos start;          // 작업 시작 위치 (작업 전)
         TextPos end;            // 작업 끝 위치 (작업 전, Delete/Replace용)
-        TextPos startAfter;   // 작업 시작 위치 (작업 후, Replace용)
+        TextPos startAfter;   // 작업 시작 위치 (작업 후, Replace용, Move는 떼어낸 뒤 기준 이동 위치)
         TextPos endAfter;    // 작업 끝 위치 (작업 후, Replace용)
         std::wstring text;      // Insert: 삽입할 내용, Delete/Replace: 원본 내용
+        std::shared_ptr<CutLines> lines; // 라인 단위 잘라내기/붙여넣기 : text 대신 [start, end) 라인들을 떼어내고 끼움
 
         // 선택 영역 복원용 (작업 전 상태)
         bool hadSelection;      // 작업 전에 선택 영역이 있었는지
@@ -346,10 +412,16 @@ protected:
     afx_msg LRESULT OnImeComposition(WPARAM wParam, LPARAM lParam);
     afx_msg LRESULT OnImeChar(WPARAM wParam, LPARAM lParam);
     afx_msg LRESULT OnImeEndComposition(WPARAM wParam, LPARAM lParam);
+    afx_msg LRESULT OnRewrapProgress(WPARAM wParam, LPARAM lParam);
+    afx_msg LRESULT OnReadError(WPARAM wParam, LPARAM lParam);
+    afx_msg void OnRenderFormat(UINT nFormat);
+    afx_msg void OnRenderAllFormats();
+    afx_msg void OnDestroyClipboard();
 
     DECLARE_MESSAGE_MAP()
 
 private:
+    friend class NemoBench;
     // 내부 기능 메서드들
     int GetLineWidth(int lineIndex);
     int GetMaxWidth(); // lineWidth의 최대값을 리턴한다.
@@ -363,8 +435,16 @@ private:
     void DeleteSelection();
     void ReplaceSelection(std::wstring text);
     int GetTextWidth(const std::wstring& line); // 문자의 길이를 캐싱된 데이터로 계산
-    std::vector<int> FindWordWrapPosition(int lineIndex); // 자동 줄바꿈 위치 찾기
-    void SplitTextByNewlines(std::wstring& text, std::list<std::wstring>& parts); // 텍스트를 줄바꿈 문자로 분리
+    const std::vector<int>& GetLinePrefixWidths(int lineIndex); // 라인의 컬럼별 누적 폭 (캐시)
+    const std::vector<int>& GetLineStepWidths(int lineIndex); // 긴 라인의 PAINT_STEP_CHARS 컬럼 간격별 누적 폭 (캐시)
+    void ClearWidthCaches(); // 폭에 따라 달라지는 캐시(누적 폭, 워드랩 위치)를 모두 비움
+    const std::vector<int>& FindWordWrapPosition(int lineIndex); // 자동 줄바꿈 위치 찾기 (캐시, 다음 호출 전까지 유효)
+    void ClearWrapCache(); // 워드랩 위치 캐시를 비움
+    void SyncWrapWidth(); // 워드랩 폭이 캐시를 채울 때와 다르면 캐시와 화면 줄 색인을 비우고 백그라운드 워드랩 요청
+    void RequestRewrap(); // 잰 결과를 버리고 백그라운드 워드랩을 다시 시작하도록 WM_NEMO_REWRAP을 보냄 (여러 번 불러도 한 번만 시작)
+    void StartRewrap(); // 아직 기록하지 않은 리프들을 현재 스냅샷으로 세기 시작 (워드랩 모드가 아니면 멈추기만 함)
+    static uint64_t HashLine(std::wstring_view text, uint64_t& check); // 워드랩 캐시 키 (check에는 확인용 두 번째 해시)
+    void SplitTextByNewlines(const std::wstring& text, TextLines& lines); // 텍스트를 줄바꿈 문자로 분리 (위치만 기록)
     void AddTabToSelectedLines();      // 여러 줄 선택 시 탭 추가 처리 메서드
     void RemoveTabFromSelectedLines(); // 여러 줄 선택 시 탭 제거 처리 메서드
     // 캐럿 관련
@@ -375,6 +455,8 @@ private:
     // 스크롤 관련
     void ScrollViewBy(int pageCount, int lineCount);  // 상대적 화면 스크롤 이동
     void RecalcScrollSizes(); // 스크롤 사이즈 재계산
+    int GetScrollRow(); // 스크롤 위치의 화면 줄 번호 (워드랩이 아니면 라인 번호)
+    void SetScrollRow(int row); // 워드랩 모드에서 화면 줄 번호로 스크롤 위치 설정
     void NemoShowScrollBar(UINT nBar, BOOL bShow); // NemoShowScrollBar 래핑 함수
     void NemoSetScrollInfo(UINT nBar, LPSCROLLINFO lpScrollInfo,
         BOOL bRedraw); // NemoSetScrollInfo 래핑 함수
@@ -382,21 +464,24 @@ private:
     // 텍스트 그리기
     //int GetLineWidth(int lineIndex);
     void DrawLineNo(int lineIndex, int yPos);
-    void DrawSegment(int lineIndex, size_t segStartIdx, const std::wstring& segment, int xOffset, int y);
+    void DrawSegment(int lineIndex, size_t segStartIdx, std::wstring_view segment, int xOffset, int y, int segLeft = 0); // segLeft : 라인 시작부터 segment 앞까지의 픽셀 폭 (워드랩 줄은 0)
+    void DrawLineWindow(int lineIndex, size_t lineLen, bool imeComposing, int xOffset, int y); // 긴 라인은 화면에 걸친 컬럼 구간만 읽어서 그림 (워드랩이 아닐 때)
     // 이동
     void MoveCaretToPrevWord();  // 이전 단어의 시작으로 이동
     void MoveCaretToNextWord();  // 다음 단어의 시작으로 이동
     void SaveClipBoard(const std::wstring& text); // 클립보드에 텍스트 저장
+    bool SaveClipBoardDelayed(); // 클립보드에 CF_UNICODETEXT를 지연 렌더링으로 등록 (내용은 요청받을 때 m_cutSnap에서 만듦)
+    void RenderCutText(); // WM_RENDERFORMAT : 잘라낸 라인들을 텍스트로 만들어 클립보드에 넣음
     std::wstring LoadClipText(); // 클립보드에서 텍스트 로드
     void HideIME(); // IME 숨기기
     void ClearText();
-    std::wstring ExpandTabs(const std::wstring& text); // \t을 space * tabSize로 치환
-    int TabCount(const std::wstring& text, int endPos);
+    std::wstring ExpandTabs(std::wstring_view text); // \t을 space * tabSize로 치환
+    int TabCount(std::wstring_view text, int endPos);
     void HandleTripleClick(CPoint point); // 트리플 클릭 처리
     // 단어 경계 검사
     void InitializeWordDelimiters();        // 구분자 초기화 함수
     bool IsWordDelimiter(wchar_t ch);      // 구분자 확인
-    void FindWordBoundary(const std::wstring& text, int position, int& start, int& end);  // 단어 경계 찾기
+    void FindWordBoundary(std::wstring_view text, int position, int& start, int& end);  // 단어 경계 찾기
     // Undo 관련 헬퍼 함수들
     void SaveCurrentState(UndoRecord& record);              // 현재 상태를 레코드에 저장
     void RestoreState(const UndoRecord& record);            // 레코드로부터 상태 복원
@@ -404,13 +489,25 @@ private:
     UndoRecord CreateInsertRecord(const TextPos& pos, const std::wstring& text);
     UndoRecord CreateDeleteRecord(const TextPos& start, const TextPos& end, const std::wstring& text);
     UndoRecord CreateReplaceRecord(const TextPos& start, const TextPos& end, const TextPos& startAfter, const TextPos& endAfter, const std::wstring& originalText);
+    UndoRecord CreateMoveRecord(int lineIndex, int count, int to); // [lineIndex, lineIndex + count) 라인을 to로 이동
+    UndoRecord CreateLinesRecord(UndoRecord::Type type, int lineIndex, int count, const std::shared_ptr<CutLines>& lines); // 라인 단위 잘라내기(Delete)/붙여넣기(Insert)
+    void DetachCutLines(const UndoRecord& record); // record의 [start, end) 라인을 record.lines로 떼어냄
+    void SpliceCutLines(const UndoRecord& record); // record.lines를 start 라인에 끼움
     void DeleteSelectionRange(const TextPos& start, const TextPos& end);
     void InsertTextAt(const TextPos& pos, std::wstring& text);
+    void MoveSelectedLines(bool up); // 캐럿 라인(선택 영역이 걸친 라인들)을 한 줄 위/아래로 이동
 
     // 내부 데이터
 	Rope m_rope; // 텍스트 데이터를 관리하는 Rope 객체
+    RewrapJob m_rewrap; // 백그라운드 워드랩 (m_rope의 스냅샷을 읽으므로 m_rope보다 먼저 소멸)
+    bool m_rewrapPending; // WM_NEMO_REWRAP을 받으면 작업을 새로 시작
+    std::vector<RewrapJob::Block> m_rewrapHeld; // 스냅샷 이후에 고쳐서 작업이 끝날 때 한꺼번에 기록할 블록
+    size_t m_rewrapSkipped; // 이번 작업에서 복사본으로 바뀌어 기록하지 못한 리프 수 (끝나면 그 리프만 다시 셈)
+    bool m_rewrapFailed; // 백그라운드 워드랩이 실패함 (문서를 새로 채울 때까지 그리는 라인만 잼)
+    bool m_readFailed; // 스왑 파일을 읽지 못해 읽기 전용으로 바꿈 (문서를 새로 채울 때까지 다시 알리지 않음)
 
 	D2Render m_d2Render;
+    TextMeasurer* m_measurer; // 텍스트 폭 측정 (기본은 m_d2Render)
     TextPos m_caretPos;                       // 캐럿 위치 (라인, 칼럼)
 	bool m_caretVisible;                      // 캐럿 표시 여부
 	SelectInfo m_selectInfo;                  // 선택 영역 정보
@@ -428,6 +525,19 @@ private:
     int m_lineSpacing;            // 추가 줄 간격 (픽셀)
     int m_tabSize; // 탭 사이즈 ( space bar width 기준 ) : space width*m_tabSize = 최종 tab width
     int m_maxWidth; // 현재 문서의 라인 최대 사이즈
+    LineWidthCache m_lineWidths[LINE_WIDTH_CACHE_SIZE]; // 라인별 누적 폭 (돌아가며 교체)
+    size_t m_lineWidthNext; // 다음에 교체할 m_lineWidths 위치
+    LineStepWidths m_lineSteps[LINE_STEP_CACHE_SIZE]; // 긴 라인의 간격별 누적 폭 (돌아가며 교체)
+    size_t m_lineStepNext; // 다음에 교체할 m_lineSteps 위치
+    std::wstring m_expandBuf; // 누적 폭을 잴 때 탭을 펼친 라인 (용량 재사용)
+    std::vector<float> m_prefixBuf; // 펼친 라인의 누적 폭 (용량 재사용)
+    // 워드랩 위치 캐시 : 라인 내용의 해시로 찾으므로 라인이 끼워지거나 지워져 번호가 밀려도 그대로 쓰고, 고친 라인만 내용이 달라져 다시 잰다.
+    std::unordered_map<uint64_t, WrapCacheEntry> m_wrapCache;
+    std::list<uint64_t> m_wrapLru; // 캐시 키의 사용 순서 (앞쪽이 최근)
+    size_t m_wrapCacheBytes; // 캐시가 쓰는 바이트 (WRAP_CACHE_BYTES를 넘으면 뒤쪽부터 버림)
+    int m_wrapCacheWidth; // m_wrapCache를 채울 때의 m_wordWrapWidth (달라지면 전부 비움)
+    std::unordered_map<int, WrapCacheKey> m_wrapKeys; // 라인 인덱스별 캐시 키 (m_wrapKeysEdits 시점의 라인 번호)
+    uint64_t m_wrapKeysEdits; // m_wrapKeys의 라인 번호가 맞는 Rope 수정 횟수 (달라지면 수정 구간만큼 옮김)
 
     // 여백
     Margin       m_margin;              // 여백 : 오른쪽만 구현
@@ -451,13 +561,44 @@ private:
     int m_scrollX; // 수평 스크롤 : 픽셀 단위로 스크린에서 제외된 크기 ( 0부터 시작 )
     int m_scrollYLine; // 수직 스크롤 : 스크린 첫라인 번호 ( 0부터 시작 )
     int m_scrollYWrapLine; // 수직 스크롤 : 스크린 첫라인 wordwrap 번호 ( 0이면 라인의 시작, 1이면 워드랩 첫줄 )
+    size_t m_scrollRows; // 스크롤바 범위에 반영한 화면 줄 수 (그리면서 새로 잰 라인이 있으면 달라짐)
 
     // Undo/Redo 스택
     std::vector<UndoRecord> m_undoStack;
     std::vector<UndoRecord> m_redoStack;
 
+    // 라인 단위 잘라내기 : 큰 구간은 라인들을 떼어낸 채로 들고 있다가 같은 클립보드 내용을 붙여넣을 때 그대로 끼운다.
+    // 클립보드 텍스트는 지연 렌더링이라 다른 프로그램이 읽을 때만 잘라내기 직전 스냅샷에서 만든다. (클립보드를 잃으면 둘 다 놓음)
+    std::shared_ptr<CutLines> m_cutLines;          // 잘라낸 라인들 (붙여넣으면 비고, Undo 레코드와 공유)
+    std::shared_ptr<const RopeSnapshot> m_cutSnap; // 잘라내기 직전 스냅샷 (클립보드 텍스트 원본)
+    size_t m_cutFirst;          // m_cutSnap에서 잘라낸 첫 라인
+    size_t m_cutCount;          // 잘라낸 라인 수
+    size_t m_cutChars;          // 클립보드 텍스트의 문자 수 (라인마다 \r\n 포함)
+    DWORD m_cutClipSeq;        // 잘라낼 때의 클립보드 시퀀스 번호
+
     // 단어 경계 검사
     bool isDivChar[256];                   // 구분자 빠른 검색을 위한 배열
 public:
     virtual BOOL PreTranslateMessage(MSG* pMsg);
+protected:
+    virtual LRESULT WindowProc(UINT message, WPARAM wParam, LPARAM lParam); // Rope 읽기 실패(RopeReadError)를 메시지 단위로 받음
+};
+
+#ifdef NEMO_BENCH
+// 성능 측정 하네스 : NEMO_BENCH를 정의하고 빌드한 콘솔 프로그램에서 NemoBench::Run(std::wcout)을 부른다.
+// 항목마다 비교 대상과 함께 걸린 시간(밀리초)을 출력한다. (Rope 항목은 창 없이 돌고, 크기는 항목별 인자로 조절)
+class NemoBench {
+public:
+    static void Run(std::wostream& out); // 모든 항목을 기본 크기로
+    static void ArenaAlloc(std::wostream& out, size_t lines); // 아레나 할당과 일괄 해제 vs 라인마다 힙 할당
+    static void ScanNewlines(std::wostream& out, size_t megabytes); // SIMD 줄바꿈 검색 vs 문자 단위 검색 (UTF-16 텍스트 크기)
+    static void TreeBuild(std::wostream& out, size_t maxLeaves); // 리프 배열로 한 번에 구성 vs 리프마다 삽입 (리프 수를 두 배씩 늘리며)
+    static void FingerAccess(std::wostream& out, size_t lines); // 화면 그리기 형태의 라인 조회 : 핑거, 커서 vs 라인마다 루트에서 탐색
+    static void MoveLines(std::wostream& out, size_t lines); // 라인 블록 이동 : 떼어내고 끼우기 vs 텍스트로 만들어 지우고 다시 삽입
+    static void CutPaste(std::wostream& out, size_t lines); // 편집기 Cut()/Paste()/Undo()로 라인 블록 잘라내기와 붙여넣기 (클립보드 텍스트는 요청받을 때 만듦)
+    static void ColdPack(std::wostream& out, size_t lines); // 차가운 리프 압축 : 상주 메모리, 스크롤할 때 압축 해제 횟수와 시간
+    static void LimitsSweep(std::wostream& out, size_t lines); // RopeLimits 설정별 편집, 로드, 덧붙이기, 화면 읽기, 구간 삭제 시간과 작업별 최적 설정
+    static bool MeasureTests(std::wostream& out); // 문자별 폭 표 측정기로 워드랩, 누적 폭, 클릭 컬럼을 손으로 계산한 값과 비교 (실패한 항목 출력)
+    static void MeasureText(std::wostream& out, size_t lines); // 워드랩과 클릭 컬럼 찾기 : 문자 폭 캐시, 누적 폭 vs 호출마다 구간 측정 (측정 횟수와 시간)
 };
+#endif
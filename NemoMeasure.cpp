@@ -0,0 +1,481 @@
+﻿//﻿*******************************************************************************
+//    파     일     명 : NemoMeasure.cpp
+//    프로그램명칭 : 네모 에디터 컨트롤
+//    프로그램용도 : 텍스트 폭 측정과 워드랩, 클릭 컬럼 계산 ( MFC, DirectWrite 없이 빌드 )
+//
+//    작    성    자 : Daniel Heo ( https://github.com/Daniel-Heo/NemoEdit )
+//    라 이  센 스  : Dual License
+//                            If you are not a citizen of the Republic of Korea : AGPL 3.0 License
+//                            If you are a citizen of the Republic of Korea : MIT License
+//*******************************************************************************
+#include "pch.h"
+#include "NemoMeasure.h"
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+// ---------------------------------------------------
+// GlyphAdvanceCache : 폰트별 문자 폭 캐시
+// ---------------------------------------------------
+static const float ADVANCE_UNKNOWN = -1.0f; // 아직 재지 않은 문자
+static const float ADVANCE_SHAPED = -2.0f;  // 셰이핑이 필요한 문자 (구간을 통째로 잼)
+
+void GlyphAdvanceCache::Reset(bool fixedPitch) {
+    for (std::unique_ptr<float[]>& page : m_pages) page.reset();
+    m_fixedPitch = fixedPitch;
+}
+
+float GlyphAdvanceCache::Advance(wchar_t ch) {
+    if ((uint32_t)ch > 0xFFFF) return ADVANCE_SHAPED; // BMP 밖 문자 (wchar_t가 4바이트인 시험 빌드)
+    std::unique_ptr<float[]>& page = m_pages[ch / ADVANCE_PAGE_CHARS];
+    if (!page) {
+        page.reset(new float[ADVANCE_PAGE_CHARS]);
+        std::fill(page.get(), page.get() + ADVANCE_PAGE_CHARS, ADVANCE_UNKNOWN);
+    }
+    float& advance = page[ch % ADVANCE_PAGE_CHARS];
+    if (advance == ADVANCE_UNKNOWN) {
+        advance = NeedsShaping(ch) ? ADVANCE_SHAPED : m_measureRun(&ch, 1, nullptr);
+    }
+    return advance;
+}
+
+float GlyphAdvanceCache::GetTextWidth(const wchar_t* text, size_t length) {
+    if (!m_fixedPitch) return m_measureRun(text, length, nullptr); // 커닝, 합자
+    float width = 0.0f;
+    for (size_t i = 0; i < length; i++) {
+        float advance = Advance(text[i]);
+        if (advance == ADVANCE_SHAPED) {
+            return m_measureRun(text, length, nullptr);
+        }
+        width += advance;
+    }
+    return width;
+}
+
+// 문자별 폭을 더할 수 없는 구간(비례 폰트, 셰이핑이 필요한 문자)은 measureRun 한 번으로 누적 폭을 받는다.
+void GlyphAdvanceCache::GetPrefixWidths(const wchar_t* text, size_t length, float* prefix) {
+    if (m_fixedPitch) {
+        prefix[0] = 0.0f;
+        size_t i = 0;
+        for (; i < length; i++) {
+            float advance = Advance(text[i]);
+            if (advance == ADVANCE_SHAPED) break;
+            prefix[i + 1] = prefix[i] + advance;
+        }
+        if (i == length) return;
+    }
+    m_measureRun(text, length, prefix);
+}
+
+// 결합 문자, 서로게이트, 폭 없는/방향 제어 문자, 글자끼리 이어지거나 재배열되는 문자 체계
+bool GlyphAdvanceCache::NeedsShaping(wchar_t ch) {
+    static const wchar_t ranges[][2] = {
+        { 0x0000, 0x001F },     // 제어 문자
+        { 0x0300, 0x036F },     // 결합 분음 부호
+        { 0x0483, 0x0489 },     // 키릴 결합 부호
+        { 0x0590, 0x08FF },     // 히브리, 아랍, 시리아, 타나 등
+        { 0x0900, 0x0DFF },     // 인도계 문자
+        { 0x0E00, 0x109F },     // 태국, 라오, 티베트, 미얀마
+        { 0x1100, 0x11FF },     // 한글 자모 (첫가끝 조합)
+        { 0x1780, 0x18AF },     // 크메르, 몽골
+        { 0x1AB0, 0x1AFF },     // 결합 분음 부호 확장
+        { 0x1DC0, 0x1DFF },     // 결합 분음 부호 보충
+        { 0x200B, 0x200F },     // 폭 없는 공백, ZWNJ/ZWJ, 방향 표시
+        { 0x202A, 0x202E },     // 양방향 제어
+        { 0x2060, 0x206F },     // 양방향 격리 등 서식 문자
+        { 0x20D0, 0x20FF },     // 기호용 결합 부호
+        { 0x302A, 0x302F },     // CJK 성조 부호
+        { 0x3099, 0x309A },     // 가나 결합 탁점
+        { 0xA960, 0xA97F },     // 한글 자모 확장 A
+        { 0xD7B0, 0xD7FF },     // 한글 자모 확장 B
+        { 0xD800, 0xDFFF },     // 서로게이트 (이모지 등 BMP 밖 문자)
+        { 0xFB1D, 0xFDFF },     // 히브리/아랍 표현형
+        { 0xFE00, 0xFE0F },     // 이체자 선택자
+        { 0xFE20, 0xFE2F },     // 결합 반기호
+        { 0xFE70, 0xFEFF },     // 아랍 표현형 B, BOM
+        { 0xFFF9, 0xFFFB },     // 행간 주석 제어
+    };
+    if (ch >= 0x20 && ch < 0x300) return false; // 라틴
+    for (const auto& range : ranges) {
+        if (ch >= range[0] && ch <= range[1]) return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------
+// TableTextMeasurer : 문자별 폭 표로 재는 측정기
+// ---------------------------------------------------
+TableTextMeasurer::TableTextMeasurer(float defaultAdvance)
+    : m_advances([this](const wchar_t* text, size_t length, float* prefix) { m_runCount++; return Measure(m_table, text, length, prefix); })
+    , m_runCount(0) {
+    m_table.advances.assign(0x10000, defaultAdvance);
+}
+
+void TableTextMeasurer::SetAdvance(wchar_t ch, float advance) {
+    m_table.advances[ch] = advance;
+    m_advances.Reset(IsFixedPitch());
+}
+
+void TableTextMeasurer::SetKerning(wchar_t left, wchar_t right, float adjust) {
+    m_table.kerning[((uint32_t)left << 16) | right] = adjust;
+    m_advances.Reset(IsFixedPitch());
+}
+
+float TableTextMeasurer::GetTextWidth(const std::wstring& line) {
+    return m_advances.GetTextWidth(line.data(), line.size());
+}
+
+// 문자 폭 캐시로 안 되는 라인(커닝, 셰이핑)은 D2Render가 레이아웃 하나로 재듯이 한 번에 잰다.
+void TableTextMeasurer::GetPrefixWidths(const std::wstring& line, std::vector<float>& prefix) {
+    prefix.assign(line.size() + 1, 0.0f);
+    m_advances.GetPrefixWidths(line.data(), line.size(), prefix.data());
+}
+
+GlyphAdvanceCache::MeasureRun TableTextMeasurer::GetWorkerMeasureRun() {
+    std::shared_ptr<const Table> table = std::make_shared<Table>(m_table);
+    return [table](const wchar_t* text, size_t length, float* prefix) { return Measure(*table, text, length, prefix); };
+}
+
+// 커닝은 뒤 문자의 위치를 옮기므로 prefix[i + 1]에는 i - 1, i 문자 쌍의 조정까지 들어간다.
+float TableTextMeasurer::Measure(const Table& table, const wchar_t* text, size_t length, float* prefix) {
+    float width = 0.0f;
+    if (prefix) prefix[0] = 0.0f;
+    for (size_t i = 0; i < length; i++) {
+        width += table.advances[(uint16_t)text[i]];
+        if (i > 0 && !table.kerning.empty()) {
+            auto it = table.kerning.find(((uint32_t)(uint16_t)text[i - 1] << 16) | (uint16_t)text[i]);
+            if (it != table.kerning.end()) width += it->second;
+        }
+        if (prefix) prefix[i + 1] = width;
+    }
+    return width;
+}
+
+// ---------------------------------------------------
+// LineLayout : 탭 펼치기, 워드랩 위치, 누적 폭과 클릭 컬럼
+// ---------------------------------------------------
+std::wstring LineLayout::ExpandTabs(std::wstring_view text, int tabSize) {
+    // 결과를 저장할 문자열
+    std::wstring result;
+    result.reserve(text.length() * 2);
+    // 탭용 공백 문자열을 미리 한 번만 생성
+    const std::wstring tabSpaces(tabSize, L' ');
+
+    // 입력 문자열을 순회하며 탭을 공백으로 변환
+    for (size_t i = 0; i < text.length(); ++i) {
+        if (text[i] == L'\t') {
+            // 탭 문자 발견 시 지정된 수의 공백 추가
+            result.append(tabSpaces);
+        }
+        else {
+            // 일반 문자는 그대로 복사
+            result.push_back(text[i]);
+        }
+    }
+
+    return result;
+}
+
+// 탭을 펼친 라인의 누적 폭(expanded)을 원래 컬럼 위치로 옮긴다. (탭 하나가 tabSize 칸)
+void LineLayout::MapPrefixWidths(std::wstring_view line, const std::vector<float>& expanded, int tabSize, std::vector<int>& prefix) {
+    prefix.resize(line.size() + 1);
+    size_t pos = 0;
+    for (size_t col = 0; col < line.size(); col++) {
+        prefix[col] = static_cast<int>(expanded[pos]);
+        pos += (line[col] == L'\t') ? tabSize : 1;
+    }
+    prefix[line.size()] = static_cast<int>(expanded[pos]);
+}
+
+// 문자 가운데를 넘으면 그 문자 뒤로 본다. (startCol부터 가운데가 x보다 앞에 있는 문자 수)
+int LineLayout::GetColumnFromX(const std::vector<int>& prefix, int startCol, int x) {
+    int base = prefix[startCol];
+    int low = startCol;
+    int high = (int)prefix.size() - 1;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if ((prefix[mid] + prefix[mid + 1]) / 2 - base < x) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// 탭을 펼쳐서 잰 누적 폭을 원래 컬럼 위치로 옮긴다. (MapPrefixWidths와 같지만 구간 폭을 뺄셈으로 구하므로 정수로 자르지 않음)
+void LineLayout::MeasureColumns(std::wstring_view line, int tabSize, const PrefixWidths& prefixWidths, std::vector<float>& prefix) {
+    std::vector<float> expanded;
+    prefixWidths(ExpandTabs(line, tabSize), expanded);
+    prefix.resize(line.size() + 1);
+    size_t pos = 0;
+    for (size_t col = 0; col < line.size(); col++) {
+        prefix[col] = expanded[pos];
+        pos += (line[col] == L'\t') ? tabSize : 1;
+    }
+    prefix[line.size()] = expanded[pos];
+}
+
+// 구간마다 폭을 다시 재지 않고, 라인의 누적 폭(비례 폰트라면 레이아웃 하나의 클러스터 폭)에서 구간 폭을 뺄셈으로 구해 이진 검색한다.
+std::vector<int> LineLayout::MeasureWordWrapPosition(std::wstring_view lineText, int wrapWidth, int tabSize, const PrefixWidths& prefixWidths) {
+    std::vector<int> wrapPos;
+    std::vector<float> prefix;
+
+    const size_t LARGE_TEXT_THRESHOLD = 2048;
+
+    // 대용량 텍스트 처리 (1024자 이상)
+    if (lineText.length() > LARGE_TEXT_THRESHOLD) {
+        // 처음 200문자 샘플로 화면에 들어갈 수 있는 최대 문자 수 찾기
+        int sampleSize = min(200, (int)lineText.length());
+        MeasureColumns(lineText.substr(0, sampleSize), tabSize, prefixWidths, prefix);
+
+        int maxCharsInLine = 1;
+        while (maxCharsInLine < sampleSize && (int)prefix[maxCharsInLine + 1] <= wrapWidth) {
+            maxCharsInLine++;
+        }
+
+        // 찾은 최대 문자 수에서 5 빼기
+        int charsPerLine = maxCharsInLine - 10;
+        if (charsPerLine < 10) charsPerLine = 10; // 최소 10문자 보장
+
+        // 고정 크기로 분할
+        for (size_t pos = charsPerLine; pos < lineText.length(); pos += charsPerLine) {
+            wrapPos.push_back(min(pos, lineText.length()));
+        }
+
+        return wrapPos;
+    }
+
+    // 기존 로직 (1024자 미만)
+    MeasureColumns(lineText, tabSize, prefixWidths, prefix);
+    int lineWidth = (int)prefix.back();
+    if (lineWidth <= wrapWidth) {
+        return {};
+    }
+
+    int currentPos = 0;
+    int currWidthSum = 0;
+    int low, high, result, currWidth, mid, testSize;
+
+    while (currentPos < (int)lineText.length()) {
+        // 이진 검색으로 현재 위치에서 가장 긴 텍스트 찾기
+        low = 1;
+        high = (int)lineText.length() - currentPos;
+        result = 1; // 기본값
+        currWidth = 0;
+
+        while (low <= high) {
+            mid = (low + high) / 2;
+            testSize = (int)(prefix[currentPos + mid] - prefix[currentPos]);
+
+            if (testSize < wrapWidth) {
+                currWidth = testSize;
+                result = mid;
+                low = mid + 1;
+            }
+            else {
+                high = mid - 1;
+            }
+        }
+
+        currWidthSum += currWidth;
+        currentPos += result;
+        wrapPos.push_back(currentPos);
+
+        // 줄이 끝나면 종료
+        if (lineWidth - currWidthSum < wrapWidth) break;
+    }
+
+    return wrapPos;
+}
+
+#ifdef NEMO_MEASURE_TESTS
+// ---------------------------------------------------
+// 측정기 시험 : 문자별 폭 표 측정기로 DirectWrite 없이 워드랩과 히트 테스트를 확인한다.
+// ---------------------------------------------------
+#include <ostream>
+#include <chrono>
+#include <iomanip>
+#include <cwchar>
+
+static bool MeasureCheck(std::wostream& out, bool ok, const wchar_t* name) {
+    if (!ok) out << L"  FAILED " << name << L"\n";
+    return ok;
+}
+
+bool RunMeasureTests(std::wostream& out) {
+    bool ok = true;
+    auto widthOf = [](TextMeasurer& measurer) {
+        return [&measurer](const std::wstring& text, std::vector<float>& prefix) { measurer.GetPrefixWidths(text, prefix); };
+    };
+
+    // 고정폭 : 기본 10px, 한글 20px
+    TableTextMeasurer fixed(10.0f);
+    fixed.SetAdvance(L'한', 20.0f);
+    ok &= MeasureCheck(out, fixed.IsFixedPitch(), L"no kerning is fixed pitch");
+    ok &= MeasureCheck(out, fixed.GetTextWidth(L"a한b") == 40.0f, L"width with wide char");
+    fixed.ResetRunCount();
+    for (int i = 0; i < 100; i++) fixed.GetTextWidth(L"abcabc");
+    ok &= MeasureCheck(out, fixed.GetRunCount() <= 3, L"advances measured once per char");
+
+    // 워드랩 : 폭이 wrapWidth보다 작은 가장 긴 앞부분마다 자름 (14자 140px, 65px 폭이면 6자씩)
+    std::vector<int> wraps = LineLayout::MeasureWordWrapPosition(L"aaaa bbbb cccc", 65, 4, widthOf(fixed));
+    ok &= MeasureCheck(out, wraps == std::vector<int>({ 6, 12 }), L"wrap positions");
+    ok &= MeasureCheck(out, LineLayout::MeasureWordWrapPosition(L"aaaa", 65, 4, widthOf(fixed)).empty(), L"short line does not wrap");
+    // 탭은 4칸 : "\tab"는 60px이라 55px 폭에서 탭 하나(40px) 뒤에서 자름
+    wraps = LineLayout::MeasureWordWrapPosition(L"\tab", 55, 4, widthOf(fixed));
+    ok &= MeasureCheck(out, !wraps.empty() && wraps[0] == 2, L"wrap after tab");
+    // 긴 라인 : 앞 200자 표본에서 한 줄 문자 수(505px면 50자)를 정하고 10자를 빼서 고정 간격으로 자름
+    wraps = LineLayout::MeasureWordWrapPosition(std::wstring(5000, L'x'), 505, 4, widthOf(fixed));
+    ok &= MeasureCheck(out, wraps.size() == 124 && wraps[0] == 40 && wraps[1] == 80, L"long line fixed wraps");
+
+    // 누적 폭과 클릭 컬럼 : 문자 가운데를 넘으면 뒤 컬럼
+    std::vector<float> expanded;
+    std::vector<int> prefix;
+    fixed.GetPrefixWidths(LineLayout::ExpandTabs(L"\ta한", 4), expanded);
+    LineLayout::MapPrefixWidths(L"\ta한", expanded, 4, prefix);
+    ok &= MeasureCheck(out, prefix == std::vector<int>({ 0, 40, 50, 70 }), L"prefix widths with tab");
+    ok &= MeasureCheck(out, LineLayout::GetColumnFromX(prefix, 0, 19) == 0 && LineLayout::GetColumnFromX(prefix, 0, 21) == 1, L"hit test tab");
+    ok &= MeasureCheck(out, LineLayout::GetColumnFromX(prefix, 0, 59) == 2 && LineLayout::GetColumnFromX(prefix, 0, 61) == 3, L"hit test wide char");
+    ok &= MeasureCheck(out, LineLayout::GetColumnFromX(prefix, 0, 1000) == 3 && LineLayout::GetColumnFromX(prefix, 1, 5) == 1, L"hit test ends and start column");
+
+    // 커닝 : A, V 사이 -3px. 문자별 폭을 더하지 않고 구간을 통째로 잼
+    TableTextMeasurer kerned(10.0f);
+    kerned.SetKerning(L'A', L'V', -3.0f);
+    ok &= MeasureCheck(out, !kerned.IsFixedPitch(), L"kerning is not fixed pitch");
+    ok &= MeasureCheck(out, kerned.GetTextWidth(L"AVA") == 27.0f && kerned.GetTextWidth(L"VA") == 20.0f, L"kerned width");
+    kerned.GetPrefixWidths(L"AVA", expanded);
+    ok &= MeasureCheck(out, expanded == std::vector<float>({ 0.0f, 10.0f, 17.0f, 27.0f }), L"kerned prefix widths");
+    GlyphAdvanceCache::MeasureRun workerRun = kerned.GetWorkerMeasureRun();
+    GlyphAdvanceCache workerAdvances(workerRun, kerned.IsFixedPitch());
+    ok &= MeasureCheck(out, workerAdvances.GetTextWidth(L"AVA", 3) == 27.0f, L"worker run keeps kerning");
+    // 커닝 쌍 "AV"가 줄마다 3px을 줄이므로 문자별 폭의 합(60px)으로는 자르게 될 폭에서도 한 줄에 들어감
+    ok &= MeasureCheck(out, LineLayout::MeasureWordWrapPosition(L"AVAVAV", 52, 4, widthOf(kerned)).empty(), L"kerned line fits");
+    ok &= MeasureCheck(out, !LineLayout::MeasureWordWrapPosition(L"AVAVAV", 52, 4, widthOf(fixed)).empty(), L"unkerned line wraps");
+    // 비례 폰트도 라인마다 구간 측정 한 번 : 누적 폭 0 10 17 27 34 44 51 61 68 78 85에서 51px(6자) 뒤에 자르고 나머지 34px은 한 줄
+    kerned.ResetRunCount();
+    wraps = LineLayout::MeasureWordWrapPosition(L"AVAVAVAVAV", 52, 4, widthOf(kerned));
+    ok &= MeasureCheck(out, wraps == std::vector<int>({ 6 }), L"kerned wrap positions");
+    ok &= MeasureCheck(out, kerned.GetRunCount() == 1, L"kerned wrap measures one run");
+    std::vector<float> workerPrefix(4);
+    workerAdvances.GetPrefixWidths(L"AVA", 3, workerPrefix.data());
+    ok &= MeasureCheck(out, workerPrefix == std::vector<float>({ 0.0f, 10.0f, 17.0f, 27.0f }), L"worker prefix widths keep kerning");
+
+    out << L"[measure tests] " << (ok ? L"ok" : L"FAILED") << L"\n";
+    return ok;
+}
+
+// ---------------------------------------------------
+// 측정기 성능 : 같은 로그 라인들로 워드랩과 클릭 컬럼 찾기의 구간 측정 횟수와 시간을 잰다.
+// ---------------------------------------------------
+// start부터 지난 밀리초
+static double MeasureElapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void MeasureRow(std::wostream& out, const wchar_t* name, double ms) {
+    out << L"  " << name << L" : " << std::fixed << std::setprecision(2) << ms << L" ms\n";
+}
+
+// 로그 형태의 시험 라인 : 시각, 수준, 스레드, 요청 번호가 라인마다 달라서 길이도 조금씩 다름 (NemoBench의 시험 텍스트와 같은 형식)
+static std::vector<std::wstring> MeasureCorpus(size_t lines) {
+    static const wchar_t* levels[] = { L"INFO", L"DEBUG", L"WARN", L"ERROR" };
+    std::vector<std::wstring> split;
+    split.reserve(lines);
+    wchar_t line[128];
+    for (size_t i = 0; i < lines; i++) {
+        swprintf(line, 128, L"2024-05-01 %02u:%02u:%02u.%03u [%ls] worker-%u request %u done in %u ms",
+            (unsigned)(i / 3600000 % 24), (unsigned)(i / 60000 % 60), (unsigned)(i / 1000 % 60), (unsigned)(i % 1000),
+            levels[i * 7 % 4], (unsigned)(i % 32), (unsigned)(i * 2654435761u % 1000000), (unsigned)(i * 13 % 500));
+        split.emplace_back(line);
+    }
+    return split;
+}
+
+// 워드랩은 라인마다 누적 폭을 한 번 재고(문자 폭 캐시가 없으면 구간 측정 한 번), 클릭 컬럼 찾기는 예전처럼 탐색마다 앞부분 폭을 두 번 잰다.
+// 표 측정기의 구간 측정은 싸므로 시간보다 구간 측정 횟수(D2Render라면 만들었을 레이아웃 수)를 본다.
+void RunMeasureBench(std::wostream& out, size_t lines) {
+    std::vector<std::wstring> split = MeasureCorpus(lines);
+    const int wrapWidth = 300, tabSize = 4;
+    out << L"[measure] lines=" << split.size() << L" wrap width=" << wrapWidth << L"px\n";
+
+    TableTextMeasurer measurer(8.0f);
+    measurer.SetAdvance(L'[', 5.0f);
+    measurer.SetAdvance(L']', 5.0f);
+    measurer.SetAdvance(L' ', 4.0f);
+    size_t runs = 0, wrapSum = 0;
+    GlyphAdvanceCache::MeasureRun run = measurer.GetWorkerMeasureRun();
+    auto layoutPerCall = [&](const std::wstring& line) { runs++; return (int)run(line.data(), line.size(), nullptr); };
+    auto prefixOf = [](TextMeasurer& m) {
+        return [&m](const std::wstring& line, std::vector<float>& prefix) { m.GetPrefixWidths(line, prefix); };
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < split.size(); i++) {
+        wrapSum += LineLayout::MeasureWordWrapPosition(split[i], wrapWidth, tabSize,
+            [&](const std::wstring& line, std::vector<float>& prefix) {
+                prefix.resize(line.size() + 1);
+                runs++;
+                run(line.data(), line.size(), prefix.data());
+            }).size();
+    }
+    MeasureRow(out, L"wrap, one run per line", MeasureElapsed(start));
+    out << L"    runs=" << runs << L" wraps=" << wrapSum << L"\n";
+
+    measurer.ResetRunCount();
+    size_t cachedSum = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < split.size(); i++) {
+        cachedSum += LineLayout::MeasureWordWrapPosition(split[i], wrapWidth, tabSize, prefixOf(measurer)).size();
+    }
+    MeasureRow(out, L"wrap, glyph advance cache", MeasureElapsed(start));
+    out << L"    runs=" << measurer.GetRunCount() << (cachedSum == wrapSum ? L"" : L" MISMATCH") << L"\n";
+
+    // 커닝 쌍이 있는 표는 비례 폰트처럼 문자 폭 캐시를 쓰지 않지만, 워드랩은 여전히 라인마다 구간 측정 한 번
+    TableTextMeasurer kerned(8.0f);
+    kerned.SetKerning(L'r', L'e', -1.0f);
+    kerned.SetKerning(L'o', L'r', -1.0f);
+    size_t kernedSum = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < split.size(); i++) {
+        kernedSum += LineLayout::MeasureWordWrapPosition(split[i], wrapWidth, tabSize, prefixOf(kerned)).size();
+    }
+    MeasureRow(out, L"wrap, kerned (proportional) table", MeasureElapsed(start));
+    out << L"    runs=" << kerned.GetRunCount() << L" wraps=" << kernedSum << L"\n";
+
+    // 클릭 컬럼 : 라인마다 임의의 x 위치 세 곳
+    const int clicks = 3;
+    runs = 0;
+    size_t colSum = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < split.size(); i++) {
+        std::wstring_view line(split[i]);
+        for (int c = 0; c < clicks; c++) {
+            int x = (int)((i * 131 + c * 97) % 600);
+            int low = 0, high = (int)line.size();
+            while (low < high) {
+                int mid = (low + high) / 2;
+                int left = layoutPerCall(LineLayout::ExpandTabs(line.substr(0, mid), tabSize));
+                int right = layoutPerCall(LineLayout::ExpandTabs(line.substr(0, mid + 1), tabSize));
+                if ((left + right) / 2 < x) low = mid + 1;
+                else high = mid;
+            }
+            colSum += low;
+        }
+    }
+    MeasureRow(out, L"hit test, two runs per probe", MeasureElapsed(start));
+    out << L"    runs=" << runs << L"\n";
+
+    measurer.ResetRunCount();
+    size_t prefixSum = 0;
+    std::vector<float> expanded;
+    std::vector<int> prefix;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < split.size(); i++) {
+        std::wstring_view line(split[i]);
+        measurer.GetPrefixWidths(LineLayout::ExpandTabs(line, tabSize), expanded);
+        LineLayout::MapPrefixWidths(line, expanded, tabSize, prefix);
+        for (int c = 0; c < clicks; c++) prefixSum += LineLayout::GetColumnFromX(prefix, 0, (int)((i * 131 + c * 97) % 600));
+    }
+    MeasureRow(out, L"hit test, prefix widths once per line", MeasureElapsed(start));
+    out << L"    runs=" << measurer.GetRunCount() << (prefixSum == colSum ? L"" : L" MISMATCH") << L"\n";
+}
+#endif
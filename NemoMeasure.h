@@ -0,0 +1,111 @@
+﻿//﻿*******************************************************************************
+//    파     일     명 : NemoMeasure.h
+//    프로그램명칭 : 네모 에디터 컨트롤
+//    프로그램용도 : 텍스트 폭 측정과 워드랩, 클릭 컬럼 계산 ( MFC, DirectWrite 없이 빌드 )
+//
+//    작    성    자 : Daniel Heo ( https://github.com/Daniel-Heo/NemoEdit )
+//    라 이  센 스  : Dual License
+//                            If you are not a citizen of the Republic of Korea : AGPL 3.0 License
+//                            If you are a citizen of the Republic of Korea : MIT License
+//*******************************************************************************
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <iosfwd>
+
+#define ADVANCE_PAGE_CHARS  256 // 문자 폭 캐시의 페이지 크기 (처음 쓰는 페이지만 할당)
+
+// 폰트별 문자 폭 캐시 : 고정폭 폰트에서 셰이핑이 필요 없는 문자(라틴, 한글 음절, 한자 등)로만 된 구간은 문자별 폭을 더해서 잰다.
+// 문자 폭은 처음 나올 때 한 번만 measureRun으로 재고, 셰이핑이 필요한 문자가 섞인 구간은 통째로 measureRun에 넘긴다.
+// 비례 폰트는 커닝과 합자 때문에 문자별 폭의 합이 실제 폭과 다르므로 모든 구간을 measureRun으로 잰다.
+// 누적 폭도 measureRun 한 번으로 함께 얻으므로, 워드랩은 비례 폰트에서도 라인마다 한 번만 잰다.
+// 폰트가 바뀌면 Reset()으로 비운다.
+class GlyphAdvanceCache {
+public:
+    typedef std::function<float(const wchar_t* text, size_t length, float* prefix)> MeasureRun; // 구간 폭 (prefix가 있으면 length + 1개의 누적 폭도)
+
+    explicit GlyphAdvanceCache(MeasureRun measureRun, bool fixedPitch = true) : m_measureRun(measureRun), m_fixedPitch(fixedPitch) {}
+    void Reset(bool fixedPitch);  // 문자 폭을 비우고 새 폰트가 고정폭인지 정함
+    bool IsFixedPitch() const { return m_fixedPitch; }
+    float GetTextWidth(const wchar_t* text, size_t length);
+    void GetPrefixWidths(const wchar_t* text, size_t length, float* prefix);  // prefix[i] : 앞의 i 문자의 폭 (문자별 폭으로 안 되면 measureRun 한 번)
+    static bool NeedsShaping(wchar_t ch);  // 앞뒤 문자에 따라 모양이나 폭이 바뀌는 문자
+
+private:
+    float Advance(wchar_t ch);  // 문자 폭 (셰이핑이 필요한 문자면 음수)
+
+    MeasureRun m_measureRun;
+    bool m_fixedPitch;  // 문자별 폭을 더해도 되는 폰트 (아니면 항상 measureRun)
+    std::unique_ptr<float[]> m_pages[0x10000 / ADVANCE_PAGE_CHARS]; // 문자별 폭 (아직 재지 않았으면 음수)
+};
+
+// 텍스트 폭 측정 인터페이스 : NemoEdit는 이것을 통해서만 폭을 잰다. (기본은 D2Render, 문자별 폭 표로 만든 구현 등으로 바꿀 수 있음)
+class TextMeasurer {
+public:
+    virtual ~TextMeasurer() {}
+    virtual float GetTextWidth(const std::wstring& line) = 0;  // 텍스트 문자열의 픽셀 너비
+    virtual void GetPrefixWidths(const std::wstring& line, std::vector<float>& prefix) = 0;  // prefix[i] : 앞의 i 문자의 폭 (line.size() + 1개)
+    // 작업 스레드에서 쓸 측정 함수 : 부른 시점의 폰트로 고정되고 여러 스레드가 동시에 불러도 된다. (nullptr이면 백그라운드 워드랩을 하지 않음)
+    virtual GlyphAdvanceCache::MeasureRun GetWorkerMeasureRun() { return nullptr; }
+    virtual bool IsFixedPitch() { return false; }  // 작업 스레드의 문자 폭 캐시가 문자별 폭을 더해도 되는지 (커닝, 합자가 없는 고정폭 폰트)
+};
+
+// 문자별 폭 표로 재는 측정기 : DirectWrite 없이 워드랩과 히트 테스트를 시험하거나 측정 횟수를 셀 때 쓴다.
+// 표에 없는 문자는 기본 폭이고, 커닝 쌍을 넣으면 두 문자 사이에 더한다. (커닝 쌍이 있으면 비례 폰트처럼 구간을 통째로 잼)
+class TableTextMeasurer : public TextMeasurer {
+public:
+    explicit TableTextMeasurer(float defaultAdvance = 8.0f);
+    void SetAdvance(wchar_t ch, float advance);
+    void SetKerning(wchar_t left, wchar_t right, float adjust);
+    float GetTextWidth(const std::wstring& line);
+    void GetPrefixWidths(const std::wstring& line, std::vector<float>& prefix);
+    GlyphAdvanceCache::MeasureRun GetWorkerMeasureRun();  // 부른 시점의 표를 복사해서 붙잡아 둠
+    bool IsFixedPitch() { return m_table.kerning.empty(); }
+    size_t GetRunCount() const { return m_runCount; }  // 구간을 통째로 잰 횟수 (D2Render라면 레이아웃을 만든 횟수)
+    void ResetRunCount() { m_runCount = 0; }
+
+private:
+    struct Table {
+        std::vector<float> advances;                    // 문자별 폭 (0x10000개)
+        std::unordered_map<uint32_t, float> kerning;    // (왼쪽 << 16 | 오른쪽) 문자 쌍의 간격 조정
+    };
+    static float Measure(const Table& table, const wchar_t* text, size_t length, float* prefix);
+
+    Table m_table;
+    GlyphAdvanceCache m_advances;
+    size_t m_runCount;
+};
+
+// 라인 배치 계산 : 탭 펼치기, 워드랩 위치, 누적 폭과 클릭 컬럼 (멤버가 없으므로 작업 스레드나 시험에서도 부름)
+class LineLayout {
+public:
+    typedef std::function<void(const std::wstring& text, std::vector<float>& prefix)> PrefixWidths; // prefix[i] : 앞의 i 문자의 폭 (text.size() + 1개)
+
+    static std::wstring ExpandTabs(std::wstring_view text, int tabSize); // \t을 space * tabSize로 치환
+    static void MapPrefixWidths(std::wstring_view line, const std::vector<float>& expanded, int tabSize, std::vector<int>& prefix); // 탭을 펼친 누적 폭을 원래 컬럼 위치로
+    static int GetColumnFromX(const std::vector<int>& prefix, int startCol, int x); // startCol부터 x 픽셀 위치에 가장 가까운 컬럼 경계
+    // 자동 줄바꿈 위치를 라인의 누적 폭을 한 번 재서 계산
+    static std::vector<int> MeasureWordWrapPosition(std::wstring_view lineText, int wrapWidth, int tabSize, const PrefixWidths& prefixWidths);
+
+private:
+    static void MeasureColumns(std::wstring_view line, int tabSize, const PrefixWidths& prefixWidths, std::vector<float>& prefix); // 원래 컬럼 기준 누적 폭
+};
+
+// NemoBench는 측정기 시험과 측정을 함께 부르므로 NEMO_BENCH면 NEMO_MEASURE_TESTS도 켠다.
+#if defined(NEMO_BENCH) && !defined(NEMO_MEASURE_TESTS)
+#define NEMO_MEASURE_TESTS
+#endif
+#ifdef NEMO_MEASURE_TESTS
+// 표 측정기로 워드랩, 누적 폭, 클릭 컬럼을 손으로 계산한 값과 비교 (실패한 항목 출력)
+// MFC 없이 빌드하는 NemoMeasureTests 실행 파일과 NemoBench::MeasureTests가 부른다.
+bool RunMeasureTests(std::wostream& out);
+// lines줄 로그로 워드랩과 클릭 컬럼 찾기를 잼 : 문자 폭 캐시, 누적 폭 vs 호출마다 구간 측정 (구간 측정 횟수와 시간)
+// MFC 없이 빌드하는 NemoMeasureBench 실행 파일과 NemoBench::MeasureText가 부른다.
+void RunMeasureBench(std::wostream& out, size_t lines);
+#endif
@@ -0,0 +1,3991 @@
+﻿//*******************************************************************************
+//    파     일     명 : NemoRope.cpp
+//    프로그램명칭 : 네모 에디터 컨트롤
+//    프로그램용도 : 라인 단위 B+트리 로프 ( 텍스트 저장, 스냅샷, 압축, 스왑, MFC 없이 빌드 )
+//
+//    작    성    자 : Daniel Heo ( https://github.com/Daniel-Heo/NemoEdit )
+//    라 이  센 스  : Dual License
+//                            If you are not a citizen of the Republic of Korea : AGPL 3.0 License
+//                            If you are a citizen of the Republic of Korea : MIT License
+//*******************************************************************************
+#include "pch.h"
+#include "NemoRope.h"
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>   // SSE2/AVX2 줄바꿈 검색
+#endif
+
+// ---------------------------------------------------
+// RopeArena
+// ---------------------------------------------------
+RopeArena::RopeArena() : m_slabPos(nullptr), m_slabLeft(0), m_large(nullptr) {
+    memset(m_smallFree, 0, sizeof(m_smallFree));
+    memset(m_mediumFree, 0, sizeof(m_mediumFree));
+}
+
+RopeArena::~RopeArena() {
+    reset();
+}
+
+size_t RopeArena::roundSize(size_t bytes) {
+    if (bytes == 0) bytes = 1;
+    if (bytes <= ARENA_SMALL_MAX) return (bytes + 15) & ~(size_t)15;
+    if (bytes > ARENA_MEDIUM_MAX) return bytes;
+
+    size_t size = ARENA_SMALL_MAX * 2;
+    while (size < bytes) size <<= 1;
+    return size;
+}
+
+RopeArena::FreeBlock*& RopeArena::freeList(size_t roundedBytes) {
+    if (roundedBytes <= ARENA_SMALL_MAX) return m_smallFree[roundedBytes / 16];
+
+    int cls = 0;
+    while (((size_t)ARENA_SMALL_MAX * 2 << cls) < roundedBytes) cls++;
+    return m_mediumFree[cls];
+}
+
+void* RopeArena::allocate(size_t bytes, size_t* capacity) {
+    size_t size = roundSize(bytes);
+    if (capacity) *capacity = size;
+
+    m_stats.allocCount++;
+    m_stats.usedBytes += size;
+    if (m_stats.usedBytes > m_stats.peakBytes) m_stats.peakBytes = m_stats.usedBytes;
+
+    // 큰 블록은 개별 할당하고 목록으로 관리
+    if (size > ARENA_MEDIUM_MAX) {
+        LargeBlock* block = (LargeBlock*)::operator new(sizeof(LargeBlock) + size);
+        block->prev = nullptr;
+        block->next = m_large;
+        block->bytes = size;
+        if (m_large) m_large->prev = block;
+        m_large = block;
+        m_stats.largeCount++;
+        m_stats.largeBytes += size;
+        return block + 1;
+    }
+
+    // 같은 크기 클래스의 반환 블록 재사용
+    FreeBlock*& head = freeList(size);
+    if (head) {
+        FreeBlock* block = head;
+        head = block->next;
+        m_stats.reuseCount++;
+        return block;
+    }
+
+    // 현재 슬랩에서 잘라 쓰고, 모자라면 남은 꼬리를 프리리스트에 넣은 뒤 새 슬랩 확보
+    if (size > m_slabLeft) {
+        while (m_slabLeft >= 16) {
+            size_t piece = m_slabLeft;
+            if (piece > ARENA_SMALL_MAX) {
+                piece = ARENA_SMALL_MAX * 2;
+                while (piece * 2 <= m_slabLeft && piece * 2 <= ARENA_MEDIUM_MAX) piece *= 2;
+                if (piece > m_slabLeft) piece = ARENA_SMALL_MAX;
+            }
+            FreeBlock* block = (FreeBlock*)m_slabPos;
+            FreeBlock*& tail = freeList(piece);
+            block->next = tail;
+            tail = block;
+            m_slabPos += piece;
+            m_slabLeft -= piece;
+        }
+
+        char* slab = (char*)::operator new(ARENA_SLAB_SIZE);
+        m_slabs.push_back(slab);
+        m_slabPos = slab;
+        m_slabLeft = ARENA_SLAB_SIZE;
+        m_stats.slabCount++;
+        m_stats.slabBytes += ARENA_SLAB_SIZE;
+    }
+
+    void* p = m_slabPos;
+    m_slabPos += size;
+    m_slabLeft -= size;
+    return p;
+}
+
+void RopeArena::release(void* p, size_t bytes) {
+    if (!p) return;
+    size_t size = roundSize(bytes);
+    m_stats.usedBytes -= size;
+
+    if (size > ARENA_MEDIUM_MAX) {
+        LargeBlock* block = (LargeBlock*)p - 1;
+        if (block->prev) block->prev->next = block->next;
+        else m_large = block->next;
+        if (block->next) block->next->prev = block->prev;
+        m_stats.largeCount--;
+        m_stats.largeBytes -= size;
+        ::operator delete(block);
+        return;
+    }
+
+    FreeBlock* block = (FreeBlock*)p;
+    FreeBlock*& head = freeList(size);
+    block->next = head;
+    head = block;
+}
+
+void RopeArena::reset() {
+    // 슬랩과 큰 블록만 반환 (개별 노드/라인은 따라가지 않음)
+    for (char* slab : m_slabs) ::operator delete(slab);
+    m_slabs.clear();
+    while (m_large) {
+        LargeBlock* next = m_large->next;
+        ::operator delete(m_large);
+        m_large = next;
+    }
+    m_slabPos = nullptr;
+    m_slabLeft = 0;
+    memset(m_smallFree, 0, sizeof(m_smallFree));
+    memset(m_mediumFree, 0, sizeof(m_mediumFree));
+
+    RopeArenaStats stats;
+    stats.peakBytes = m_stats.peakBytes;
+    stats.allocCount = m_stats.allocCount;
+    stats.reuseCount = m_stats.reuseCount;
+    stats.resetCount = m_stats.resetCount + 1;
+    m_stats = stats;
+}
+
+// ---------------------------------------------------
+// RopeMappedFile
+// ---------------------------------------------------
+bool RopeMappedFile::open(const std::wstring& path) {
+    close();
+    m_hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (m_hFile == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_hFile, &fileSize)) {
+        close();
+        return false;
+    }
+    size = (size_t)fileSize.QuadPart;
+
+    // 빈 파일은 매핑할 수 없으므로 뷰 없이 연다.
+    if (size > 0) {
+        m_hMapping = CreateFileMappingW(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_hMapping == NULL) {
+            close();
+            return false;
+        }
+        view = (const uint8_t*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr) {
+            close();
+            return false;
+        }
+    }
+
+    // BOM으로 인코딩 판별, 없으면 앞부분이 UTF-8로 유효한지 보고 아니면 시스템 코드페이지로 처리
+    dataStart = 0;
+    if (size >= 3 && view[0] == 0xEF && view[1] == 0xBB && view[2] == 0xBF) {
+        encoding = Utf8;
+        dataStart = 3;
+    }
+    else if (size >= 2 && view[0] == 0xFF && view[1] == 0xFE) {
+        encoding = Utf16LE;
+        dataStart = 2;
+    }
+    else if (size >= 2 && view[0] == 0xFE && view[1] == 0xFF) {
+        encoding = Utf16BE;
+        dataStart = 2;
+    }
+    else {
+        encoding = isUtf8(view, min(size, (size_t)(64 * 1024))) ? Utf8 : Ansi;
+    }
+    return true;
+}
+
+void RopeMappedFile::close() {
+    if (view) UnmapViewOfFile(view);
+    if (m_hMapping) CloseHandle(m_hMapping);
+    if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+    view = nullptr;
+    m_hMapping = NULL;
+    m_hFile = INVALID_HANDLE_VALUE;
+    size = dataStart = 0;
+}
+
+void RopeMappedFile::decode(const uint8_t* src, size_t bytes, std::wstring& out) const {
+    out.clear();
+    if (bytes == 0) return;
+
+    if (encoding == Utf16LE || encoding == Utf16BE) {
+        size_t len = bytes / 2;
+        int hi = (encoding == Utf16BE) ? 0 : 1;
+        out.resize(len);
+        for (size_t i = 0; i < len; i++) {
+            out[i] = (wchar_t)((src[i * 2 + hi] << 8) | src[i * 2 + 1 - hi]);
+        }
+        return;
+    }
+
+    UINT codePage = (encoding == Utf8) ? CP_UTF8 : CP_ACP;
+    int len = MultiByteToWideChar(codePage, 0, (LPCCH)src, (int)bytes, NULL, 0);
+    out.resize(len);
+    if (len > 0) MultiByteToWideChar(codePage, 0, (LPCCH)src, (int)bytes, &out[0], len);
+}
+
+bool RopeMappedFile::isUtf8(const uint8_t* p, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        uint8_t c = p[i];
+        size_t follow;
+        if (c < 0x80) follow = 0;
+        else if (c >= 0xC2 && c <= 0xDF) follow = 1;
+        else if (c >= 0xE0 && c <= 0xEF) follow = 2;
+        else if (c >= 0xF0 && c <= 0xF4) follow = 3;
+        else return false;
+
+        // 검사 구간 끝에서 잘린 문자는 유효한 것으로 본다.
+        for (size_t k = 1; k <= follow; k++) {
+            if (i + k >= n) return true;
+            if ((p[i + k] & 0xC0) != 0x80) return false;
+        }
+        i += follow + 1;
+    }
+    return true;
+}
+
+// ---------------------------------------------------
+// RopeSwapFile
+// ---------------------------------------------------
+bool RopeSwapFile::open() {
+    close();
+    wchar_t dir[MAX_PATH], path[MAX_PATH];
+    if (!GetTempPathW(MAX_PATH, dir) || !GetTempFileNameW(dir, L"nms", 0, path)) return false;
+    m_hFile = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    return m_hFile != INVALID_HANDLE_VALUE;
+}
+
+void RopeSwapFile::close() {
+    if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_end = 0;
+    m_free.clear();
+}
+
+// 요청 크기 이상인 가장 작은 빈 구간을 쓰고 남는 부분은 다시 빈 구간으로 둔다. (인접한 빈 구간은 합치지 않음)
+uint64_t RopeSwapFile::write(const uint8_t* data, size_t bytes) {
+    size_t blockBytes = (bytes + SWAP_BLOCK - 1) / SWAP_BLOCK * SWAP_BLOCK;
+    uint64_t pos;
+    auto it = m_free.lower_bound(blockBytes);
+    if (it != m_free.end()) {
+        pos = it->second;
+        size_t rest = it->first - blockBytes;
+        m_free.erase(it);
+        if (rest) m_free.insert({ rest, pos + blockBytes });
+    }
+    else {
+        pos = m_end;
+        m_end += blockBytes;
+    }
+
+    OVERLAPPED ov = {};
+    ov.Offset = (DWORD)pos;
+    ov.OffsetHigh = (DWORD)(pos >> 32);
+    DWORD written = 0;
+    if (!WriteFile(m_hFile, data, (DWORD)bytes, &written, &ov) || written != bytes) {
+        release(pos, bytes);
+        return SWAP_FAIL;
+    }
+    return pos;
+}
+
+bool RopeSwapFile::read(uint64_t pos, uint8_t* data, size_t bytes) const {
+    OVERLAPPED ov = {};
+    ov.Offset = (DWORD)pos;
+    ov.OffsetHigh = (DWORD)(pos >> 32);
+    DWORD done = 0;
+    return ReadFile(m_hFile, data, (DWORD)bytes, &done, &ov) && done == bytes;
+}
+
+void RopeSwapFile::release(uint64_t pos, size_t bytes) {
+    m_free.insert({ (bytes + SWAP_BLOCK - 1) / SWAP_BLOCK * SWAP_BLOCK, pos });
+}
+
+// ---------------------------------------------------
+// LineScanner
+// ---------------------------------------------------
+size_t LineScanner::scan(const wchar_t* text, size_t len, size_t from, size_t stopAt, size_t maxCount, std::vector<size_t>& breaks) {
+    return scanUnits<wchar_t>(text, len, from, stopAt, maxCount, breaks, L'\r', L'\n');
+}
+
+size_t LineScanner::scan(const uint8_t* text, size_t len, size_t from, size_t stopAt, size_t maxCount, std::vector<size_t>& breaks) {
+    return scanUnits<uint8_t>(text, len, from, stopAt, maxCount, breaks, '\r', '\n');
+}
+
+// 빅엔디안은 바이트 순서가 뒤집힌 값으로 비교한다.
+size_t LineScanner::scan(const uint16_t* text, size_t len, size_t from, size_t stopAt, size_t maxCount, std::vector<size_t>& breaks, bool bigEndian) {
+    return scanUnits<uint16_t>(text, len, from, stopAt, maxCount, breaks,
+        bigEndian ? (uint16_t)0x0D00 : (uint16_t)0x000D, bigEndian ? (uint16_t)0x0A00 : (uint16_t)0x000A);
+}
+
+template <typename T>
+size_t LineScanner::scanUnits(const T* text, size_t len, size_t from, size_t stopAt, size_t maxCount, std::vector<size_t>& breaks, T cr, T lf) {
+    size_t next = from;
+    size_t found = 0;
+    size_t i = from;
+    while (found < maxCount && next < stopAt) {
+        i = findBreak(text, i, len, cr, lf);
+        if (i >= len) break;
+        breaks.push_back(i);
+        found++;
+        // \r\n 쌍은 블록 경계에 걸쳐 있어도 여기서 한 번에 건너뛴다.
+        i += (text[i] == cr && i + 1 < len && text[i + 1] == lf) ? 2 : 1;
+        next = i;
+    }
+    return next;
+}
+
+#if defined(_M_IX86) || defined(_M_X64)
+bool LineScanner::hasAvx2() {
+    static const bool supported = [] {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+
+        // AVX + OSXSAVE 지원 및 OS가 YMM 레지스터 상태를 저장하는지 확인
+        __cpuid(info, 1);
+        if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return false;
+        if ((_xgetbv(0) & 6) != 6) return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return supported;
+}
+
+size_t LineScanner::findBreak(const uint8_t* p, size_t i, size_t len, uint8_t cr, uint8_t lf) {
+    unsigned long bit;
+    if (hasAvx2()) {
+        const __m256i vcr = _mm256_set1_epi8((char)cr);
+        const __m256i vlf = _mm256_set1_epi8((char)lf);
+        for (; i + 32 <= len; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+            unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, vcr), _mm256_cmpeq_epi8(v, vlf)));
+            if (mask) {
+                _BitScanForward(&bit, mask);
+                return i + bit;
+            }
+        }
+    }
+    const __m128i vcr = _mm_set1_epi8((char)cr);
+    const __m128i vlf = _mm_set1_epi8((char)lf);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, vcr), _mm_cmpeq_epi8(v, vlf)));
+        if (mask) {
+            _BitScanForward(&bit, mask);
+            return i + bit;
+        }
+    }
+    for (; i < len; i++) {
+        if (p[i] == cr || p[i] == lf) return i;
+    }
+    return len;
+}
+
+// 16비트 비교 결과는 movemask에서 문자당 2비트가 되므로 비트 위치를 2로 나눈다.
+size_t LineScanner::findBreak(const uint16_t* p, size_t i, size_t len, uint16_t cr, uint16_t lf) {
+    unsigned long bit;
+    if (hasAvx2()) {
+        const __m256i vcr = _mm256_set1_epi16((short)cr);
+        const __m256i vlf = _mm256_set1_epi16((short)lf);
+        for (; i + 16 <= len; i += 16) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+            unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi16(v, vcr), _mm256_cmpeq_epi16(v, vlf)));
+            if (mask) {
+                _BitScanForward(&bit, mask);
+                return i + bit / 2;
+            }
+        }
+    }
+    const __m128i vcr = _mm_set1_epi16((short)cr);
+    const __m128i vlf = _mm_set1_epi16((short)lf);
+    for (; i + 8 <= len; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(v, vcr), _mm_cmpeq_epi16(v, vlf)));
+        if (mask) {
+            _BitScanForward(&bit, mask);
+            return i + bit / 2;
+        }
+    }
+    for (; i < len; i++) {
+        if (p[i] == cr || p[i] == lf) return i;
+    }
+    return len;
+}
+#else
+bool LineScanner::hasAvx2() {
+    return false;
+}
+
+size_t LineScanner::findBreak(const uint8_t* p, size_t i, size_t len, uint8_t cr, uint8_t lf) {
+    for (; i < len; i++) {
+        if (p[i] == cr || p[i] == lf) return i;
+    }
+    return len;
+}
+
+size_t LineScanner::findBreak(const uint16_t* p, size_t i, size_t len, uint16_t cr, uint16_t lf) {
+    for (; i < len; i++) {
+        if (p[i] == cr || p[i] == lf) return i;
+    }
+    return len;
+}
+#endif
+
+// Windows의 wchar_t는 16비트이므로 UTF-16 검색을 그대로 사용한다.
+size_t LineScanner::findBreak(const wchar_t* p, size_t i, size_t len, wchar_t cr, wchar_t lf) {
+    if (sizeof(wchar_t) == sizeof(uint16_t)) {
+        return findBreak((const uint16_t*)p, i, len, (uint16_t)cr, (uint16_t)lf);
+    }
+    for (; i < len; i++) {
+        if (p[i] == cr || p[i] == lf) return i;
+    }
+    return len;
+}
+
+// ---------------------------------------------------
+// Rope
+// ---------------------------------------------------
+Rope::Rope() : m_source(std::make_shared<RopeMappedFile>()), root(nullptr), m_totalLines(0), m_finger(nullptr), m_fingerStart(0), m_viewLeaf(nullptr), m_viewLine(0),
+    m_gen(1), m_frozenGen(0), m_sweepAt(SNAPSHOT_SWEEP_MIN), m_hotHead(nullptr), m_hotTail(nullptr), m_hotCount(0), m_hotBytes(0), m_hotMax(0), m_swapBudget(0), m_editCount(0), m_unmappedEdit(0), m_editNoted(true), m_interning(false) {
+    root = allocLeaf();
+}
+
+Rope::~Rope() {
+    // 노드와 리프 버퍼는 m_arena 소멸 시 슬랩 단위로 일괄 해제된다.
+}
+
+void Rope::insert(size_t lineIndex, std::wstring_view text) {
+    dropFinger();
+    noteLines(lineIndex, 0, 1);
+    insertLine(lineIndex, text);
+}
+
+// insert의 본문 : 다른 수정 연산 안에서 부를 때는 dropFinger(내보내기)를 다시 하지 않는다.
+void Rope::insertLine(size_t lineIndex, std::wstring_view text) {
+    if (lineIndex > m_totalLines) return;
+
+    RopePath path;
+    size_t offset;
+    RopeLeaf* leaf = findResidentLeaf(lineIndex, offset, &path);
+    if (offset > leaf->lineCount()) offset = leaf->lineCount();
+
+    RopeWeight before = leaf->weight();
+    leafInsertLine(leaf, offset, text.data(), text.size());
+    addWeight(path, leaf->weight() - before);
+    m_totalLines++;
+
+    // 노드 크기 기준 분할 : 트리 높이는 루트 분할로만 늘어나므로 재조정이 필요 없다.
+    splitIfNeeded(leaf, path);
+}
+
+void Rope::insertAt(size_t lineIndex, size_t offset, std::wstring_view text) {
+    dropFinger();
+    noteLines(lineIndex, lineIndex < m_totalLines ? 1 : 0, 1);
+    if (lineIndex > m_totalLines) return;
+
+    if (lineIndex == m_totalLines) {
+        insertLine(lineIndex, text);
+    }
+    else {
+        RopePath path;
+        size_t lineOffset;
+        RopeLeaf* leaf = findResidentLeaf(lineIndex, lineOffset, &path);
+        size_t startPos = offset;
+        if (offset >= leaf->lineLen(lineOffset)) {
+            startPos = leaf->lineLen(lineOffset);
+        }
+        RopeWeight before = leaf->weight();
+        leafReplace(leaf, lineOffset, startPos, 0, text.data(), text.size());
+        addWeight(path, leaf->weight() - before);
+        splitIfNeeded(leaf, path);
+    }
+    return;
+}
+
+void Rope::insertBack(std::wstring_view text) {
+    insert(m_totalLines, text);
+}
+
+void Rope::erase(size_t lineIndex) {
+    dropFinger();
+    noteLines(lineIndex, 1, 0);
+    eraseLine(lineIndex);
+}
+
+// erase의 본문 : 다른 수정 연산 안에서 부를 때는 dropFinger(내보내기)를 다시 하지 않는다.
+void Rope::eraseLine(size_t lineIndex) {
+    if (lineIndex >= m_totalLines) return;
+
+    RopePath path;
+    size_t offset;
+    RopeLeaf* leaf = findResidentLeaf(lineIndex, offset, &path);
+    if (offset >= leaf->lineCount()) return;
+
+    RopeWeight before = leaf->weight();
+    leafEraseLines(leaf, offset, 1);
+    addWeight(path, leaf->weight() - before);
+    m_totalLines--;
+    repairLeaf(leaf, path);
+}
+
+void Rope::eraseAt(size_t lineIndex, size_t offset, size_t size) {
+    dropFinger();
+    noteLines(lineIndex, 1, 1);
+    if (lineIndex >= m_totalLines) return;
+
+    RopePath path;
+    size_t lineOffset;
+    RopeLeaf* leaf = findResidentLeaf(lineIndex, lineOffset, &path);
+    size_t lineLen = leaf->lineLen(lineOffset);
+    size_t actualSize = size;
+    if (lineLen == 0 || offset >= lineLen) return;
+    if (offset + size > lineLen) actualSize = lineLen - offset;
+    if (actualSize == 0) return;
+
+    RopeWeight before = leaf->weight();
+    leafReplace(leaf, lineOffset, offset, actualSize, nullptr, 0);
+    addWeight(path, leaf->weight() - before);
+}
+
+void Rope::update(size_t lineIndex, std::wstring_view newText) {
+    dropFinger();
+    noteLines(lineIndex, 1, 1);
+    if (lineIndex >= m_totalLines) return;
+
+    RopePath path;
+    size_t offset;
+    RopeLeaf* leaf = findResidentLeaf(lineIndex, offset, &path);
+    RopeWeight before = leaf->weight();
+    leafReplace(leaf, offset, 0, leaf->lineLen(offset), newText.data(), newText.size());
+    addWeight(path, leaf->weight() - before);
+    splitIfNeeded(leaf, path);
+}
+
+void Rope::mergeLine(size_t lineIndex)
+{
+    dropFinger();
+    noteLines(lineIndex, 2, 1);
+    if (lineIndex + 1 >= getSize())
+        return;
+
+    RopePath path;
+    size_t offset;
+    RopeLeaf* leaf = findResidentLeaf(lineIndex, offset, &path);
+    RopeWeight before = leaf->weight();
+
+    // 같은 리프 안에서 인코딩도 같으면 버퍼는 그대로 두고 라인 경계만 제거 (긴 라인, 공유 라인이나 합쳐서 긴 라인이 되는 경우 제외)
+    if (offset + 1 < leaf->lineCount() && leaf->lineWide[offset] == leaf->lineWide[offset + 1] &&
+        !leaf->isRef(offset) && leaf->lineLen(offset) + leaf->lineLen(offset + 1) <= LONG_LINE_MIN) {
+        leafResetWrap(leaf, offset);
+        leafResetWrap(leaf, offset + 1);
+        if (leaf->lineWraps.size) leaf->lineWraps.erase(offset + 1, 1);
+        leaf->lineEnd.erase(offset, 1);
+        leaf->lineWide.erase(offset + 1, 1);
+        addWeight(path, leaf->weight() - before);
+        m_totalLines--;
+        repairLeaf(leaf, path);
+        return;
+    }
+
+    // 인코딩이 다르거나 다음 라인이 다른 리프에 있으면 다음 라인을 뷰로 읽어서 끝에 붙인다.
+    RopeLeaf* nextLeaf = leaf;
+    size_t nextOffset = offset + 1;
+    RopePath nextPath;
+    if (nextOffset >= leaf->lineCount()) {
+        nextLeaf = findResidentLeaf(lineIndex + 1, nextOffset, &nextPath);
+    }
+    if (nextLeaf->isLong(nextOffset)) {
+        // 다음 라인이 긴 라인이면 문자를 복사하지 않고 청크째 옮긴다. (빈 라인으로 남은 다음 라인은 아래에서 지움)
+        RopeWeight nextBefore = nextLeaf->weight();
+        RopeLongLine* tail = leafTakeLong(nextLeaf, nextOffset);
+        if (nextLeaf != leaf) addWeight(nextPath, nextLeaf->weight() - nextBefore);
+        leafJoinLong(leaf, offset, tail);
+    }
+    std::wstring_view nextLine = lineView(nextLeaf, nextOffset);
+    if (nextLeaf == leaf && nextLine.data() != m_viewBuf.data()) {
+        // 같은 버퍼를 편집하므로 UTF-16 라인은 먼저 복사
+        m_viewBuf.assign(nextLine);
+        nextLine = m_viewBuf;
+    }
+    m_viewLeaf = nullptr;
+    leafReplace(leaf, offset, leaf->lineLen(offset), 0, nextLine.data(), nextLine.size());
+
+    if (nextLeaf == leaf) {
+        leafEraseLines(leaf, offset + 1, 1);
+        addWeight(path, leaf->weight() - before);
+        m_totalLines--;
+        if (leafUnderflow(leaf)) repairLeaf(leaf, path);
+        else splitIfNeeded(leaf, path);
+    }
+    else {
+        addWeight(path, leaf->weight() - before);
+        splitIfNeeded(leaf, path);
+        eraseLine(lineIndex + 1);
+    }
+}
+
+void Rope::splitLine(size_t lineIndex, size_t column) {
+    dropFinger();
+    noteLines(lineIndex, 1, 2);
+    if (lineIndex >= m_totalLines) return;
+
+    RopePath path;
+    size_t offset;
+    RopeLeaf* leaf = findResidentLeaf(lineIndex, offset, &path);
+    if (column > leaf->lineLen(offset)) column = leaf->lineLen(offset);
+
+    RopeWeight before = leaf->weight();
+    leafResetWrap(leaf, offset);
+    if (leaf->isLong(offset)) {
+        // 긴 라인 : column 뒤쪽 청크들을 새 긴 라인으로 떼어 다음 라인에 두고, 짧아진 쪽은 다시 리프 버퍼로
+        RopeLongLine* tail = longLineSplit(leaf->longLine(offset), column);
+        leaf->chars -= tail->chars;
+        leaf->utf8 -= tail->utf8;
+        leafInsertLine(leaf, offset + 1, nullptr, 0);
+        leafJoinLong(leaf, offset + 1, tail);
+        leafUnchunk(leaf, offset + 1);
+        leafUnchunk(leaf, offset);
+    }
+    else {
+        // 앞부분과 뒷부분이 버퍼에 이미 연속으로 있으므로 라인 끝 위치만 하나 끼워 넣는다. (인코딩은 둘 다 유지)
+        if (leaf->isAtom(offset)) leafUnatom(leaf, offset);
+        uint8_t shift = leaf->lineWide[offset];
+        uint32_t cut = (uint32_t)(leaf->lineStart(offset) + (column << shift));
+        uint32_t noWrap = 0;
+        leaf->lineEnd.insert(m_arena, offset, &cut, 1);
+        leaf->lineWide.insert(m_arena, offset, &shift, 1);
+        if (leaf->lineWraps.size) leaf->lineWraps.insert(m_arena, offset, &noWrap, 1);
+    }
+    addWeight(path, leaf->weight() - before);
+    m_totalLines++;
+    splitIfNeeded(leaf, path);
+}
+
+// 오래된 절반을 버릴 때는 버린 수정까지를 구간을 모르는 수정으로 친다.
+void Rope::noteLines(size_t line, size_t removed, size_t inserted) {
+    if (m_lineEdits.size() >= LINE_EDIT_LOG) {
+        size_t drop = LINE_EDIT_LOG / 2;
+        m_unmappedEdit = max(m_unmappedEdit, m_lineEdits[drop - 1].edit);
+        m_lineEdits.erase(m_lineEdits.begin(), m_lineEdits.begin() + drop);
+    }
+    m_lineEdits.push_back({ m_editCount, line, removed, inserted });
+    m_editNoted = true;
+}
+
+// 기록된 구간을 since 이후 것만 차례로 적용 : 구간 앞 라인은 그대로, 구간 안은 실패, 구간 뒤는 늘어난 만큼 민다.
+bool Rope::mapLine(uint64_t since, size_t& lineIndex) const {
+    if (since == m_editCount) return true;
+    uint64_t unmapped = m_editNoted ? m_unmappedEdit : m_editCount;
+    if (since < unmapped) return false;
+    auto it = std::upper_bound(m_lineEdits.begin(), m_lineEdits.end(), since,
+        [](uint64_t edit, const LineEdit& e) { return edit < e.edit; });
+    for (; it != m_lineEdits.end(); ++it) {
+        if (lineIndex < it->line) continue;
+        if (lineIndex - it->line < it->removed) return false;
+        lineIndex = lineIndex - it->removed + it->inserted;
+    }
+    return true;
+}
+
+bool Rope::clear() {
+    dropFinger();
+    sweepSnapshots();
+    if (m_snapshots.empty()) {
+        // 노드를 하나씩 따라가며 해제하지 않고 아레나를 통째로 반환
+        m_arena.reset();
+        m_retired.clear();
+        m_hotHead = m_hotTail = nullptr;
+        m_hotCount = m_hotBytes = 0;
+        m_packStats.packedLeaves = m_packStats.packedBytes = m_packStats.rawBytes = 0;
+        m_swap.close(); // 다음에 스왑할 때 새로 만든다.
+        m_swapStats.swappedLeaves = m_swapStats.swapBytes = 0;
+        std::fill(m_atomTable.begin(), m_atomTable.end(), nullptr);
+        std::fill(m_seenHash.begin(), m_seenHash.end(), 0);
+        m_internStats = RopeInternStats();
+    }
+    else {
+        // 스냅샷이 살아 있으면 공유 노드는 해제를 미루고 나머지만 반환
+        releaseSubtree(root);
+    }
+    m_source = std::make_shared<RopeMappedFile>(); // 스냅샷이 참조하던 원본 파일은 마지막 스냅샷과 함께 닫힌다.
+    root = allocLeaf();
+    m_totalLines = 0;
+    return true;
+}
+
+bool Rope::empty() {
+    return m_totalLines == 0;
+}
+
+size_t Rope::getSize() {
+    return m_totalLines;
+}
+
+size_t Rope::getLineSize(size_t lineIndex) {
+    if (lineIndex >= m_totalLines) return 0;
+    beginRead();
+
+    size_t offset;
+    RopeLeaf* leaf = findResidentLeaf(lineIndex, offset);
+    return leaf->lineLen(offset);
+}
+
+std::wstring Rope::getLine(size_t lineIndex) {
+    if (lineIndex >= m_totalLines) return L"";
+    beginRead();
+
+    size_t offset;
+    RopeLeaf* leaf = findResidentLeaf(lineIndex, offset);
+    std::wstring line;
+    appendLine(line, leaf, offset, 0, leaf->lineLen(offset));
+    return line;
+}
+
+RopeCursor Rope::cursorAt(size_t lineIndex) {
+    RopeCursor cursor;
+    if (lineIndex >= m_totalLines) return cursor;
+    beginRead();
+
+    cursor.leaf = findResidentLeaf(lineIndex, cursor.offset);
+    cursor.line = lineIndex;
+    return cursor;
+}
+
+bool Rope::next(RopeCursor& cursor) {
+    if (!cursor.leaf) return false;
+    if (cursor.offset + 1 < cursor.leaf->lineCount()) {
+        cursor.offset++;
+    }
+    else {
+        if (!cursor.leaf->next) return false;
+        cursor.leaf = residentLeaf(cursor.leaf->next, cursor.line + 1);
+        cursor.offset = 0;
+    }
+    cursor.line++;
+    return true;
+}
+
+bool Rope::prev(RopeCursor& cursor) {
+    if (!cursor.leaf) return false;
+    if (cursor.offset > 0) {
+        cursor.offset--;
+    }
+    else {
+        if (!cursor.leaf->prev) return false;
+        cursor.leaf = residentLeaf(cursor.leaf->prev, cursor.line - 1);
+        cursor.offset = cursor.leaf->lineCount() - 1;
+    }
+    cursor.line--;
+    return true;
+}
+
+size_t Rope::getLineSize(const RopeCursor& cursor) {
+    return cursor.leaf ? residentLeaf(cursor.leaf, cursor.line)->lineLen(cursor.offset) : 0;
+}
+
+std::wstring Rope::getLine(const RopeCursor& cursor) {
+    std::wstring line;
+    if (!cursor.leaf) return line;
+    RopeLeaf* leaf = residentLeaf(cursor.leaf, cursor.line); // 그 사이에 압축되었을 수 있음
+    appendLine(line, leaf, cursor.offset, 0, leaf->lineLen(cursor.offset));
+    return line;
+}
+
+std::wstring_view Rope::getLineView(size_t lineIndex) {
+    if (lineIndex >= m_totalLines) return std::wstring_view();
+    beginRead();
+
+    size_t offset;
+    RopeLeaf* leaf = findResidentLeaf(lineIndex, offset);
+    return lineView(leaf, offset);
+}
+
+std::wstring_view Rope::getLineView(const RopeCursor& cursor) {
+    return cursor.leaf ? lineView(residentLeaf(cursor.leaf, cursor.line), cursor.offset) : std::wstring_view();
+}
+
+std::wstring_view Rope::getLineView(size_t lineIndex, size_t column, size_t count) {
+    if (lineIndex >= m_totalLines) return std::wstring_view();
+    beginRead();
+
+    size_t offset;
+    RopeLeaf* leaf = findResidentLeaf(lineIndex, offset);
+    return lineView(leaf, offset, column, count);
+}
+
+// UTF-16 라인은 정렬되어 있으면 리프 버퍼를 그대로 보여주고, 그 외에는 m_viewBuf에 펼친다.
+// 같은 라인을 연속으로 요청하면 m_viewBuf를 다시 채우지 않으므로 앞서 얻은 뷰도 유효하다.
+std::wstring_view Rope::lineView(RopeLeaf* leaf, size_t line) {
+    size_t len = leaf->lineLen(line);
+    uint8_t shift;
+    const uint8_t* src = leaf->lineText(line, shift);
+    if (shift == WIDE_CHAR_SHIFT && (uintptr_t)src % sizeof(wchar_t) == 0) {
+        return std::wstring_view((const wchar_t*)src, len);
+    }
+
+    if (m_viewLeaf != leaf || m_viewLine != line) {
+        m_viewBuf.clear();
+        appendLine(m_viewBuf, leaf, line, 0, len);
+        m_viewLeaf = leaf;
+        m_viewLine = line;
+    }
+    return m_viewBuf;
+}
+
+// 긴 라인은 column이 들어 있는 청크만 찾고, 구간이 UTF-16 청크 하나 안이면 청크 버퍼를 그대로 보여준다.
+std::wstring_view Rope::lineView(RopeLeaf* leaf, size_t line, size_t column, size_t count) {
+    size_t len = leaf->lineLen(line);
+    if (column > len) column = len;
+    if (count > len - column) count = len - column;
+
+    const uint8_t* src = nullptr;
+    if (leaf->isLong(line)) {
+        const RopeLongLine* ll = leaf->longLine(line);
+        size_t pos;
+        const RopeChunk& ch = ll->chunks[ll->findChunk(column, pos)];
+        if (ch.shift == WIDE_CHAR_SHIFT && pos + count <= ch.len()) src = ch.text.ptr + (pos << WIDE_CHAR_SHIFT);
+    }
+    else {
+        uint8_t shift;
+        const uint8_t* text = leaf->lineText(line, shift);
+        if (shift == WIDE_CHAR_SHIFT) src = text + (column << WIDE_CHAR_SHIFT);
+    }
+    if (src && (uintptr_t)src % sizeof(wchar_t) == 0) {
+        return std::wstring_view((const wchar_t*)src, count);
+    }
+
+    m_viewBuf.clear();
+    appendLine(m_viewBuf, leaf, line, column, count);
+    m_viewLeaf = nullptr; // 라인 일부만 담았으므로 전체 라인 뷰로 다시 쓰지 않음
+    return m_viewBuf;
+}
+
+std::wstring Rope::getText() {
+    std::wstring text = L"";
+
+    // 리프 버퍼 크기(문자 수 이상)로 미리 할당 후 리프 링크를 따라 순차 디코딩
+    size_t totalSize = 0;
+    for (RopeLeaf* leaf = firstLeaf(); leaf; leaf = leaf->next) {
+        totalSize += leaf->src ? leaf->srcBytes : leaf->chars;
+    }
+    if (m_totalLines > 0) totalSize += (m_totalLines - 1) * 2;
+    text.reserve(totalSize);
+
+    size_t lineCnt = 0;
+    for (RopeLeaf* leaf = firstLeaf(); leaf; leaf = leaf->next) {
+        if (overHot()) evictCold(); // 지나온 리프는 다시 내보내서 예산 유지
+        leaf = residentLeaf(leaf, lineCnt);
+        for (size_t i = 0; i < leaf->lineCount(); i++) {
+            if (lineCnt++ > 0) text += L"\r\n";
+            appendLine(text, leaf, i, 0, leaf->lineLen(i));
+        }
+    }
+    return text;
+}
+
+// LineIndex도 Column도 0부터 시작
+std::wstring Rope::getTextRange(size_t startLineIndex, size_t startLineColumn, size_t endLineIndex, size_t endLineColumn) {
+    std::wstring text = L"";
+    if (startLineIndex >= m_totalLines || endLineIndex >= m_totalLines)
+        return text;
+    beginRead();
+
+    size_t offset;
+    RopeLeaf* leaf = findResidentLeaf(startLineIndex, offset);
+    size_t lineLen = leaf->lineLen(offset);
+    if (startLineColumn > lineLen) startLineColumn = lineLen;
+
+    if (startLineIndex == endLineIndex) {
+        // 한 라인 내에서 선택
+        size_t cnt = (endLineColumn > startLineColumn) ? min(endLineColumn, lineLen) - startLineColumn : 0;
+        appendLine(text, leaf, offset, startLineColumn, cnt);
+    }
+    else {
+        // 여러 라인에 걸쳐 선택 : 리프 링크를 따라 순차 접근
+        appendLine(text, leaf, offset, startLineColumn, lineLen - startLineColumn);
+        text += L"\r\n";
+        for (size_t line = startLineIndex + 1; line < endLineIndex; line++) {
+            if (++offset >= leaf->lineCount()) {
+                leaf = leaf->next;
+                offset = 0;
+                if (!leaf) return text;
+                leaf = residentLeaf(leaf, line);
+            }
+            appendLine(text, leaf, offset, 0, leaf->lineLen(offset));
+            text += L"\r\n";
+        }
+        if (++offset >= leaf->lineCount()) {
+            leaf = leaf->next;
+            offset = 0;
+            if (!leaf) return text;
+            leaf = residentLeaf(leaf, endLineIndex);
+        }
+        appendLine(text, leaf, offset, 0, min(endLineColumn, leaf->lineLen(offset)));
+    }
+    return text;
+}
+
+size_t Rope::getCharCount() {
+    return root->isLeaf ? static_cast<RopeLeaf*>(root)->chars : static_cast<RopeInternal*>(root)->total().chars;
+}
+
+size_t Rope::getUtf8Size() {
+    return root->isLeaf ? static_cast<RopeLeaf*>(root)->utf8 : static_cast<RopeInternal*>(root)->total().utf8;
+}
+
+// 왼쪽 형제 서브트리의 크기(라인마다 줄바꿈 포함)를 더하며 내려가고, 리프 안에서는 앞 라인들을 직접 센다.
+size_t Rope::offsetFromPos(size_t lineIndex, size_t column, OffsetUnit unit, size_t newlineSize) {
+    if (m_totalLines == 0) return 0;
+    beginRead();
+    if (lineIndex >= m_totalLines) {
+        lineIndex = m_totalLines - 1;
+        column = (size_t)-1;
+    }
+
+    size_t RopeWeight::* metric = (unit == Chars) ? &RopeWeight::chars : &RopeWeight::utf8;
+    size_t result = 0;
+    size_t idx = lineIndex;
+    RopeNode* node = root;
+    while (!node->isLeaf) {
+        RopeInternal* in = static_cast<RopeInternal*>(node);
+        int i = 0;
+        while (i < in->count - 1 && idx >= in->weight[i].lines) {
+            idx -= in->weight[i].lines;
+            result += in->weight[i].*metric + in->weight[i].lines * newlineSize;
+            i++;
+        }
+        node = in->child[i];
+    }
+
+    RopeLeaf* leaf = residentLeaf(static_cast<RopeLeaf*>(node), lineIndex);
+    for (size_t i = 0; i < idx; i++) {
+        size_t len = leaf->lineLen(i);
+        result += ((unit == Chars) ? len : lineUtf8(leaf, i, len)) + newlineSize;
+    }
+    size_t len = leaf->lineLen(idx);
+    if (column > len) column = len;
+    result += (unit == Chars) ? column : lineUtf8(leaf, idx, column);
+    return result;
+}
+
+// 오프셋이 줄바꿈 안을 가리키면 그 라인의 끝, UTF-8 문자 중간을 가리키면 그 문자의 시작으로 맞춘다.
+void Rope::posFromOffset(size_t offset, size_t& lineIndex, size_t& column, OffsetUnit unit, size_t newlineSize) {
+    lineIndex = column = 0;
+    if (m_totalLines == 0) return;
+    beginRead();
+
+    size_t RopeWeight::* metric = (unit == Chars) ? &RopeWeight::chars : &RopeWeight::utf8;
+    RopeNode* node = root;
+    while (!node->isLeaf) {
+        RopeInternal* in = static_cast<RopeInternal*>(node);
+        int i = 0;
+        while (i < in->count - 1) {
+            size_t span = in->weight[i].*metric + in->weight[i].lines * newlineSize;
+            if (offset < span) break;
+            offset -= span;
+            lineIndex += in->weight[i].lines;
+            i++;
+        }
+        node = in->child[i];
+    }
+
+    RopeLeaf* leaf = residentLeaf(static_cast<RopeLeaf*>(node), lineIndex);
+    size_t cnt = leaf->lineCount();
+    for (size_t i = 0; i < cnt; i++, lineIndex++) {
+        size_t len = leaf->lineLen(i);
+        size_t size = (unit == Chars) ? len : lineUtf8(leaf, i, len);
+        if (offset < size + newlineSize || i + 1 == cnt) {
+            if (offset >= size) {
+                column = len;
+            }
+            else if (unit == Chars) {
+                column = offset;
+            }
+            else if (leaf->isLong(i)) {
+                column = leaf->longLine(i)->columnAt(offset);
+            }
+            else {
+                uint8_t shift;
+                const uint8_t* src = leaf->lineText(i, shift);
+                size_t bytes = 0;
+                while (column < len) {
+                    size_t charBytes = utf8Size(charAt(src, column, shift));
+                    if (bytes + charBytes > offset) break;
+                    bytes += charBytes;
+                    column++;
+                }
+            }
+            return;
+        }
+        offset -= size + newlineSize;
+    }
+}
+
+// 루트에서 반복적으로 내려가며 idx 라인이 속한 리프를 찾는다.
+// idx가 전체 줄수 이상이면 마지막 리프를 반환하고 offset은 리프 크기 이상이 된다.
+// path를 받으면 호출자가 경로를 고칠 것이므로 스냅샷과 공유 중인 노드를 내려가면서 복사본으로 바꾼다.
+RopeLeaf* Rope::findLeaf(size_t idx, size_t& offset, RopePath* path) {
+    if (path) {
+        path->depth = 0;
+        root = writable(root);
+    }
+    RopeNode* node = root;
+
+    while (!node->isLeaf) {
+        RopeInternal* in = static_cast<RopeInternal*>(node);
+        int i = 0;
+        // idx는 0부터 lines는 1부터 시작
+        while (i < in->count - 1 && idx >= in->weight[i].lines) {
+            idx -= in->weight[i].lines;
+            i++;
+        }
+        if (path) {
+            in->child[i] = writable(in->child[i]);
+            path->node[path->depth] = in;
+            path->slot[path->depth] = i;
+            path->depth++;
+        }
+        node = in->child[i];
+    }
+
+    offset = idx;
+    return static_cast<RopeLeaf*>(node);
+}
+
+RopeLeaf* Rope::findResidentLeaf(size_t idx, size_t& offset, RopePath* path) {
+    if (path) {
+        RopeLeaf* leaf = findLeaf(idx, offset, path);
+        ensureResident(leaf);
+        return leaf;
+    }
+    RopeLeaf* leaf = findFingerLeaf(idx, offset);
+    return residentLeaf(leaf, idx);
+}
+
+// 마지막으로 찾은 리프와 그 좌우 리프 안이면 형제 링크로 바로 찾고, 아니면 루트부터 탐색해서 기억한다.
+RopeLeaf* Rope::findFingerLeaf(size_t idx, size_t& offset) {
+    if (m_finger && idx < m_totalLines) {
+        RopeLeaf* leaf = m_finger;
+        size_t start = m_fingerStart;
+        if (idx >= start + leaf->lineCount() && leaf->next) {
+            start += leaf->lineCount();
+            leaf = leaf->next;
+        }
+        else if (idx < start && leaf->prev) {
+            leaf = leaf->prev;
+            start -= leaf->lineCount();
+        }
+        if (idx >= start && idx < start + leaf->lineCount()) {
+            m_finger = leaf;
+            m_fingerStart = start;
+            offset = idx - start;
+            return leaf;
+        }
+    }
+
+    RopeLeaf* leaf = findLeaf(idx, offset);
+    m_finger = leaf;
+    m_fingerStart = idx - offset;
+    return leaf;
+}
+
+// 원본 파일 구간을 디코딩하거나 압축, 스왑된 버퍼를 풀어서 라인 버퍼로 옮긴다.
+void Rope::ensureResident(RopeLeaf* leaf) {
+    if (leaf->packed.ptr) unpackLeaf(leaf);
+    if (leaf->swapBytes) swapIn(leaf);
+    if (leaf->src) loadSource(leaf);
+    if (hotListOn()) touchLeaf(leaf); // 상주한 뒤의 크기로 센다.
+}
+
+void Rope::loadSource(RopeLeaf* leaf) {
+    std::wstring text;
+    TextLines lines;
+    decodeLeaf(*m_source, leaf, text, lines);
+    size_t lineCnt = leaf->srcLines;
+    leaf->src = nullptr;
+    leaf->chars = leaf->utf8 = 0; // 라인을 넣으면서 다시 센다. (로드할 때 센 값과 같음)
+    if (lineCnt == 0) return;
+
+    RopeBuf<uint32_t> wraps = leaf->lineWraps; // 디코딩 전에 기록한 워드랩 줄 수는 라인을 다 넣은 뒤 되돌림
+    bool wrapsSet = leaf->wrapsSet;
+    leaf->lineWraps = RopeBuf<uint32_t>();
+    leaf->text.reserve(m_arena, text.size());
+    leaf->lineEnd.reserve(m_arena, lineCnt);
+    leaf->lineWide.reserve(m_arena, lineCnt);
+    for (size_t i = 0; i < lineCnt; i++) {
+        leafInsertLine(leaf, i, lines.linePtr(i), lines.lineLen(i));
+    }
+    leaf->lineWraps = wraps;
+    leaf->wrapsSet = wrapsSet;
+}
+
+// 읽기만 하는 경로도 디코딩/압축 해제는 리프를 고치므로, 스냅샷과 공유 중인 리프는 경로를 복사해서 복사본을 상주시킨다.
+RopeLeaf* Rope::residentLeaf(RopeLeaf* leaf, size_t line) {
+    if ((leaf->src || leaf->packed.ptr || leaf->swapBytes) && isShared(leaf)) {
+        RopePath path;
+        size_t offset;
+        leaf = findLeaf(line, offset, &path);
+    }
+    ensureResident(leaf);
+    return leaf;
+}
+
+// 줄바꿈 규칙은 SplitTextByNewlines와 동일 : \r\n, \r, \n
+// 구간 끝의 줄바꿈까지 찾으면 마지막 라인도 줄바꿈 앞에서 끝난다. (문서 끝 구간은 나머지 전체)
+void Rope::decodeLeaf(const RopeMappedFile& source, const RopeLeaf* leaf, std::wstring& text, TextLines& lines) {
+    source.decode(leaf->src, leaf->srcBytes, text);
+    lines.text = text.data();
+    lines.length = text.size();
+    lines.breaks.clear();
+    LineScanner::scan(lines.text, lines.length, 0, lines.length, leaf->srcLines, lines.breaks);
+}
+
+RopeLeaf* Rope::firstLeaf() {
+    RopeNode* node = root;
+    while (!node->isLeaf) {
+        node = static_cast<RopeInternal*>(node)->child[0];
+    }
+    return static_cast<RopeLeaf*>(node);
+}
+
+void Rope::addWeight(const RopePath& path, const RopeWeight& diff) {
+    for (int i = 0; i < path.depth; i++) {
+        path.node[i]->weight[path.slot[i]] += diff;
+    }
+}
+
+// leaf를 cutSize 위치에서 둘로 나누고 오른쪽 리프를 부모에 추가한다. (전체 라인 수는 변하지 않음)
+void Rope::splitLeaf(RopeLeaf* leaf, RopePath& path, size_t cutSize) {
+    RopeLeaf* newLeaf = allocLeaf();
+    leafMoveLines(leaf, cutSize, leaf->lineCount() - cutSize, newLeaf, 0);
+
+    // 형제 리프 링크 연결
+    newLeaf->prev = leaf;
+    newLeaf->next = leaf->next;
+    if (leaf->next) leaf->next->prev = newLeaf;
+    leaf->next = newLeaf;
+
+    // leaf가 root였으면 새로운 루트 생성
+    if (path.depth == 0) {
+        RopeInternal* newRoot = allocInternal();
+        newRoot->child[0] = leaf;
+        newRoot->weight[0] = leaf->weight();
+        newRoot->child[1] = newLeaf;
+        newRoot->weight[1] = newLeaf->weight();
+        newRoot->count = 2;
+        root = newRoot;
+        return;
+    }
+
+    int level = path.depth - 1;
+    path.node[level]->weight[path.slot[level]] = leaf->weight();
+    insertChildAt(path, level, path.slot[level] + 1, newLeaf, newLeaf->weight());
+}
+
+// 줄수가 넘치면 반으로, 바이트 수가 넘치면 버퍼 중간 위치의 라인 경계에서 분할 (호출 후 path는 무효)
+void Rope::splitIfNeeded(RopeLeaf* leaf, RopePath& path) {
+    size_t cnt = leaf->lineCount();
+    if (cnt < 2) return;
+
+    if (cnt > m_limits.splitLines) {
+        splitLeaf(leaf, path, cnt / 2);
+    }
+    else if (leaf->text.size > m_limits.leafBytes) {
+        size_t half = leaf->text.size / 2;
+        const uint32_t* it = std::lower_bound(leaf->lineEnd.ptr, leaf->lineEnd.ptr + cnt, (uint32_t)half);
+        size_t cut = (it - leaf->lineEnd.ptr) + 1;
+        if (cut >= cnt) cut = cnt - 1;
+        splitLeaf(leaf, path, cut);
+    }
+}
+
+// path.node[level]의 slot 위치에 자식을 끼워 넣는다. 넘치면 반으로 나누고 상위로 전파한다.
+// 상위 레벨의 크기는 호출 전에 이미 반영되어 있어야 한다. (호출 후 path는 무효)
+void Rope::insertChildAt(RopePath& path, int level, int slot, RopeNode* node, const RopeWeight& weight) {
+    RopeInternal* p = path.node[level];
+    for (int i = p->count; i > slot; i--) {
+        p->child[i] = p->child[i - 1];
+        p->weight[i] = p->weight[i - 1];
+    }
+    p->child[slot] = node;
+    p->weight[slot] = weight;
+    p->count++;
+
+    if (p->count <= NODE_FANOUT) return;
+
+    // 내부 노드 분할
+    RopeInternal* q = allocInternal();
+    int half = p->count / 2;
+    for (int i = half; i < p->count; i++) {
+        q->child[i - half] = p->child[i];
+        q->weight[i - half] = p->weight[i];
+    }
+    q->count = p->count - half;
+    p->count = half;
+
+    if (level == 0) {
+        RopeInternal* newRoot = allocInternal();
+        newRoot->child[0] = p;
+        newRoot->weight[0] = p->total();
+        newRoot->child[1] = q;
+        newRoot->weight[1] = q->total();
+        newRoot->count = 2;
+        root = newRoot;
+        return;
+    }
+
+    path.node[level - 1]->weight[path.slot[level - 1]] = p->total();
+    insertChildAt(path, level - 1, path.slot[level - 1] + 1, q, q->total());
+}
+
+// lineIndex가 리프 경계(또는 문서 끝)일 때 그 위치에 리프를 통째로 삽입한다.
+void Rope::insertLeafAt(size_t lineIndex, RopeLeaf* leaf) {
+    RopeWeight w = leaf->weight();
+
+    // 빈 문서면 루트 리프를 교체
+    if (root->isLeaf && static_cast<RopeLeaf*>(root)->lineCount() == 0) {
+        deleteNode(root);
+        leaf->prev = leaf->next = nullptr;
+        root = leaf;
+        return;
+    }
+
+    RopePath path;
+    size_t offset;
+    bool before = (lineIndex == 0);
+    RopeLeaf* at = findLeaf(before ? 0 : lineIndex - 1, offset, &path);
+
+    // 형제 리프 링크 연결
+    if (before) {
+        leaf->next = at;
+        leaf->prev = at->prev;
+        if (at->prev) at->prev->next = leaf;
+        at->prev = leaf;
+    }
+    else {
+        leaf->prev = at;
+        leaf->next = at->next;
+        if (at->next) at->next->prev = leaf;
+        at->next = leaf;
+    }
+
+    if (path.depth == 0) {
+        RopeInternal* newRoot = allocInternal();
+        newRoot->child[0] = before ? leaf : at;
+        newRoot->weight[0] = before ? w : at->weight();
+        newRoot->child[1] = before ? at : leaf;
+        newRoot->weight[1] = before ? at->weight() : w;
+        newRoot->count = 2;
+        root = newRoot;
+        return;
+    }
+
+    int level = path.depth - 1;
+    for (int i = 0; i < level; i++) {
+        path.node[i]->weight[path.slot[i]] += w;
+    }
+    insertChildAt(path, level, path.slot[level] + (before ? 0 : 1), leaf, w);
+}
+
+// 레벨마다 노드들을 NODE_FANOUT 이하로 고르게 묶어서 위 레벨을 같은 배열 앞쪽에 덮어쓴다.
+// 묶음 수를 올림으로 정하므로 루트를 제외한 모든 내부 노드는 NODE_FANOUT / 2 이상의 자식을 가진다.
+// 기존 트리의 내부 노드와 빈 루트 리프는 호출자가 먼저 해제한다.
+void Rope::buildFromLeaves(const std::vector<RopeLeaf*>& leaves) {
+    if (leaves.empty()) {
+        root = allocLeaf();
+        return;
+    }
+
+    std::vector<RopeNode*> level(leaves.size());
+    std::vector<RopeWeight> weight(leaves.size());
+    for (size_t i = 0; i < leaves.size(); i++) {
+        leaves[i]->prev = i ? leaves[i - 1] : nullptr;
+        leaves[i]->next = (i + 1 < leaves.size()) ? leaves[i + 1] : nullptr;
+        level[i] = leaves[i];
+        weight[i] = leaves[i]->weight();
+    }
+
+    size_t n = level.size();
+    while (n > 1) {
+        size_t groups = (n + NODE_FANOUT - 1) / NODE_FANOUT;
+        size_t pos = 0;
+        for (size_t g = 0; g < groups; g++) {
+            size_t take = (n - pos) / (groups - g);
+            RopeInternal* node = allocInternal();
+            RopeWeight sum;
+            for (size_t k = 0; k < take; k++) {
+                node->child[k] = level[pos + k];
+                node->weight[k] = weight[pos + k];
+                sum += weight[pos + k];
+            }
+            node->count = (int)take;
+            pos += take;
+            level[g] = node;
+            weight[g] = sum;
+        }
+        n = groups;
+    }
+    root = level[0];
+}
+
+void Rope::releaseInternals(RopeNode* node) {
+    if (node->isLeaf) return;
+    RopeInternal* in = static_cast<RopeInternal*>(node);
+    for (int i = 0; i < in->count; i++) {
+        releaseInternals(in->child[i]);
+    }
+    deleteNode(in);
+}
+
+// path.node[level]에서 path.slot[level]의 자식 항목을 제거한다. (자식 노드 해제는 호출자가 처리)
+void Rope::removeChild(RopePath& path, int level) {
+    RopeInternal* p = path.node[level];
+    int slot = path.slot[level];
+    for (int i = slot; i < p->count - 1; i++) {
+        p->child[i] = p->child[i + 1];
+        p->weight[i] = p->weight[i + 1];
+    }
+    p->count--;
+
+    if (level == 0) {
+        // 루트에 자식이 하나만 남으면 높이를 줄인다.
+        if (p->count == 1) {
+            root = p->child[0];
+            deleteNode(p);
+        }
+        return;
+    }
+
+    if (p->count < NODE_FANOUT / 2) {
+        rebalanceInternal(path, level);
+    }
+}
+
+// 라인이 줄어든 리프 정리 : 비었으면 트리에서 제거하고, 부족하면 병합/차용 (호출 후 path는 무효)
+void Rope::repairLeaf(RopeLeaf* leaf, RopePath& path) {
+    if (leaf->lineCount() == 0 && path.depth > 0) {
+        unlinkLeaf(leaf);
+        deleteNode(leaf);
+        removeChild(path, path.depth - 1);
+    }
+    else if (leafUnderflow(leaf)) {
+        rebalanceLeaf(leaf, path);
+    }
+}
+
+// 부족한 리프를 형제 리프와 병합하거나 라인을 나눠 받는다.
+void Rope::rebalanceLeaf(RopeLeaf* leaf, RopePath& path) {
+    if (path.depth == 0) return; // 루트 리프는 부족해도 그대로 둔다.
+
+    int level = path.depth - 1;
+    RopeInternal* p = path.node[level];
+    int slot = path.slot[level];
+    int ls = (slot > 0) ? slot - 1 : slot; // 왼쪽 형제 우선
+    p->child[ls] = writable(p->child[ls]); // leaf는 경로상에 있어서 이미 수정 가능하고 형제만 복사될 수 있다.
+    p->child[ls + 1] = writable(p->child[ls + 1]);
+    RopeLeaf* left = static_cast<RopeLeaf*>(p->child[ls]);
+    RopeLeaf* right = static_cast<RopeLeaf*>(p->child[ls + 1]);
+    ensureResident(left);
+    ensureResident(right);
+
+    if (left->lineCount() + right->lineCount() <= m_limits.splitLines &&
+        left->text.size + right->text.size <= m_limits.leafBytes) {
+        // 병합 : 오른쪽 리프를 왼쪽으로 옮기고 제거
+        leafMoveLines(right, 0, right->lineCount(), left, left->lineCount());
+        p->weight[ls] = left->weight();
+        unlinkLeaf(right);
+        deleteNode(right);
+        path.slot[level] = ls + 1;
+        removeChild(path, level);
+        return;
+    }
+
+    // 차용 : 부족한 리프가 더 이상 부족하지 않을 만큼만 형제에서 인접 라인을 가져온다.
+    RopeLeaf* donor = (leaf == left) ? right : left;
+    size_t donorCnt = donor->lineCount();
+    size_t moveCnt = 0, moveBytes = 0;
+    while (moveCnt + 1 < donorCnt &&
+           leaf->lineCount() + moveCnt < m_limits.mergeLines / 2 &&
+           leaf->text.size + moveBytes < m_limits.leafBytes / 4) {
+        size_t line = (donor == right) ? moveCnt : donorCnt - 1 - moveCnt;
+        if (leaf->text.size + moveBytes + donor->lineBytes(line) > m_limits.leafBytes) break;
+        moveBytes += donor->lineBytes(line);
+        moveCnt++;
+    }
+    if (moveCnt == 0) return;
+
+    if (donor == right) leafMoveLines(right, 0, moveCnt, left, left->lineCount());
+    else leafMoveLines(left, donorCnt - moveCnt, moveCnt, right, 0);
+    p->weight[ls] = left->weight();
+    p->weight[ls + 1] = right->weight();
+}
+
+// 부족한 내부 노드를 형제 노드와 병합하거나 자식을 나눠 받는다.
+void Rope::rebalanceInternal(RopePath& path, int level) {
+    RopeInternal* parent = path.node[level - 1];
+    int slot = path.slot[level - 1];
+    int ls = (slot > 0) ? slot - 1 : slot;
+    parent->child[ls] = writable(parent->child[ls]);
+    parent->child[ls + 1] = writable(parent->child[ls + 1]);
+    RopeInternal* left = static_cast<RopeInternal*>(parent->child[ls]);
+    RopeInternal* right = static_cast<RopeInternal*>(parent->child[ls + 1]);
+    int sum = left->count + right->count;
+
+    if (sum <= NODE_FANOUT) {
+        // 병합
+        for (int i = 0; i < right->count; i++) {
+            left->child[left->count + i] = right->child[i];
+            left->weight[left->count + i] = right->weight[i];
+        }
+        left->count = sum;
+        parent->weight[ls] += parent->weight[ls + 1];
+        deleteNode(right);
+        path.slot[level - 1] = ls + 1;
+        removeChild(path, level - 1);
+    }
+    else {
+        // 차용
+        int half = sum / 2;
+        if (left->count > half) {
+            int moveCnt = left->count - half;
+            for (int i = right->count - 1; i >= 0; i--) {
+                right->child[i + moveCnt] = right->child[i];
+                right->weight[i + moveCnt] = right->weight[i];
+            }
+            for (int i = 0; i < moveCnt; i++) {
+                right->child[i] = left->child[half + i];
+                right->weight[i] = left->weight[half + i];
+            }
+            right->count += moveCnt;
+            left->count = half;
+        }
+        else {
+            int moveCnt = half - left->count;
+            for (int i = 0; i < moveCnt; i++) {
+                left->child[left->count + i] = right->child[i];
+                left->weight[left->count + i] = right->weight[i];
+            }
+            for (int i = moveCnt; i < right->count; i++) {
+                right->child[i - moveCnt] = right->child[i];
+                right->weight[i - moveCnt] = right->weight[i];
+            }
+            left->count = half;
+            right->count -= moveCnt;
+        }
+        parent->weight[ls] = left->total();
+        parent->weight[ls + 1] = right->total();
+    }
+}
+
+void Rope::unlinkLeaf(RopeLeaf* leaf) {
+    if (leaf->prev) leaf->prev->next = leaf->next;
+    if (leaf->next) leaf->next->prev = leaf->prev;
+    leaf->prev = leaf->next = nullptr;
+}
+
+RopeLeaf* Rope::allocLeaf() {
+    RopeLeaf* leaf = new (m_arena.allocate(sizeof(RopeLeaf))) RopeLeaf();
+    leaf->gen = m_gen;
+    if (hotListOn()) touchLeaf(leaf);
+    return leaf;
+}
+
+RopeInternal* Rope::allocInternal() {
+    RopeInternal* node = new (m_arena.allocate(sizeof(RopeInternal))) RopeInternal();
+    node->gen = m_gen;
+    return node;
+}
+
+// 공유 중인 노드의 복사본을 만든다. 내부 노드는 자식 포인터만 복사하므로 자식들은 계속 공유되고,
+// 리프는 버퍼를 복사하고 형제 링크를 복사본으로 옮긴다. (링크는 원본 트리만 쓰므로 공유 리프의 링크는 고쳐도 된다.)
+RopeNode* Rope::writable(RopeNode* node) {
+    if (!isShared(node)) return node;
+
+    if (!node->isLeaf) {
+        RopeInternal* in = static_cast<RopeInternal*>(node);
+        RopeInternal* copy = allocInternal();
+        copy->count = in->count;
+        for (int i = 0; i < in->count; i++) {
+            copy->child[i] = in->child[i];
+            copy->weight[i] = in->weight[i];
+        }
+        deleteNode(in);
+        return copy;
+    }
+
+    RopeLeaf* leaf = static_cast<RopeLeaf*>(node);
+    RopeLeaf* copy = allocLeaf();
+    copy->text.insert(m_arena, 0, leaf->text.ptr, leaf->text.size);
+    copy->lineEnd.insert(m_arena, 0, leaf->lineEnd.ptr, leaf->lineEnd.size);
+    copy->lineWide.insert(m_arena, 0, leaf->lineWide.ptr, leaf->lineWide.size);
+    copy->lineWraps.insert(m_arena, 0, leaf->lineWraps.ptr, leaf->lineWraps.size);
+    copy->wraps = leaf->wraps;
+    copy->wrapsSet = leaf->wrapsSet;
+    if (leaf->swapBytes) {
+        // 스왑 구간은 원본(스냅샷 쪽)이 해제될 때 돌려주므로 복사본은 읽어서 상주시킨다.
+        loadSwapped(copy, leaf);
+    }
+    if (leaf->packed.ptr) {
+        copy->packed.insert(m_arena, 0, leaf->packed.ptr, leaf->packed.size);
+        m_packStats.packedLeaves++;
+        m_packStats.packedBytes += copy->packed.size;
+        m_packStats.rawBytes += copy->lineStart(copy->lineCount());
+    }
+    for (size_t i = 0; i < copy->lineEnd.size; i++) {
+        // 긴 라인은 리프마다 따로 소유하므로 청크까지 복사
+        if (copy->isLong(i)) {
+            RopeLongLine* ll = copyLongLine(copy->longLine(i));
+            memcpy(copy->text.ptr + copy->lineStart(i), &ll, sizeof(ll));
+        }
+        else if (copy->isAtom(i)) {
+            retainAtom(copy->atom(i)); // 공유 버퍼는 불변이므로 참조만 늘림
+        }
+    }
+    copy->src = leaf->src;
+    copy->srcBytes = leaf->srcBytes;
+    copy->srcLines = leaf->srcLines;
+    copy->chars = leaf->chars;
+    copy->utf8 = leaf->utf8;
+    copy->prev = leaf->prev;
+    copy->next = leaf->next;
+    if (copy->prev) copy->prev->next = copy;
+    if (copy->next) copy->next->prev = copy;
+    if (m_finger == leaf) m_finger = copy;
+    if (m_viewLeaf == leaf) m_viewLeaf = nullptr;
+    deleteNode(leaf);
+    return copy;
+}
+
+// 스냅샷 세대 s는 만든 세대 <= s < 트리에서 빠진 세대인 노드를 볼 수 있다. 살아 있는 스냅샷 누구도 볼 수 없는 보류 노드를 해제한다.
+void Rope::sweepSnapshots() {
+    size_t keep = 0;
+    uint32_t newest = 0;
+    for (size_t i = 0; i < m_snapshots.size(); i++) {
+        if (m_snapshots[i].ref.expired()) continue;
+        newest = max(newest, m_snapshots[i].gen);
+        m_snapshots[keep++] = m_snapshots[i];
+    }
+    m_snapshots.resize(keep);
+    m_frozenGen = newest; // 살아 있는 가장 최근 스냅샷 뒤에 만든 노드는 공유되지 않는다.
+
+    keep = 0;
+    for (size_t i = 0; i < m_retired.size(); i++) {
+        RetiredNode r = m_retired[i];
+        bool visible = false;
+        for (const auto& snap : m_snapshots) {
+            if (r.node->gen <= snap.gen && snap.gen < r.gen) {
+                visible = true;
+                break;
+            }
+        }
+        if (visible) m_retired[keep++] = r;
+        else freeNode(r.node);
+    }
+    m_retired.resize(keep);
+    m_sweepAt = max((size_t)SNAPSHOT_SWEEP_MIN, keep * 2);
+}
+
+// 현재 트리 전체를 얼리고 세대를 올린다. 이후 수정은 얼린 노드를 복사본으로 바꿔가며 진행된다.
+std::shared_ptr<const RopeSnapshot> Rope::snapshot() {
+    sweepSnapshots();
+    std::shared_ptr<RopeSnapshot> snap(new RopeSnapshot());
+    snap->m_root = root;
+    snap->m_totalLines = m_totalLines;
+    snap->m_weight = treeWeight(root);
+    snap->m_edits = m_editCount;
+    snap->m_source = m_source;
+    snap->m_swap = &m_swap;
+
+    m_frozenGen = m_gen;
+    m_snapshots.push_back({ m_gen, snap });
+    m_gen++;
+    return snap;
+}
+
+// 압축 모드 설정. 최근 접근한 리프 PACK_HOT_MIN개는 항상 풀어두므로 바로 앞에서 얻은 라인 뷰는 계속 유효하다.
+void Rope::setColdCompression(size_t hotLeaves) {
+    m_hotMax = hotLeaves ? max(hotLeaves, (size_t)PACK_HOT_MIN) : 0;
+    if (!m_hotMax) {
+        // 목록만 비우고, 이미 압축된 리프는 접근할 때 푼다.
+        resetHotList();
+        return;
+    }
+    // 이미 있는 리프도 목록에 넣어서 다음 연산부터 압축 대상이 되게 한다. (최근에 찾은 리프를 가장 앞에)
+    for (RopeLeaf* leaf = firstLeaf(); leaf; leaf = leaf->next) touchLeaf(leaf);
+    if (m_finger) touchLeaf(m_finger);
+}
+
+// 스왑 모드 설정. 끄더라도 이미 스왑된 리프는 접근할 때 읽어 들이므로 스왑 파일은 clear까지 유지된다.
+void Rope::setSwapBudget(size_t budgetBytes) {
+    m_swapBudget = budgetBytes;
+    if (!m_swapBudget) {
+        resetHotList();
+        return;
+    }
+    for (RopeLeaf* leaf = firstLeaf(); leaf; leaf = leaf->next) touchLeaf(leaf);
+    if (m_finger) touchLeaf(m_finger);
+}
+
+RopeSwapStats Rope::getSwapStats() const {
+    RopeSwapStats stats = m_swapStats;
+    stats.fileBytes = (size_t)m_swap.fileBytes();
+    stats.residentBytes = m_hotBytes;
+    return stats;
+}
+
+void Rope::resetHotList() {
+    if (hotListOn()) return;
+    while (m_hotTail) unlinkHot(m_hotTail);
+}
+
+void Rope::touchLeaf(RopeLeaf* leaf) {
+    unlinkHot(leaf);
+    leaf->hotBytes = leaf->text.size + leaf->packed.size + leaf->lineEnd.size * (sizeof(uint32_t) + 1);
+    m_hotBytes += leaf->hotBytes;
+    leaf->hotNext = m_hotHead;
+    if (m_hotHead) m_hotHead->hotPrev = leaf;
+    m_hotHead = leaf;
+    if (!m_hotTail) m_hotTail = leaf;
+    m_hotCount++;
+}
+
+void Rope::unlinkHot(RopeLeaf* leaf) {
+    if (!leaf->hotPrev && m_hotHead != leaf) return; // 목록에 없음
+    if (leaf->hotPrev) leaf->hotPrev->hotNext = leaf->hotNext;
+    else m_hotHead = leaf->hotNext;
+    if (leaf->hotNext) leaf->hotNext->hotPrev = leaf->hotPrev;
+    else m_hotTail = leaf->hotPrev;
+    leaf->hotPrev = leaf->hotNext = nullptr;
+    m_hotCount--;
+    m_hotBytes -= leaf->hotBytes;
+}
+
+// 스냅샷과 공유 중인 리프는 다른 스레드가 읽고 있을 수 있으므로 목록에서만 뺀다.
+// 스왑 모드에서는 메모리에 압축해 두지 않고 모두 스왑 파일로 내보내서 예산을 지킨다.
+void Rope::evictCold() {
+    while (overHot()) {
+        RopeLeaf* leaf = m_hotTail;
+        unlinkHot(leaf);
+        if (isShared(leaf)) continue;
+        if (m_swapBudget) swapOut(leaf);
+        else packLeaf(leaf);
+    }
+}
+
+// 라인 끝 위치, 문자 크기, text를 이어서 한 번에 압축한다. 긴 라인과 공유 라인은 리프 밖 버퍼라 내보내지 않는다.
+void Rope::swapOut(RopeLeaf* leaf) {
+    if (leaf->src || leaf->swapBytes || leaf->lineEnd.size == 0) return;
+    if (hasRefLines(leaf)) return;
+    if (!m_swap.isOpen() && !m_swap.open()) {
+        // 임시 파일을 만들 수 없으면 스왑 모드를 끈다.
+        m_swapBudget = 0;
+        resetHotList();
+        return;
+    }
+    if (leaf->packed.ptr) unpackLeaf(leaf);
+
+    size_t lines = leaf->lineEnd.size;
+    std::vector<uint8_t> raw(lines * (sizeof(uint32_t) + 1) + leaf->text.size);
+    memcpy(raw.data(), leaf->lineEnd.ptr, lines * sizeof(uint32_t));
+    memcpy(raw.data() + lines * sizeof(uint32_t), leaf->lineWide.ptr, lines);
+    if (leaf->text.size) memcpy(raw.data() + lines * (sizeof(uint32_t) + 1), leaf->text.ptr, leaf->text.size);
+    std::vector<uint8_t> out;
+    packBytes(raw.data(), raw.size(), out);
+    uint64_t pos = m_swap.write(out.data(), out.size());
+    if (pos == SWAP_FAIL) return; // 디스크가 가득 차면 메모리에 둠
+
+    leaf->swapPos = pos;
+    leaf->swapBytes = (uint32_t)out.size();
+    leaf->swapRaw = (uint32_t)raw.size();
+    leaf->srcLines = lines;
+    leaf->text.free(m_arena);
+    leaf->lineEnd.free(m_arena);
+    leaf->lineWide.free(m_arena);
+    m_swapStats.swappedLeaves++;
+    m_swapStats.swapBytes += leaf->swapBytes;
+    m_swapStats.swapOutCount++;
+    if (m_viewLeaf == leaf) m_viewLeaf = nullptr;
+}
+
+void Rope::swapIn(RopeLeaf* leaf) {
+    loadSwapped(leaf, leaf);
+    m_swap.release(leaf->swapPos, leaf->swapBytes);
+    m_swapStats.swappedLeaves--;
+    m_swapStats.swapBytes -= leaf->swapBytes;
+    leaf->swapPos = 0;
+    leaf->swapBytes = leaf->swapRaw = 0;
+    leaf->srcLines = 0;
+}
+
+void Rope::loadSwapped(RopeLeaf* dst, const RopeLeaf* leaf) {
+    std::vector<uint8_t> raw;
+    readSwapped(m_swap, leaf, raw);
+    size_t lines = leaf->srcLines;
+    dst->lineEnd.insert(m_arena, 0, (const uint32_t*)raw.data(), lines);
+    dst->lineWide.insert(m_arena, 0, raw.data() + lines * sizeof(uint32_t), lines);
+    dst->text.insert(m_arena, 0, raw.data() + lines * (sizeof(uint32_t) + 1), raw.size() - lines * (sizeof(uint32_t) + 1));
+    m_swapStats.swapInCount++;
+}
+
+// 스왑 파일을 읽지 못하면 리프 내용을 되살릴 수 없으므로 파일 예외로 알린다.
+void Rope::readSwapped(const RopeSwapFile& swap, const RopeLeaf* leaf, std::vector<uint8_t>& raw) {
+    std::vector<uint8_t> packed(leaf->swapBytes);
+    if (!swap.read(leaf->swapPos, packed.data(), packed.size())) throw RopeReadError();
+    raw.resize(leaf->swapRaw);
+    unpackBytes(packed.data(), packed.size(), raw.data());
+}
+
+// 디코딩 전이거나 작은 리프, 긴 라인이나 공유 라인(포인터가 버퍼에 있음)이 있는 리프, 1/8도 줄지 않는 리프는 그대로 둔다.
+void Rope::packLeaf(RopeLeaf* leaf) {
+    if (leaf->src || leaf->packed.ptr || leaf->text.size < PACK_MIN_BYTES) return;
+    if (hasRefLines(leaf)) return;
+
+    std::vector<uint8_t> out;
+    packBytes(leaf->text.ptr, leaf->text.size, out);
+    if (out.size() > leaf->text.size - leaf->text.size / 8) return;
+
+    leaf->packed.insert(m_arena, 0, out.data(), out.size());
+    m_packStats.packedLeaves++;
+    m_packStats.packedBytes += leaf->packed.size;
+    m_packStats.rawBytes += leaf->text.size;
+    m_packStats.packCount++;
+    leaf->text.free(m_arena);
+    if (m_viewLeaf == leaf) m_viewLeaf = nullptr;
+}
+
+void Rope::unpackLeaf(RopeLeaf* leaf) {
+    size_t bytes = leaf->lineStart(leaf->lineCount());
+    leaf->text.reserve(m_arena, bytes);
+    unpackBytes(leaf->packed.ptr, leaf->packed.size, leaf->text.ptr);
+    leaf->text.size = bytes;
+    m_packStats.packedLeaves--;
+    m_packStats.packedBytes -= leaf->packed.size;
+    m_packStats.rawBytes -= bytes;
+    m_packStats.unpackCount++;
+    leaf->packed.free(m_arena);
+}
+
+// LZ4 블록과 같은 형식 : 토큰(상위 4비트 리터럴 길이, 하위 4비트 일치 길이 - 4) + 리터럴 + 일치 거리(2바이트)
+// 길이가 15 이상이면 255씩 덧붙인 바이트가 뒤따른다. 마지막 시퀀스는 리터럴만 있다.
+// 4바이트 해시 테이블로 64KB 안의 이전 위치 하나만 찾는 빠른 압축이다.
+void Rope::packBytes(const uint8_t* src, size_t n, std::vector<uint8_t>& out) {
+    auto putLength = [&out](size_t len) {
+        for (; len >= 255; len -= 255) out.push_back(255);
+        out.push_back((uint8_t)len);
+    };
+    auto hash = [src](size_t i) {
+        uint32_t v;
+        memcpy(&v, src + i, 4);
+        return (v * 2654435761u) >> (32 - PACK_HASH_BITS);
+    };
+
+    std::vector<uint32_t> table((size_t)1 << PACK_HASH_BITS, 0); // 위치 + 1 (0이면 없음)
+    out.clear();
+    out.reserve(n / 2 + 16);
+    size_t anchor = 0; // 아직 내보내지 않은 리터럴 시작
+    size_t i = 0;
+    while (i + 4 <= n) {
+        uint32_t h = hash(i);
+        size_t cand = table[h];
+        table[h] = (uint32_t)(i + 1);
+        if (!cand || i - (cand - 1) > 0xFFFF || memcmp(src + cand - 1, src + i, 4) != 0) {
+            i++;
+            continue;
+        }
+        size_t match = cand - 1;
+        size_t len = 4;
+        while (i + len < n && src[match + len] == src[i + len]) len++;
+
+        size_t lit = i - anchor;
+        size_t ml = len - 4;
+        out.push_back((uint8_t)((min(lit, (size_t)15) << 4) | min(ml, (size_t)15)));
+        if (lit >= 15) putLength(lit - 15);
+        out.insert(out.end(), src + anchor, src + i);
+        size_t dist = i - match;
+        out.push_back((uint8_t)dist);
+        out.push_back((uint8_t)(dist >> 8));
+        if (ml >= 15) putLength(ml - 15);
+
+        i += len;
+        anchor = i;
+    }
+
+    size_t lit = n - anchor;
+    out.push_back((uint8_t)(min(lit, (size_t)15) << 4));
+    if (lit >= 15) putLength(lit - 15);
+    out.insert(out.end(), src + anchor, src + n);
+}
+
+// 일치 구간은 자기 자신과 겹칠 수 있으므로 바이트 단위로 복사
+void Rope::unpackBytes(const uint8_t* src, size_t srcBytes, uint8_t* dst) {
+    const uint8_t* end = src + srcBytes;
+    while (src < end) {
+        uint8_t token = *src++;
+        size_t lit = token >> 4;
+        if (lit == 15) {
+            uint8_t b;
+            do { b = *src++; lit += b; } while (b == 255);
+        }
+        memcpy(dst, src, lit);
+        dst += lit;
+        src += lit;
+        if (src >= end) break; // 마지막 시퀀스
+
+        size_t dist = src[0] | ((size_t)src[1] << 8);
+        src += 2;
+        size_t len = token & 15;
+        if (len == 15) {
+            uint8_t b;
+            do { b = *src++; len += b; } while (b == 255);
+        }
+        len += 4;
+        const uint8_t* match = dst - dist;
+        for (size_t k = 0; k < len; k++) dst[k] = match[k];
+        dst += len;
+    }
+}
+
+// ---------------------------------------------------
+// RopeSnapshot : 얼린 노드만 읽으므로 원본 Rope의 수정과 동시에 읽어도 안전하다.
+
+const RopeLeaf* RopeSnapshot::findLeaf(size_t idx, size_t& offset) const {
+    const RopeNode* node = m_root;
+    while (!node->isLeaf) {
+        const RopeInternal* in = static_cast<const RopeInternal*>(node);
+        int i = 0;
+        while (i < in->count - 1 && idx >= in->weight[i].lines) {
+            idx -= in->weight[i].lines;
+            i++;
+        }
+        node = in->child[i];
+    }
+    offset = idx;
+    return static_cast<const RopeLeaf*>(node);
+}
+
+std::wstring RopeSnapshot::getLine(size_t lineIndex) const {
+    std::wstring line;
+    if (lineIndex >= m_totalLines) return line;
+
+    size_t offset;
+    const RopeLeaf* leaf = findLeaf(lineIndex, offset);
+    if (leaf->src) {
+        std::wstring text;
+        TextLines lines;
+        Rope::decodeLeaf(*m_source, leaf, text, lines);
+        line = lines.line(offset);
+    }
+    else {
+        RopeLeaf view;
+        std::vector<uint8_t> text;
+        leaf = unpackedLeaf(leaf, view, text);
+        Rope::appendLine(line, leaf, offset, 0, leaf->lineLen(offset));
+    }
+    return line;
+}
+
+std::wstring RopeSnapshot::getText() const {
+    std::wstring text;
+    if (m_totalLines > 0) text.reserve(m_weight.chars + (m_totalLines - 1) * 2);
+    size_t lineCnt = 0;
+    appendSubtree(text, m_root, lineCnt);
+    return text;
+}
+
+void RopeSnapshot::appendSubtree(std::wstring& out, const RopeNode* node, size_t& lineCnt) const {
+    if (!node->isLeaf) {
+        const RopeInternal* in = static_cast<const RopeInternal*>(node);
+        for (int i = 0; i < in->count; i++) {
+            appendSubtree(out, in->child[i], lineCnt);
+        }
+        return;
+    }
+
+    const RopeLeaf* leaf = static_cast<const RopeLeaf*>(node);
+    if (leaf->src) {
+        std::wstring text;
+        TextLines lines;
+        Rope::decodeLeaf(*m_source, leaf, text, lines);
+        for (size_t i = 0; i < leaf->srcLines; i++) {
+            if (lineCnt++ > 0) out += L"\r\n";
+            out.append(lines.linePtr(i), lines.lineLen(i));
+        }
+    }
+    else {
+        RopeLeaf view;
+        std::vector<uint8_t> text;
+        leaf = unpackedLeaf(leaf, view, text);
+        for (size_t i = 0; i < leaf->lineCount(); i++) {
+            if (lineCnt++ > 0) out += L"\r\n";
+            Rope::appendLine(out, leaf, i, 0, leaf->lineLen(i));
+        }
+    }
+}
+
+// 리프 링크는 원본 Rope가 고치므로 리프마다 findLeaf로 다시 내려간다.
+void RopeSnapshot::forEachLine(size_t first, size_t count, const std::function<bool(size_t lineIndex, std::wstring_view line)>& fn) const {
+    size_t end = min(first + count, m_totalLines);
+    size_t idx = first;
+    std::wstring line;
+    while (idx < end) {
+        size_t offset;
+        const RopeLeaf* leaf = findLeaf(idx, offset);
+        if (leaf->src) {
+            std::wstring text;
+            TextLines lines;
+            Rope::decodeLeaf(*m_source, leaf, text, lines);
+            for (; offset < leaf->srcLines && idx < end; offset++, idx++) {
+                if (!fn(idx, lines.lineView(offset))) return;
+            }
+        }
+        else {
+            RopeLeaf view;
+            std::vector<uint8_t> text;
+            leaf = unpackedLeaf(leaf, view, text);
+            for (; offset < leaf->lineCount() && idx < end; offset++, idx++) {
+                line.clear();
+                Rope::appendLine(line, leaf, offset, 0, leaf->lineLen(offset));
+                if (!fn(idx, line)) return;
+            }
+        }
+    }
+}
+
+// 공유 중인 압축/스왑 리프는 그 자리에서 풀 수 없으므로 임시 버퍼에 풀고, 그 버퍼를 가리키는 사본으로 읽는다.
+const RopeLeaf* RopeSnapshot::unpackedLeaf(const RopeLeaf* leaf, RopeLeaf& view, std::vector<uint8_t>& text) const {
+    if (leaf->swapBytes) {
+        Rope::readSwapped(*m_swap, leaf, text);
+        size_t lines = leaf->srcLines;
+        view.lineEnd.ptr = (uint32_t*)text.data();
+        view.lineEnd.size = lines;
+        view.lineWide.ptr = text.data() + lines * sizeof(uint32_t);
+        view.lineWide.size = lines;
+        view.text.ptr = text.data() + lines * (sizeof(uint32_t) + 1);
+        view.text.size = text.size() - lines * (sizeof(uint32_t) + 1);
+        return &view;
+    }
+    if (!leaf->packed.ptr) return leaf;
+    text.resize(leaf->lineStart(leaf->lineCount()));
+    Rope::unpackBytes(leaf->packed.ptr, leaf->packed.size, text.data());
+    view.lineEnd = leaf->lineEnd; // 최근 접근 목록 링크는 원본 Rope가 고치므로 필요한 필드만 복사
+    view.lineWide = leaf->lineWide;
+    view.text.ptr = text.data();
+    view.text.size = text.size();
+    return &view;
+}
+
+void Rope::deleteNode(RopeNode* node) {
+    if (node->isLeaf) unlinkHot(static_cast<RopeLeaf*>(node));
+    if (isShared(node)) {
+        m_retired.push_back({ node, m_gen });
+        return;
+    }
+    freeNode(node);
+}
+
+void Rope::freeNode(RopeNode* node) {
+    if (node->isLeaf) {
+        RopeLeaf* leaf = static_cast<RopeLeaf*>(node);
+        for (size_t i = 0; i < leaf->lineEnd.size; i++) {
+            if (leaf->isLong(i)) freeLongLine(leaf->longLine(i));
+            else if (leaf->isAtom(i)) releaseAtom(leaf->atom(i));
+        }
+        if (leaf->packed.ptr) {
+            m_packStats.packedLeaves--;
+            m_packStats.packedBytes -= leaf->packed.size;
+            m_packStats.rawBytes -= leaf->lineStart(leaf->lineCount());
+            leaf->packed.free(m_arena);
+        }
+        if (leaf->swapBytes) {
+            m_swap.release(leaf->swapPos, leaf->swapBytes);
+            m_swapStats.swappedLeaves--;
+            m_swapStats.swapBytes -= leaf->swapBytes;
+        }
+        leaf->text.free(m_arena);
+        leaf->lineEnd.free(m_arena);
+        leaf->lineWide.free(m_arena);
+        leaf->lineWraps.free(m_arena);
+        m_arena.release(leaf, sizeof(RopeLeaf));
+    }
+    else {
+        m_arena.release(node, sizeof(RopeInternal));
+    }
+}
+
+// 라인 내부의 [offset, offset + eraseLen) 문자 구간을 str로 교체하고 뒤쪽 라인 끝 위치를 보정
+// Latin-1 라인에 넓은 문자가 들어오면 라인 전체를 UTF-16으로 넓히고, UTF-16 라인이 줄어들면 다시 좁힐 수 있는지 확인한다.
+void Rope::leafReplace(RopeLeaf* leaf, size_t line, size_t offset, size_t eraseLen, const wchar_t* str, size_t len) {
+    leafResetWrap(leaf, line);
+    if (leaf->isAtom(line)) leafUnatom(leaf, line); // 공유 라인은 리프 버퍼로 풀어서 고친다. (쓰기 시 복사)
+    if (leaf->isLong(line)) {
+        // 긴 라인 : 걸친 청크만 고치고 리프 크기는 라인 크기 변화로 보정
+        RopeLongLine* ll = leaf->longLine(line);
+        leaf->chars -= ll->chars;
+        leaf->utf8 -= ll->utf8;
+        longLineReplace(ll, offset, eraseLen, str, len);
+        leaf->chars += ll->chars;
+        leaf->utf8 += ll->utf8;
+        leafUnchunk(leaf, line);
+        return;
+    }
+    if (leaf->lineLen(line) - eraseLen + len > LONG_LINE_MIN) {
+        // 한도를 넘는 라인 : 편집한 결과를 청크로 나눠 리프 밖으로 옮긴다.
+        std::wstring lineText;
+        appendLine(lineText, leaf, line, 0, leaf->lineLen(line));
+        lineText.replace(offset, eraseLen, str, len);
+        RopeWeight old = linesWeight(leaf, line, 1);
+        RopeLongLine* ll = newLongLine(lineText.data(), lineText.size());
+        leaf->chars += ll->chars - old.chars;
+        leaf->utf8 += ll->utf8 - old.utf8;
+        leafSetLong(leaf, line, ll);
+        return;
+    }
+
+    uint8_t shift = leaf->lineWide[line];
+    size_t start = leaf->lineStart(line);
+    size_t oldBytes = leaf->lineBytes(line);
+    size_t newBytes;
+
+    // 리프 크기는 지우는 문자와 넣는 문자만 세어서 보정
+    leaf->chars += len - eraseLen;
+    leaf->utf8 += utf8Size(str, len) - utf8Size(leaf->linePtr(line) + (offset << shift), eraseLen, shift);
+
+    if (shift == 0 && charShift(str, len) == 0) {
+        // 인코딩 유지 : Latin-1
+        encodeChars(leaf->text.splice(m_arena, start + offset, eraseLen, len), str, len, 0);
+        newBytes = oldBytes + len - eraseLen;
+    }
+    else if (shift != 0 && !(offset == 0 && eraseLen == leaf->lineLen(line))) {
+        // 인코딩 유지 : UTF-16 라인 일부 편집 (라인 전체를 바꿀 때만 더 좁은 인코딩으로 다시 기록)
+        encodeChars(leaf->text.splice(m_arena, start + (offset << shift), eraseLen << shift, len << shift), str, len, shift);
+        newBytes = oldBytes + (len << shift) - (eraseLen << shift);
+    }
+    else {
+        // 인코딩이 바뀔 수 있는 경우 : 라인을 디코딩해서 편집한 뒤 가장 좁은 인코딩으로 다시 기록
+        std::wstring lineText;
+        if (offset == 0 && eraseLen == leaf->lineLen(line)) {
+            lineText.assign(str, len);
+        }
+        else {
+            appendLine(lineText, leaf, line, 0, leaf->lineLen(line));
+            lineText.replace(offset, eraseLen, str, len);
+        }
+        uint8_t newShift = charShift(lineText.data(), lineText.size());
+        newBytes = lineText.size() << newShift;
+        encodeChars(leaf->text.splice(m_arena, start, oldBytes, newBytes), lineText.data(), lineText.size(), newShift);
+        leaf->lineWide[line] = newShift;
+    }
+
+    long long diff = (long long)newBytes - (long long)oldBytes;
+    if (diff == 0) return;
+    for (size_t i = line; i < leaf->lineEnd.size; i++) {
+        leaf->lineEnd[i] = (uint32_t)(leaf->lineEnd[i] + diff);
+    }
+}
+
+void Rope::leafInsertLine(RopeLeaf* leaf, size_t line, const wchar_t* str, size_t len) {
+    // 긴 라인은 청크로 나눠 리프 밖에 두고, 반복되는 라인은 공유 버퍼를 찾아서 버퍼에는 포인터만 기록
+    RopeLongLine* ll = (len > LONG_LINE_MIN) ? newLongLine(str, len) : nullptr;
+    uint8_t shift = ll ? LONG_LINE_SHIFT : charShift(str, len);
+    RopeAtom* atom = (!ll && m_interning && (len << shift) >= ATOM_MIN_BYTES) ? internLine(str, len, shift) : nullptr;
+    size_t bytes = ll ? sizeof(ll) : atom ? sizeof(atom) : len << shift;
+    size_t start = leaf->lineStart(line);
+    uint32_t end = (uint32_t)start;
+    leaf->chars += len;
+    leaf->utf8 += ll ? ll->utf8 : atom ? atom->utf8 : utf8Size(str, len);
+
+    uint8_t* dst = leaf->text.splice(m_arena, start, 0, bytes);
+    if (ll) memcpy(dst, &ll, sizeof(ll));
+    else if (atom) memcpy(dst, &atom, sizeof(atom));
+    else encodeChars(dst, str, len, shift);
+    if (atom) shift = SHARED_LINE_SHIFT;
+    uint32_t noWrap = 0;
+    leaf->lineEnd.insert(m_arena, line, &end, 1);
+    leaf->lineWide.insert(m_arena, line, &shift, 1);
+    if (leaf->lineWraps.size) leaf->lineWraps.insert(m_arena, line, &noWrap, 1);
+    leaf->wrapsSet = false;
+    for (size_t i = line; i < leaf->lineEnd.size; i++) {
+        leaf->lineEnd[i] = (uint32_t)(leaf->lineEnd[i] + bytes);
+    }
+}
+
+void Rope::leafEraseLines(RopeLeaf* leaf, size_t line, size_t cnt, const RopeWeight* moved) {
+    RopeWeight w = moved ? *moved : linesWeight(leaf, line, cnt);
+    leaf->chars -= w.chars;
+    leaf->utf8 -= w.utf8;
+    leaf->wraps -= w.wraps;
+    if (!moved) {
+        for (size_t i = line; i < line + cnt; i++) {
+            if (leaf->isLong(i)) freeLongLine(leaf->longLine(i));
+            else if (leaf->isAtom(i)) releaseAtom(leaf->atom(i));
+        }
+    }
+
+    size_t start = leaf->lineStart(line);
+    size_t len = leaf->lineStart(line + cnt) - start;
+    leaf->text.erase(start, len);
+    leaf->lineEnd.erase(line, cnt);
+    leaf->lineWide.erase(line, cnt);
+    if (leaf->lineWraps.size) leaf->lineWraps.erase(line, cnt);
+    for (size_t i = line; i < leaf->lineEnd.size; i++) {
+        leaf->lineEnd[i] = (uint32_t)(leaf->lineEnd[i] - len);
+    }
+}
+
+// src의 [line, line + cnt) 라인을 dst의 dstLine 위치로 옮긴다. (버퍼는 인코딩 그대로 한 번에 복사, 긴 라인과 공유 라인은 포인터만 넘어감)
+void Rope::leafMoveLines(RopeLeaf* src, size_t line, size_t cnt, RopeLeaf* dst, size_t dstLine) {
+    if (cnt == 0) return;
+
+    RopeWeight moved = linesWeight(src, line, cnt);
+    dst->wrapsSet = (dst->wrapsSet || !dst->lineCount()) && src->wrapsSet; // 옮긴 라인의 기록 여부를 이어받음
+    dst->chars += moved.chars;
+    dst->utf8 += moved.utf8;
+    if (moved.wraps || dst->lineWraps.size) {
+        dst->wraps += moved.wraps;
+        leafFillWraps(dst);
+        if (src->lineWraps.size) dst->lineWraps.insert(m_arena, dstLine, src->lineWraps.ptr + line, cnt);
+        else memset(dst->lineWraps.splice(m_arena, dstLine, 0, cnt), 0, cnt * sizeof(uint32_t));
+    }
+
+    size_t srcStart = src->lineStart(line);
+    size_t len = src->lineStart(line + cnt) - srcStart;
+    size_t dstStart = dst->lineStart(dstLine);
+
+    dst->text.insert(m_arena, dstStart, src->text.ptr + srcStart, len);
+    dst->lineEnd.insert(m_arena, dstLine, src->lineEnd.ptr + line, cnt);
+    dst->lineWide.insert(m_arena, dstLine, src->lineWide.ptr + line, cnt);
+    for (size_t i = dstLine; i < dstLine + cnt; i++) {
+        dst->lineEnd[i] = (uint32_t)(dst->lineEnd[i] - srcStart + dstStart);
+    }
+    for (size_t i = dstLine + cnt; i < dst->lineEnd.size; i++) {
+        dst->lineEnd[i] = (uint32_t)(dst->lineEnd[i] + len);
+    }
+
+    leafEraseLines(src, line, cnt, &moved);
+}
+
+RopeWeight Rope::linesWeight(const RopeLeaf* leaf, size_t line, size_t cnt) {
+    RopeWeight w;
+    w.lines = cnt;
+    for (size_t i = line; i < line + cnt; i++) {
+        size_t len = leaf->lineLen(i);
+        w.chars += len;
+        w.utf8 += lineUtf8(leaf, i, len);
+        w.wraps += leaf->lineWrap(i);
+    }
+    return w;
+}
+
+bool Rope::leafUnderflow(RopeLeaf* leaf) {
+    return leaf->lineCount() < m_limits.mergeLines / 2 && leaf->text.size < m_limits.leafBytes / 4;
+}
+
+// 라인 버퍼를 newBytes 크기로 바꾸고 뒤쪽 라인 끝 위치를 보정한다. (내용은 호출자가 기록)
+uint8_t* Rope::leafResizeLine(RopeLeaf* leaf, size_t line, size_t newBytes, uint8_t shift) {
+    size_t start = leaf->lineStart(line);
+    size_t oldBytes = leaf->lineBytes(line);
+    uint8_t* dst = leaf->text.splice(m_arena, start, oldBytes, newBytes);
+    leaf->lineWide[line] = shift;
+    for (size_t i = line; i < leaf->lineEnd.size; i++) {
+        leaf->lineEnd[i] = (uint32_t)(leaf->lineEnd[i] + newBytes - oldBytes);
+    }
+    return dst;
+}
+
+void Rope::leafSetLong(RopeLeaf* leaf, size_t line, RopeLongLine* ll) {
+    memcpy(leafResizeLine(leaf, line, sizeof(ll), LONG_LINE_SHIFT), &ll, sizeof(ll));
+}
+
+RopeLongLine* Rope::leafTakeLong(RopeLeaf* leaf, size_t line) {
+    RopeLongLine* ll = leaf->longLine(line);
+    leaf->chars -= ll->chars;
+    leaf->utf8 -= ll->utf8;
+    leafResizeLine(leaf, line, 0, 0);
+    return ll;
+}
+
+// 라인도 긴 라인이면 청크 배열만 이어붙이고, 짧은 라인이면 그 문자들을 tail 앞에 넣은 뒤 라인을 tail로 바꾼다.
+void Rope::leafJoinLong(RopeLeaf* leaf, size_t line, RopeLongLine* tail) {
+    leaf->chars += tail->chars;
+    leaf->utf8 += tail->utf8;
+    if (leaf->isLong(line)) {
+        RopeLongLine* ll = leaf->longLine(line);
+        ll->chunks.insert(m_arena, ll->chunks.size, tail->chunks.ptr, tail->chunks.size);
+        tail->chunks.size = 0; // 청크 버퍼는 ll로 넘어감
+        freeLongLine(tail);
+        ll->rebuildIndex(m_arena);
+    }
+    else {
+        if (leaf->isAtom(line)) leafUnatom(leaf, line);
+        std::wstring head;
+        appendLine(head, leaf, line, 0, leaf->lineLen(line));
+        longLineReplace(tail, 0, 0, head.data(), head.size());
+        leafSetLong(leaf, line, tail);
+    }
+}
+
+// LONG_LINE_MIN의 절반보다 짧아진 긴 라인만 되돌린다. (한도 근처에서 편집할 때마다 오가지 않도록)
+void Rope::leafUnchunk(RopeLeaf* leaf, size_t line) {
+    if (!leaf->isLong(line) || leaf->longLine(line)->chars >= LONG_LINE_MIN / 2) return;
+
+    RopeLongLine* ll = leaf->longLine(line);
+    std::wstring lineText;
+    ll->append(lineText, 0, ll->chars);
+    freeLongLine(ll);
+    uint8_t shift = charShift(lineText.data(), lineText.size());
+    encodeChars(leafResizeLine(leaf, line, lineText.size() << shift, shift), lineText.data(), lineText.size(), shift);
+}
+
+void Rope::leafUnatom(RopeLeaf* leaf, size_t line) {
+    RopeAtom* atom = leaf->atom(line);
+    memcpy(leafResizeLine(leaf, line, atom->bytes(), atom->shift), atom->data(), atom->bytes());
+    releaseAtom(atom);
+}
+
+void Rope::leafResetWrap(RopeLeaf* leaf, size_t line) {
+    leaf->wrapsSet = false;
+    if (!leaf->lineWraps.size) return;
+    leaf->wraps -= leaf->lineWraps[line];
+    leaf->lineWraps[line] = 0;
+}
+
+void Rope::leafFillWraps(RopeLeaf* leaf) {
+    size_t cnt = leaf->lineCount();
+    if (leaf->lineWraps.size || !cnt) return;
+    memset(leaf->lineWraps.splice(m_arena, 0, 0, cnt), 0, cnt * sizeof(uint32_t));
+}
+
+bool Rope::hasRefLines(const RopeLeaf* leaf) {
+    for (size_t i = 0; i < leaf->lineWide.size; i++) {
+        if (leaf->isRef(i)) return true;
+    }
+    return false;
+}
+
+void Rope::appendLine(std::wstring& out, const RopeLeaf* leaf, size_t line, size_t from, size_t cnt) {
+    if (leaf->isLong(line)) {
+        leaf->longLine(line)->append(out, from, cnt);
+        return;
+    }
+
+    uint8_t shift;
+    const uint8_t* src = leaf->lineText(line, shift);
+    size_t pos = out.size();
+    out.resize(pos + cnt);
+    if (cnt == 0) return;
+
+    if (shift) {
+        memcpy(&out[pos], src + (from << WIDE_CHAR_SHIFT), cnt << WIDE_CHAR_SHIFT);
+    }
+    else {
+        for (size_t i = 0; i < cnt; i++) out[pos + i] = src[from + i];
+    }
+}
+
+size_t Rope::lineUtf8(const RopeLeaf* leaf, size_t line, size_t column) {
+    if (leaf->isLong(line)) return leaf->longLine(line)->utf8Before(column);
+    if (leaf->isAtom(line) && column == leaf->atom(line)->chars) return leaf->atom(line)->utf8;
+    uint8_t shift;
+    const uint8_t* src = leaf->lineText(line, shift);
+    return utf8Size(src, column, shift);
+}
+
+uint8_t Rope::charShift(const wchar_t* str, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] > 0xFF) return WIDE_CHAR_SHIFT;
+    }
+    return 0;
+}
+
+size_t Rope::utf8Size(const wchar_t* str, size_t len) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < len; i++) bytes += utf8Size(str[i]);
+    return bytes;
+}
+
+size_t Rope::utf8Size(const uint8_t* src, size_t len, uint8_t shift) {
+    size_t bytes = len;
+    if (shift) {
+        for (size_t i = 0; i < len; i++) bytes += utf8Size(charAt(src, i, shift)) - 1;
+    }
+    else {
+        for (size_t i = 0; i < len; i++) bytes += src[i] >> 7; // 0x80 이상은 2바이트
+    }
+    return bytes;
+}
+
+void Rope::encodeChars(uint8_t* dst, const wchar_t* str, size_t len, uint8_t shift) {
+    if (len == 0) return; // 삭제만 할 때는 str이 nullptr
+
+    if (shift) {
+        memcpy(dst, str, len << WIDE_CHAR_SHIFT);
+    }
+    else {
+        for (size_t i = 0; i < len; i++) dst[i] = (uint8_t)str[i];
+    }
+}
+
+RopeLongLine* Rope::newLongLine(const wchar_t* str, size_t len) {
+    RopeLongLine* ll = new (m_arena.allocate(sizeof(RopeLongLine))) RopeLongLine();
+    fillChunks(ll, 0, str, len);
+    ll->rebuildIndex(m_arena);
+    return ll;
+}
+
+RopeLongLine* Rope::copyLongLine(const RopeLongLine* ll) {
+    RopeLongLine* copy = new (m_arena.allocate(sizeof(RopeLongLine))) RopeLongLine();
+    copy->chunks.insert(m_arena, 0, ll->chunks.ptr, ll->chunks.size);
+    for (size_t i = 0; i < copy->chunks.size; i++) {
+        RopeBuf<uint8_t>& text = copy->chunks[i].text;
+        const RopeBuf<uint8_t> src = text;
+        text = RopeBuf<uint8_t>();
+        text.insert(m_arena, 0, src.ptr, src.size);
+    }
+    copy->rebuildIndex(m_arena);
+    return copy;
+}
+
+void Rope::freeLongLine(RopeLongLine* ll) {
+    for (size_t i = 0; i < ll->chunks.size; i++) {
+        ll->chunks[i].text.free(m_arena);
+    }
+    ll->chunks.free(m_arena);
+    ll->charIndex.free(m_arena);
+    ll->utf8Index.free(m_arena);
+    m_arena.release(ll, sizeof(RopeLongLine));
+}
+
+// str을 LINE_CHUNK_CHARS 이하의 고른 크기로 나눠서 청크마다 가장 좁은 인코딩으로 기록한다.
+void Rope::fillChunks(RopeLongLine* ll, size_t at, const wchar_t* str, size_t len) {
+    if (len == 0) return;
+
+    size_t cnt = (len + LINE_CHUNK_CHARS - 1) / LINE_CHUNK_CHARS;
+    RopeChunk* dst = ll->chunks.splice(m_arena, at, 0, cnt);
+    for (size_t i = 0; i < cnt; i++) {
+        size_t n = len / cnt + (i < len % cnt ? 1 : 0);
+        RopeChunk ch = {};
+        ch.shift = charShift(str, n);
+        ch.utf8 = utf8Size(str, n);
+        encodeChars(ch.text.splice(m_arena, 0, 0, n << ch.shift), str, n, ch.shift);
+        dst[i] = ch;
+        str += n;
+    }
+}
+
+// 지울 구간이 걸친 청크들을 앞에서부터 줄이고 다 지워진 청크는 뺀다. 넣을 문자는 offset이 들어 있는 청크에 넣고,
+// 청크가 넓은 인코딩으로 바뀌거나 기준의 2배를 넘을 때만 그 청크를 다시 나눈다. 인덱스는 청크 수가 바뀔 때만 다시 구성한다.
+void Rope::longLineReplace(RopeLongLine* ll, size_t offset, size_t eraseLen, const wchar_t* str, size_t len) {
+    size_t pos;
+    size_t c = ll->findChunk(offset, pos);
+
+    if (eraseLen > 0) {
+        size_t last = c;
+        size_t erasedChars = 0, erasedBytes = 0;
+        for (size_t i = c; eraseLen > 0; i++, pos = 0) {
+            RopeChunk& ch = ll->chunks[i];
+            size_t n = min(eraseLen, ch.len() - pos);
+            size_t bytes = utf8Size(ch.text.ptr + (pos << ch.shift), n, ch.shift);
+            ch.text.erase(pos << ch.shift, n << ch.shift);
+            ch.utf8 -= bytes;
+            erasedChars += n;
+            erasedBytes += bytes;
+            eraseLen -= n;
+            last = i;
+        }
+        if (last == c && ll->chunks[c].text.size > 0) {
+            ll->addIndex(c, 0 - erasedChars, 0 - erasedBytes);
+        }
+        else {
+            size_t keep = c;
+            for (size_t i = c; i <= last; i++) {
+                if (ll->chunks[i].text.size == 0) ll->chunks[i].text.free(m_arena);
+                else ll->chunks[keep++] = ll->chunks[i];
+            }
+            ll->chunks.erase(keep, last + 1 - keep);
+            ll->rebuildIndex(m_arena);
+        }
+    }
+    if (len == 0) return;
+
+    if (ll->chunks.size == 0) {
+        fillChunks(ll, 0, str, len);
+        ll->rebuildIndex(m_arena);
+        return;
+    }
+    c = ll->findChunk(offset, pos);
+    RopeChunk& ch = ll->chunks[c];
+    if (ch.len() + len <= LINE_CHUNK_CHARS * 2 && charShift(str, len) <= ch.shift) {
+        // 청크 인코딩 그대로 끼워 넣기
+        size_t bytes = utf8Size(str, len);
+        encodeChars(ch.text.splice(m_arena, pos << ch.shift, 0, len << ch.shift), str, len, ch.shift);
+        ch.utf8 += bytes;
+        ll->addIndex(c, len, bytes);
+        return;
+    }
+
+    // 청크 앞부분 + 넣을 문자 + 뒷부분을 기준 크기 청크들로 다시 나눈다.
+    std::wstring text(ch.len(), L'\0');
+    for (size_t i = 0; i < text.size(); i++) text[i] = charAt(ch.text.ptr, i, ch.shift);
+    text.insert(pos, str, len);
+    ch.text.free(m_arena);
+    ll->chunks.erase(c, 1);
+    fillChunks(ll, c, text.data(), text.size());
+    ll->rebuildIndex(m_arena);
+}
+
+// column이 청크 중간이면 그 청크의 뒷부분만 새 청크로 복사하고, 뒤쪽 청크들은 버퍼째 넘긴다.
+RopeLongLine* Rope::longLineSplit(RopeLongLine* ll, size_t column) {
+    RopeLongLine* tail = new (m_arena.allocate(sizeof(RopeLongLine))) RopeLongLine();
+    if (column < ll->chars) {
+        size_t pos;
+        size_t c = ll->findChunk(column, pos);
+        if (pos > 0) {
+            RopeChunk& ch = ll->chunks[c];
+            size_t at = pos << ch.shift;
+            RopeChunk back = {};
+            back.shift = ch.shift;
+            back.text.insert(m_arena, 0, ch.text.ptr + at, ch.text.size - at);
+            back.utf8 = utf8Size(back.text.ptr, back.len(), back.shift);
+            ch.text.erase(at, ch.text.size - at);
+            ch.utf8 -= back.utf8;
+            tail->chunks.push_back(m_arena, back);
+            c++;
+        }
+        tail->chunks.insert(m_arena, tail->chunks.size, ll->chunks.ptr + c, ll->chunks.size - c);
+        ll->chunks.size = c; // 뒤쪽 청크 버퍼는 tail로 넘어감
+        ll->rebuildIndex(m_arena);
+    }
+    tail->rebuildIndex(m_arena);
+    return tail;
+}
+
+// 양 끝 리프에서 범위에 걸친 라인만 지우고, 사이의 리프들은 서브트리 단위로 떼어낸 뒤 두 경계 경로만 복구한다.
+// 비용은 지우는 구간의 노드 수 + O(log n)이며 디코딩 전 리프는 통째로 지워지면 디코딩하지 않는다.
+void Rope::eraseRange(size_t startLine, size_t eraseSize) {
+    dropFinger();
+    noteLines(startLine, eraseSize, 0);
+    if (eraseSize == 0 || startLine >= m_totalLines) return; // 유효하지 않은 범위 방지
+    eraseSize = min(eraseSize, m_totalLines - startLine);
+
+    // 전체 삭제
+    if (startLine == 0 && eraseSize == m_totalLines) {
+        releaseSubtree(root);
+        root = allocLeaf();
+        m_totalLines = 0;
+        return;
+    }
+
+    // 앞쪽 경계 리프의 범위에 걸친 뒷부분
+    RopePath path;
+    size_t offset;
+    RopeLeaf* leaf = findLeaf(startLine, offset, &path);
+    if (offset > 0) {
+        size_t cnt = min(eraseSize, leaf->lineCount() - offset);
+        ensureResident(leaf);
+        RopeWeight before = leaf->weight();
+        leafEraseLines(leaf, offset, cnt);
+        addWeight(path, leaf->weight() - before);
+        m_totalLines -= cnt;
+        eraseSize -= cnt;
+        if (eraseSize == 0) {
+            repairLeaf(leaf, path);
+            return;
+        }
+    }
+
+    // 뒤쪽 경계 리프의 범위에 걸친 앞부분
+    size_t endLine = startLine + eraseSize;
+    if (endLine < m_totalLines) {
+        leaf = findLeaf(endLine, offset, &path);
+        if (offset > 0) {
+            ensureResident(leaf);
+            RopeWeight before = leaf->weight();
+            leafEraseLines(leaf, 0, offset);
+            addWeight(path, leaf->weight() - before);
+            m_totalLines -= offset;
+            eraseSize -= offset;
+        }
+    }
+
+    // 남은 구간은 리프 경계에 맞춰진 통째 리프들
+    if (eraseSize > 0) {
+        RopeLeaf* before = findLeaf(startLine, offset)->prev;
+        RopeLeaf* after = (startLine + eraseSize < m_totalLines) ? findLeaf(startLine + eraseSize, offset) : nullptr;
+        root = writable(root);
+        removeLeafRange(static_cast<RopeInternal*>(root), startLine, eraseSize);
+        m_totalLines -= eraseSize;
+        if (before) before->next = after;
+        if (after) after->prev = before;
+    }
+
+    // 떼어낸 자리 양쪽 경로의 부족한 노드 복구
+    if (startLine > 0) repairPath(startLine - 1);
+    if (startLine < m_totalLines) repairPath(startLine);
+}
+
+// node 아래에서 리프 경계에 맞춘 [from, from + cnt) 구간을 제거한다. 통째로 덮인 자식은 내려가지 않고 서브트리째 해제
+void Rope::removeLeafRange(RopeInternal* node, size_t from, size_t cnt) {
+    int keep = 0;
+    size_t pos = 0;
+    for (int i = 0; i < node->count; i++) {
+        RopeNode* child = node->child[i];
+        RopeWeight childWeight = node->weight[i];
+        size_t childCnt = childWeight.lines;
+        size_t s = max(from, pos);
+        size_t e = min(from + cnt, pos + childCnt);
+        pos += childCnt;
+
+        if (s < e) {
+            if (e - s == childCnt) {
+                releaseSubtree(child);
+                continue;
+            }
+            // 리프 경계에 맞춰져 있으므로 일부만 덮인 자식은 내부 노드
+            child = writable(child);
+            removeLeafRange(static_cast<RopeInternal*>(child), s - (pos - childCnt), e - s);
+            childWeight = static_cast<RopeInternal*>(child)->total();
+        }
+        node->child[keep] = child;
+        node->weight[keep] = childWeight;
+        keep++;
+    }
+    node->count = keep;
+}
+
+// line까지의 경로를 위에서부터 내려가며 부족한 노드를 형제와 병합/차용한다.
+// 위 레벨부터 고치므로 병합/차용할 때 부모는 항상 자식이 둘 이상이다. (구조가 바뀌면 처음부터 다시 확인)
+void Rope::repairPath(size_t line) {
+    int level = 0;
+    for (;;) {
+        // 루트에 자식이 하나만 남으면 높이를 줄인다.
+        while (!root->isLeaf && static_cast<RopeInternal*>(root)->count == 1) {
+            RopeNode* child = static_cast<RopeInternal*>(root)->child[0];
+            deleteNode(root);
+            root = child;
+        }
+
+        RopePath path;
+        size_t offset;
+        RopeLeaf* leaf = findLeaf(line, offset, &path);
+        if (level >= path.depth) {
+            if (leafUnderflow(leaf)) rebalanceLeaf(leaf, path);
+            return;
+        }
+        if (level > 0 && path.node[level]->count < NODE_FANOUT / 2) {
+            rebalanceInternal(path, level);
+            level = 0;
+            continue;
+        }
+        level++;
+    }
+}
+
+// 서브트리 전체 해제
+void Rope::releaseSubtree(RopeNode* node) {
+    if (!node->isLeaf) {
+        RopeInternal* in = static_cast<RopeInternal*>(node);
+        for (int i = 0; i < in->count; i++) {
+            releaseSubtree(in->child[i]);
+        }
+    }
+    deleteNode(node);
+}
+
+// 라인 경계 line에서 서브트리를 두 트리로 나눈다. (0 < line < 라인 수, 경계가 리프 중간이면 리프만 분할)
+// 경계에 걸친 자식만 재귀로 나누고 나머지 자식들은 서브트리째 양쪽에 붙이므로 O(NODE_FANOUT * 높이)
+// 결과 트리는 경계 쪽 가장자리 경로의 노드만 부족할 수 있다. (호출자가 repairPath로 복구)
+void Rope::splitTree(RopeNode* node, size_t line, RopeNode*& left, RopeNode*& right) {
+    if (node->isLeaf) {
+        RopeLeaf* leaf = static_cast<RopeLeaf*>(writable(node));
+        ensureResident(leaf);
+        RopeLeaf* newLeaf = allocLeaf();
+        leafMoveLines(leaf, line, leaf->lineCount() - line, newLeaf, 0);
+        newLeaf->prev = leaf;
+        newLeaf->next = leaf->next;
+        if (leaf->next) leaf->next->prev = newLeaf;
+        leaf->next = newLeaf;
+        left = leaf;
+        right = newLeaf;
+        return;
+    }
+
+    RopeInternal* in = static_cast<RopeInternal*>(node);
+    int i = 0;
+    while (line >= in->weight[i].lines) {
+        line -= in->weight[i].lines;
+        i++;
+    }
+
+    if (line == 0) {
+        // 자식 경계에서 나뉘면 자식 배열만 나눈다.
+        left = takeChildren(in, 0, i);
+        right = takeChildren(in, i, in->count);
+    }
+    else {
+        RopeNode *cl, *cr;
+        splitTree(in->child[i], line, cl, cr);
+        RopeNode* leftPart = takeChildren(in, 0, i);
+        RopeNode* rightPart = takeChildren(in, i + 1, in->count);
+        left = leftPart ? joinTrees(leftPart, cl) : cl;
+        right = rightPart ? joinTrees(cr, rightPart) : cr;
+    }
+    deleteNode(in);
+}
+
+// node의 [from, to) 자식들로 만든 트리 (자식이 없으면 nullptr, 하나면 그 자식)
+RopeNode* Rope::takeChildren(RopeInternal* node, int from, int to) {
+    if (from >= to) return nullptr;
+    if (to - from == 1) return node->child[from];
+
+    RopeInternal* part = allocInternal();
+    for (int i = from; i < to; i++) {
+        part->child[i - from] = node->child[i];
+        part->weight[i - from] = node->weight[i];
+    }
+    part->count = to - from;
+    return part;
+}
+
+// left 뒤에 right를 이어붙인 트리 : 높이가 같으면 새 루트 아래에 두고,
+// 다르면 낮은 트리를 높은 트리의 맞닿는 가장자리에서 같은 높이의 자식 자리에 끼운다. (넘치면 분할 전파)
+RopeNode* Rope::joinTrees(RopeNode* left, RopeNode* right) {
+    RopeLeaf* a = edgeLeaf(left, true);
+    RopeLeaf* b = edgeLeaf(right, false);
+    a->next = b;
+    b->prev = a;
+
+    int hl = treeHeight(left), hr = treeHeight(right);
+    if (hl == hr) {
+        RopeInternal* node = allocInternal();
+        node->child[0] = left;
+        node->weight[0] = treeWeight(left);
+        node->child[1] = right;
+        node->weight[1] = treeWeight(right);
+        node->count = 2;
+        return node;
+    }
+
+    bool intoLeft = hl > hr;
+    RopeNode* tall = intoLeft ? left : right;
+    RopeNode* low = intoLeft ? right : left;
+    int lowHeight = intoLeft ? hr : hl;
+    RopeWeight w = treeWeight(low);
+
+    // 낮은 트리와 높이가 같은 자식들을 가진 노드까지 가장자리를 따라 내려간다.
+    RopePath path;
+    tall = writable(tall);
+    RopeNode* node = tall;
+    for (int h = max(hl, hr); h > lowHeight; h--) {
+        RopeInternal* in = static_cast<RopeInternal*>(node);
+        int slot = intoLeft ? in->count - 1 : 0;
+        if (h - 1 > lowHeight) in->child[slot] = writable(in->child[slot]);
+        path.node[path.depth] = in;
+        path.slot[path.depth] = slot;
+        node = in->child[slot];
+        path.depth++;
+    }
+    int level = path.depth - 1;
+    for (int i = 0; i < level; i++) {
+        path.node[i]->weight[path.slot[i]] += w;
+    }
+
+    // insertChildAt은 level 0이 분할되면 root를 바꾸므로 잠시 tall을 루트로 둔다.
+    RopeNode* saved = root;
+    root = tall;
+    insertChildAt(path, level, intoLeft ? path.node[level]->count : 0, low, w);
+    RopeNode* joined = root;
+    root = saved;
+    return joined;
+}
+
+int Rope::treeHeight(RopeNode* node) {
+    int height = 0;
+    while (!node->isLeaf) {
+        node = static_cast<RopeInternal*>(node)->child[0];
+        height++;
+    }
+    return height;
+}
+
+RopeLeaf* Rope::edgeLeaf(RopeNode* node, bool last) {
+    while (!node->isLeaf) {
+        RopeInternal* in = static_cast<RopeInternal*>(node);
+        node = in->child[last ? in->count - 1 : 0];
+    }
+    return static_cast<RopeLeaf*>(node);
+}
+
+RopeWeight Rope::treeWeight(RopeNode* node) {
+    return node->isLeaf ? static_cast<RopeLeaf*>(node)->weight() : static_cast<RopeInternal*>(node)->total();
+}
+
+// 트리 양 끝 리프의 바깥쪽 링크를 끊는다.
+void Rope::cutEdges(RopeNode* node) {
+    edgeLeaf(node, false)->prev = nullptr;
+    edgeLeaf(node, true)->next = nullptr;
+}
+
+// [lineIndex, lineIndex + count) 라인을 서브트리째 떼어낸다. 리프 버퍼는 복사하지 않고 경계 리프 두 개만 나눈다.
+RopeSlice Rope::detachLines(size_t lineIndex, size_t count) {
+    dropFinger();
+    noteLines(lineIndex, count, 0);
+    return detachRange(lineIndex, count);
+}
+
+// detachLines의 본문 (dropFinger 없이)
+RopeSlice Rope::detachRange(size_t lineIndex, size_t count) {
+    RopeSlice slice;
+    if (count == 0 || lineIndex >= m_totalLines) return slice;
+    count = min(count, m_totalLines - lineIndex);
+
+    RopeNode *head = nullptr, *mid = root, *tail = nullptr;
+    if (lineIndex > 0) splitTree(mid, lineIndex, head, mid);
+    if (lineIndex + count < m_totalLines) splitTree(mid, count, mid, tail);
+    cutEdges(mid);
+
+    if (head && tail) root = joinTrees(head, tail);
+    else if (head || tail) root = head ? head : tail;
+    else root = allocLeaf();
+    m_totalLines -= count;
+
+    if (m_totalLines > 0) {
+        cutEdges(root);
+        if (lineIndex > 0) repairPath(lineIndex - 1);
+        if (lineIndex < m_totalLines) repairPath(lineIndex);
+    }
+
+    slice.root = mid;
+    slice.lines = count;
+    return slice;
+}
+
+// 떼어낸 라인들을 lineIndex 위치에 서브트리째 끼운다. (slice는 비워짐)
+void Rope::spliceLines(size_t lineIndex, RopeSlice& slice) {
+    dropFinger();
+    noteLines(lineIndex, 0, slice.lines);
+    spliceRange(lineIndex, slice);
+}
+
+// spliceLines의 본문 (dropFinger 없이)
+void Rope::spliceRange(size_t lineIndex, RopeSlice& slice) {
+    if (!slice.root) return;
+    RopeNode* lines = slice.root;
+    size_t count = slice.lines;
+    slice = RopeSlice();
+    lineIndex = min(lineIndex, m_totalLines);
+
+    if (m_totalLines == 0) {
+        deleteNode(root);
+        root = lines;
+    }
+    else if (lineIndex == 0) {
+        root = joinTrees(lines, root);
+    }
+    else if (lineIndex == m_totalLines) {
+        root = joinTrees(root, lines);
+    }
+    else {
+        RopeNode *head, *tail;
+        splitTree(root, lineIndex, head, tail);
+        root = joinTrees(joinTrees(head, lines), tail);
+    }
+    m_totalLines += count;
+
+    // 이어붙인 자리 양쪽과 떼어낼 때 잘린 slice 가장자리 경로 복구
+    if (lineIndex > 0) repairPath(lineIndex - 1);
+    repairPath(lineIndex);
+    repairPath(lineIndex + count - 1);
+    if (lineIndex + count < m_totalLines) repairPath(lineIndex + count);
+}
+
+// 다시 끼우지 않을 slice 해제
+void Rope::releaseLines(RopeSlice& slice) {
+    if (slice.root) releaseSubtree(slice.root);
+    slice = RopeSlice();
+}
+
+// [lineIndex, lineIndex + count) 라인을 떼어내서 to 위치로 옮긴다. (to는 떼어낸 뒤의 라인 번호)
+void Rope::moveLines(size_t lineIndex, size_t count, size_t to) {
+    // 짧은 한 줄은 복사해서 지우고 넣는 편이 경계 리프 두 개를 나누고 다시 잇는 것보다 싸다. (Alt+Up/Down 반복)
+    dropFinger();
+    noteLines(lineIndex, count, 0);
+    noteLines(to, 0, count);
+    if (count == 1 && lineIndex < m_totalLines) {
+        RopePath path;
+        size_t offset;
+        RopeLeaf* leaf = findResidentLeaf(lineIndex, offset, &path);
+        if (leaf->lineLen(offset) < LONG_LINE_MIN) {
+            std::wstring line(lineView(leaf, offset));
+            uint32_t wraps = leaf->lineWrap(offset); // 내용은 그대로이므로 워드랩 줄 수도 옮긴다. (넣은 라인은 0으로 시작)
+            m_viewLeaf = nullptr;
+            eraseLine(lineIndex);
+            size_t at = min(to, m_totalLines);
+            insertLine(at, line);
+            setLineWraps(at, wraps);
+            return;
+        }
+    }
+    RopeSlice slice = detachRange(lineIndex, count);
+    spliceRange(to, slice);
+}
+
+void Rope::insertMultiple(size_t lineIndex, const TextLines& lines, size_t first, size_t count) {
+    dropFinger();
+    noteLines(lineIndex, 0, count);
+    if (count == 0) return;
+    size_t insertIndex = min(lineIndex, m_totalLines);
+
+    // 삽입 지점의 리프를 나눠서 리프 경계를 만든다.
+    RopePath path;
+    size_t offset;
+    RopeLeaf* divLeaf = findLeaf(insertIndex, offset, &path);
+    if (offset > 0 && offset < divLeaf->lineCount()) {
+        ensureResident(divLeaf);
+        splitLeaf(divLeaf, path, offset);
+    }
+
+    // 라인들을 리프 버퍼에 이어붙이며 줄수/문자수 한도 단위로 리프 배열을 만든다.
+    std::vector<RopeLeaf*> newLeaves;
+    size_t newLines = 0;
+    RopeLeaf* addLeaf = allocLeaf();
+    for (size_t i = first; i < first + count; i++) {
+        leafInsertLine(addLeaf, addLeaf->lineCount(), lines.linePtr(i), lines.lineLen(i));
+
+        // 현재 리프 노드가 가득 찼는지 확인
+        if (addLeaf->lineCount() >= m_limits.splitLines || addLeaf->text.size >= m_limits.leafBytes) {
+            newLines += addLeaf->lineCount();
+            newLeaves.push_back(addLeaf);
+            addLeaf = allocLeaf();
+        }
+    }
+
+    // 마지막 리프 노드 처리
+    if (addLeaf->lineCount() > 0) {
+        newLines += addLeaf->lineCount();
+        newLeaves.push_back(addLeaf);
+    }
+    else {
+        deleteNode(addLeaf);
+    }
+
+    // 추가량이 기존 문서보다 적으면 경계에 리프를 차례로 삽입 (리프당 O(log n))
+    if (newLines < m_totalLines) {
+        size_t at = insertIndex;
+        for (RopeLeaf* leaf : newLeaves) {
+            m_totalLines += leaf->lineCount();
+            insertLeafAt(at, leaf);
+            at += leaf->lineCount();
+        }
+        return;
+    }
+
+    // 기존 문서 이상 크기면 기존 리프 사이에 새 리프를 끼운 배열로 트리를 다시 구성 (전체 리프 수에 선형)
+    std::vector<RopeLeaf*> leaves;
+    size_t lineAt = 0;
+    if (m_totalLines == 0) {
+        deleteNode(root); // 빈 루트 리프
+    }
+    else {
+        for (RopeLeaf* leaf = firstLeaf(); leaf; leaf = leaf->next) {
+            if (lineAt == insertIndex) leaves.insert(leaves.end(), newLeaves.begin(), newLeaves.end());
+            leaves.push_back(leaf);
+            lineAt += leaf->lineCount();
+        }
+        releaseInternals(root);
+    }
+    if (lineAt == insertIndex) {
+        leaves.insert(leaves.end(), newLeaves.begin(), newLeaves.end()); // 문서 끝에 추가
+    }
+    m_totalLines += newLines;
+    buildFromLeaves(leaves);
+}
+
+// 파일을 읽기 전용으로 매핑하고 줄바꿈만 세어서 원본 구간을 가리키는 리프들로 트리를 만든다.
+// 라인 디코딩은 리프가 처음 접근될 때 일어나고, 편집된 리프는 아레나 버퍼로 옮겨진다.
+// 큰 파일은 라인 경계에서 나눈 구간별로 작업 스레드가 줄바꿈을 검색하고, 모은 리프로 트리를 한 번에 구성한다.
+bool Rope::loadFile(const std::wstring& path) {
+    clear();
+    if (!m_source->open(path)) return false;
+
+    const uint8_t* data = m_source->view + m_source->dataStart;
+    size_t unit = m_source->unitSize();
+    size_t end = m_source->size - m_source->dataStart;
+    end -= end % unit;
+    if (end == 0) {
+        m_source->close();
+        insertLine(0, L"");
+        return true;
+    }
+
+    // 작업 구간 경계는 라인 시작 위치 (위치는 검색 단위 기준)
+    size_t units = end / unit;
+    size_t workers = min((size_t)std::thread::hardware_concurrency(), end / LOAD_CHUNK_MIN_BYTES);
+    std::vector<size_t> bounds(1, 0);
+    for (size_t k = 1; k < workers; k++) {
+        size_t at = sourceLineStart(units / workers * k, units);
+        if (at > bounds.back() && at < units) bounds.push_back(at);
+    }
+    bounds.push_back(units);
+
+    size_t parts = bounds.size() - 1;
+    std::vector<std::vector<SourceSpan>> spans(parts);
+    if (parts == 1) {
+        scanSourceSpans(0, units, spans[0]);
+    }
+    else {
+        std::vector<std::thread> threads;
+        threads.reserve(parts);
+        for (size_t k = 0; k < parts; k++) {
+            threads.emplace_back(&Rope::scanSourceSpans, this, bounds[k], bounds[k + 1], std::ref(spans[k]));
+        }
+        for (auto& t : threads) t.join();
+    }
+
+    // 리프 할당은 아레나를 쓰므로 작업 스레드가 끝난 뒤 한 스레드에서 처리
+    std::vector<RopeLeaf*> leaves;
+    for (const auto& part : spans) {
+        for (const auto& span : part) {
+            RopeLeaf* leaf = allocLeaf();
+            leaf->src = data + span.from;
+            leaf->srcBytes = span.bytes;
+            leaf->srcLines = span.lines;
+            leaf->chars = span.chars;
+            leaf->utf8 = span.utf8;
+            leaves.push_back(leaf);
+            m_totalLines += span.lines;
+        }
+    }
+
+    // 마지막 라인 (파일이 줄바꿈으로 끝나면 빈 라인)
+    if (leaves.back()->srcLines < m_limits.splitLines) {
+        leaves.back()->srcLines++;
+    }
+    else {
+        RopeLeaf* leaf = allocLeaf();
+        leaf->src = data + end;
+        leaf->srcLines = 1;
+        leaves.push_back(leaf);
+    }
+    m_totalLines++;
+
+    deleteNode(root);
+    buildFromLeaves(leaves);
+    return true;
+}
+
+size_t Rope::scanSource(size_t len, size_t from, size_t stopAt, size_t maxCount, std::vector<size_t>& breaks) const {
+    const uint8_t* data = m_source->view + m_source->dataStart;
+    if (m_source->unitSize() == 1) {
+        return LineScanner::scan(data, len, from, stopAt, maxCount, breaks);
+    }
+    return LineScanner::scan((const uint16_t*)data, len, from, stopAt, maxCount, breaks, m_source->encoding == RopeMappedFile::Utf16BE);
+}
+
+// pos - 1부터 검색하면 pos가 \r\n 사이여도 쌍을 통째로 건너뛴다.
+size_t Rope::sourceLineStart(size_t pos, size_t len) const {
+    if (pos == 0) return 0;
+    std::vector<size_t> breaks;
+    size_t next = scanSource(len, pos - 1, (size_t)-1, 1, breaks);
+    return breaks.empty() ? len : next;
+}
+
+// m_limits.splitLines 줄 또는 m_limits.leafBytes / 2 바이트마다 줄바꿈 직후에서 구간을 나눈다.
+// end는 라인 시작 위치이거나 본문 끝이어야 하고, 줄바꿈 없이 끝나는 나머지는 마지막 구간에 포함된다.
+void Rope::scanSourceSpans(size_t begin, size_t end, std::vector<SourceSpan>& spans) const {
+    size_t unit = m_source->unitSize();
+    size_t chunkUnits = m_limits.leafBytes / 2 / unit;
+    std::vector<size_t> breaks;
+    breaks.reserve(m_limits.splitLines);
+
+    size_t pos = begin;
+    while (pos < end) {
+        breaks.clear();
+        size_t stopAt = pos + chunkUnits;
+        size_t next = scanSource(end, pos, stopAt, m_limits.splitLines, breaks);
+        if (breaks.size() < m_limits.splitLines && next < stopAt) next = end; // 구간 끝까지 더 이상 줄바꿈 없음
+        SourceSpan span = { pos * unit, (next - pos) * unit, breaks.size(), 0, 0 };
+        measureSource(m_source->view + m_source->dataStart + span.from, span.bytes, span.chars, span.utf8);
+        spans.push_back(span);
+        pos = next;
+    }
+}
+
+// ensureResident가 만들 라인들의 크기를 디코딩 없이 센다. (\r, \n은 모두 줄바꿈이므로 제외)
+// UTF-16과 올바른 UTF-8은 원본에서 바로 세고, 코드페이지나 잘못된 UTF-8(대체 문자로 바뀜)은 실제로 디코딩해서 센다.
+void Rope::measureSource(const uint8_t* src, size_t bytes, size_t& chars, size_t& utf8) const {
+    chars = utf8 = 0;
+    if (m_source->unitSize() == 2) {
+        int hi = (m_source->encoding == RopeMappedFile::Utf16BE) ? 0 : 1;
+        for (size_t i = 0; i + 1 < bytes; i += 2) {
+            wchar_t c = (wchar_t)((src[i + hi] << 8) | src[i + 1 - hi]);
+            if (c == L'\r' || c == L'\n') continue;
+            chars++;
+            utf8 += utf8Size(c);
+        }
+        return;
+    }
+
+    if (m_source->encoding == RopeMappedFile::Utf8) {
+        size_t i = 0;
+        while (i < bytes) {
+            uint8_t c = src[i];
+            size_t follow;
+            uint8_t lo = 0x80, hi = 0xBF; // 두 번째 바이트 범위 (과잉 표현, 서로게이트, 범위 초과 제외)
+            if (c < 0x80) {
+                if (c != '\r' && c != '\n') { chars++; utf8++; }
+                i++;
+                continue;
+            }
+            else if (c >= 0xC2 && c <= 0xDF) follow = 1;
+            else if (c >= 0xE0 && c <= 0xEF) { follow = 2; if (c == 0xE0) lo = 0xA0; if (c == 0xED) hi = 0x9F; }
+            else if (c >= 0xF0 && c <= 0xF4) { follow = 3; if (c == 0xF0) lo = 0x90; if (c == 0xF4) hi = 0x8F; }
+            else break;
+
+            if (i + follow >= bytes || src[i + 1] < lo || src[i + 1] > hi) break;
+            size_t k = 2;
+            while (k <= follow && (src[i + k] & 0xC0) == 0x80) k++;
+            if (k <= follow) break;
+
+            chars += (follow == 3) ? 2 : 1; // 4바이트 문자는 서로게이트 쌍
+            utf8 += follow + 1;
+            i += follow + 1;
+        }
+        if (i == bytes) return;
+        chars = utf8 = 0;
+    }
+
+    std::wstring text;
+    m_source->decode(src, bytes, text);
+    for (wchar_t c : text) {
+        if (c == L'\r' || c == L'\n') continue;
+        chars++;
+        utf8 += utf8Size(c);
+    }
+}
+
+// ---------------------------------------------------
+// RopeLongLine
+// ---------------------------------------------------
+// 펜윅 트리의 i번째 값은 청크 (i - (i & -i), i] 구간의 합 (1부터)
+size_t RopeLongLine::findChunk(size_t column, size_t& pos) const {
+    size_t cnt = chunks.size;
+    if (column >= chars) {
+        pos = cnt ? chunks[cnt - 1].len() : 0;
+        return cnt ? cnt - 1 : 0;
+    }
+
+    // 누적 문자 수가 column 이하인 가장 긴 청크 구간을 큰 단위부터 찾는다.
+    size_t idx = 0;
+    size_t step = 1;
+    while (step * 2 <= cnt) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (idx + step <= cnt && charIndex[idx + step] <= column) {
+            idx += step;
+            column -= charIndex[idx];
+        }
+    }
+    pos = column;
+    return idx;
+}
+
+size_t RopeLongLine::utf8Before(size_t column) const {
+    if (column >= chars) return utf8;
+
+    size_t pos;
+    size_t c = findChunk(column, pos);
+    size_t bytes = 0;
+    for (size_t i = c; i > 0; i -= i & (0 - i)) bytes += utf8Index[i]; // 앞쪽 c개 청크의 합
+    const RopeChunk& ch = chunks[c];
+    return bytes + Rope::utf8Size(ch.text.ptr, pos, ch.shift);
+}
+
+size_t RopeLongLine::columnAt(size_t bytes) const {
+    if (bytes >= utf8) return chars;
+
+    size_t cnt = chunks.size;
+    size_t idx = 0, column = 0;
+    size_t step = 1;
+    while (step * 2 <= cnt) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (idx + step <= cnt && utf8Index[idx + step] <= bytes) {
+            idx += step;
+            bytes -= utf8Index[idx];
+            column += charIndex[idx];
+        }
+    }
+
+    const RopeChunk& ch = chunks[idx];
+    for (size_t i = 0; i < ch.len(); i++, column++) {
+        size_t charBytes = Rope::utf8Size(Rope::charAt(ch.text.ptr, i, ch.shift));
+        if (charBytes > bytes) break;
+        bytes -= charBytes;
+    }
+    return column;
+}
+
+void RopeLongLine::append(std::wstring& out, size_t from, size_t cnt) const {
+    size_t pos = out.size();
+    out.resize(pos + cnt);
+    if (cnt == 0) return;
+
+    size_t at;
+    size_t c = findChunk(from, at);
+    while (cnt > 0) {
+        const RopeChunk& ch = chunks[c++];
+        size_t n = min(cnt, ch.len() - at);
+        if (ch.shift) {
+            memcpy(&out[pos], ch.text.ptr + (at << WIDE_CHAR_SHIFT), n << WIDE_CHAR_SHIFT);
+        }
+        else {
+            for (size_t i = 0; i < n; i++) out[pos + i] = ch.text.ptr[at + i];
+        }
+        pos += n;
+        cnt -= n;
+        at = 0;
+    }
+}
+
+void RopeLongLine::addIndex(size_t chunk, size_t charDiff, size_t utf8Diff) {
+    chars += charDiff;
+    utf8 += utf8Diff;
+    for (size_t i = chunk + 1; i < charIndex.size; i += i & (0 - i)) {
+        charIndex[i] += charDiff;
+        utf8Index[i] += utf8Diff;
+    }
+}
+
+void RopeLongLine::rebuildIndex(RopeArena& arena) {
+    size_t cnt = chunks.size;
+    charIndex.reserve(arena, cnt + 1);
+    utf8Index.reserve(arena, cnt + 1);
+    charIndex.size = utf8Index.size = cnt + 1;
+    charIndex[0] = utf8Index[0] = 0;
+    chars = utf8 = 0;
+    for (size_t i = 1; i <= cnt; i++) {
+        charIndex[i] = chunks[i - 1].len();
+        utf8Index[i] = chunks[i - 1].utf8;
+        chars += charIndex[i];
+        utf8 += utf8Index[i];
+    }
+    for (size_t i = 1; i <= cnt; i++) {
+        size_t parent = i + (i & (0 - i));
+        if (parent <= cnt) {
+            charIndex[parent] += charIndex[i];
+            utf8Index[parent] += utf8Index[i];
+        }
+    }
+}
+
+// ---------------------------------------------------
+// RopeAtom : 반복되는 라인의 공유 버퍼
+// ---------------------------------------------------
+// 나누면 절반씩 남으므로 합치는 기준(절반)이 나누는 기준보다 작아야 나누자마자 다시 합치지 않는다.
+void Rope::setLimits(const RopeLimits& limits) {
+    m_limits.splitLines = max(limits.splitLines, (size_t)2);
+    m_limits.mergeLines = min(limits.mergeLines, m_limits.splitLines);
+    m_limits.leafBytes = min(max(limits.leafBytes, (size_t)64), (size_t)UINT32_MAX / 2); // 라인 끝 위치가 uint32_t
+}
+
+void Rope::setLineInterning(bool enable) {
+    m_interning = enable;
+    if (enable && m_atomTable.empty()) {
+        m_atomTable.assign(1024, nullptr);
+        m_seenHash.assign((size_t)1 << ATOM_SEEN_BITS, 0);
+    }
+    // 끄더라도 이미 공유 중인 라인은 그대로 두므로 표는 유지한다.
+}
+
+// FNV-1a (문자 단위)
+uint32_t Rope::hashChars(const wchar_t* str, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint32_t)str[i]) * 16777619u;
+    }
+    return h;
+}
+
+// 처음 나온 라인은 해시만 기억하고 리프 버퍼에 두므로, 한 번만 나오는 라인은 공유 버퍼를 만드는 비용이 없다.
+RopeAtom* Rope::internLine(const wchar_t* str, size_t len, uint8_t shift) {
+    uint32_t h = hashChars(str, len);
+    for (RopeAtom* atom = m_atomTable[h & (m_atomTable.size() - 1)]; atom; atom = atom->next) {
+        if (atom->hash != h || atom->chars != len || atom->shift != shift) continue;
+        const uint8_t* data = atom->data();
+        size_t i = 0;
+        while (i < len && charAt(data, i, shift) == str[i]) i++;
+        if (i == len) {
+            retainAtom(atom);
+            return atom;
+        }
+    }
+
+    uint32_t& seen = m_seenHash[(h * 2654435761u) >> (32 - ATOM_SEEN_BITS)];
+    if (seen != h) {
+        seen = h;
+        return nullptr;
+    }
+
+    size_t bytes = len << shift;
+    RopeAtom* atom = static_cast<RopeAtom*>(m_arena.allocate(sizeof(RopeAtom) + bytes));
+    atom->hash = h;
+    atom->refs = 0;
+    atom->chars = (uint32_t)len;
+    atom->utf8 = (uint32_t)utf8Size(str, len);
+    atom->shift = shift;
+    encodeChars(const_cast<uint8_t*>(atom->data()), str, len, shift);
+    m_internStats.atoms++;
+    m_internStats.storedBytes += sizeof(RopeAtom) + bytes;
+
+    if (m_internStats.atoms > m_atomTable.size()) {
+        // 버킷을 두 배로 늘리고 다시 나눔
+        std::vector<RopeAtom*> table(m_atomTable.size() * 2, nullptr);
+        for (RopeAtom* head : m_atomTable) {
+            while (head) {
+                RopeAtom* next = head->next;
+                RopeAtom*& bucket = table[head->hash & (table.size() - 1)];
+                head->next = bucket;
+                bucket = head;
+                head = next;
+            }
+        }
+        m_atomTable.swap(table);
+    }
+    RopeAtom*& bucket = m_atomTable[h & (m_atomTable.size() - 1)];
+    atom->next = bucket;
+    bucket = atom;
+    retainAtom(atom);
+    return atom;
+}
+
+void Rope::retainAtom(RopeAtom* atom) {
+    atom->refs++;
+    m_internStats.refs++;
+    m_internStats.lineBytes += atom->bytes();
+    m_internStats.storedBytes += sizeof(RopeAtom*);
+}
+
+void Rope::releaseAtom(RopeAtom* atom) {
+    m_internStats.refs--;
+    m_internStats.lineBytes -= atom->bytes();
+    m_internStats.storedBytes -= sizeof(RopeAtom*);
+    if (--atom->refs > 0) return;
+
+    RopeAtom** link = &m_atomTable[atom->hash & (m_atomTable.size() - 1)];
+    while (*link != atom) link = &(*link)->next;
+    *link = atom->next;
+    m_internStats.atoms--;
+    m_internStats.storedBytes -= sizeof(RopeAtom) + atom->bytes();
+    m_arena.release(atom, sizeof(RopeAtom) + atom->bytes());
+}
+
+// ---------------------------------------------------
+// 화면 줄 색인 : 라인별 워드랩 줄 수를 서브트리 크기에 합산
+// ---------------------------------------------------
+// 화면을 그리면서 라인마다 부르므로 값이 같으면 아무것도 고치지 않고, 다르면 리프와 경로의 크기만 고친다.
+// 경로를 복사하지 않으므로 스냅샷과 공유 중인 노드도 그 자리에서 고친다. (스냅샷은 lines, chars, utf8만 읽음)
+void Rope::setLineWraps(size_t lineIndex, size_t wraps) {
+    if (lineIndex >= m_totalLines) return;
+
+    RopePath path;
+    size_t idx = lineIndex;
+    RopeNode* node = root;
+    while (!node->isLeaf) {
+        RopeInternal* in = static_cast<RopeInternal*>(node);
+        int i = 0;
+        while (i < in->count - 1 && idx >= in->weight[i].lines) {
+            idx -= in->weight[i].lines;
+            i++;
+        }
+        path.node[path.depth] = in;
+        path.slot[path.depth] = i;
+        path.depth++;
+        node = in->child[i];
+    }
+
+    RopeLeaf* leaf = static_cast<RopeLeaf*>(node);
+    uint32_t count = (uint32_t)min(wraps, (size_t)UINT32_MAX);
+    if (leaf->lineWrap(idx) == count) return;
+
+    leafFillWraps(leaf);
+    size_t diff = (size_t)count - leaf->lineWraps[idx]; // 줄어들면 부호 없는 뺄셈으로 넘어가도 더할 때 맞음
+    leaf->lineWraps[idx] = count;
+    leaf->wraps += diff;
+    // addWeight는 lines, chars, utf8에도 0을 더해 쓰므로 스냅샷이 읽는 필드를 건드리지 않도록 wraps만 고친다.
+    for (int i = 0; i < path.depth; i++) {
+        path.node[i]->weight[path.slot[i]].wraps += diff;
+    }
+}
+
+void Rope::clearWraps() {
+    clearSubtreeWraps(root);
+}
+
+// 워드랩이 없는 라인만 기록한 리프도 표시를 지워야 하므로 워드랩 줄 수가 0인 서브트리도 내려간다.
+void Rope::clearSubtreeWraps(RopeNode* node) {
+    if (node->isLeaf) {
+        RopeLeaf* leaf = static_cast<RopeLeaf*>(node);
+        leaf->lineWraps.free(m_arena);
+        leaf->wraps = 0;
+        leaf->wrapsSet = false;
+        return;
+    }
+    RopeInternal* in = static_cast<RopeInternal*>(node);
+    for (int i = 0; i < in->count; i++) {
+        clearSubtreeWraps(in->child[i]);
+        in->weight[i].wraps = 0;
+    }
+}
+
+// 이웃한 리프끼리 묶되 maxLines를 넘기기 전에 끊는다. (리프 하나가 maxLines보다 크면 그 리프만으로 한 구간)
+void Rope::getUnwrappedRanges(size_t maxLines, std::vector<std::pair<size_t, size_t>>& ranges) {
+    ranges.clear();
+    size_t line = 0;
+    for (RopeLeaf* leaf = firstLeaf(); leaf; leaf = leaf->next) {
+        size_t cnt = leaf->lineCount();
+        if (!leaf->wrapsSet && cnt) {
+            if (!ranges.empty() && ranges.back().first + ranges.back().second == line && ranges.back().second + cnt <= maxLines) {
+                ranges.back().second += cnt;
+            }
+            else {
+                ranges.emplace_back(line, cnt);
+            }
+        }
+        line += cnt;
+    }
+}
+
+// 스냅샷과 같은 리프 객체가 아직 트리에 있으면 내용도 그대로이므로 (고친 리프는 복사본으로 바뀜) 그 리프의 현재 위치에 기록한다.
+// 스냅샷 이후에 라인 위치가 바뀌었으면 현재 리프들의 첫 라인 번호를 한 번 모아서 찾는다.
+// 고치지 않았어도 읽으면서 푼 공유 리프는 복사본으로 바뀌므로 건너뛴 리프 수를 돌려준다.
+size_t Rope::setSnapshotWraps(const RopeSnapshot& snap, const std::vector<RopeWrapBlock>& blocks) {
+    size_t skipped = 0;
+    bool moved = snap.m_edits != m_editCount;
+    std::unordered_map<const RopeLeaf*, size_t> leafLines;
+    if (moved) {
+        size_t line = 0;
+        for (RopeLeaf* leaf = firstLeaf(); leaf; leaf = leaf->next) {
+            leafLines[leaf] = line;
+            line += leaf->lineCount();
+        }
+    }
+
+    for (const RopeWrapBlock& block : blocks) {
+        auto wraps = block.wraps.begin();
+        size_t end = min(block.first + block.count, snap.m_totalLines);
+        size_t line = block.first;
+        while (line < end) {
+            size_t offset;
+            const RopeLeaf* leaf = snap.findLeaf(line, offset);
+            size_t snapStart = line - offset;
+            size_t next = snapStart + leaf->lineCount();
+            if (next <= line) break;
+
+            // 현재 트리에서 같은 리프의 첫 라인
+            RopeLeaf* live = nullptr;
+            size_t start = snapStart;
+            if (!moved) {
+                size_t liveOffset;
+                if (findLeaf(snapStart, liveOffset) == leaf) live = const_cast<RopeLeaf*>(leaf);
+            }
+            else {
+                auto it = leafLines.find(leaf);
+                if (it != leafLines.end()) {
+                    live = const_cast<RopeLeaf*>(leaf);
+                    start = it->second;
+                }
+            }
+
+            for (; wraps != block.wraps.end() && wraps->first < next; ++wraps) {
+                if (live && wraps->first >= line) setLineWraps(start + (wraps->first - snapStart), wraps->second);
+            }
+            if (!live) skipped++;
+            else if (offset == 0 && next <= end) live->wrapsSet = true;
+            line = next;
+        }
+    }
+    return skipped;
+}
+
+size_t Rope::getRowCount() {
+    return m_totalLines + (root->isLeaf ? static_cast<RopeLeaf*>(root)->wraps : static_cast<RopeInternal*>(root)->total().wraps);
+}
+
+// 왼쪽 형제 서브트리의 화면 줄 수(lines + wraps)를 더하며 내려가고, 리프 안에서는 앞 라인들을 직접 센다.
+size_t Rope::rowFromLine(size_t lineIndex) {
+    if (lineIndex >= m_totalLines) return getRowCount();
+
+    size_t row = 0;
+    size_t idx = lineIndex;
+    RopeNode* node = root;
+    while (!node->isLeaf) {
+        RopeInternal* in = static_cast<RopeInternal*>(node);
+        int i = 0;
+        while (i < in->count - 1 && idx >= in->weight[i].lines) {
+            idx -= in->weight[i].lines;
+            row += in->weight[i].lines + in->weight[i].wraps;
+            i++;
+        }
+        node = in->child[i];
+    }
+
+    const RopeLeaf* leaf = static_cast<const RopeLeaf*>(node);
+    row += idx;
+    for (size_t i = 0; i < idx && leaf->lineWraps.size; i++) {
+        row += leaf->lineWraps[i];
+    }
+    return row;
+}
+
+size_t Rope::lineFromRow(size_t row, size_t& wrapRow) {
+    wrapRow = 0;
+    if (m_totalLines == 0) return 0;
+
+    size_t lineIndex = 0;
+    RopeNode* node = root;
+    while (!node->isLeaf) {
+        RopeInternal* in = static_cast<RopeInternal*>(node);
+        int i = 0;
+        while (i < in->count - 1) {
+            size_t rows = in->weight[i].lines + in->weight[i].wraps;
+            if (row < rows) break;
+            row -= rows;
+            lineIndex += in->weight[i].lines;
+            i++;
+        }
+        node = in->child[i];
+    }
+
+    const RopeLeaf* leaf = static_cast<const RopeLeaf*>(node);
+    size_t cnt = leaf->lineCount();
+    for (size_t i = 0; i < cnt; i++, lineIndex++) {
+        size_t rows = 1 + leaf->lineWrap(i);
+        if (row < rows || i + 1 == cnt) {
+            wrapRow = min(row, rows - 1);
+            return lineIndex;
+        }
+        row -= rows;
+    }
+    return lineIndex;
+}
+
+#ifdef NEMO_ROPE_TESTS
+// ---------------------------------------------------
+// 로프 시험 : 작은 리프 한도로 나누기/합치기가 자주 일어나게 하고, 연산마다 라인 배열 모델과 비교한다.
+// ---------------------------------------------------
+#include <ostream>
+
+static bool RopeCheck(std::wostream& out, bool ok, const wchar_t* name) {
+    if (!ok) out << L"  FAILED " << name << L"\n";
+    return ok;
+}
+
+// 시험용 의사 난수 (실행마다 같은 순서)
+struct RopeTestRandom {
+    uint64_t state;
+    explicit RopeTestRandom(uint64_t seed) : state(seed) {}
+    size_t next(size_t n) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return n ? (size_t)(state >> 33) % n : 0;
+    }
+};
+
+// 라인 배열 모델 : 라인 내용과, 넣거나 고친 라인마다 새로 붙이는 번호 (mapLine이 옮긴 번호가 같은 라인인지 확인)
+struct RopeTestModel {
+    std::vector<std::wstring> lines;
+    std::vector<size_t> ids;
+    size_t nextId = 0;
+
+    void insert(size_t at, const std::wstring& text) {
+        lines.insert(lines.begin() + at, text);
+        ids.insert(ids.begin() + at, nextId++);
+    }
+    void erase(size_t at, size_t count) {
+        lines.erase(lines.begin() + at, lines.begin() + at + count);
+        ids.erase(ids.begin() + at, ids.begin() + at + count);
+    }
+    void touch(size_t at) { ids[at] = nextId++; }
+    std::wstring text() const {
+        std::wstring all;
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (i) all += L"\r\n";
+            all += lines[i];
+        }
+        return all;
+    }
+};
+
+// 앞 n 문자의 UTF-8 바이트 수 (서로게이트는 한쪽당 2바이트, Rope::utf8Size와 같은 규칙)
+static size_t RopeTestUtf8(const std::wstring& s, size_t n) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        wchar_t c = s[i];
+        bytes += c < 0x80 ? 1 : (c < 0x800 || (c >= 0xD800 && c <= 0xDFFF)) ? 2 : 3;
+    }
+    return bytes;
+}
+
+// ASCII, Latin-1, 한글, 탭, 서로게이트 쌍이 섞인 라인 (셋 중 하나는 반복되는 라인이라 공유 대상)
+static std::wstring RopeTestLine(RopeTestRandom& rnd) {
+    static const wchar_t* repeated[] = { L"", L"2024-05-01 INFO request done", L"한글로 쓴 반복 라인입니다", L"caf\x00E9 \xD83D\xDE00 emoji line" };
+    if (rnd.next(3) == 0) return repeated[rnd.next(4)];
+    std::wstring s;
+    size_t n = rnd.next(48);
+    for (size_t i = 0; i < n; i++) {
+        size_t kind = rnd.next(12);
+        if (kind < 7) s += (wchar_t)(L'a' + rnd.next(26));
+        else if (kind < 9) s += (wchar_t)(0xAC00 + rnd.next(200));
+        else if (kind < 10) s += L'\t';
+        else if (kind < 11) s += (wchar_t)(0xC0 + rnd.next(64));
+        else { s += (wchar_t)0xD83D; s += (wchar_t)(0xDE00 + rnd.next(64)); }
+    }
+    return s;
+}
+
+// 라인, 라인 크기, 전체 크기, 커서 순회, 전체 텍스트를 모델과 비교
+static bool RopeMatches(Rope& rope, const RopeTestModel& model) {
+    if (rope.getSize() != model.lines.size() || rope.empty() != model.lines.empty()) return false;
+    size_t chars = 0, utf8 = 0;
+    for (size_t i = 0; i < model.lines.size(); i++) {
+        const std::wstring& line = model.lines[i];
+        if (rope.getLineSize(i) != line.size() || rope.getLineView(i) != line) return false;
+        chars += line.size();
+        utf8 += RopeTestUtf8(line, line.size());
+    }
+    if (rope.getCharCount() != chars || rope.getUtf8Size() != utf8) return false;
+    if (!model.lines.empty()) {
+        RopeCursor cursor = rope.cursorAt(0);
+        size_t i = 0;
+        do {
+            if (i >= model.lines.size() || rope.getLine(cursor) != model.lines[i]) return false;
+            i++;
+        } while (rope.next(cursor));
+        if (i != model.lines.size()) return false;
+    }
+    return rope.getText() == model.text();
+}
+
+// 라인마다 임의의 열에서 오프셋 <-> 위치 변환 (문자 단위 + \r\n, UTF-8 단위 + \n)
+static bool RopeOffsetsMatch(Rope& rope, const RopeTestModel& model, RopeTestRandom& rnd) {
+    size_t chars = 0, utf8 = 0;
+    for (size_t i = 0; i < model.lines.size(); i++) {
+        const std::wstring& line = model.lines[i];
+        size_t column = rnd.next(line.size() + 1);
+        if (column && column < line.size() && line[column] >= 0xDC00 && line[column] <= 0xDFFF) column--; // 서로게이트 쌍 가운데는 피함
+        size_t prefix8 = RopeTestUtf8(line, column);
+        if (rope.offsetFromPos(i, column) != chars + column) return false;
+        if (rope.offsetFromPos(i, column, Rope::Utf8Bytes, 1) != utf8 + prefix8) return false;
+        size_t lineIndex, col;
+        rope.posFromOffset(chars + column, lineIndex, col);
+        if (lineIndex != i || col != column) return false;
+        rope.posFromOffset(utf8 + prefix8, lineIndex, col, Rope::Utf8Bytes, 1);
+        if (lineIndex != i || col != column) return false;
+        chars += line.size() + 2;
+        utf8 += RopeTestUtf8(line, line.size()) + 1;
+    }
+    return true;
+}
+
+// since 이후 옮긴 라인 번호가 모델에서도 같은 라인인지, 고치지 않고 남은 라인은 모두 옮겨지는지
+static bool RopeMapsLines(Rope& rope, const RopeTestModel& model, uint64_t since, const std::vector<size_t>& sinceIds, bool complete) {
+    std::unordered_map<size_t, size_t> where;
+    for (size_t i = 0; i < model.ids.size(); i++) where[model.ids[i]] = i;
+    for (size_t i = 0; i < sinceIds.size(); i++) {
+        size_t line = i;
+        bool mapped = rope.mapLine(since, line);
+        auto it = where.find(sinceIds[i]);
+        if (mapped && (it == where.end() || it->second != line)) return false;
+        if (!mapped && complete && it != where.end()) return false;
+    }
+    return true;
+}
+
+// 한 번에 여러 라인을 넣는 텍스트 (\r\n, \n, \r 섞음, 빈 라인 양쪽은 \r + \n이 한 줄바꿈으로 읽히지 않도록 \r\n)
+static std::wstring RopeTestChunk(RopeTestRandom& rnd, std::vector<std::wstring>& parts) {
+    static const wchar_t* breaks[] = { L"\r\n", L"\n", L"\r" };
+    std::wstring chunk;
+    size_t count = 1 + rnd.next(12);
+    for (size_t i = 0; i < count; i++) {
+        parts.push_back(RopeTestLine(rnd));
+        if (i) chunk += (parts[i - 1].empty() || parts[i].empty()) ? breaks[0] : breaks[rnd.next(3)];
+        chunk += parts.back();
+    }
+    return chunk;
+}
+
+// 임의 편집 steps번 : 연산마다 모델과 비교하고, 16번마다 기준을 바꿔 mapLine, 64번마다 스냅샷이 그 시점 내용을 유지하는지 확인
+static bool RopeRandomEdits(std::wostream& out, Rope& rope, RopeTestModel& model, uint64_t seed, size_t steps, size_t checkEvery) {
+    static const wchar_t* opNames[] = { L"random insert", L"random insertAt", L"random eraseAt", L"random update", L"random erase",
+        L"random splitLine", L"random mergeLine", L"random eraseRange", L"random moveLines", L"random detach/splice",
+        L"random insertMultiple", L"random insertBack" };
+    RopeTestRandom rnd(seed);
+    uint64_t since = rope.getEditCount();
+    std::vector<size_t> sinceIds = model.ids;
+    std::shared_ptr<const RopeSnapshot> snap = rope.snapshot();
+    RopeTestModel snapModel = model;
+    bool ok = true;
+    for (size_t step = 0; step < steps && ok; step++) {
+        size_t n = model.lines.size();
+        size_t op = n ? rnd.next(12) : 0;
+        size_t line = rnd.next(n);
+        switch (op) {
+        case 0: {
+            size_t at = rnd.next(n + 1);
+            std::wstring text = RopeTestLine(rnd);
+            rope.insert(at, text);
+            model.insert(at, text);
+            break;
+        }
+        case 1: {
+            std::wstring text = RopeTestLine(rnd);
+            size_t offset = rnd.next(model.lines[line].size() + 3);
+            rope.insertAt(line, offset, text);
+            model.lines[line].insert(min(offset, model.lines[line].size()), text);
+            model.touch(line);
+            break;
+        }
+        case 2: {
+            size_t offset = rnd.next(model.lines[line].size() + 1), count = rnd.next(8);
+            rope.eraseAt(line, offset, count);
+            if (offset < model.lines[line].size()) model.lines[line].erase(offset, count);
+            model.touch(line);
+            break;
+        }
+        case 3: {
+            std::wstring text = RopeTestLine(rnd);
+            rope.update(line, text);
+            model.lines[line] = text;
+            model.touch(line);
+            break;
+        }
+        case 4:
+            rope.erase(line);
+            model.erase(line, 1);
+            break;
+        case 5: {
+            size_t column = rnd.next(model.lines[line].size() + 2);
+            rope.splitLine(line, column);
+            column = min(column, model.lines[line].size());
+            std::wstring tail = model.lines[line].substr(column);
+            model.lines[line].resize(column);
+            model.touch(line);
+            model.insert(line + 1, tail);
+            break;
+        }
+        case 6:
+            if (line + 1 >= n) break;
+            rope.mergeLine(line);
+            model.lines[line] += model.lines[line + 1];
+            model.erase(line + 1, 1);
+            model.touch(line);
+            break;
+        case 7: {
+            size_t count = 1 + rnd.next(rnd.next(4) ? 6 : 60);
+            rope.eraseRange(line, count);
+            model.erase(line, min(count, n - line));
+            break;
+        }
+        case 8:
+        case 9: {
+            size_t count = rnd.next(2) ? 1 : 1 + rnd.next(min(n - line, (size_t)40));
+            size_t to = rnd.next(n - count + 1);
+            std::vector<std::wstring> block(model.lines.begin() + line, model.lines.begin() + line + count);
+            model.erase(line, count);
+            if (op == 8) {
+                rope.moveLines(line, count, to);
+            }
+            else {
+                RopeSlice slice = rope.detachLines(line, count);
+                if (rnd.next(4) == 0) {
+                    rope.releaseLines(slice);
+                    break;
+                }
+                rope.spliceLines(to, slice);
+            }
+            for (size_t i = 0; i < count; i++) model.insert(to + i, block[i]); // 옮긴 라인은 mapLine이 옮기지 않으므로 새 번호
+            break;
+        }
+        case 10: {
+            std::vector<std::wstring> parts;
+            std::wstring chunk = RopeTestChunk(rnd, parts);
+            TextLines split;
+            split.text = chunk.data();
+            split.length = chunk.size();
+            LineScanner::scan(split.text, split.length, 0, split.length, (size_t)-1, split.breaks);
+            size_t first = rnd.next(parts.size()), count = 1 + rnd.next(parts.size() - first);
+            size_t at = rnd.next(n + 1);
+            rope.insertMultiple(at, split, first, count);
+            for (size_t i = 0; i < count; i++) model.insert(at + i, parts[first + i]);
+            break;
+        }
+        case 11: {
+            std::wstring text = RopeTestLine(rnd);
+            rope.insertBack(text);
+            model.insert(n, text);
+            break;
+        }
+        }
+        if (step % checkEvery == 0 || step + 1 == steps) {
+            ok &= RopeCheck(out, RopeMatches(rope, model), opNames[op]);
+            ok &= RopeCheck(out, RopeOffsetsMatch(rope, model, rnd), L"random offsets");
+        }
+        ok &= RopeCheck(out, RopeMapsLines(rope, model, since, sinceIds, true), L"random mapLine");
+        if (step % 16 == 15) {
+            since = rope.getEditCount();
+            sinceIds = model.ids;
+        }
+        if (step % 64 == 63) {
+            ok &= RopeCheck(out, snap->getSize() == snapModel.lines.size() && snap->getText() == snapModel.text(), L"snapshot keeps its text");
+            size_t probe = rnd.next(snapModel.lines.size());
+            ok &= RopeCheck(out, snapModel.lines.empty() || snap->getLine(probe) == snapModel.lines[probe], L"snapshot line");
+            snap = rope.snapshot();
+            snapModel = model;
+        }
+    }
+    return ok;
+}
+
+// 긴 라인 : 청크 경계에 걸친 편집, 구간 뷰, 나누고 다시 합치기
+static bool RopeLongLineTests(std::wostream& out) {
+    bool ok = true;
+    Rope rope;
+    RopeTestModel model;
+    std::wstring big;
+    for (size_t i = 0; i < LONG_LINE_MIN * 2 + 123; i++) big += (i % 7 == 0) ? (wchar_t)(0xAC00 + i % 50) : (wchar_t)(L'a' + i % 26);
+    rope.insert(0, L"head");
+    rope.insert(1, big);
+    rope.insert(2, L"tail");
+    model.insert(0, L"head");
+    model.insert(1, big);
+    model.insert(2, L"tail");
+    ok &= RopeCheck(out, RopeMatches(rope, model), L"long line insert");
+
+    rope.insertAt(1, LINE_CHUNK_CHARS + 5, L"XYZ");
+    model.lines[1].insert(LINE_CHUNK_CHARS + 5, L"XYZ");
+    rope.eraseAt(1, LINE_CHUNK_CHARS * 2 - 3, 10);
+    model.lines[1].erase(LINE_CHUNK_CHARS * 2 - 3, 10);
+    ok &= RopeCheck(out, RopeMatches(rope, model), L"long line edit across chunks");
+
+    const size_t windows[][2] = { { 0, 100 }, { LINE_CHUNK_CHARS - 10, 20 }, { LINE_CHUNK_CHARS * 3 - 1, 2 * LINE_CHUNK_CHARS }, { model.lines[1].size() - 5, 5 } };
+    for (const auto& w : windows) {
+        ok &= RopeCheck(out, rope.getLineView(1, w[0], w[1]) == std::wstring_view(model.lines[1]).substr(w[0], w[1]), L"long line window view");
+    }
+    RopeTestRandom rnd(7);
+    ok &= RopeCheck(out, RopeOffsetsMatch(rope, model, rnd), L"long line offsets");
+
+    size_t cut = LONG_LINE_MIN + 17;
+    rope.splitLine(1, cut);
+    model.insert(2, model.lines[1].substr(cut));
+    model.lines[1].resize(cut);
+    ok &= RopeCheck(out, RopeMatches(rope, model), L"long line split");
+    rope.mergeLine(1);
+    model.lines[1] += model.lines[2];
+    model.erase(2, 1);
+    ok &= RopeCheck(out, RopeMatches(rope, model), L"long line merge");
+
+    rope.eraseAt(1, 100, model.lines[1].size() - 200); // 짧아지면 다시 리프 버퍼로
+    model.lines[1].erase(100, model.lines[1].size() - 200);
+    ok &= RopeCheck(out, RopeMatches(rope, model), L"long line shrinks back");
+    return ok;
+}
+
+// 화면 줄 색인 : 워드랩 줄 수 합과 라인 <-> 화면 줄 변환 (고친 라인은 한 줄, 한 줄 이동은 줄 수를 옮김)
+static bool RopeRowsMatch(Rope& rope, const std::vector<size_t>& wraps) {
+    size_t rows = 0;
+    for (size_t i = 0; i < wraps.size(); i++) {
+        if (rope.rowFromLine(i) != rows) return false;
+        for (size_t k = 0; k <= wraps[i]; k++) {
+            size_t wrapRow;
+            if (rope.lineFromRow(rows + k, wrapRow) != i || wrapRow != k) return false;
+        }
+        rows += wraps[i] + 1;
+    }
+    size_t wrapRow;
+    return rope.getRowCount() == rows && (wraps.empty() || (rope.lineFromRow(rows + 5, wrapRow) == wraps.size() - 1 && wrapRow == wraps.back()));
+}
+
+static bool RopeWrapTests(std::wostream& out) {
+    bool ok = true;
+    Rope rope;
+    rope.setLimits({ 8, 4, 256 });
+    std::vector<size_t> wraps;
+    for (size_t i = 0; i < 60; i++) {
+        rope.insertBack(L"line " + std::wstring(i % 7 + 1, (wchar_t)(L'a' + i % 26)));
+        wraps.push_back(i % 4);
+    }
+    for (size_t i = 0; i < wraps.size(); i++) rope.setLineWraps(i, wraps[i]);
+    ok &= RopeCheck(out, RopeRowsMatch(rope, wraps), L"rows after setLineWraps");
+    rope.update(10, L"changed");
+    wraps[10] = 0;
+    rope.insert(5, L"new");
+    wraps.insert(wraps.begin() + 5, 0);
+    rope.erase(20);
+    wraps.erase(wraps.begin() + 20);
+    ok &= RopeCheck(out, RopeRowsMatch(rope, wraps), L"rows after edits");
+    rope.moveLines(3, 1, 30);
+    size_t moved = wraps[3];
+    wraps.erase(wraps.begin() + 3);
+    wraps.insert(wraps.begin() + 30, moved);
+    rope.moveLines(40, 12, 2);
+    std::vector<size_t> block(wraps.begin() + 40, wraps.begin() + 52);
+    wraps.erase(wraps.begin() + 40, wraps.begin() + 52);
+    wraps.insert(wraps.begin() + 2, block.begin(), block.end());
+    ok &= RopeCheck(out, RopeRowsMatch(rope, wraps), L"rows after moveLines");
+    rope.clearWraps();
+    std::fill(wraps.begin(), wraps.end(), 0);
+    ok &= RopeCheck(out, RopeRowsMatch(rope, wraps), L"rows after clearWraps");
+    return ok;
+}
+
+// mapLine : 같은 시점, 지운 라인, clear, 기록이 넘쳐서 잘린 경우
+static bool RopeMapLineTests(std::wostream& out) {
+    bool ok = true;
+    Rope rope;
+    for (int i = 0; i < 10; i++) rope.insertBack(L"line");
+    uint64_t start = rope.getEditCount();
+    size_t line = 7;
+    ok &= RopeCheck(out, rope.mapLine(start, line) && line == 7, L"mapLine without edits");
+    rope.insert(2, L"above");
+    rope.erase(9);
+    line = 7;
+    ok &= RopeCheck(out, rope.mapLine(start, line) && line == 8, L"mapLine shifts by inserted lines");
+    line = 8;
+    ok &= RopeCheck(out, !rope.mapLine(start, line), L"mapLine of erased line");
+    line = 1;
+    ok &= RopeCheck(out, rope.mapLine(start, line) && line == 1, L"mapLine above edits");
+
+    for (int i = 0; i < LINE_EDIT_LOG * 2; i++) rope.update(0, L"first");
+    line = 5;
+    ok &= RopeCheck(out, !rope.mapLine(start, line), L"mapLine after the log is trimmed");
+    uint64_t late = rope.getEditCount() - 10;
+    line = 5;
+    ok &= RopeCheck(out, rope.mapLine(late, line) && line == 5, L"mapLine of recent edits after trimming");
+
+    uint64_t beforeClear = rope.getEditCount();
+    rope.clear();
+    rope.insert(0, L"again");
+    line = 0;
+    ok &= RopeCheck(out, !rope.mapLine(beforeClear, line), L"mapLine across clear");
+    return ok;
+}
+
+// 압축, 스왑, 공유 모드에서의 임의 편집 (리프 버퍼가 PACK_MIN_BYTES를 넘도록 큰 리프 한도)
+static bool RopeModeTests(std::wostream& out) {
+    bool ok = true;
+    const wchar_t* names[] = { L"cold compression", L"swap", L"interning" };
+    for (int mode = 0; mode < 3; mode++) {
+        Rope rope;
+        RopeTestModel model;
+        rope.setLimits(mode == 2 ? RopeLimits{ 8, 4, 256 } : RopeLimits{ 64, 32, 4096 });
+        if (mode == 2) rope.setLineInterning(true);
+        RopeTestRandom rnd(100 + mode);
+        for (size_t i = 0; i < 2000; i++) {
+            std::wstring text = RopeTestLine(rnd);
+            rope.insertBack(text);
+            model.insert(i, text);
+        }
+        if (mode == 0) rope.setColdCompression(1);
+        if (mode == 1) rope.setSwapBudget(16 * 1024);
+        ok &= RopeCheck(out, RopeMatches(rope, model), names[mode]);
+        ok &= RopeRandomEdits(out, rope, model, 200 + mode, 600, 16);
+        if (mode == 0) ok &= RopeCheck(out, rope.getPackStats().packCount > 0 && rope.getPackStats().unpackCount > 0, L"cold compression packs leaves");
+        if (mode == 1) ok &= RopeCheck(out, rope.getSwapStats().swapOutCount > 0 && rope.getSwapStats().swapInCount > 0, L"swap writes and reads leaves");
+        if (mode == 2) ok &= RopeCheck(out, rope.getInternStats().refs > rope.getInternStats().atoms, L"interning shares repeated lines");
+    }
+    return ok;
+}
+
+// 임시 파일에 bytes를 쓰고 loadFile로 열어서 모델과 비교한 뒤, 디코딩 전 리프를 고쳐 봄
+static bool RopeLoadCase(std::wostream& out, const std::string& bytes, const std::vector<std::wstring>& expect, const wchar_t* name) {
+    wchar_t dir[MAX_PATH], path[MAX_PATH];
+    if (!GetTempPathW(MAX_PATH, dir) || !GetTempFileNameW(dir, L"nrt", 0, path)) return RopeCheck(out, false, name);
+    HANDLE file = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    DWORD written = 0;
+    bool ok = file != INVALID_HANDLE_VALUE && WriteFile(file, bytes.data(), (DWORD)bytes.size(), &written, NULL) && written == bytes.size();
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    if (ok) {
+        Rope rope;
+        rope.setLimits({ 8, 4, 256 });
+        RopeTestModel model;
+        for (size_t i = 0; i < expect.size(); i++) model.insert(i, expect[i]);
+        ok = rope.loadFile(path);
+        if (ok) {
+            std::shared_ptr<const RopeSnapshot> snap = rope.snapshot(); // 디코딩 전 리프를 스냅샷이 읽음
+            ok = snap->getText() == model.text();
+            size_t last = expect.size() - 1;
+            rope.insertAt(last, 0, L"edited ");
+            model.lines[last].insert(0, L"edited ");
+            rope.erase(0);
+            model.erase(0, 1);
+            RopeTestRandom rnd(3);
+            ok = ok && RopeMatches(rope, model) && RopeOffsetsMatch(rope, model, rnd);
+        }
+        rope.clear(); // 파일 매핑을 닫은 뒤 지움
+    }
+    DeleteFileW(path);
+    return RopeCheck(out, ok, name);
+}
+
+static bool RopeLoadTests(std::wostream& out) {
+    bool ok = true;
+    std::vector<std::wstring> expect = { L"\xCCAB \xC904", L"second", L"third", L"\xD83D\xDE00 emoji", L"" };
+    ok &= RopeLoadCase(out, "\xEF\xBB\xBF\xEC\xB2\xAB \xEC\xA4\x84\r\nsecond\nthird\r\xF0\x9F\x98\x80 emoji\r\n", expect, L"load UTF-8 with BOM");
+
+    std::string le = "\xFF\xFE", be = "\xFE\xFF";
+    const wchar_t* breaks[] = { L"\r\n", L"\n", L"\r", L"\r\n" };
+    for (size_t i = 0; i < expect.size(); i++) {
+        std::wstring unit = expect[i] + (i + 1 < expect.size() ? breaks[i] : L"");
+        for (wchar_t c : unit) {
+            le += (char)(c & 0xFF); le += (char)(c >> 8);
+            be += (char)(c >> 8); be += (char)(c & 0xFF);
+        }
+    }
+    ok &= RopeLoadCase(out, le, expect, L"load UTF-16LE");
+    ok &= RopeLoadCase(out, be, expect, L"load UTF-16BE");
+
+    // 리프 여러 개로 나뉘는 ASCII 파일 (코드페이지와 무관)
+    std::string ascii;
+    std::vector<std::wstring> lines;
+    for (int i = 0; i < 5000; i++) {
+        std::string line = "log line " + std::to_string(i) + " value " + std::to_string(i * 7919 % 1000);
+        ascii += line + "\n";
+        lines.push_back(std::wstring(line.begin(), line.end()));
+    }
+    lines.push_back(L"");
+    ok &= RopeLoadCase(out, ascii, lines, L"load ASCII in many leaves");
+    return ok;
+}
+
+bool RunRopeTests(std::wostream& out) {
+    bool ok = true;
+    {
+        // 작은 리프 한도 : 몇 줄마다 나누고 합침
+        Rope rope;
+        RopeTestModel model;
+        rope.setLimits({ 8, 4, 256 });
+        ok &= RopeCheck(out, RopeMatches(rope, model), L"empty rope");
+        ok &= RopeRandomEdits(out, rope, model, 1, 4000, 1);
+    }
+    {
+        // 기본 한도 : 큰 리프 안의 편집과 떼어내기/끼우기
+        Rope rope;
+        RopeTestModel model;
+        ok &= RopeRandomEdits(out, rope, model, 2, 2000, 4);
+    }
+    ok &= RopeLongLineTests(out);
+    ok &= RopeWrapTests(out);
+    ok &= RopeMapLineTests(out);
+    ok &= RopeModeTests(out);
+    ok &= RopeLoadTests(out);
+    out << L"[rope tests] " << (ok ? L"ok" : L"FAILED") << L"\n";
+    return ok;
+}
+#endif
@@ -0,0 +1,718 @@
+﻿//*******************************************************************************
+//    파     일     명 : NemoRope.h
+//    프로그램명칭 : 네모 에디터 컨트롤
+//    프로그램용도 : 라인 단위 B+트리 로프 ( 텍스트 저장, 스냅샷, 압축, 스왑, MFC 없이 빌드 )
+//
+//    작    성    자 : Daniel Heo ( https://github.com/Daniel-Heo/NemoEdit )
+//    라 이  센 스  : Dual License
+//                            If you are not a citizen of the Republic of Korea : AGPL 3.0 License
+//                            If you are a citizen of the Republic of Korea : MIT License
+//*******************************************************************************
+#pragma once
+#include <windows.h>   // 메모리 맵 파일, 스왑 파일 (MFC는 쓰지 않음)
+#include <list>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <iosfwd>
+
+#define SPLIT_THRESHOLD         2000 // 리프 최대 줄수 기본값 (RopeLimits로 문서마다 바꿀 수 있음)
+#define MERGE_THRESHOLD     1000 // 리프가 이 값의 절반보다 작아지면 이웃과 합침 (기본값)
+#ifndef NODE_FANOUT
+#define NODE_FANOUT         64   // B+트리 내부 노드의 최대 자식 수 (최소는 NODE_FANOUT/2, 비교할 때는 빌드 옵션으로 바꿈)
+#endif
+#define ROPE_MAX_DEPTH      32   // 탐색 경로 최대 깊이 (팬아웃 32 기준으로 32^32줄까지 충분)
+#define LEAF_MAX_BYTES      (128 * 1024) // 리프 버퍼 최대 바이트 수 (한 줄이 이보다 길면 그 줄만 단독 리프)
+#define WIDE_CHAR_SHIFT     1             // UTF-16 라인의 문자당 바이트 수 시프트 (sizeof(wchar_t) == 2)
+#define LONG_LINE_MIN       (64 * 1024)   // 이보다 긴 라인은 청크로 나눠 리프 밖에 저장 (절반 아래로 줄면 다시 리프 버퍼로)
+#define LINE_CHUNK_CHARS    (16 * 1024)   // 긴 라인 청크의 기준 문자 수 (2배를 넘으면 다시 나눔)
+#define LONG_LINE_SHIFT     0xFF          // 긴 라인 표식 (lineWide) : 라인 버퍼에는 RopeLongLine 포인터만 있음
+#define SHARED_LINE_SHIFT   0xFE          // 공유 라인 표식 (lineWide) : 라인 버퍼에는 RopeAtom 포인터만 있음
+#define ATOM_MIN_BYTES      16            // 인코딩한 크기가 이보다 작은 라인은 공유하지 않음 (포인터 크기 이상 줄어야 이득)
+#define ATOM_SEEN_BITS      16            // 한 번 나온 라인의 해시를 기억하는 표의 크기 (두 번째로 나올 때부터 공유)
+#define ARENA_SLAB_SIZE     (1024 * 1024) // 아레나가 한 번에 확보하는 슬랩 크기
+#define ARENA_SMALL_MAX     4096          // 16바이트 단위 크기 클래스로 관리하는 블록의 최대 크기
+#define ARENA_MEDIUM_MAX    (256 * 1024)  // 2의 거듭제곱 크기 클래스로 관리하는 블록의 최대 크기 (초과하면 개별 할당)
+#define LOAD_CHUNK_MIN_BYTES (16 * 1024 * 1024) // 파일 로드 시 작업 스레드 하나가 맡는 최소 바이트 (작은 파일은 단일 스레드)
+#define SNAPSHOT_SWEEP_MIN  256           // 스냅샷 때문에 해제를 미룬 노드가 이만큼 쌓이면 정리 (이후 남은 수의 2배마다)
+#define PACK_HOT_MIN        16            // 압축 모드에서 항상 풀어두는 최근 리프의 최소 수
+#define PACK_MIN_BYTES      1024          // 이보다 작은 리프 버퍼는 압축하지 않음
+#define PACK_HASH_BITS      12            // 압축기의 일치 검색 해시 테이블 크기 (2의 거듭제곱)
+#define SWAP_BLOCK          4096          // 스왑 파일 구간 할당 단위
+#define SWAP_FAIL           ((uint64_t)-1) // 스왑 파일 기록 실패
+#define LINE_EDIT_LOG       256           // 라인 번호를 옮길 수 있도록 남겨 두는 최근 수정 구간 수 (넘치면 오래된 절반을 버림)
+
+static_assert(sizeof(wchar_t) == (1 << WIDE_CHAR_SHIFT), "UTF-16 리프 버퍼는 wchar_t가 2바이트라고 가정한다 (wchar_t가 4바이트인 빌드는 지원하지 않음)");
+
+using namespace std;
+
+// 아레나 통계
+struct RopeArenaStats {
+    size_t slabCount = 0;   // 확보한 슬랩 수
+    size_t slabBytes = 0;   // 슬랩으로 확보한 전체 바이트
+    size_t largeCount = 0;  // 슬랩 밖에서 개별 할당한 큰 블록 수
+    size_t largeBytes = 0;  // 큰 블록 전체 바이트
+    size_t usedBytes = 0;   // 현재 사용 중인 바이트 (크기 클래스 기준)
+    size_t peakBytes = 0;   // 최대 사용 바이트
+    size_t allocCount = 0;  // 누적 할당 횟수
+    size_t reuseCount = 0;  // 프리리스트에서 재사용한 횟수
+    size_t resetCount = 0;  // 일괄 해제 횟수
+};
+
+// 차가운 리프 압축 통계
+struct RopePackStats {
+    size_t packedLeaves = 0;    // 현재 압축된 리프 수
+    size_t packedBytes = 0;     // 압축된 버퍼 전체 바이트
+    size_t rawBytes = 0;        // 압축된 리프들의 원래 버퍼 바이트
+    size_t packCount = 0;       // 누적 압축 횟수
+    size_t unpackCount = 0;     // 누적 압축 해제 횟수
+};
+
+// 스왑 통계
+struct RopeSwapStats {
+    size_t swappedLeaves = 0;   // 현재 스왑 파일에 있는 리프 수
+    size_t swapBytes = 0;       // 스왑된 리프들의 압축된 바이트
+    size_t fileBytes = 0;       // 스왑 파일 크기 (빈 구간 포함)
+    size_t residentBytes = 0;   // 최근 접근 목록에 있는 리프들의 버퍼 바이트 (예산과 비교하는 값, 근사)
+    size_t swapOutCount = 0;    // 누적 스왑 아웃 횟수
+    size_t swapInCount = 0;     // 누적 스왑 인 횟수
+};
+
+// 라인 공유 통계 (중복 제거율 : refs / atoms, 메모리 절약률 : lineBytes / storedBytes)
+struct RopeInternStats {
+    size_t atoms = 0;           // 공유 버퍼 수
+    size_t refs = 0;            // 공유 버퍼를 참조하는 라인 수
+    size_t lineBytes = 0;       // 참조하는 라인들을 각자 리프 버퍼에 두었을 때의 바이트
+    size_t storedBytes = 0;     // 공유 버퍼와 리프 버퍼의 포인터로 실제로 쓰는 바이트
+};
+
+// 리프 크기 한도 : 작은 편집이 잦은 문서는 작은 리프(복사/이동 비용이 적음), 큰 로그는 큰 리프(노드 수와 트리 깊이가 적음)를 쓰려는 것이다.
+// 두 프리셋의 값은 측정으로 고른 것이 아니다. MSVC로 빌드한 NemoBench::LimitsSweep 결과로 확인하기 전에는 기본값을 쓴다.
+// 내부 노드 팬아웃은 노드 안의 배열 크기라 NODE_FANOUT으로 고정한다.
+struct RopeLimits {
+    size_t splitLines = SPLIT_THRESHOLD;    // 리프 최대 줄수 (넘으면 나눔)
+    size_t mergeLines = MERGE_THRESHOLD;    // 리프가 이 값의 절반보다 작아지면 이웃과 합침
+    size_t leafBytes = LEAF_MAX_BYTES;      // 리프 버퍼 최대 바이트 수 (4분의 1보다 작아지면 이웃과 합침)
+
+    static RopeLimits smallEdits() { return { 256, 128, 16 * 1024 }; }     // 짧은 문서를 자주 고칠 때
+    static RopeLimits hugeLogs() { return { 8000, 4000, 512 * 1024 }; }    // 수백 MB 로그를 읽고 끝에만 덧붙일 때
+};
+
+// 문서 단위 아레나 : 노드와 리프 버퍼를 슬랩에서 크기 클래스별로 잘라 쓰고, 해제된 블록은 프리리스트로 재사용
+// reset()은 개별 블록을 따라가지 않고 슬랩 단위로 한 번에 반환한다.
+class RopeArena {
+private:
+    struct FreeBlock { FreeBlock* next; };
+    struct alignas(16) LargeBlock { LargeBlock* prev; LargeBlock* next; size_t bytes; }; // 큰 블록 헤더 (데이터는 헤더 뒤)
+
+    std::vector<char*> m_slabs;     // 확보한 슬랩들
+    char* m_slabPos;                // 현재 슬랩의 할당 위치
+    size_t m_slabLeft;              // 현재 슬랩의 남은 바이트
+    FreeBlock* m_smallFree[ARENA_SMALL_MAX / 16 + 1];   // 16바이트 단위 프리리스트
+    FreeBlock* m_mediumFree[32];    // 2의 거듭제곱 단위 프리리스트
+    LargeBlock* m_large;            // 개별 할당한 큰 블록 목록
+    RopeArenaStats m_stats;
+
+    static size_t roundSize(size_t bytes); // 크기 클래스로 올림
+    FreeBlock*& freeList(size_t roundedBytes); // 크기 클래스의 프리리스트
+
+public:
+    RopeArena();
+    ~RopeArena();
+    RopeArena(const RopeArena&) = delete;
+    RopeArena& operator=(const RopeArena&) = delete;
+
+    void* allocate(size_t bytes, size_t* capacity = nullptr); // capacity : 실제 사용 가능한 크기
+    void release(void* p, size_t bytes); // allocate에 요청했던 크기나 capacity로 반환
+    void reset(); // 전체 일괄 해제
+    RopeArenaStats getStats() const { return m_stats; }
+};
+
+// 아레나에서 할당받는 POD 가변 배열 : 소멸자가 없으므로 아레나 일괄 해제로 정리된다.
+template<typename T>
+struct RopeBuf {
+    T*      ptr = nullptr;
+    size_t  size = 0;
+    size_t  cap = 0;
+
+    T& operator[](size_t i) { return ptr[i]; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+
+    void reserve(RopeArena& arena, size_t n) {
+        if (n <= cap) return;
+        size_t newCap = max(n, cap + cap / 2);
+        size_t capBytes;
+        T* newPtr = (T*)arena.allocate(newCap * sizeof(T), &capBytes);
+        if (size) memcpy(newPtr, ptr, size * sizeof(T));
+        if (ptr) arena.release(ptr, cap * sizeof(T));
+        ptr = newPtr;
+        cap = capBytes / sizeof(T);
+    }
+    // [pos, pos + eraseCnt) 구간을 n개 크기의 빈 공간으로 바꾸고 그 시작 위치를 반환
+    T* splice(RopeArena& arena, size_t pos, size_t eraseCnt, size_t n) {
+        if (n > eraseCnt) reserve(arena, size + n - eraseCnt);
+        if (pos + eraseCnt < size) memmove(ptr + pos + n, ptr + pos + eraseCnt, (size - pos - eraseCnt) * sizeof(T));
+        size = size + n - eraseCnt;
+        return ptr + pos;
+    }
+    // [pos, pos + eraseCnt) 구간을 src의 n개로 교체
+    void replace(RopeArena& arena, size_t pos, size_t eraseCnt, const T* src, size_t n) {
+        T* dst = splice(arena, pos, eraseCnt, n);
+        if (n) memcpy(dst, src, n * sizeof(T));
+    }
+    void insert(RopeArena& arena, size_t pos, const T* src, size_t n) { replace(arena, pos, 0, src, n); }
+    void erase(size_t pos, size_t n) {
+        if (pos + n < size) memmove(ptr + pos, ptr + pos + n, (size - pos - n) * sizeof(T));
+        size -= n;
+    }
+    void push_back(RopeArena& arena, const T& value) {
+        if (size == cap) reserve(arena, size + 1);
+        ptr[size++] = value;
+    }
+    void free(RopeArena& arena) {
+        if (ptr) arena.release(ptr, cap * sizeof(T));
+        ptr = nullptr;
+        size = cap = 0;
+    }
+};
+
+// 읽기 전용 메모리 맵 원본 파일 : 디코딩 전의 리프들이 이 뷰의 바이트 구간을 참조한다.
+class RopeMappedFile {
+public:
+    enum Encoding { Utf8, Utf16LE, Utf16BE, Ansi };
+
+    const uint8_t*  view = nullptr;     // 매핑된 파일 전체
+    size_t          size = 0;           // 파일 크기
+    size_t          dataStart = 0;      // BOM을 제외한 본문 시작 위치
+    Encoding        encoding = Utf8;
+
+    RopeMappedFile() {}
+    ~RopeMappedFile() { close(); }
+    RopeMappedFile(const RopeMappedFile&) = delete;
+    RopeMappedFile& operator=(const RopeMappedFile&) = delete;
+
+    bool open(const std::wstring& path); // 파일 매핑 및 인코딩 판별
+    void close();
+    size_t unitSize() const { return (encoding == Utf16LE || encoding == Utf16BE) ? 2 : 1; } // 줄바꿈 검색 단위
+    void decode(const uint8_t* src, size_t bytes, std::wstring& out) const; // 구간을 UTF-16으로 디코딩
+
+private:
+    HANDLE          m_hFile = INVALID_HANDLE_VALUE;
+    HANDLE          m_hMapping = NULL;
+
+    static bool isUtf8(const uint8_t* p, size_t n); // UTF-8 유효성 검사 (끝에서 잘린 문자는 허용)
+};
+
+// 스왑 파일 : 메모리 예산을 넘은 차가운 리프를 압축해서 기록하는 임시 파일 (닫으면 삭제)
+// 위치를 지정해서 읽고 쓰므로 스냅샷이 다른 스레드에서 읽는 동안에도 다른 구간에 쓸 수 있다.
+// 스왑 파일에서 리프를 다시 읽지 못함 : 읽기 연산(getLineView, 커서, 스냅샷의 forEachLine 등)에서도 던진다.
+// NemoEdit는 WindowProc에서 한 번에 받아 처리하고, 작업 스레드는 각자 받아서 작업을 실패로 끝낸다.
+struct RopeReadError : public std::runtime_error {
+    RopeReadError() : std::runtime_error("rope swap file read failed") {}
+};
+
+class RopeSwapFile {
+public:
+    RopeSwapFile() {}
+    ~RopeSwapFile() { close(); }
+    RopeSwapFile(const RopeSwapFile&) = delete;
+    RopeSwapFile& operator=(const RopeSwapFile&) = delete;
+
+    bool open(); // 임시 폴더에 스왑 파일 생성
+    void close();
+    bool isOpen() const { return m_hFile != INVALID_HANDLE_VALUE; }
+    uint64_t write(const uint8_t* data, size_t bytes); // 빈 구간이나 파일 끝에 기록하고 위치를 반환 (실패하면 SWAP_FAIL)
+    bool read(uint64_t pos, uint8_t* data, size_t bytes) const;
+    void release(uint64_t pos, size_t bytes); // 구간을 빈 구간으로 돌려줌
+    uint64_t fileBytes() const { return m_end; }
+
+private:
+    HANDLE          m_hFile = INVALID_HANDLE_VALUE;
+    uint64_t        m_end = 0;                  // 파일 끝 (SWAP_BLOCK 단위)
+    std::multimap<size_t, uint64_t> m_free;     // 빈 구간 : 크기 -> 위치
+};
+
+// 줄바꿈(\r\n, \r, \n) 검색기 : x86/x64는 SSE2(지원되면 AVX2)로 16/32바이트씩 비교하고, 그 외 플랫폼은 스칼라로 처리
+class LineScanner {
+public:
+    // text[from, len)의 줄바꿈 위치를 breaks에 추가한다. (\r\n은 \r 위치 하나로 기록)
+    // maxCount개를 찾았거나 다음 라인 시작이 stopAt 이상이 되면 멈추고, 마지막 줄바꿈 다음 라인의 시작 위치를 반환 (못 찾으면 from)
+    static size_t scan(const wchar_t* text, size_t len, size_t from, size_t stopAt, size_t maxCount, std::vector<size_t>& breaks);
+    static size_t scan(const uint8_t* text, size_t len, size_t from, size_t stopAt, size_t maxCount, std::vector<size_t>& breaks); // UTF-8, ANSI
+    static size_t scan(const uint16_t* text, size_t len, size_t from, size_t stopAt, size_t maxCount, std::vector<size_t>& breaks, bool bigEndian); // UTF-16 원본
+    // brk 위치 줄바꿈 다음 라인의 시작 위치
+    static size_t nextLine(const wchar_t* text, size_t len, size_t brk) {
+        return brk + ((text[brk] == L'\r' && brk + 1 < len && text[brk + 1] == L'\n') ? 2 : 1);
+    }
+
+private:
+    static bool hasAvx2(); // CPU와 OS가 AVX2를 지원하는지 (최초 1회 검사)
+    static size_t findBreak(const uint8_t* p, size_t i, size_t len, uint8_t cr, uint8_t lf); // [i, len)에서 첫 cr/lf 위치 (없으면 len)
+    static size_t findBreak(const uint16_t* p, size_t i, size_t len, uint16_t cr, uint16_t lf);
+    static size_t findBreak(const wchar_t* p, size_t i, size_t len, wchar_t cr, wchar_t lf);
+    template <typename T>
+    static size_t scanUnits(const T* text, size_t len, size_t from, size_t stopAt, size_t maxCount, std::vector<size_t>& breaks, T cr, T lf);
+};
+
+// 텍스트를 라인별 문자열로 복사하지 않고 줄바꿈 위치만으로 나눈 결과 (text는 사용하는 동안 유지되어야 함)
+// 라인 i는 text의 [lineStart(i), lineEnd(i)) 구간이고, 줄바꿈으로 끝나는 텍스트는 마지막에 빈 라인이 있다.
+struct TextLines {
+    const wchar_t*      text = nullptr;
+    size_t              length = 0;
+    std::vector<size_t> breaks;     // 줄바꿈 위치 (라인 수 = breaks.size() + 1)
+
+    size_t size() const { return breaks.size() + 1; }
+    size_t lineStart(size_t i) const { return i ? LineScanner::nextLine(text, length, breaks[i - 1]) : 0; }
+    size_t lineEnd(size_t i) const { return i < breaks.size() ? breaks[i] : length; }
+    size_t lineLen(size_t i) const { return lineEnd(i) - lineStart(i); }
+    const wchar_t* linePtr(size_t i) const { return text + lineStart(i); }
+    std::wstring line(size_t i) const { return std::wstring(linePtr(i), lineLen(i)); }
+    std::wstring_view lineView(size_t i) const { return std::wstring_view(linePtr(i), lineLen(i)); }
+};
+
+// B+트리 노드 공통 헤더 : 내부 노드와 리프 노드는 별도 타입
+struct RopeNode {
+    bool        isLeaf;
+    uint32_t    gen;        // 만들어진 세대 : 스냅샷에 포함된 세대의 노드는 고치지 않고 복사본을 만든다.
+
+    explicit RopeNode(bool leaf) : isLeaf(leaf), gen(0) {}
+};
+
+// 서브트리 크기 : 라인 수, 문자 수(UTF-16 단위), UTF-8 바이트 수 (문자와 바이트는 줄바꿈 제외)
+// 수정 전후의 차이를 부호 없는 값으로 더해도 결과는 항상 0 이상이므로 뺄셈은 순환 연산으로 처리한다.
+struct RopeWeight {
+    size_t lines = 0;
+    size_t chars = 0;
+    size_t utf8 = 0;
+    size_t wraps = 0;   // 워드랩으로 늘어난 화면 줄 수 (화면 줄 수 = lines + wraps)
+
+    RopeWeight& operator+=(const RopeWeight& w) { lines += w.lines; chars += w.chars; utf8 += w.utf8; wraps += w.wraps; return *this; }
+    RopeWeight& operator-=(const RopeWeight& w) { lines -= w.lines; chars -= w.chars; utf8 -= w.utf8; wraps -= w.wraps; return *this; }
+    RopeWeight operator-(const RopeWeight& w) const { RopeWeight d = *this; d -= w; return d; }
+};
+
+// 내부 노드 : 자식 포인터와 자식별 크기를 연속 배열로 보관 (분할 직전 1개 초과 허용)
+struct RopeInternal : public RopeNode {
+    int         count;                          // 자식 수
+    RopeWeight  weight[NODE_FANOUT + 1];        // 자식 서브트리별 크기
+    RopeNode*   child[NODE_FANOUT + 1];         // 자식 노드
+
+    RopeInternal() : RopeNode(false), count(0) {}
+    RopeWeight total() const { RopeWeight sum; for (int i = 0; i < count; i++) sum += weight[i]; return sum; }
+};
+
+// 긴 라인의 청크 : 청크마다 담을 수 있는 가장 좁은 인코딩으로 저장
+struct RopeChunk {
+    RopeBuf<uint8_t>    text;
+    uint8_t             shift;      // 0 : Latin-1, WIDE_CHAR_SHIFT : UTF-16
+    size_t              utf8;       // UTF-8 바이트 수
+
+    size_t len() const { return text.size >> shift; } // 문자 수
+};
+
+// 아주 긴 라인 : 청크 배열과 청크 크기의 펜윅 트리로 열 위치를 O(log n)에 찾고, 편집은 걸친 청크만 고친다.
+// 리프에는 포인터만 두므로 리프 분할/병합이나 라인 이동은 포인터만 옮긴다. (라인을 가진 리프가 소유)
+struct RopeLongLine {
+    RopeBuf<RopeChunk>  chunks;
+    RopeBuf<size_t>     charIndex;  // 청크 문자 수의 펜윅 트리 (1부터, 크기 = 청크 수 + 1)
+    RopeBuf<size_t>     utf8Index;  // 청크 UTF-8 바이트 수의 펜윅 트리
+    size_t              chars = 0;
+    size_t              utf8 = 0;
+
+    size_t findChunk(size_t column, size_t& pos) const; // column이 들어 있는 청크와 청크 안 위치 (column >= chars면 마지막 청크 끝)
+    size_t utf8Before(size_t column) const; // [0, column) 구간의 UTF-8 바이트 수
+    size_t columnAt(size_t bytes) const; // UTF-8 오프셋의 열 (문자 중간이면 그 문자 시작, 끝을 넘으면 chars)
+    void append(std::wstring& out, size_t from, size_t cnt) const; // [from, from + cnt) 구간을 걸친 청크에서만 디코딩
+    void addIndex(size_t chunk, size_t charDiff, size_t utf8Diff); // 청크 하나의 크기 변화 반영 (순환 연산)
+    void rebuildIndex(RopeArena& arena); // 청크가 늘거나 줄면 인덱스와 전체 크기를 다시 구성 (청크 수에 선형)
+};
+
+// 공유 라인 : 내용이 같은 라인들이 참조 카운트로 함께 쓰는 불변 버퍼 (헤더 바로 뒤에 라인 인코딩의 문자들)
+// 고치는 라인은 먼저 리프 버퍼로 풀어서 고치므로(쓰기 시 복사) 만든 뒤에는 바뀌지 않고, 스냅샷에서도 그대로 읽는다.
+struct RopeAtom {
+    RopeAtom*   next;   // 해시 버킷 체인
+    uint32_t    hash;
+    uint32_t    refs;   // 참조하는 라인 수 (리프 복사본 포함)
+    uint32_t    chars;  // 문자 수
+    uint32_t    utf8;   // UTF-8 바이트 수
+    uint8_t     shift;  // 문자 크기 시프트
+
+    size_t bytes() const { return (size_t)chars << shift; }
+    const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(this + 1); }
+};
+
+// 리프 노드 : 라인들을 줄바꿈 없이 이어붙인 연속 버퍼와 라인 끝 위치 배열, 좌우 형제 리프 링크
+// 라인마다 모든 문자가 0xFF 이하면 1바이트(Latin-1), 아니면 2바이트(UTF-16)로 저장한다. LONG_LINE_MIN보다 긴 라인은 RopeLongLine 포인터로 저장한다.
+// 라인 공유를 켜면 반복되는 라인은 RopeAtom 포인터로 저장한다.
+// 버퍼는 모두 아레나에서 할당한다. LoadFile로 연 리프는 처음 접근할 때까지 원본 파일 구간만 가리킨다.
+// 압축 모드에서 최근에 접근하지 않은 리프는 text를 압축해서 packed에 두고, 접근할 때 다시 푼다. (라인 위치 배열은 그대로)
+// 스왑 모드에서는 라인 위치 배열까지 압축해서 스왑 파일에 쓰고 버퍼를 모두 해제한다. (크기와 라인 수만 남음)
+struct RopeLeaf : public RopeNode {
+    RopeBuf<uint8_t>    text;       // 리프의 모든 라인을 이어붙인 바이트 버퍼
+    RopeBuf<uint32_t>   lineEnd;    // 각 라인의 끝 바이트 위치 (text 기준, 다음 라인의 시작 위치)
+    RopeBuf<uint8_t>    lineWide;   // 라인별 문자 크기 시프트 (0 : Latin-1, WIDE_CHAR_SHIFT : UTF-16)
+    const uint8_t*  src;        // 디코딩 전이면 원본 파일 뷰의 구간 시작 (nullptr이면 버퍼에 상주)
+    size_t          srcBytes;   // 원본 구간 바이트 수 (줄바꿈 포함)
+    size_t          srcLines;   // 원본 구간 라인 수 (스왑된 리프면 스왑 전 라인 수)
+    size_t      chars;  // 모든 라인의 문자 수 (디코딩 전이면 로드할 때 센 값)
+    size_t      utf8;   // 모든 라인의 UTF-8 바이트 수
+    RopeLeaf*   prev;   // 왼쪽 형제 리프
+    RopeLeaf*   next;   // 오른쪽 형제 리프
+    RopeBuf<uint8_t>    packed;     // 압축된 text (비어 있지 않으면 text는 해제된 상태)
+    RopeLeaf*   hotPrev;    // 최근 접근 순서 목록 (압축, 스왑 모드에서만 사용)
+    RopeLeaf*   hotNext;
+    size_t      hotBytes;   // 목록에 넣을 때 센 버퍼 바이트
+    uint64_t    swapPos;    // 스왑 파일 구간 위치
+    uint32_t    swapBytes;  // 스왑 파일 구간 바이트 (0이면 스왑되지 않음)
+    uint32_t    swapRaw;    // 압축 전 바이트 (라인 끝 위치, 문자 크기, text 순서)
+    RopeBuf<uint32_t>   lineWraps;  // 라인별 워드랩 줄 수 (비어 있으면 모두 0, 디코딩/압축/스왑과 무관하게 상주)
+    size_t      wraps;  // lineWraps의 합
+    bool        wrapsSet;   // 모든 라인의 워드랩 줄 수를 기록함 (라인을 넣거나 고치면 지움, 백그라운드 워드랩이 건너뜀)
+
+    RopeLeaf() : RopeNode(true), src(nullptr), srcBytes(0), srcLines(0), chars(0), utf8(0), prev(nullptr), next(nullptr), hotPrev(nullptr), hotNext(nullptr),
+        hotBytes(0), swapPos(0), swapBytes(0), swapRaw(0), wraps(0), wrapsSet(false) {}
+    size_t lineCount() const { return (src || swapBytes) ? srcLines : lineEnd.size; }
+    RopeWeight weight() const { RopeWeight w; w.lines = lineCount(); w.chars = chars; w.utf8 = utf8; w.wraps = wraps; return w; }
+    size_t lineWrap(size_t i) const { return lineWraps.size ? lineWraps[i] : 0; }
+    size_t lineStart(size_t i) const { return i ? lineEnd[i - 1] : 0; } // i == lineCount()면 버퍼 끝
+    size_t lineBytes(size_t i) const { return lineEnd[i] - lineStart(i); }
+    size_t lineLen(size_t i) const { uint8_t w = lineWide[i]; return w < SHARED_LINE_SHIFT ? lineBytes(i) >> w : w == LONG_LINE_SHIFT ? longLine(i)->chars : atom(i)->chars; } // 문자 수
+    const uint8_t* linePtr(size_t i) const { return text.ptr + lineStart(i); }
+    bool isLong(size_t i) const { return lineWide[i] == LONG_LINE_SHIFT; }
+    bool isAtom(size_t i) const { return lineWide[i] == SHARED_LINE_SHIFT; }
+    bool isRef(size_t i) const { return lineWide[i] >= SHARED_LINE_SHIFT; } // 버퍼에 포인터만 있는 라인 (긴 라인, 공유 라인)
+    RopeLongLine* longLine(size_t i) const { RopeLongLine* p; memcpy(&p, linePtr(i), sizeof(p)); return p; }
+    RopeAtom* atom(size_t i) const { RopeAtom* p; memcpy(&p, linePtr(i), sizeof(p)); return p; }
+    const uint8_t* lineText(size_t i, uint8_t& shift) const { if (isAtom(i)) { shift = atom(i)->shift; return atom(i)->data(); } shift = lineWide[i]; return linePtr(i); } // 문자들의 위치와 시프트 (긴 라인이면 포인터 자리와 LONG_LINE_SHIFT)
+};
+
+// 루트에서 리프까지의 탐색 경로 : 부모 포인터 없이 경로를 따라 올라가며 갱신
+struct RopePath {
+    int             depth = 0;                    // 경로에 포함된 내부 노드 수
+    RopeInternal*   node[ROPE_MAX_DEPTH];         // 각 레벨의 내부 노드
+    int             slot[ROPE_MAX_DEPTH];         // 각 레벨에서 내려간 자식 위치
+};
+
+// 라인 순회 커서 : 리프와 리프 안 위치를 기억해서 이웃 라인으로 O(1) 이동 (문서를 수정하면 다시 얻어야 함)
+struct RopeCursor {
+    RopeLeaf*   leaf = nullptr;     // 현재 리프 (nullptr이면 범위 밖)
+    size_t      offset = 0;         // 리프 안 라인 위치
+    size_t      line = 0;           // 문서 전체 라인 번호
+};
+
+// 떼어낸 라인 구간 : 같은 Rope의 spliceLines로 다시 끼우거나 releaseLines로 해제 (clear, loadFile 후에는 무효)
+struct RopeSlice {
+    RopeNode*   root = nullptr;     // 떼어낸 서브트리 (nullptr이면 비어 있음)
+    size_t      lines = 0;          // 라인 수
+};
+
+// 스냅샷에서 잰 라인 구간의 워드랩 줄 수 (백그라운드 워드랩 결과, Rope::setSnapshotWraps로 기록)
+struct RopeWrapBlock {
+    size_t      first = 0;          // 스냅샷 기준 첫 라인
+    size_t      count = 0;          // 라인 수 (getUnwrappedRanges가 리프 경계에 맞춰 나눈 구간)
+    std::vector<std::pair<size_t, uint32_t>> wraps; // 워드랩이 있는 라인(스냅샷 기준)과 줄 수
+};
+
+// 문서의 읽기 전용 스냅샷 : 만든 시점의 트리를 복사 없이 공유하고, 원본 Rope는 이후 공유 노드를 고칠 때 복사본을 만든다.
+// 어느 스레드에서 읽어도 되지만 원본 Rope보다 오래 살아 있으면 안 된다. (해제된 스냅샷의 노드는 원본을 수정할 때 정리)
+class RopeSnapshot {
+public:
+    size_t getSize() const { return m_totalLines; } // 전체 줄수
+    size_t getCharCount() const { return m_weight.chars; } // 전체 문자 수 (줄바꿈 제외)
+    size_t getUtf8Size() const { return m_weight.utf8; } // 전체 UTF-8 바이트 수 (줄바꿈 제외)
+    uint64_t getEditCount() const { return m_edits; } // 만들 때의 Rope 수정 횟수
+    std::wstring getLine(size_t lineIndex) const; // 라인 텍스트 (디코딩 전이거나 압축, 스왑된 리프면 그 리프만 임시로 풂)
+    std::wstring getText() const; // 전체 텍스트 (줄바꿈은 \r\n, Rope::getText와 같음)
+    // first부터 count개 라인을 차례로 fn에 넘김 (리프마다 한 번만 풀고, fn이 false를 반환하면 중단) : line은 fn 안에서만 유효
+    void forEachLine(size_t first, size_t count, const std::function<bool(size_t lineIndex, std::wstring_view line)>& fn) const;
+
+private:
+    friend class Rope;
+    RopeSnapshot() {}
+
+    RopeNode* m_root = nullptr; // 스냅샷 시점의 루트 (이 아래 노드는 원본에서 고치지 않음)
+    size_t m_totalLines = 0;
+    RopeWeight m_weight;
+    uint64_t m_edits = 0;
+    std::shared_ptr<RopeMappedFile> m_source; // 디코딩 전 리프가 참조하는 원본 파일 (원본 Rope가 다른 파일을 열어도 유지)
+    const RopeSwapFile* m_swap = nullptr; // 스왑된 리프를 읽을 원본 Rope의 스왑 파일
+
+    const RopeLeaf* findLeaf(size_t idx, size_t& offset) const;
+    void appendSubtree(std::wstring& out, const RopeNode* node, size_t& lineCnt) const; // 서브트리의 라인들을 순서대로 추가 (리프 링크는 원본이 고치므로 쓰지 않음)
+    const RopeLeaf* unpackedLeaf(const RopeLeaf* leaf, RopeLeaf& view, std::vector<uint8_t>& text) const; // 압축되거나 스왑된 리프면 text에 푼 사본(view)을 반환
+};
+
+class Rope {
+private:
+    friend class RopeSnapshot;
+    friend struct RopeLongLine;
+    friend class NemoBench;
+    RopeArena m_arena; // 노드와 리프 버퍼를 할당하는 문서 단위 아레나
+    std::shared_ptr<RopeMappedFile> m_source; // LoadFile로 연 원본 파일 (디코딩 전 리프들과 스냅샷이 참조)
+    RopeNode* root;    // B+트리의 루트 노드 (비어 있으면 빈 리프)
+    size_t m_totalLines; // 전체 줄수
+    RopeLimits m_limits; // 리프 크기 한도 (나누기/합치기/로드할 때 참조)
+    RopeLeaf* m_finger; // 마지막으로 읽은 리프 (화면 주변 라인 반복 조회용, 수정 시 무효화)
+    size_t m_fingerStart; // m_finger의 첫 라인 번호
+    std::wstring m_viewBuf; // Latin-1 라인을 wchar_t로 펼쳐서 보여주는 버퍼 (용량은 재사용)
+    const RopeLeaf* m_viewLeaf; // m_viewBuf에 담긴 라인의 리프
+    size_t m_viewLine; // m_viewBuf에 담긴 라인의 리프 안 위치
+
+    // 스냅샷 공유 : 노드를 만든 세대가 m_frozenGen 이하면 스냅샷과 공유 중일 수 있으므로 고치기 전에 복사한다.
+    // 트리에서 빠진 공유 노드는 그 노드를 볼 수 있는 스냅샷이 모두 해제될 때까지 m_retired에 두었다가 해제한다.
+    struct SnapshotRef {
+        uint32_t gen;                               // 스냅샷을 만든 세대
+        std::weak_ptr<const RopeSnapshot> ref;
+    };
+    struct RetiredNode {
+        RopeNode* node;
+        uint32_t gen;                               // 트리에서 빠진 세대
+    };
+    uint32_t m_gen; // 현재 세대 (새로 만드는 노드에 기록)
+    uint32_t m_frozenGen; // 살아 있는 가장 최근 스냅샷의 세대 (0이면 공유 없음)
+    std::vector<SnapshotRef> m_snapshots; // 내준 스냅샷들
+    std::vector<RetiredNode> m_retired; // 해제를 미룬 공유 노드
+    size_t m_sweepAt; // m_retired가 이 크기가 되면 정리
+
+    // 차가운 리프 압축/스왑 : 접근한 리프를 목록 앞으로 옮기고, 목록이 m_hotMax개나 m_swapBudget 바이트를 넘으면 뒤쪽(오래된) 리프부터 내보낸다.
+    // 내보내기는 공개 연산의 시작(수정은 dropFinger, 읽기는 beginRead)에서만 하므로 연산 도중에 잡고 있는 리프 버퍼는 바뀌지 않는다.
+    // (getText는 지나온 리프만 내보내고, next/prev는 내보내지 않음) 최근 PACK_HOT_MIN개 리프는 내보내지 않는다.
+    RopeLeaf* m_hotHead; // 가장 최근에 접근한 리프
+    RopeLeaf* m_hotTail; // 가장 오래전에 접근한 리프
+    size_t m_hotCount; // 목록의 리프 수
+    size_t m_hotBytes; // 목록의 리프 버퍼 바이트 (hotBytes 합)
+    size_t m_hotMax; // 풀어둘 리프 수 (0이면 압축 모드 꺼짐)
+    size_t m_swapBudget; // 목록 리프들이 쓸 수 있는 바이트 (0이면 스왑 모드 꺼짐)
+    RopePackStats m_packStats;
+    RopeSwapFile m_swap; // 처음 스왑할 때 생성 (스냅샷이 읽으므로 Rope와 수명이 같음)
+    RopeSwapStats m_swapStats;
+    uint64_t m_editCount; // dropFinger 호출 횟수
+
+    // 수정 구간 기록 : 수정마다 바뀐 라인 구간을 남겨서, 예전 수정 횟수 기준의 라인 번호를 지금 번호로 옮길 수 있게 한다. (mapLine)
+    // 구간을 남기지 않은 수정(clear, loadFile 등)을 지나는 번호는 옮기지 않는다.
+    struct LineEdit {
+        uint64_t edit;      // 수정 횟수 (getEditCount)
+        size_t line;        // 바뀐 구간의 첫 라인
+        size_t removed;     // 수정 전 구간의 라인 수 (내용만 바뀐 라인도 포함)
+        size_t inserted;    // 수정 후 구간의 라인 수
+    };
+    std::vector<LineEdit> m_lineEdits; // 오래된 것부터 (같은 수정의 구간은 적용 순서대로)
+    uint64_t m_unmappedEdit; // 구간을 모르는 가장 최근 수정 (이보다 앞선 번호는 옮길 수 없음)
+    bool m_editNoted; // 현재 수정이 구간을 남겼는지
+
+    // 라인 공유 : 켜져 있으면 새로 넣는 라인 중 두 번째로 나온 같은 내용부터 RopeAtom 하나를 함께 쓴다. (처음 나온 라인은 리프 버퍼에 그대로)
+    bool m_interning;
+    std::vector<RopeAtom*> m_atomTable; // 해시 버킷 (크기는 2의 거듭제곱, 공유 버퍼가 버킷보다 많아지면 두 배로)
+    std::vector<uint32_t> m_seenHash; // 한 번 나온 라인의 해시 (해시 위치에 바로 기록하고 충돌하면 덮어씀)
+    RopeInternStats m_internStats;
+
+    // 원본 파일에서 리프 하나가 가리킬 구간
+    struct SourceSpan {
+        size_t from;    // 본문 시작 기준 바이트 위치
+        size_t bytes;   // 구간 바이트 수
+        size_t lines;   // 구간 안의 줄바꿈 수
+        size_t chars;   // 디코딩했을 때의 문자 수 (줄바꿈 제외)
+        size_t utf8;    // 디코딩했을 때의 UTF-8 바이트 수 (줄바꿈 제외)
+    };
+
+    // 내부 함수
+    RopeLeaf* findLeaf(size_t idx, size_t& offset, RopePath* path = nullptr); // 반복 탐색 (idx == 전체 줄수면 마지막 리프의 끝, path를 받으면 경로를 수정 가능하게 복사)
+    RopeLeaf* findResidentLeaf(size_t idx, size_t& offset, RopePath* path = nullptr); // findLeaf 후 버퍼에 상주시킴 (경로가 필요 없으면 핑거 사용, 내보내기는 하지 않음)
+    RopeLeaf* findFingerLeaf(size_t idx, size_t& offset); // 핑거 리프나 그 이웃이면 O(1), 아니면 findLeaf 후 핑거 갱신
+    void dropFinger() { if (!m_editNoted) m_unmappedEdit = m_editCount; m_editCount++; m_editNoted = false; m_finger = nullptr; m_viewLeaf = nullptr; if (m_retired.size() >= m_sweepAt) sweepSnapshots(); if (overHot()) evictCold(); } // 라인 위치나 내용이 바뀌는 수정 전에 호출 (핑거, 라인 뷰 무효화, 수정 횟수 증가)
+    void noteLines(size_t line, size_t removed, size_t inserted); // dropFinger 뒤에 이번 수정이 바꾸는 라인 구간을 기록 (여러 번이면 순서대로 적용)
+    void beginRead() { if (overHot()) evictCold(); } // 라인을 찾는 공개 읽기 연산의 시작에서 호출 (읽기만 계속하는 경우에도 예산 유지)
+    std::wstring_view lineView(RopeLeaf* leaf, size_t line); // 리프 라인의 뷰 (UTF-16 라인은 버퍼 직접, Latin-1 라인과 긴 라인은 m_viewBuf)
+    std::wstring_view lineView(RopeLeaf* leaf, size_t line, size_t column, size_t count); // 라인 일부의 뷰 (한 UTF-16 버퍼 안이면 직접, 아니면 m_viewBuf)
+    void ensureResident(RopeLeaf* leaf); // 원본 파일 구간을 가리키거나 압축, 스왑된 리프를 버퍼에 상주 (수정 가능한 리프만)
+    void loadSource(RopeLeaf* leaf); // 원본 파일 구간을 디코딩해서 버퍼로
+    RopeLeaf* residentLeaf(RopeLeaf* leaf, size_t line); // 읽기 경로의 상주화 : 공유 중인 리프면 line까지의 경로를 복사한 뒤 상주
+    static void decodeLeaf(const RopeMappedFile& source, const RopeLeaf* leaf, std::wstring& text, TextLines& lines); // 디코딩 전 리프의 원본 구간을 라인으로 나눔
+    bool isShared(const RopeNode* node) const { return node->gen <= m_frozenGen; } // 스냅샷과 공유 중일 수 있는 노드인지
+    RopeNode* writable(RopeNode* node); // 공유 중이면 복사본으로 바꿔서 반환 (원본은 해제 보류), 아니면 그대로
+    void sweepSnapshots(); // 해제된 스냅샷을 지우고 더 이상 보이지 않는 보류 노드 해제
+    bool hotListOn() const { return m_hotMax || m_swapBudget; }
+    bool overHot() const { return (m_hotMax && m_hotCount > m_hotMax) || (m_swapBudget && m_hotBytes > m_swapBudget && m_hotCount > PACK_HOT_MIN); }
+    void touchLeaf(RopeLeaf* leaf); // 최근 접근 목록 맨 앞으로
+    void unlinkHot(RopeLeaf* leaf); // 최근 접근 목록에서 제거
+    void resetHotList(); // 두 모드가 모두 꺼졌으면 목록을 비움
+    void evictCold(); // 목록 뒤쪽 리프부터 압축하거나 (스왑 모드) 스왑 파일로 내보내서 한도 안으로
+    void swapOut(RopeLeaf* leaf); // 버퍼를 압축해서 스왑 파일에 쓰고 해제 (기록에 실패하면 그대로 둠)
+    void swapIn(RopeLeaf* leaf);
+    void loadSwapped(RopeLeaf* dst, const RopeLeaf* leaf); // 스왑된 리프의 버퍼를 dst에 채움 (공유 리프의 복사본용)
+    static void readSwapped(const RopeSwapFile& swap, const RopeLeaf* leaf, std::vector<uint8_t>& raw); // 스왑 구간을 읽어서 압축 해제
+    void packLeaf(RopeLeaf* leaf); // text를 압축 (줄어드는 양이 적으면 그대로 둠)
+    void unpackLeaf(RopeLeaf* leaf);
+    static void packBytes(const uint8_t* src, size_t n, std::vector<uint8_t>& out); // LZ4 방식 블록 압축
+    static void unpackBytes(const uint8_t* src, size_t srcBytes, uint8_t* dst); // dst는 원래 크기만큼 확보되어 있어야 함
+    size_t scanSource(size_t len, size_t from, size_t stopAt, size_t maxCount, std::vector<size_t>& breaks) const; // 원본 인코딩 단위로 줄바꿈 검색
+    size_t sourceLineStart(size_t pos, size_t len) const; // pos 이후 첫 라인 시작 위치 (검색 단위 기준)
+    void scanSourceSpans(size_t begin, size_t end, std::vector<SourceSpan>& spans) const; // [begin, end) 구간을 리프 구간으로 나눔 (작업 스레드에서 호출)
+    void measureSource(const uint8_t* src, size_t bytes, size_t& chars, size_t& utf8) const; // 원본 구간을 디코딩했을 때의 문자 수와 UTF-8 바이트 수
+    RopeLeaf* firstLeaf(); // 가장 왼쪽 리프
+    void addWeight(const RopePath& path, const RopeWeight& diff); // 경로상의 모든 내부 노드 크기 갱신 (diff는 수정 후 - 수정 전)
+    void splitLeaf(RopeLeaf* leaf, RopePath& path, size_t cutSize); // cutSize 위치에서 리프 분할
+    void splitIfNeeded(RopeLeaf* leaf, RopePath& path); // 줄수나 문자수가 넘치면 리프 분할
+    void insertChildAt(RopePath& path, int level, int slot, RopeNode* node, const RopeWeight& weight); // 내부 노드에 자식 삽입 (넘치면 분할 전파)
+    void insertLeafAt(size_t lineIndex, RopeLeaf* leaf); // 리프 경계 lineIndex에 새 리프 삽입
+    void buildFromLeaves(const std::vector<RopeLeaf*>& leaves); // 리프 배열로 아래에서부터 트리를 한 번에 구성 (리프 수에 선형)
+    void releaseInternals(RopeNode* node); // 내부 노드만 해제 (리프는 그대로 둠)
+    void releaseSubtree(RopeNode* node); // 서브트리의 노드와 리프 버퍼 전부 해제
+    void splitTree(RopeNode* node, size_t line, RopeNode*& left, RopeNode*& right); // 라인 경계에서 서브트리를 둘로 나눔 (경계 쪽 가장자리만 부족할 수 있음)
+    RopeNode* takeChildren(RopeInternal* node, int from, int to); // [from, to) 자식들로 만든 트리 (하나면 그 자식)
+    RopeNode* joinTrees(RopeNode* left, RopeNode* right); // 두 트리를 이어붙임 (낮은 트리를 높은 트리 가장자리에 끼움)
+    static int treeHeight(RopeNode* node); // 리프까지의 높이 (리프는 0)
+    static RopeLeaf* edgeLeaf(RopeNode* node, bool last); // 서브트리의 첫/마지막 리프
+    static RopeWeight treeWeight(RopeNode* node); // 서브트리 전체 크기
+    void cutEdges(RopeNode* node); // 양 끝 리프의 바깥쪽 링크 끊기
+    RopeSlice detachRange(size_t lineIndex, size_t count); // detachLines 본문 (다른 수정 연산 안에서 쓰므로 dropFinger 없음)
+    void spliceRange(size_t lineIndex, RopeSlice& slice); // spliceLines 본문 (dropFinger 없음)
+    void removeLeafRange(RopeInternal* node, size_t from, size_t cnt); // 리프 경계에 맞춘 라인 구간을 서브트리 단위로 제거
+    void repairPath(size_t line); // line까지의 경로에서 부족한 노드를 위에서부터 복구
+    void removeChild(RopePath& path, int level); // path.slot[level]의 자식 제거 (부족하면 병합/차용 전파)
+    void insertLine(size_t lineIndex, std::wstring_view text); // insert 본문 (다른 수정 연산 안에서 쓰므로 dropFinger 없음)
+    void eraseLine(size_t lineIndex); // erase 본문 (dropFinger 없음)
+    void repairLeaf(RopeLeaf* leaf, RopePath& path); // 라인이 줄어든 리프 정리 (빈 리프 제거, 부족 시 병합/차용)
+    void rebalanceLeaf(RopeLeaf* leaf, RopePath& path); // 리프 부족 시 형제와 병합/차용
+    void rebalanceInternal(RopePath& path, int level); // 내부 노드 부족 시 형제와 병합/차용
+    void unlinkLeaf(RopeLeaf* leaf); // 형제 리프 링크에서 제거
+    RopeLeaf* allocLeaf(); // 아레나에서 리프 할당
+    RopeInternal* allocInternal(); // 아레나에서 내부 노드 할당
+    void deleteNode(RopeNode* node); // 노드와 버퍼를 아레나에 반환 (스냅샷과 공유 중이면 해제 보류)
+    void freeNode(RopeNode* node); // 즉시 반환
+
+    // 리프 버퍼 연산
+    void leafReplace(RopeLeaf* leaf, size_t line, size_t offset, size_t eraseLen, const wchar_t* str, size_t len); // 라인 내부 교체 (필요하면 인코딩 변경)
+    void leafInsertLine(RopeLeaf* leaf, size_t line, const wchar_t* str, size_t len); // line 위치에 라인 삽입
+    void leafEraseLines(RopeLeaf* leaf, size_t line, size_t cnt, const RopeWeight* moved = nullptr); // line부터 cnt개 라인 삭제 (moved : 다른 리프로 옮긴 구간의 미리 센 크기, 긴 라인은 해제하지 않음)
+    RopeWeight linesWeight(const RopeLeaf* leaf, size_t line, size_t cnt); // 리프 안 [line, line + cnt) 라인의 크기
+    void leafMoveLines(RopeLeaf* src, size_t line, size_t cnt, RopeLeaf* dst, size_t dstLine); // 리프 간 라인 이동
+    bool leafUnderflow(RopeLeaf* leaf); // 병합/차용이 필요한 리프인지
+    uint8_t* leafResizeLine(RopeLeaf* leaf, size_t line, size_t newBytes, uint8_t shift); // 라인 버퍼를 newBytes 크기의 빈 공간으로 바꾸고 그 시작 위치를 반환
+    void leafSetLong(RopeLeaf* leaf, size_t line, RopeLongLine* ll); // 라인을 긴 라인 포인터로 바꿈 (리프 크기는 호출자가 보정)
+    RopeLongLine* leafTakeLong(RopeLeaf* leaf, size_t line); // 긴 라인을 떼어내고 그 자리는 빈 라인으로 둠
+    void leafJoinLong(RopeLeaf* leaf, size_t line, RopeLongLine* tail); // 라인 끝에 긴 라인을 청크째 이어붙임 (tail은 라인에 합쳐짐)
+    void leafUnchunk(RopeLeaf* leaf, size_t line); // 짧아진 긴 라인을 다시 리프 버퍼로
+    void leafUnatom(RopeLeaf* leaf, size_t line); // 공유 라인을 리프 버퍼로 풀어서 고칠 수 있게 함
+    void leafResetWrap(RopeLeaf* leaf, size_t line); // 내용이 바뀐 라인의 워드랩 줄 수를 0(다시 잴 때까지 한 줄)으로
+    void leafFillWraps(RopeLeaf* leaf); // lineWraps가 비어 있으면 라인 수만큼 0으로 채움
+    void clearSubtreeWraps(RopeNode* node); // 서브트리의 워드랩 줄 수를 0으로, 기록 표시도 지움
+    static bool hasRefLines(const RopeLeaf* leaf); // 긴 라인이나 공유 라인이 있는지 (버퍼의 포인터를 따라가야 하므로 압축, 스왑하지 않음)
+    static void appendLine(std::wstring& out, const RopeLeaf* leaf, size_t line, size_t from, size_t cnt); // 라인 일부를 UTF-16으로 디코딩해서 추가
+    static size_t lineUtf8(const RopeLeaf* leaf, size_t line, size_t column); // 라인 앞 column 문자의 UTF-8 바이트 수
+    static uint8_t charShift(const wchar_t* str, size_t len); // 담을 수 있는 가장 좁은 인코딩의 문자 크기 시프트
+    static size_t utf8Size(wchar_t c) { return c < 0x80 ? 1 : (c < 0x800 || (c >= 0xD800 && c <= 0xDFFF)) ? 2 : 3; } // 서로게이트는 한쪽당 2바이트 (쌍이면 4바이트)
+    static size_t utf8Size(const wchar_t* str, size_t len);
+    static size_t utf8Size(const uint8_t* src, size_t len, uint8_t shift); // 라인 인코딩으로 기록된 len 문자
+    static wchar_t charAt(const uint8_t* src, size_t i, uint8_t shift) { if (!shift) return src[i]; wchar_t c; memcpy(&c, src + (i << shift), sizeof(c)); return c; }
+    static void encodeChars(uint8_t* dst, const wchar_t* str, size_t len, uint8_t shift); // 라인 인코딩으로 기록
+
+    // 긴 라인 연산 : 청크 버퍼도 아레나에서 할당
+    RopeLongLine* newLongLine(const wchar_t* str, size_t len);
+    RopeLongLine* copyLongLine(const RopeLongLine* ll); // 스냅샷과 공유 중인 리프를 복사할 때 (청크까지 복사)
+    void freeLongLine(RopeLongLine* ll);
+    void fillChunks(RopeLongLine* ll, size_t at, const wchar_t* str, size_t len); // at 위치에 str을 기준 크기 청크들로 나눠 끼움 (인덱스는 호출자가 갱신)
+    void longLineReplace(RopeLongLine* ll, size_t offset, size_t eraseLen, const wchar_t* str, size_t len); // 걸친 청크만 고침
+    RopeLongLine* longLineSplit(RopeLongLine* ll, size_t column); // column 뒤쪽을 떼어낸 새 긴 라인 (가운데 청크 하나만 나눔)
+
+    // 공유 라인 연산 : 공유 버퍼도 아레나에서 할당
+    RopeAtom* internLine(const wchar_t* str, size_t len, uint8_t shift); // 같은 내용의 공유 버퍼를 찾거나, 두 번째로 나온 라인이면 새로 만듦 (아니면 nullptr)
+    void retainAtom(RopeAtom* atom);
+    void releaseAtom(RopeAtom* atom); // 마지막 참조면 표에서 빼고 해제
+    static uint32_t hashChars(const wchar_t* str, size_t len);
+
+public:
+    Rope();
+    ~Rope();
+    // 핵심 연산들: 텍스트는 뷰로 받아서 리프 버퍼에 바로 기록 (임시 문자열 없음)
+    void insert(size_t lineIndex, std::wstring_view text);
+    void insertAt(size_t lineIndex, size_t offset, std::wstring_view text);
+    void insertBack(std::wstring_view text);
+    void insertMultiple(size_t lineIndex, const TextLines& lines, size_t first, size_t count); // lines의 first부터 count개 라인을 리프 단위로 삽입
+    bool loadFile(const std::wstring& path); // 메모리 맵으로 파일 열기 (라인은 처음 접근할 때 리프 단위로 디코딩)
+    void erase(size_t lineIndex);
+    void eraseAt(size_t lineIndex, size_t offset, size_t size);
+    void eraseRange(size_t startLine, size_t eraseSize);
+    void update(size_t lineIndex, std::wstring_view newText);
+    void splitLine(size_t lineIndex, size_t column); // column 위치에서 라인을 둘로 나눔 (버퍼 이동 없이 라인 경계만 추가)
+    void mergeLine(size_t lineIndex); // 다음 라인을 이어붙임
+    // 라인 구간 이동 : 서브트리째 떼어내고 끼우므로 구간 크기와 무관하게 O(log n) (경계 리프 두 개만 나눔)
+    RopeSlice detachLines(size_t lineIndex, size_t count); // 라인 구간을 떼어냄
+    void spliceLines(size_t lineIndex, RopeSlice& slice); // 떼어낸 구간을 lineIndex 위치에 끼움 (slice는 비워짐)
+    void releaseLines(RopeSlice& slice); // 끼우지 않을 구간 해제
+    void moveLines(size_t lineIndex, size_t count, size_t to); // 라인 구간을 to로 이동 (to는 떼어낸 뒤 기준)
+    bool clear(); // 전체 초기화
+    bool empty(); // 줄이 하나도 없는지
+    size_t getSize(); // 전체 줄수
+    size_t getLineSize(size_t lineIndex); // 라인 사이즈
+    std::wstring getLine(size_t lineIndex); // 라인 텍스트
+    RopeCursor cursorAt(size_t lineIndex); // 라인 커서 (범위 밖이면 leaf == nullptr)
+    bool next(RopeCursor& cursor); // 다음 라인으로 이동 (마지막 라인이면 false)
+    bool prev(RopeCursor& cursor); // 이전 라인으로 이동 (첫 라인이면 false)
+    size_t getLineSize(const RopeCursor& cursor); // 커서 위치 라인 사이즈
+    std::wstring getLine(const RopeCursor& cursor); // 커서 위치 라인 텍스트
+    // 복사 없는 라인 뷰 : 문서를 수정하거나 다른 라인의 뷰를 얻기 전까지 유효 (같은 라인을 다시 얻는 것은 안전)
+    // 압축, 스왑 모드에서는 읽기 연산도 오래된 리프를 내보내므로, 뷰를 잡은 채로 다른 리프를 PACK_HOT_MIN개 넘게 읽지 않는다.
+    // 긴 라인은 전체를 m_viewBuf에 펼치므로 화면에 보이는 부분만 필요하면 구간 뷰를 사용한다.
+    std::wstring_view getLineView(size_t lineIndex);
+    std::wstring_view getLineView(const RopeCursor& cursor);
+    // 라인의 [column, column + count) 구간 뷰 : 긴 라인도 걸친 청크만 읽는다. (다른 뷰를 얻기 전까지 유효)
+    std::wstring_view getLineView(size_t lineIndex, size_t column, size_t count);
+    std::wstring getText(); // 전체 텍스트
+    std::wstring getTextRange(size_t startLineIndex, size_t startLineColum, size_t endLineIndex, size_t endLineColumn); // 구간 텍스트
+    // 문서 시작부터의 오프셋 <-> 라인/열 변환 : 트리를 한 번 내려가며 서브트리 크기를 더하므로 O(log n) + 리프 하나
+    // 줄바꿈은 newlineSize 단위로 센다. (getText, getTextRange는 \r\n이므로 2)
+    enum OffsetUnit { Chars, Utf8Bytes }; // 오프셋 단위 : UTF-16 문자, UTF-8 바이트
+    size_t getCharCount(); // 전체 문자 수 (줄바꿈 제외)
+    size_t getUtf8Size(); // 전체 UTF-8 바이트 수 (줄바꿈 제외)
+    size_t offsetFromPos(size_t lineIndex, size_t column, OffsetUnit unit = Chars, size_t newlineSize = 2);
+    void posFromOffset(size_t offset, size_t& lineIndex, size_t& column, OffsetUnit unit = Chars, size_t newlineSize = 2);
+    // 현재 내용의 스냅샷 : O(1)이고, 이후 수정되는 노드만 복사된다. (백그라운드 검색, 저장, 통계용)
+    std::shared_ptr<const RopeSnapshot> snapshot();
+    uint64_t getEditCount() const { return m_editCount; } // 라인 위치나 내용을 바꾼 수정 횟수 (스냅샷으로 계산한 결과가 아직 맞는지 확인용)
+    // since 시점의 라인 번호를 지금 번호로 옮김 : 그 뒤에 내용이 바뀌었거나 지운 라인, 기록이 남아 있지 않은 경우는 false (라인별 캐시를 고친 라인만 버리는 데 사용)
+    bool mapLine(uint64_t since, size_t& lineIndex) const;
+    RopeArenaStats getArenaStats() const { return m_arena.getStats(); } // 아레나 메모리 통계
+    // 차가운 리프 압축 모드 : 최근에 접근한 hotLeaves개(최소 PACK_HOT_MIN) 외의 리프는 압축해 두고 접근할 때 푼다. (0이면 끔)
+    void setColdCompression(size_t hotLeaves);
+    RopePackStats getPackStats() const { return m_packStats; } // 압축 크기와 해제 횟수
+    // 스왑 모드 : 최근 접근한 리프들의 버퍼가 budgetBytes를 넘으면 오래된 리프부터 임시 스왑 파일로 내보내고, 접근하거나 고칠 때 다시 읽는다. (0이면 끔)
+    // 디코딩 전 리프(원본 파일), 긴 라인이나 공유 라인이 있는 리프, 스냅샷과 공유 중인 리프는 내보내지 않는다.
+    void setSwapBudget(size_t budgetBytes);
+    RopeSwapStats getSwapStats() const;
+    // 라인 공유 : 켜면 이후에 넣거나 파일에서 읽는 라인 중 반복되는 라인이 하나의 버퍼를 함께 쓴다. (고치는 라인만 따로 복사)
+    void setLineInterning(bool enable);
+    RopeInternStats getInternStats() const { return m_internStats; } // 공유 버퍼 수, 참조 수, 절약한 바이트
+    // 리프 크기 한도 : 이미 있는 리프는 다음에 고칠 때 새 한도에 맞춰 나누거나 합친다.
+    void setLimits(const RopeLimits& limits);
+    const RopeLimits& getLimits() const { return m_limits; }
+    // 화면 줄 색인 : 라인마다 워드랩으로 늘어난 줄 수를 기록해 두면 서브트리 크기에 함께 합산되어 화면 줄 <-> 라인 변환이 O(log n)
+    // 기록하지 않은 라인과 내용이 바뀐 라인은 한 줄로 센다. 스냅샷은 읽지 않으므로 공유 노드도 그 자리에서 고치고, 라인 뷰와 커서도 무효화하지 않는다.
+    void setLineWraps(size_t lineIndex, size_t wraps); // 라인의 워드랩 줄 수 (화면 줄 수 - 1)
+    void clearWraps(); // 모든 라인의 워드랩 줄 수를 0으로 (줄바꿈 폭이나 폰트가 바뀐 경우)
+    // 백그라운드 워드랩 : 워드랩 줄 수를 다 기록하지 않은 리프들을 리프 경계에 맞춰 maxLines 안팎의 (첫 라인, 라인 수) 구간으로 묶음
+    void getUnwrappedRanges(size_t maxLines, std::vector<std::pair<size_t, size_t>>& ranges);
+    // 스냅샷에서 잰 구간들을 기록하고 통째로 잰 리프는 기록한 것으로 표시 (스냅샷 이후에 고쳐서 복사본으로 바뀐 리프는 건너뜀)
+    size_t setSnapshotWraps(const RopeSnapshot& snap, const std::vector<RopeWrapBlock>& blocks); // 건너뛴 리프 수
+    size_t getRowCount(); // 전체 화면 줄 수
+    size_t rowFromLine(size_t lineIndex); // 라인의 첫 화면 줄 위치
+    size_t lineFromRow(size_t row, size_t& wrapRow); // 화면 줄이 속한 라인과 그 라인 안의 워드랩 줄 위치 (범위 밖이면 마지막 화면 줄)
+};
+
+#ifdef NEMO_ROPE_TESTS
+// 라인 배열 모델과 비교해서 편집, 오프셋 변환, 스냅샷, 긴 라인, 화면 줄 색인, mapLine, 압축/스왑/공유 모드, 파일 로드를 확인 (실패한 항목 출력)
+// MFC 없이 빌드하는 NemoRopeTests 실행 파일이 부른다. (Win32 파일 API와 2바이트 wchar_t가 필요)
+bool RunRopeTests(std::wostream& out);
+#endif
@@ -0,0 +1,39 @@
+﻿// NemoBench 콘솔 프로그램 : 인자가 없으면 전체 항목, "항목 크기"를 주면 그 항목 하나만 잰다.
+// 예) NemoBench.exe MoveLines 4000000
+#include "pch.h"
+#include "NemoEdit.h"
+#include <cwchar>
+#include <cstdlib>
+
+int wmain(int argc, wchar_t* argv[]) {
+    if (!AfxWinInit(::GetModuleHandle(nullptr), nullptr, ::GetCommandLine(), 0)) return 1;
+    if (argc < 2) {
+        NemoBench::Run(std::wcout);
+        return 0;
+    }
+
+    struct Item { const wchar_t* name; void (*run)(std::wostream&, size_t); };
+    static const Item items[] = {
+        { L"ArenaAlloc", NemoBench::ArenaAlloc },
+        { L"ScanNewlines", NemoBench::ScanNewlines },
+        { L"TreeBuild", NemoBench::TreeBuild },
+        { L"FingerAccess", NemoBench::FingerAccess },
+        { L"MoveLines", NemoBench::MoveLines },
+        { L"CutPaste", NemoBench::CutPaste },
+        { L"ColdPack", NemoBench::ColdPack },
+        { L"LimitsSweep", NemoBench::LimitsSweep },
+        { L"MeasureText", NemoBench::MeasureText },
+    };
+    for (const Item& item : items) {
+        if (wcscmp(argv[1], item.name) != 0) continue;
+        if (argc < 3) {
+            std::wcerr << L"usage: NemoBench " << item.name << L" <size>\n";
+            return 1;
+        }
+        item.run(std::wcout, (size_t)_wcstoui64(argv[2], nullptr, 10));
+        return 0;
+    }
+    if (wcscmp(argv[1], L"MeasureTests") == 0) return NemoBench::MeasureTests(std::wcout) ? 0 : 1;
+    std::wcerr << L"unknown item: " << argv[1] << L"\n";
+    return 1;
+}
@@ -0,0 +1,7 @@
+﻿// NemoBench 빌드용 pch.h : NemoEdit.cpp는 프로젝트의 pch.h를 먼저 포함하므로 MFC 헤더만 넣은 것을 둔다.
+#pragma once
+
+#ifndef VC_EXTRALEAN
+#define VC_EXTRALEAN
+#endif
+#include <afxwin.h>
@@ -0,0 +1,12 @@
+﻿// NemoMeasureBench : MFC, DirectWrite 없이 표 측정기로 워드랩과 클릭 컬럼 찾기를 잰다. (인자로 라인 수, 기본 200000)
+// 예) NemoMeasureBench 1000000
+#include "pch.h"
+#include "NemoMeasure.h"
+#include <iostream>
+#include <cstdlib>
+
+int main(int argc, char** argv) {
+    size_t lines = argc > 1 ? (size_t)std::strtoull(argv[1], nullptr, 10) : 200000;
+    RunMeasureBench(std::wcout, lines ? lines : 200000);
+    return 0;
+}
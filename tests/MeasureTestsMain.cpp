@@ -0,0 +1,8 @@
+﻿// NemoMeasureTests : MFC, DirectWrite 없이 표 측정기로 워드랩, 누적 폭, 클릭 컬럼 계산을 확인한다. (실패하면 1)
+#include "pch.h"
+#include "NemoMeasure.h"
+#include <iostream>
+
+int main() {
+    return RunMeasureTests(std::wcout) ? 0 : 1;
+}
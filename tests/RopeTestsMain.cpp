@@ -0,0 +1,8 @@
+﻿// NemoRopeTests : MFC 없이 로프의 편집, 변환, 스냅샷, 압축, 스왑을 라인 배열 모델과 비교해서 확인한다. (실패하면 1)
+#include "pch.h"
+#include "NemoRope.h"
+#include <iostream>
+
+int main() {
+    return RunRopeTests(std::wcout) ? 0 : 1;
+}
@@ -0,0 +1,2 @@
+﻿// MFC 없이 빌드하는 시험용 pch.h : NemoMeasure.cpp, NemoRope.cpp는 프로젝트의 pch.h를 먼저 포함하므로 빈 것을 둔다.
+#pragma once